@@ -74,6 +74,8 @@ void Converter::setWSDL(const WSDL &wsdl)
         cleanupUnusedTypes();
     }
 
+    applyStreamingBinaryElements();
+
     // set the xsd types
     mTypeMap.addSchemaTypes(mWSDL.definitions().type().types(), Settings::self()->nameSpace());
 
@@ -420,3 +422,40 @@ KODE::Code Converter::serializePart(const Part &part, const QString &localVariab
     serializer.setOptional(false); // Don't omit entire parts, this especially breaks the wrappers for RPC messages
     return serializer.generateSerializationCode();
 }
+
+void Converter::applyStreamingBinaryElements()
+{
+    // Give the base64Binary elements selected with -streaming-binary their own type, mapped to KDSoapAttachment by the TypeMap
+    const Settings *settings = Settings::self();
+    if (settings->streamingBinaryElements().isEmpty()) {
+        return;
+    }
+    const QName base64Binary(XMLSchemaURI, QStringLiteral("base64Binary"));
+    auto adaptElements = [&](XSD::Element::List &elements) {
+        for (XSD::Element &element : elements) {
+            if (element.type() == base64Binary && settings->isStreamingBinaryElement(element.name())) {
+                element.setType(TypeMap::streamingBinaryType());
+            }
+        }
+    };
+
+    Definitions definitions = mWSDL.definitions();
+    Type type = definitions.type();
+    XSD::Types types = type.types();
+
+    XSD::Element::List elements = types.elements();
+    adaptElements(elements);
+    types.setElements(elements);
+
+    XSD::ComplexType::List complexTypes = types.complexTypes();
+    for (XSD::ComplexType &complexType : complexTypes) {
+        XSD::Element::List complexTypeElements = complexType.elements();
+        adaptElements(complexTypeElements);
+        complexType.setElements(complexTypeElements);
+    }
+    types.setComplexTypes(complexTypes);
+
+    type.setTypes(types);
+    definitions.setType(type);
+    mWSDL.setDefinitions(definitions);
+}
@@ -56,10 +56,13 @@ public:
 
 private:
     void cleanupUnusedTypes();
+    void applyStreamingBinaryElements();
     void convertTypes();
 
     void convertComplexType(const XSD::ComplexType *);
     void createComplexTypeSerializer(KODE::Class &, const XSD::ComplexType *);
+    void createComplexTypeXmlStreamDeserializer(KODE::Class &, const XSD::ComplexType *);
+    void createComplexTypeXmlStreamSerializer(KODE::Class &, const XSD::ComplexType *);
 
     void convertSimpleType(const XSD::SimpleType *, const XSD::SimpleType::List &simpleTypeList);
     void createSimpleTypeSerializer(KODE::Class &, const XSD::SimpleType *, const XSD::SimpleType::List &simpleTypeList);
@@ -91,6 +94,7 @@ private:
     QString listTypeFor(const QString &itemTypeName, KODE::Class &newClass);
     KODE::Code deserializeRetVal(const KWSDL::Part &part, const QString &replyMsgName, const QString &qtRetType, const QString &varName) const;
     QName elementNameForPart(const Part &part, bool *qualified, bool *nillable) const;
+    bool canWriteMessageDirectly(const Binding &binding, const Part &part, const Operation &operation) const;
     bool isQualifiedPart(const Part &part) const;
 
     // Server Stub
@@ -295,6 +295,14 @@ bool Converter::convertClientService()
                 } else {
                     code += "d_ptr->m_clientInterface->setSoapVersion( KDSoapClientInterface::SOAP1_1 );";
                 }
+                const Operation::List operations = mWSDL.findPortType(binding.portTypeName()).operations();
+                for (const Operation &operation : operations) {
+                    if (operation.operationType() == Operation::RequestResponseOperation
+                        && Settings::self()->isIdempotentOperation(operation.name())) {
+                        code += QLatin1String("d_ptr->m_clientInterface->setRetryPolicy(QLatin1String(\"") + operation.name()
+                            + QLatin1String("\"), KDSoapRetryPolicy::idempotentPolicy());");
+                    }
+                }
                 code.unindent();
                 code += "}";
                 code += "return d_ptr->m_clientInterface;";
@@ -471,10 +479,29 @@ bool Converter::convertClientService()
                     slot.addArgument(QLatin1String("KDSoapPendingCallWatcher* watcher"));
                     KODE::Code slotCode;
                     slotCode += QLatin1String("watcher->deleteLater();");
-                    slotCode += QLatin1String("KDSoapMessage _reply = watcher->returnMessage();");
-                    const Part::List outputParts = selectedParts(binding, outputMsg, operation, false /*input*/);
+                    Part::List outputParts = selectedParts(binding, outputMsg, operation, false /*input*/);
                     const SoapBinding::Headers outputHeaders = getOutputHeaders(binding, operationName);
 
+                    const bool streamDeserializer = Settings::self()->generateXmlStreamDeserializers()
+                        && soapStyle(binding) == SoapBinding::DocumentStyle && outputParts.count() == 1
+                        && mTypeMap.isComplexType(outputParts.first().type(), outputParts.first().element())
+                        && !mTypeMap.isPolymorphic(outputParts.first().type(), outputParts.first().element());
+                    if (streamDeserializer) {
+                        // Fill the result directly from the XML stream, there's no need for a KDSoapMessage.
+                        // MTOM replies are parsed into a KDSoapMessage anyway, see below
+                        const Part &part = outputParts.first();
+                        const QString varName = mNameMapper.escape(QLatin1String("result") + upperlize(part.name()));
+                        const KODE::MemberVariable member(varName, QString());
+                        const QString partType = mTypeMap.localType(part.type(), part.element());
+                        slotCode += QLatin1String("const bool _streamed = watcher->readReturnMessage([this](QXmlStreamReader& reader) {") + COMMENT;
+                        slotCode.indent();
+                        slotCode += member.name() + QLatin1String(" = ") + partType + QLatin1String("();") + COMMENT;
+                        slotCode += member.name() + QLatin1String(".deserialize(reader);");
+                        slotCode.unindent();
+                        slotCode += QLatin1String("});");
+                    }
+                    slotCode += QLatin1String("KDSoapMessage _reply = watcher->returnMessage();");
+
                     if (!outputParts.isEmpty() || !outputHeaders.isEmpty()) {
                         slotCode += QLatin1String("if (!_reply.isFault()) {") + COMMENT;
                         slotCode.indent();
@@ -497,8 +524,16 @@ bool Converter::convertClientService()
                             for (const Part &part : qAsConst(outputParts)) {
                                 const QString varName = mNameMapper.escape(QLatin1String("result") + upperlize(part.name()));
                                 const KODE::MemberVariable member(varName, QString());
+                                if (streamDeserializer) {
+                                    slotCode += QLatin1String("if (!_streamed) {") + COMMENT;
+                                    slotCode.indent();
+                                }
                                 slotCode.addBlock(
                                     deserializeRetVal(part, QLatin1String("_reply"), mTypeMap.localType(part.type(), part.element()), member.name()));
+                                if (streamDeserializer) {
+                                    slotCode.unindent();
+                                    slotCode += QLatin1String("}");
+                                }
 
                                 addJobResultMember(jobClass, part, varName, inputGetters);
                             }
@@ -608,6 +643,23 @@ QName Converter::elementNameForPart(const Part &part, bool *qualified, bool *nil
     }
 }
 
+// With -xml-stream-serializers, a document/literal request made of a single complex element
+// is written by the generated writeXml() method rather than via KDSoapValue
+bool Converter::canWriteMessageDirectly(const Binding &binding, const Part &part, const Operation &operation) const
+{
+    if (!Settings::self()->generateXmlStreamSerializers() || binding.type() != Binding::SOAPBinding) {
+        return false;
+    }
+    const SoapBinding::Operation op = binding.soapBinding().operations().value(operation.name());
+    if (op.input().use() != SoapBinding::LiteralUse || soapStyle(binding) != SoapBinding::DocumentStyle) {
+        return false;
+    }
+    bool qualified, nillable;
+    elementNameForPart(part, &qualified, &nillable);
+    return !nillable && part.type().isEmpty() && mTypeMap.isComplexType(part.type(), part.element())
+        && !mTypeMap.isPolymorphic(part.type(), part.element());
+}
+
 void Converter::addMessageArgument(KODE::Code &code, const SoapBinding::Style &bindingStyle, const Part &part, const QString &localVariableName,
                                    const QByteArray &messageName, bool varIsMember)
 {
@@ -648,7 +700,28 @@ void Converter::clientGenerateMessage(KODE::Code &code, const Binding &binding,
 
     bool isBuiltin = false;
 
-    for (const Part &part : selectedParts(binding, message, operation, true /*input*/)) {
+    const Part::List parts = selectedParts(binding, message, operation, true /*input*/);
+    if (parts.count() == 1 && canWriteMessageDirectly(binding, parts.first(), operation)) {
+        // Let the message writer call writeXml() on the complex type, instead of building KDSoapValues
+        const Part &part = parts.first();
+        const QString partname = varsAreMembers ? KODE::MemberVariable::memberVariableName(part.name()) : mNameMapper.escape(lowerlize(part.name()));
+        bool qualified, nillable;
+        const QName elemName = elementNameForPart(part, &qualified, &nillable);
+        code += QLatin1String("const ") + mTypeMap.localType(part.type(), part.element()) + QLatin1String(" _contents(") + partname + QLatin1String(");");
+        code += QLatin1String("message = KDSoapValue(QStringLiteral(\"") + elemName.localName() + QLatin1String("\"), QVariant());");
+        code += QLatin1String("message.setNamespaceUri(QStringLiteral(\"") + elemName.nameSpace() + QLatin1String("\"));");
+        if (qualified) {
+            code += QLatin1String("message.setQualified(true);");
+        }
+        code += QLatin1String("message.setContentsWriter([_contents](QXmlStreamWriter& writer, const QString& messageNamespace) {");
+        code.indent();
+        code += QLatin1String("_contents.writeXml(writer, messageNamespace);");
+        code.unindent();
+        code += QLatin1String("});");
+        return;
+    }
+
+    for (const Part &part : parts) {
         isBuiltin = isBuiltin || mTypeMap.isBuiltinType(part.type(), part.element());
         addMessageArgument(code, soapStyle(binding), part, part.name(), "message", varsAreMembers);
     }
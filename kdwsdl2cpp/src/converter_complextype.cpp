@@ -10,6 +10,7 @@
 #include <code_generation/style.h>
 
 #include <QDebug>
+#include <QSet>
 
 using namespace KWSDL;
 
@@ -490,6 +491,30 @@ static KODE::Code demarshalNameTest(const QName &type, const QString &tagName, b
     return demarshalCode;
 }
 
+// Types with at least this many elements look up their children through KDSoapValueList::childIndexes()
+// rather than comparing every child against every element name.
+static const int s_wideTypeElementCount = 16;
+
+// Helper method for the generation of the deserialize() method
+static bool useIndexedLookup(const XSD::Element::List &elements)
+{
+    if (elements.count() < s_wideTypeElementCount) {
+        return false;
+    }
+    QSet<QString> names;
+    for (const XSD::Element &elem : elements) {
+        const QName type = elem.type();
+        if (type.nameSpace() == XMLSchemaURI && type.localName() == QLatin1String("any")) {
+            return false; // the catch-all needs to see every child
+        }
+        if (names.contains(elem.name())) {
+            return false; // the first matching element wins, keep the if/else chain
+        }
+        names.insert(elem.name());
+    }
+    return true;
+}
+
 void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::ComplexType *type)
 {
     newClass.addInclude(QLatin1String("KDSoapClient/KDSoapNamespaceManager.h"));
@@ -567,14 +592,30 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
         demarshalCode += QLatin1String("const KDSoapValueList& args = mainValue.childValues();") + COMMENT;
     }
 
+    const bool indexedLookup = !type->isArray() && useIndexedLookup(elements);
+    // Arrays of numbers are converted all at once, see KDSoapValueList::toDoubleArray()
+    const bool numericArray = type->isArray() && elements.count() == 1 && !mTypeMap.numericArrayItemType(type->arrayType()).isEmpty();
+
     if (!elements.isEmpty()) {
         marshalCode += QLatin1String("KDSoapValueList& args = mainValue.childValues();") + COMMENT;
         if (elements.at(0).isQualified()) {
             marshalCode += QLatin1String("mainValue.setQualified(true);") + COMMENT;
         }
-        demarshalCode += "for (const KDSoapValue& val : qAsConst(args)) {";
-        demarshalCode.indent();
-        demarshalCode += "const QString _name = val.name();";
+        if (numericArray) {
+            const XSD::Element elem = elements.first();
+            ElementArgumentSerializer deserializer(mTypeMap, type->arrayType(), QName(),
+                                                   QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elem.name()),
+                                                   QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elem.name() + "_nil"));
+            deserializer.setOptional(isElementOptional(elem));
+            demarshalCode.addBlock(deserializer.demarshalNumericArray(QStringLiteral("args")));
+            demarshalCode += "if (!_numbersOk) {";
+            demarshalCode.indent();
+        }
+        if (!indexedLookup) {
+            demarshalCode += "for (const KDSoapValue& val : qAsConst(args)) {";
+            demarshalCode.indent();
+            demarshalCode += "const QString _name = val.name();";
+        }
     } else {
         // The Q_UNUSED is not necessarily true in case of attributes, but who cares.
         demarshalCode += QLatin1String("Q_UNUSED(mainValue);") + COMMENT;
@@ -624,8 +665,17 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
             const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elemName);
             const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elemName + "_nil");
 
-            demarshalCode.addBlock(demarshalNameTest(elem.type(), elemName, &first));
-            demarshalCode.indent();
+            if (indexedLookup) {
+                demarshalCode += QLatin1String("{") + COMMENT;
+                demarshalCode.indent();
+                demarshalCode += QLatin1String("const QVector<int> _indexes = args.childIndexes(QStringLiteral(\"") + elemName + QLatin1String("\"));");
+                demarshalCode += "for (int _index : _indexes) {";
+                demarshalCode.indent();
+                demarshalCode += "const KDSoapValue& val = args.at(_index);";
+            } else {
+                demarshalCode.addBlock(demarshalNameTest(elem.type(), elemName, &first));
+                demarshalCode.indent();
+            }
 
             ElementArgumentSerializer serializer(mTypeMap, elem.type(), QName(), variableName, nilVariableName);
             serializer.setOutputVariable("args", true);
@@ -675,10 +725,18 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
 
             demarshalCode.unindent();
             demarshalCode += "}";
+            if (indexedLookup) {
+                demarshalCode.unindent();
+                demarshalCode += "}";
+            }
         } // end: for each element
     }
 
-    if (!elements.isEmpty()) {
+    if (!elements.isEmpty() && !indexedLookup) {
+        demarshalCode.unindent();
+        demarshalCode += "}";
+    }
+    if (numericArray) {
         demarshalCode.unindent();
         demarshalCode += "}";
     }
@@ -730,4 +788,243 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
 
     deserializeFunc.setBody(demarshalCode);
     newClass.addFunction(deserializeFunc);
+
+    if (Settings::self()->generateXmlStreamDeserializers()) {
+        createComplexTypeXmlStreamDeserializer(newClass, type);
+    }
+    if (Settings::self()->generateXmlStreamSerializers()) {
+        createComplexTypeXmlStreamSerializer(newClass, type);
+    }
+}
+
+// Generates writeXml(QXmlStreamWriter&, const QString&), which writes the contents of the element
+// directly into the XML, without building a KDSoapValue tree first. Called by createComplexTypeSerializer.
+void Converter::createComplexTypeXmlStreamSerializer(KODE::Class &newClass, const XSD::ComplexType *type)
+{
+    newClass.addHeaderInclude(QLatin1String("QtCore/QXmlStreamWriter"));
+
+    KODE::Function writeFunc(QLatin1String("writeXml"), QLatin1String("void"));
+    writeFunc.addArgument(QLatin1String("QXmlStreamWriter& writer"));
+    writeFunc.addArgument(QLatin1String("const QString& messageNamespace"));
+    if (!type->derivedTypes().isEmpty()) {
+        writeFunc.setVirtualMode(KODE::Function::Virtual);
+    }
+    if (!newClass.baseClasses().isEmpty()) {
+        writeFunc.setVirtualMode(KODE::Function::Override);
+    }
+    writeFunc.setConst(true);
+    writeFunc.setDocs(QLatin1String("Writes the attributes and child elements of this object into \\p writer, in literal use."));
+
+    KODE::Code marshalCode;
+
+    const XSD::Attribute::List attributes = type->attributes();
+    bool directAttributes = true;
+    for (const XSD::Attribute &attribute : attributes) {
+        const QString typeName = mTypeMap.localTypeForAttribute(attribute.type());
+        if (!attribute.name().isEmpty() && mTypeMap.serializeBuiltinText(attribute.type(), QName(), QString(), typeName).isEmpty()) {
+            directAttributes = false;
+        }
+    }
+
+    if ((type->baseTypeName() != XmlAnyType && !type->baseTypeName().isEmpty()) || type->isArray() || !directAttributes) {
+        // Derived types, simple contents, soap-enc arrays and non-builtin attributes: not worth a separate code path
+        marshalCode += QLatin1String("serialize(QString()).writeXmlContents(writer, messageNamespace);") + COMMENT;
+        writeFunc.setBody(marshalCode);
+        newClass.addFunction(writeFunc);
+        return;
+    }
+
+    for (const XSD::Attribute &attribute : attributes) {
+        const QString attrName = attribute.name();
+        if (attrName.isEmpty()) {
+            continue;
+        }
+        const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(attrName);
+        const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(attrName + "_nil");
+        const QString text = mTypeMap.serializeBuiltinText(attribute.type(), QName(), variableName, mTypeMap.localTypeForAttribute(attribute.type()));
+        const bool optional = attribute.attributeUse() == XSD::Attribute::Optional || attribute.attributeUse() == XSD::Attribute::Prohibited;
+        if (optional) {
+            marshalCode += QLatin1String("if (!") + nilVariableName + QLatin1String(") {");
+            marshalCode.indent();
+        }
+        if (attribute.isQualified()) {
+            marshalCode += QLatin1String("writer.writeAttribute(QStringLiteral(\"") + attribute.nameSpace() + QLatin1String("\"), QStringLiteral(\"")
+                + attrName + QLatin1String("\"), ") + text + QLatin1String(");") + COMMENT;
+        } else {
+            marshalCode += QLatin1String("writer.writeAttribute(QStringLiteral(\"") + attrName + QLatin1String("\"), ") + text + QLatin1String(");") + COMMENT;
+        }
+        if (optional) {
+            marshalCode.unindent();
+            marshalCode += "}";
+        }
+    }
+
+    const XSD::Element::List elements = type->elements();
+    for (const XSD::Element &elem : elements) {
+        const QString typeName = mTypeMap.localType(elem.type());
+        if (typeName == QLatin1String("void")) {
+            continue;
+        }
+        const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elem.name());
+        const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elem.name() + "_nil");
+        const QName qualName = elem.qualifiedName();
+
+        ElementArgumentSerializer serializer(mTypeMap, elem.type(), QName(), variableName, nilVariableName);
+        serializer.setIsQualified(elem.isQualified());
+        if (elem.maxOccurs() > 1 || elem.compositor().maxOccurs() > 1) {
+            const QString localVariableName = variableName + QLatin1String(".at(i)");
+            marshalCode += QLatin1String("for (int i = 0; i < ") + variableName + QLatin1String(".count(); ++i) {") + COMMENT;
+            marshalCode.indent();
+            serializer.setLocalVariableName(localVariableName);
+            if (elem.hasSubstitutions()) {
+                serializer.setDynamicElementName(localVariableName + "->_kd_substitutionElementName()",
+                                                 localVariableName + "->_kd_substitutionElementNameSpace()", qualName);
+            } else {
+                serializer.setElementName(qualName);
+            }
+            marshalCode.addBlock(serializer.generateXmlWriterCode(QLatin1String("writer")));
+            marshalCode.unindent();
+            marshalCode += '}';
+        } else {
+            if (elem.hasSubstitutions()) {
+                serializer.setDynamicElementName(variableName + "->_kd_substitutionElementName()", variableName + "->_kd_substitutionElementNameSpace()",
+                                                 qualName);
+            } else {
+                serializer.setElementName(qualName);
+            }
+            serializer.setOptional(isElementOptional(elem));
+            serializer.setUsePointer(usePointerForElement(elem, newClass, mTypeMap, false));
+            serializer.setNillable(elem.nillable());
+            marshalCode.addBlock(serializer.generateXmlWriterCode(QLatin1String("writer")));
+        }
+    }
+
+    if (attributes.isEmpty() && elements.isEmpty()) {
+        marshalCode += QLatin1String("Q_UNUSED(writer);");
+        marshalCode += QLatin1String("Q_UNUSED(messageNamespace);");
+    }
+
+    writeFunc.setBody(marshalCode);
+    newClass.addFunction(writeFunc);
+}
+
+// Generates deserialize(QXmlStreamReader&), which fills the members directly from the XML stream,
+// without building a KDSoapValue tree first. Called by createComplexTypeSerializer.
+void Converter::createComplexTypeXmlStreamDeserializer(KODE::Class &newClass, const XSD::ComplexType *type)
+{
+    newClass.addHeaderInclude(QLatin1String("QtCore/QXmlStreamReader"));
+
+    KODE::Function deserializeFunc(QLatin1String("deserialize"), QLatin1String("void"));
+    deserializeFunc.addArgument(QLatin1String("QXmlStreamReader& reader"));
+    if (!type->derivedTypes().isEmpty()) {
+        deserializeFunc.setVirtualMode(KODE::Function::Virtual);
+    }
+    if (!newClass.baseClasses().isEmpty()) {
+        deserializeFunc.setVirtualMode(KODE::Function::Override);
+    }
+    deserializeFunc.setDocs(QLatin1String("Fills this object from the element \\p reader is positioned on, up to its end element."));
+
+    KODE::Code demarshalCode;
+
+    if ((type->baseTypeName() != XmlAnyType && !type->baseTypeName().isEmpty()) || type->isArray()) {
+        // Derived types, simple contents and soap-enc arrays: not worth a separate code path
+        demarshalCode += QLatin1String("deserialize(KDSoapValue::fromXml(reader));") + COMMENT;
+        deserializeFunc.setBody(demarshalCode);
+        newClass.addFunction(deserializeFunc);
+        return;
+    }
+
+    const XSD::Attribute::List attributes = type->attributes();
+    if (!attributes.isEmpty()) {
+        demarshalCode += "const QXmlStreamAttributes attributes = reader.attributes();";
+        demarshalCode += "for (const QXmlStreamAttribute& attribute : attributes) {";
+        demarshalCode.indent();
+        // Attributes are cheap, reuse the KDSoapValue-based code for them
+        demarshalCode += "const KDSoapValue val(attribute.name().toString(), attribute.value().toString());";
+        demarshalCode += "const QString _name = val.name();";
+
+        bool first = true;
+        for (const XSD::Attribute &attribute : qAsConst(attributes)) {
+            const QString attrName = attribute.name();
+            if (attrName.isEmpty()) {
+                continue;
+            }
+            const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(attrName);
+            const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(attrName + "_nil");
+
+            demarshalCode.addBlock(demarshalNameTest(attribute.type(), attrName, &first));
+            demarshalCode.indent();
+
+            ElementArgumentSerializer serializer(mTypeMap, attribute.type(), QName(), variableName, nilVariableName);
+            serializer.setOptional(attribute.attributeUse() == XSD::Attribute::Optional || attribute.attributeUse() == XSD::Attribute::Prohibited);
+            demarshalCode.addBlock(serializer.demarshalVariable("val"));
+
+            demarshalCode.unindent();
+            demarshalCode += "}";
+        }
+
+        demarshalCode.unindent();
+        demarshalCode += "}";
+    }
+
+    demarshalCode += "while (reader.readNextStartElement()) {";
+    demarshalCode.indent();
+
+    // remove "void" elements, as in createComplexTypeSerializer
+    XSD::Element::List elements = type->elements();
+    QMutableListIterator<XSD::Element> itElem(elements);
+    bool testsNames = false;
+    while (itElem.hasNext()) {
+        const XSD::Element &elem = itElem.next();
+        if (mTypeMap.localType(elem.type()) == QLatin1String("void")) {
+            itElem.remove();
+        } else if (!mTypeMap.isTypeAny(elem.type())) {
+            testsNames = true;
+        }
+    }
+    if (testsNames) {
+        demarshalCode += "const auto _name = reader.name();";
+    }
+
+    bool first = true;
+    bool hasCatchAll = false;
+    for (const XSD::Element &elem : qAsConst(elements)) {
+        const QString elemName = elem.name();
+        const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elemName);
+        const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elemName + "_nil");
+
+        hasCatchAll = hasCatchAll || mTypeMap.isTypeAny(elem.type());
+        demarshalCode.addBlock(demarshalNameTest(elem.type(), elemName, &first));
+        demarshalCode.indent();
+
+        ElementArgumentSerializer deserializer(mTypeMap, elem.type(), QName(), variableName, nilVariableName);
+        deserializer.setOptional(isElementOptional(elem));
+        if (elem.maxOccurs() > 1 || elem.compositor().maxOccurs() > 1) {
+            demarshalCode.addBlock(deserializer.demarshalArrayItemFromXml("reader"));
+        } else {
+            deserializer.setUsePointer(usePointerForElement(elem, newClass, mTypeMap, false));
+            demarshalCode.addBlock(deserializer.demarshalVariableFromXml("reader"));
+        }
+
+        demarshalCode.unindent();
+        demarshalCode += "}";
+    }
+
+    if (!hasCatchAll) {
+        if (first) {
+            demarshalCode += "reader.skipCurrentElement();";
+        } else {
+            demarshalCode += "else {";
+            demarshalCode.indent();
+            demarshalCode += "reader.skipCurrentElement();";
+            demarshalCode.unindent();
+            demarshalCode += "}";
+        }
+    }
+
+    demarshalCode.unindent();
+    demarshalCode += "}";
+
+    deserializeFunc.setBody(demarshalCode);
+    newClass.addFunction(deserializeFunc);
 }
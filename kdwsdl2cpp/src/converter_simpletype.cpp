@@ -5,6 +5,7 @@
 */
 
 #include "converter.h"
+#include "elementargumentserializer.h"
 #include "settings.h"
 #include <code_generation/style.h>
 
@@ -428,6 +429,14 @@ void Converter::createSimpleTypeSerializer(KODE::Class &newClass, const XSD::Sim
             newClass.addHeaderInclude("QtCore/QStringList");
             KODE::Code code;
             code += "if (mainValue.value().toString().trimmed().isEmpty()) return;";
+            // Lists of numbers are parsed in one pass, see KDSoapValue::toDoubleArray()
+            const bool numericList = !mTypeMap.numericArrayItemType(baseName).isEmpty();
+            if (numericList) {
+                const ElementArgumentSerializer deserializer(mTypeMap, baseName, QName(), variableName, QString());
+                code.addBlock(deserializer.demarshalNumericArray(QStringLiteral("mainValue")));
+                code += "if (!_numbersOk) {";
+                code.indent();
+            }
             code += "const KDSoapValueList list = mainValue.split();";
             code += "for (int i = 0; i < list.count(); ++i) {";
             code.indent();
@@ -444,6 +453,10 @@ void Converter::createSimpleTypeSerializer(KODE::Class &newClass, const XSD::Sim
             code += variableName + ".append(" + val + ");";
             code.unindent();
             code += "}";
+            if (numericList) {
+                code.unindent();
+                code += "}";
+            }
             deserializeFunc.setBody(code);
         }
     } break;
@@ -35,6 +35,8 @@ void ElementArgumentSerializer::setElementName(const QName &name)
 {
     mNameArg = QLatin1String("QString::fromLatin1(\"") + name.localName() + QLatin1String("\")");
     mNameNamespace = namespaceString(name.nameSpace());
+    mNameLocalName = name.localName();
+    mNameNamespaceUri = name.nameSpace();
     mValueVarName = QLatin1String("_value") + upperlize(KODE::Style::makeIdentifier(name.localName()));
 }
 
@@ -42,6 +44,8 @@ void ElementArgumentSerializer::setDynamicElementName(const QString &codeLocalNa
 {
     mNameArg = codeLocalName;
     mNameNamespace = codeNamespace;
+    mNameLocalName.clear();
+    mNameNamespaceUri.clear();
     mValueVarName = QLatin1String("_value") + upperlize(KODE::Style::makeIdentifier(baseName.localName()));
 }
 
@@ -91,44 +95,12 @@ KODE::Code ElementArgumentSerializer::generateSerializationCode() const
         block.unindent();
         block += "}";
     } else {
-        const QName actualType = mType.isEmpty() ? mElementType : mType;
-        // UNUSED const QString typeArgs = namespaceString(actualType.nameSpace()) + QLatin1String(", QString::fromLatin1(\"") +
-        // actualType.localName() + QLatin1String("\")");
-        const bool isComplex = mTypeMap.isComplexType(mType, mElementType);
-        const bool isPolymorphic = mTypeMap.isPolymorphic(mType, mElementType);
-
         if (mAppend && mOptional) {
-            if (mUsePointer) {
-                block += "if (" + mLocalVarName + ") {";
-            } else {
-                block += "if (!" + mNilLocalVarName + ") {" + COMMENT;
-            }
+            block += optionalTest();
             block.indent();
         }
 
-        if (isComplex) {
-            const QString op = (isPolymorphic || mUsePointer) ? "->" : ".";
-            block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1Char('(') + mLocalVarName + op + QLatin1String("serialize(") + mNameArg
-                + QLatin1String("));") + COMMENT;
-        } else {
-            if (mTypeMap.isBuiltinType(mType, mElementType)) {
-                const QString value =
-                    mTypeMap.serializeBuiltin(mType, mElementType, mLocalVarName, mNameArg, actualType.nameSpace(), actualType.localName());
-                block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1String(" = ") + value + QLatin1String(";") + COMMENT;
-            } else {
-                block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1String(" = ") + mLocalVarName + QLatin1String(".serialize(")
-                    + mNameArg + QLatin1String(");") + COMMENT;
-            }
-        }
-        if (!mNameNamespace.isEmpty()) {
-            block += mValueVarName + QLatin1String(".setNamespaceUri(") + mNameNamespace + QLatin1String(");");
-        }
-        if (mIsQualified) {
-            block += mValueVarName + QLatin1String(".setQualified(true);");
-        }
-        if (mNillable) {
-            block += mValueVarName + QLatin1String(".setNillable(true);");
-        }
+        block.addBlock(generateValueCode());
         block += varAndMethodBefore + mValueVarName + varAndMethodAfter + QLatin1String(";") + COMMENT;
 
         if (mAppend && mOptional) {
@@ -139,6 +111,107 @@ KODE::Code ElementArgumentSerializer::generateSerializationCode() const
     return block;
 }
 
+KODE::Code ElementArgumentSerializer::generateXmlWriterCode(const QString &writerVarName) const
+{
+    Q_ASSERT(!mLocalVarName.isEmpty());
+    const QString writeArgs = writerVarName + QLatin1String(", messageNamespace");
+
+    KODE::Code block;
+    if (mTypeMap.isTypeAny(mType)) {
+        block += QLatin1String("if (!") + mLocalVarName + QLatin1String(".isNull()) {");
+        block.indent();
+        block += mLocalVarName + QLatin1String(".writeXml(") + writeArgs + QLatin1String(");") + COMMENT;
+        block.unindent();
+        block += "}";
+        return block;
+    }
+
+    if (mOptional) {
+        block += optionalTest();
+        block.indent();
+    }
+
+    const QString qtTypeName = mTypeMap.localType(mType, mElementType);
+    // base64Binary goes through KDSoapValue, which writes an xop:Include instead of the text when MTOM is enabled
+    const QString builtinText = mTypeMap.isBuiltinType(mType, mElementType) && !mTypeMap.isBase64Binary(mType, mElementType)
+        ? mTypeMap.serializeBuiltinText(mType, mElementType, mLocalVarName, qtTypeName)
+        : QString();
+    const bool isComplex = mTypeMap.isComplexType(mType, mElementType);
+    const bool isPolymorphic = mTypeMap.isPolymorphic(mType, mElementType);
+    // Element name, namespace and qualification, as used by KDSoapValue::writeXml
+    const QString nameSpaceArg =
+        mNameNamespaceUri.isEmpty() ? QString::fromLatin1("QString()") : QLatin1String("QStringLiteral(\"") + mNameNamespaceUri + QLatin1String("\")");
+    const QString elementArgs =
+        nameSpaceArg + QLatin1String(", QStringLiteral(\"") + mNameLocalName + QLatin1String("\"), ") + QLatin1String(mIsQualified ? "true" : "false");
+
+    if (mNameLocalName.isEmpty() || mNillable) {
+        // Substitution groups and xsi:nil: go through a KDSoapValue
+        block.addBlock(generateValueCode());
+        block += mValueVarName + QLatin1String(".writeXml(") + writeArgs + QLatin1String(");") + COMMENT;
+    } else if (!builtinText.isEmpty()) {
+        block += QLatin1String("KDSoapValue::writeXmlElement(") + writerVarName + QLatin1String(", ") + elementArgs
+            + QLatin1String(", messageNamespace, ") + builtinText + QLatin1String(");") + COMMENT;
+    } else if (isComplex && !isPolymorphic && !mUsePointer) {
+        block += QLatin1String("KDSoapValue::writeXmlStartElement(") + writerVarName + QLatin1String(", ") + elementArgs
+            + QLatin1String(", messageNamespace);") + COMMENT;
+        block += mLocalVarName + QLatin1String(".writeXml(") + writeArgs + QLatin1String(");");
+        block += writerVarName + QLatin1String(".writeEndElement();");
+    } else {
+        block.addBlock(generateValueCode());
+        block += mValueVarName + QLatin1String(".writeXml(") + writeArgs + QLatin1String(");") + COMMENT;
+    }
+
+    if (mOptional) {
+        block.unindent();
+        block += "}";
+    }
+    return block;
+}
+
+QString ElementArgumentSerializer::optionalTest() const
+{
+    if (mUsePointer) {
+        return "if (" + mLocalVarName + ") {";
+    } else {
+        return "if (!" + mNilLocalVarName + ") {" + COMMENT;
+    }
+}
+
+KODE::Code ElementArgumentSerializer::generateValueCode() const
+{
+    KODE::Code block;
+    const QName actualType = mType.isEmpty() ? mElementType : mType;
+    // UNUSED const QString typeArgs = namespaceString(actualType.nameSpace()) + QLatin1String(", QString::fromLatin1(\"") +
+    // actualType.localName() + QLatin1String("\")");
+    const bool isComplex = mTypeMap.isComplexType(mType, mElementType);
+    const bool isPolymorphic = mTypeMap.isPolymorphic(mType, mElementType);
+
+    if (isComplex) {
+        const QString op = (isPolymorphic || mUsePointer) ? "->" : ".";
+        block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1Char('(') + mLocalVarName + op + QLatin1String("serialize(") + mNameArg
+            + QLatin1String("));") + COMMENT;
+    } else {
+        if (mTypeMap.isBuiltinType(mType, mElementType)) {
+            const QString value =
+                mTypeMap.serializeBuiltin(mType, mElementType, mLocalVarName, mNameArg, actualType.nameSpace(), actualType.localName());
+            block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1String(" = ") + value + QLatin1String(";") + COMMENT;
+        } else {
+            block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1String(" = ") + mLocalVarName + QLatin1String(".serialize(")
+                + mNameArg + QLatin1String(");") + COMMENT;
+        }
+    }
+    if (!mNameNamespace.isEmpty()) {
+        block += mValueVarName + QLatin1String(".setNamespaceUri(") + mNameNamespace + QLatin1String(");");
+    }
+    if (mIsQualified) {
+        block += mValueVarName + QLatin1String(".setQualified(true);");
+    }
+    if (mNillable) {
+        block += mValueVarName + QLatin1String(".setNillable(true);");
+    }
+    return block;
+}
+
 QString ElementArgumentSerializer::pointerStorageType(const QString &typeName)
 {
     if (typeName == "QString" || typeName == "bool") {
@@ -184,6 +257,79 @@ KODE::Code ElementArgumentSerializer::demarshalArray(const QString &soapValueVar
     return code;
 }
 
+// Returns the condition under which "_number" (of type numberType) doesn't fit into qtTypeName,
+// or an empty string if it always does
+static QString numberOutOfRange(const QString &numberType, const QString &qtTypeName)
+{
+    if (qtTypeName == numberType) {
+        return QString();
+    }
+    if (qtTypeName == QLatin1String("int")) {
+        return QStringLiteral("_number < -2147483647 - 1 || _number > 2147483647");
+    }
+    if (qtTypeName == QLatin1String("unsigned int")) {
+        return QStringLiteral("_number < 0 || _number > Q_INT64_C(4294967295)");
+    }
+    if (qtTypeName == QLatin1String("signed char")) {
+        return QStringLiteral("_number < -128 || _number > 127");
+    }
+    if (qtTypeName == QLatin1String("unsigned char")) {
+        return QStringLiteral("_number < 0 || _number > 255");
+    }
+    if (qtTypeName == QLatin1String("quint64")) {
+        return QStringLiteral("_number < 0");
+    }
+    if (qtTypeName == QLatin1String("float")) {
+        return QStringLiteral("_number < -3.40282347e+38 || _number > 3.40282347e+38");
+    }
+    Q_ASSERT_X(false, "numberOutOfRange", qPrintable(qtTypeName));
+    return QString();
+}
+
+KODE::Code ElementArgumentSerializer::demarshalNumericArray(const QString &sourceVarName) const
+{
+    KODE::Code code;
+    const QString numberType = mTypeMap.numericArrayItemType(mType);
+    Q_ASSERT(!numberType.isEmpty());
+    const QString qtTypeName = mTypeMap.localType(mType, mElementType);
+    const QString function = numberType == QLatin1String("double") ? QStringLiteral("toDoubleArray") : QStringLiteral("toInt64Array");
+    const QString number = qtTypeName == numberType ? QStringLiteral("_number") : QLatin1String("static_cast<") + qtTypeName + QLatin1String(">(_number)");
+    code += QLatin1String("bool _numbersOk = false;");
+    code += QLatin1String("const QVector<") + numberType + QLatin1String("> _numbers = ") + sourceVarName + QLatin1Char('.') + function
+        + QLatin1String("(&_numbersOk);") + COMMENT;
+    const QString outOfRange = numberOutOfRange(numberType, qtTypeName);
+    if (!outOfRange.isEmpty()) {
+        code += QLatin1String("for (") + numberType + QLatin1String(" _number : _numbers) {");
+        code.indent();
+        code += QLatin1String("if (") + outOfRange + QLatin1String(") {");
+        code.indent();
+        code += QLatin1String("_numbersOk = false; // doesn't fit into ") + qtTypeName + QLatin1String(", convert each value instead");
+        code += QLatin1String("break;");
+        code.unindent();
+        code += QLatin1String("}");
+        code.unindent();
+        code += QLatin1String("}");
+    }
+    code += QLatin1String("if (_numbersOk) {");
+    code.indent();
+    code += mLocalVarName + QLatin1String(".reserve(") + mLocalVarName + QLatin1String(".count() + _numbers.count());");
+    code += QLatin1String("for (") + numberType + QLatin1String(" _number : _numbers) {");
+    code.indent();
+    code += mLocalVarName + QLatin1String(".append(") + number + QLatin1String(");");
+    code.unindent();
+    code += QLatin1String("}");
+    if (mOptional) {
+        code += QLatin1String("if (!_numbers.isEmpty()) {");
+        code.indent();
+        code += mNilLocalVarName + QLatin1String(" = false;");
+        code.unindent();
+        code += QLatin1String("}");
+    }
+    code.unindent();
+    code += QLatin1String("}");
+    return code;
+}
+
 KODE::Code ElementArgumentSerializer::demarshalVariable(const QString &soapValueVarName) const
 {
     const bool isPolymorphic = mTypeMap.isPolymorphic(mType, mElementType);
@@ -203,6 +349,64 @@ KODE::Code ElementArgumentSerializer::demarshalVariable(const QString &soapValue
     }
 }
 
+QString ElementArgumentSerializer::builtinFromXml(const QString &readerVarName) const
+{
+    if (mTypeMap.isTypeAny(mType) || !mTypeMap.isBuiltinType(mType, mElementType)) {
+        return QString();
+    }
+    const QString qtTypeName = mTypeMap.localType(mType, mElementType);
+    return mTypeMap.deserializeBuiltinText(mType, mElementType, readerVarName + QLatin1String(".readElementText(QXmlStreamReader::SkipChildElements)"),
+                                           qtTypeName);
+}
+
+KODE::Code ElementArgumentSerializer::demarshalArrayItemFromXml(const QString &readerVarName) const
+{
+    KODE::Code code;
+    const QString builtinValue = builtinFromXml(readerVarName);
+    if (!builtinValue.isEmpty()) {
+        code += mLocalVarName + QLatin1String(".append(") + builtinValue + QLatin1String(");") + COMMENT;
+    } else if (mTypeMap.isComplexType(mType, mElementType) && !mTypeMap.isPolymorphic(mType, mElementType)) {
+        const QString qtTypeName = mTypeMap.localType(mType, mElementType);
+        QString tempVar;
+        if (mLocalVarName.startsWith(QLatin1String("d_ptr->"))) {
+            tempVar = mLocalVarName.mid(7) + QLatin1String("Temp");
+        } else {
+            tempVar = mLocalVarName + QLatin1String("Temp");
+        }
+        code += qtTypeName + QLatin1String(" ") + tempVar + QLatin1String(";") + COMMENT;
+        code += tempVar + QLatin1String(".deserialize(") + readerVarName + QLatin1String(");");
+        code += mLocalVarName + QLatin1String(".append(") + tempVar + QLatin1String(");");
+    } else {
+        code += QLatin1String("const KDSoapValue val = KDSoapValue::fromXml(") + readerVarName + QLatin1String(");") + COMMENT;
+        code.addBlock(demarshalArray(QLatin1String("val")));
+        return code;
+    }
+    if (mOptional) {
+        code += mNilLocalVarName + QLatin1String(" = false;") + COMMENT;
+    }
+    return code;
+}
+
+KODE::Code ElementArgumentSerializer::demarshalVariableFromXml(const QString &readerVarName) const
+{
+    KODE::Code code;
+    const QString builtinValue = builtinFromXml(readerVarName);
+    const bool isPolymorphic = mTypeMap.isPolymorphic(mType, mElementType);
+    if (!builtinValue.isEmpty()) {
+        code += mLocalVarName + QLatin1String(" = ") + builtinValue + QLatin1String(";") + COMMENT;
+    } else if (mTypeMap.isComplexType(mType, mElementType) && !mUsePointer && !isPolymorphic) {
+        code += mLocalVarName + QLatin1String(".deserialize(") + readerVarName + QLatin1String(");") + COMMENT;
+    } else {
+        code += QLatin1String("const KDSoapValue val = KDSoapValue::fromXml(") + readerVarName + QLatin1String(");") + COMMENT;
+        code.addBlock(demarshalVariable(QLatin1String("val")));
+        return code;
+    }
+    if (mOptional) {
+        code += mNilLocalVarName + QLatin1String(" = false;") + COMMENT;
+    }
+    return code;
+}
+
 KODE::Code ElementArgumentSerializer::demarshalVarHelper(const QString &soapValueVarName) const
 {
     KODE::Code code;
@@ -93,12 +93,30 @@ public:
      */
     KODE::Code generateSerializationCode() const;
 
+    /**
+     * Generate the code writing the element directly into the QXmlStreamWriter @p writerVarName,
+     * for the writeXml() methods. Expects a "messageNamespace" variable in the generated code.
+     * Types which can't be written directly go through a temporary KDSoapValue.
+     * @return the generated code
+     */
+    KODE::Code generateXmlWriterCode(const QString &writerVarName) const;
+
     /**
      * Generate code to deserialize an entire array
      * @return the generated code
      */
     KODE::Code demarshalArray(const QString &soapValueVarName) const;
 
+    /**
+     * Generate code converting all the numbers of an array at once, for arrays of numeric builtin types
+     * (see TypeMap::numericArrayItemType). The generated code declares a "_numbersOk" variable, which is false
+     * if the conversion failed or if a number doesn't fit into the item type, and the items have to be
+     * deserialized one by one instead.
+     * @param sourceVarName the KDSoapValue (xsd:list) or KDSoapValueList (array items) to convert
+     * @return the generated code
+     */
+    KODE::Code demarshalNumericArray(const QString &sourceVarName) const;
+
     /**
      * Generate code to deserialize the variable
      * @param the name of the variable containing the KDSoapValue to read from
@@ -106,17 +124,41 @@ public:
      */
     KODE::Code demarshalVariable(const QString &soapValueVarName) const;
 
+    /**
+     * Generate code to deserialize one item of an array, directly from the XML stream.
+     * Types which can't be read from the stream directly go through a temporary KDSoapValue.
+     * @param readerVarName the name of the QXmlStreamReader variable, positioned on the start element
+     * @return the generated code
+     */
+    KODE::Code demarshalArrayItemFromXml(const QString &readerVarName) const;
+
+    /**
+     * Generate code to deserialize the variable directly from the XML stream.
+     * Types which can't be read from the stream directly go through a temporary KDSoapValue.
+     * @param readerVarName the name of the QXmlStreamReader variable, positioned on the start element
+     * @return the generated code
+     */
+    KODE::Code demarshalVariableFromXml(const QString &readerVarName) const;
+
     static QString pointerStorageType(const QString &typeName);
 
 private:
     // Low-level helper for demarshalVariable, doesn't handle the polymorphic case (so it can be called for lists of polymorphics)
     KODE::Code demarshalVarHelper(const QString &soapValueVarName) const;
+    // Creates the KDSoapValue for the element (mValueVarName), shared by the above
+    KODE::Code generateValueCode() const;
+    // The "if" line testing whether an optional element is set
+    QString optionalTest() const;
+    // Returns the code converting the element text into the builtin type, empty if that needs a KDSoapValue
+    QString builtinFromXml(const QString &readerVarName) const;
 
     const KWSDL::TypeMap &mTypeMap;
     QName mType;
     QName mElementType;
     QString mNameArg;
     QString mNameNamespace;
+    QString mNameLocalName; // empty for dynamic element names
+    QString mNameNamespaceUri;
     QString mLocalVarName;
     QString mNilLocalVarName;
     QString mOutputVarName;
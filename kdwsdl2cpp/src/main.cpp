@@ -69,6 +69,22 @@ static void showHelp(const char *appName)
             "  -no-sync                  Do not generate synchronous API methods to the client code\n"
             "  -no-async                 Do not generate asynchronous API methods to the client code\n"
             "  -no-async-jobs            Do not generate asynchronous job API classes to the client code\n"
+            "  -xml-stream-deserializers Generate deserialize(QXmlStreamReader&) methods for complex types,\n"
+            "                            and let the job classes fill their results directly from the\n"
+            "                            XML of the response, without building a KDSoapMessage first\n"
+            "  -xml-stream-serializers   Generate writeXml(QXmlStreamWriter&) methods for complex types,\n"
+            "                            and let the client code write document/literal requests\n"
+            "                            directly into the XML, without building KDSoapValues first\n"
+            "  -streaming-binary <element>\n"
+            "                            map the xsd:base64Binary element <element> to KDSoapAttachment,\n"
+            "                            whose device is encoded while sending and decoded while reading\n"
+            "                            (the received base64 text is still held in memory),\n"
+            "                            instead of QByteArray. may be specified multiple times;\n"
+            "                            use '*' for all base64Binary elements\n"
+            "  -idempotent <operation>   the operation <operation> is idempotent: the client code retries\n"
+            "                            its calls after transport errors, and hedges the slow ones\n"
+            "                            (see KDSoapRetryPolicy). may be specified multiple times;\n"
+            "                            use '*' for all operations\n"
             "\n",
             appName, appName, appName);
 }
@@ -93,9 +109,13 @@ int main(int argc, char **argv)
     Settings::OptionalElementType optionalElementType = Settings::ENone;
     bool keepUnusedTypes = false;
     QStringList importPathList;
+    QStringList streamingBinaryElements;
+    QStringList idempotentOperations;
     bool useLocalFilesOnly = false;
     bool helpOnMissing = false;
     bool skipAsync = false, skipSync = false, skipAsyncJobs = false;
+    bool xmlStreamDeserializers = false;
+    bool xmlStreamSerializers = false;
 #if !defined(QT_NO_SSL)
     QString pkcs12File, pkcs12Password;
 #endif
@@ -238,6 +258,24 @@ int main(int argc, char **argv)
             skipAsync = true;
         } else if (opt == QLatin1String("-no-async-jobs")) {
             skipAsyncJobs = true;
+        } else if (opt == QLatin1String("-xml-stream-deserializers")) {
+            xmlStreamDeserializers = true;
+        } else if (opt == QLatin1String("-xml-stream-serializers")) {
+            xmlStreamSerializers = true;
+        } else if (opt == QLatin1String("-streaming-binary")) {
+            ++arg;
+            if (!argv[arg]) {
+                showHelp(argv[0]);
+                return 1;
+            }
+            streamingBinaryElements.append(QString::fromLatin1(argv[arg]));
+        } else if (opt == QLatin1String("-idempotent")) {
+            ++arg;
+            if (!argv[arg]) {
+                showHelp(argv[0]);
+                return 1;
+            }
+            idempotentOperations.append(QString::fromLatin1(argv[arg]));
         } else if (!fileName) {
             fileName = argv[arg];
         } else {
@@ -294,6 +332,10 @@ int main(int argc, char **argv)
     Settings::self()->setSkipSync(skipSync);
     Settings::self()->setSkipAsync(skipAsync);
     Settings::self()->setSkipAsyncJobs(skipAsyncJobs);
+    Settings::self()->setGenerateXmlStreamDeserializers(xmlStreamDeserializers);
+    Settings::self()->setGenerateXmlStreamSerializers(xmlStreamSerializers);
+    Settings::self()->setStreamingBinaryElements(streamingBinaryElements);
+    Settings::self()->setIdempotentOperations(idempotentOperations);
 
     KWSDL::Compiler compiler;
 #if !defined(QT_NO_SSL)
@@ -40,6 +40,56 @@ void Settings::setSkipAsyncJobs(bool skipAsyncJobs)
     mSkipAsyncJobs = skipAsyncJobs;
 }
 
+bool Settings::generateXmlStreamDeserializers() const
+{
+    return mGenerateXmlStreamDeserializers;
+}
+
+void Settings::setGenerateXmlStreamDeserializers(bool generate)
+{
+    mGenerateXmlStreamDeserializers = generate;
+}
+
+bool Settings::generateXmlStreamSerializers() const
+{
+    return mGenerateXmlStreamSerializers;
+}
+
+void Settings::setGenerateXmlStreamSerializers(bool generate)
+{
+    mGenerateXmlStreamSerializers = generate;
+}
+
+QStringList Settings::streamingBinaryElements() const
+{
+    return mStreamingBinaryElements;
+}
+
+void Settings::setStreamingBinaryElements(const QStringList &elements)
+{
+    mStreamingBinaryElements = elements;
+}
+
+bool Settings::isStreamingBinaryElement(const QString &elementName) const
+{
+    return mStreamingBinaryElements.contains(elementName) || mStreamingBinaryElements.contains(QLatin1String("*"));
+}
+
+QStringList Settings::idempotentOperations() const
+{
+    return mIdempotentOperations;
+}
+
+void Settings::setIdempotentOperations(const QStringList &operations)
+{
+    mIdempotentOperations = operations;
+}
+
+bool Settings::isIdempotentOperation(const QString &operationName) const
+{
+    return mIdempotentOperations.contains(operationName) || mIdempotentOperations.contains(QLatin1String("*"));
+}
+
 bool Settings::skipAsync() const
 {
     return mSkipAsync;
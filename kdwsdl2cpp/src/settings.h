@@ -87,6 +87,22 @@ public:
     bool skipAsyncJobs() const;
     void setSkipAsyncJobs(bool skipAsyncJobs);
 
+    bool generateXmlStreamDeserializers() const;
+    void setGenerateXmlStreamDeserializers(bool generate);
+
+    bool generateXmlStreamSerializers() const;
+    void setGenerateXmlStreamSerializers(bool generate);
+
+    // Names of the xsd:base64Binary elements mapped to KDSoapAttachment, "*" for all of them
+    QStringList streamingBinaryElements() const;
+    void setStreamingBinaryElements(const QStringList &elements);
+    bool isStreamingBinaryElement(const QString &elementName) const;
+
+    // Names of the operations whose calls are retried and hedged, "*" for all of them
+    QStringList idempotentOperations() const;
+    void setIdempotentOperations(const QStringList &operations);
+    bool isIdempotentOperation(const QString &operationName) const;
+
 private:
     friend class SettingsSingleton;
     Settings();
@@ -99,6 +115,8 @@ private:
     QString mExportDeclaration;
     QString mNameSpace;
     QStringList mImportPathList;
+    QStringList mStreamingBinaryElements;
+    QStringList mIdempotentOperations;
     NSMapping mNamespaceMapping;
     OptionalElementType mOptionalElementType;
     bool mHeader = false;
@@ -110,6 +128,8 @@ private:
     bool mSkipSync = false;
     bool mSkipAsync = false;
     bool mSkipAsyncJobs = false;
+    bool mGenerateXmlStreamDeserializers = false;
+    bool mGenerateXmlStreamSerializers = false;
 };
 
 #endif
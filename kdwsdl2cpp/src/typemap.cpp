@@ -90,6 +90,26 @@ TypeMap::TypeMap()
     addBuiltinType("unsignedInt", "unsigned int"); // 32 bits
     addBuiltinType("unsignedLong", "quint64"); // 64 bits
     addBuiltinType("unsignedShort", "unsigned int"); // 16 bits, 0-65535. But QVariant doesn't support short.
+
+    // base64Binary elements selected with -streaming-binary, see Converter::applyStreamingBinaryElements
+    Entry streamingEntry;
+    streamingEntry.builtinType = true;
+    streamingEntry.nameSpace = streamingBinaryType().nameSpace();
+    streamingEntry.typeName = streamingBinaryType().localName();
+    streamingEntry.localType = QStringLiteral("KDSoapAttachment");
+    streamingEntry.headers << QStringLiteral("KDSoapClient/KDSoapAttachment.h");
+    streamingEntry.headerIncludes << QStringLiteral("KDSoapClient/KDSoapAttachment.h") << QStringLiteral("KDSoapClient/KDSoapBinaryCodec.h");
+    mTypeMap.append(streamingEntry);
+}
+
+QName TypeMap::streamingBinaryType()
+{
+    return QName(QStringLiteral("urn:kdsoap:streaming-binary"), QStringLiteral("base64Binary"));
+}
+
+static bool isStreamingBinary(const QName &type)
+{
+    return type == TypeMap::streamingBinaryType();
 }
 
 TypeMap::~TypeMap()
@@ -114,6 +134,13 @@ void TypeMap::addBuiltinType(const char *typeName, const char *localType)
         }
         entry.headers << header;
         entry.headerIncludes << header;
+        if (entry.localType == QLatin1String("QByteArray")) {
+            // base64Binary and hexBinary are converted by KDSoapBinaryCodec
+            entry.headerIncludes << QStringLiteral("KDSoapClient/KDSoapBinaryCodec.h");
+        } else if (entry.localType == QLatin1String("QDate") || entry.localType == QLatin1String("QTime")) {
+            // date and time are parsed by KDDateTime
+            entry.headerIncludes << QStringLiteral("KDSoapClient/KDDateTime.h");
+        }
     }
     mTypeMap.append(entry);
 }
@@ -547,13 +574,23 @@ QString KWSDL::TypeMap::Entry::dumpBools() const
 QString KWSDL::TypeMap::deserializeBuiltin(const QName &typeName, const QName &elementName, const QString &var, const QString &qtTypeName) const
 {
     const QName type = typeName.isEmpty() ? baseTypeForElement(elementName) : typeName;
-    if (type.nameSpace() == XMLSchemaURI && type.localName() == "hexBinary") {
-        return "QByteArray::fromHex(" + var + ".value().toString().toLatin1())";
+    if (isStreamingBinary(type)) {
+        return "KDSoapBinaryCodec::toAttachment(" + var + ".value())";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "hexBinary") {
+        return "KDSoapBinaryCodec::fromHexValue(" + var + ".value())";
     } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "base64Binary") {
-        return "QByteArray::fromBase64(" + var + ".value().toString().toLatin1())";
+        return "KDSoapBinaryCodec::fromBase64Value(" + var + ".value())";
     } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "dateTime") {
         Q_ASSERT(qtTypeName == QLatin1String("KDDateTime"));
-        return "KDDateTime::fromDateString(" + var + ".value().toString())";
+        // With use=encoded, the message reader already converted the text to a KDDateTime
+        return "(" + var + ".value().userType() == qMetaTypeId<KDDateTime>() ? " + var + ".value().value<KDDateTime>() : KDDateTime::fromDateString("
+            + var + ".value().toString()))";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "date") {
+        return "(" + var + ".value().userType() == QMetaType::QDate ? " + var + ".value().toDate() : KDDateTime::dateFromString(" + var
+            + ".value().toString()))";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "time") {
+        return "(" + var + ".value().userType() == QMetaType::QTime ? " + var + ".value().toTime() : KDDateTime::timeFromString(" + var
+            + ".value().toString()))";
     } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "QName") {
         Q_ASSERT(qtTypeName == QLatin1String("KDQName"));
         return "KDQName::fromSoapValue(" + var + ")";
@@ -564,6 +601,83 @@ QString KWSDL::TypeMap::deserializeBuiltin(const QName &typeName, const QName &e
     }
 }
 
+QString KWSDL::TypeMap::deserializeBuiltinText(const QName &typeName, const QName &elementName, const QString &textVar,
+                                               const QString &qtTypeName) const
+{
+    const QName type = typeName.isEmpty() ? baseTypeForElement(elementName) : typeName;
+    if (isStreamingBinary(type)) {
+        return "KDSoapBinaryCodec::toAttachment(QVariant(" + textVar + "))";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "hexBinary") {
+        return "KDSoapBinaryCodec::fromHex(" + textVar + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "base64Binary") {
+        return "KDSoapBinaryCodec::fromBase64(" + textVar + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "dateTime") {
+        Q_ASSERT(qtTypeName == QLatin1String("KDDateTime"));
+        return "KDDateTime::fromDateString(" + textVar + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "date") {
+        return "KDDateTime::dateFromString(" + textVar + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "time") {
+        return "KDDateTime::timeFromString(" + textVar + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "QName") {
+        return QString(); // prefix resolution needs the namespace declarations
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "anySimpleType") {
+        return "QVariant(" + textVar + ")";
+    } else if (qtTypeName == QLatin1String("QString")) {
+        return textVar;
+    } else {
+        return "QVariant(" + textVar + ").value<" + qtTypeName + ">()";
+    }
+}
+
+QString KWSDL::TypeMap::numericArrayItemType(const QName &typeName) const
+{
+    if (typeName.nameSpace() != XMLSchemaURI || !isBuiltinType(typeName)) {
+        return QString();
+    }
+    const QString qtTypeName = localType(typeName);
+    if (qtTypeName == QLatin1String("double") || qtTypeName == QLatin1String("float")) {
+        return QStringLiteral("double");
+    }
+    if (qtTypeName == QLatin1String("int") || qtTypeName == QLatin1String("unsigned int") || qtTypeName == QLatin1String("qint64")
+        || qtTypeName == QLatin1String("quint64") || qtTypeName == QLatin1String("signed char") || qtTypeName == QLatin1String("unsigned char")) {
+        // quint64 values above the range of qint64 are rare; the generated code falls back to converting each value then
+        return QStringLiteral("qint64");
+    }
+    return QString();
+}
+
+bool KWSDL::TypeMap::isBase64Binary(const QName &typeName, const QName &elementName) const
+{
+    const QName type = typeName.isEmpty() ? baseTypeForElement(elementName) : typeName;
+    return type.nameSpace() == XMLSchemaURI && type.localName() == "base64Binary";
+}
+
+QString KWSDL::TypeMap::serializeBuiltinText(const QName &typeName, const QName &elementName, const QString &var, const QString &qtTypeName) const
+{
+    // Must give the same result as variantToTextValue in KDSoapValue.cpp
+    const QName type = typeName.isEmpty() ? baseTypeForElement(elementName) : typeName;
+    if (isStreamingBinary(type)) {
+        return QString(); // written by KDSoapValue, which can stream it or send it with MTOM
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "hexBinary") {
+        return "KDSoapBinaryCodec::toHex(" + var + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "base64Binary") {
+        return "KDSoapBinaryCodec::toBase64(" + var + ")";
+    } else if (type.nameSpace() == XMLSchemaURI && type.localName() == "dateTime") {
+        return var + ".toDateString()";
+    } else if (qtTypeName == QLatin1String("QString")) {
+        return var;
+    } else if (qtTypeName == QLatin1String("bool")) {
+        return "(" + var + " ? QStringLiteral(\"true\") : QStringLiteral(\"false\"))";
+    } else if (qtTypeName == QLatin1String("int") || qtTypeName == QLatin1String("unsigned int") || qtTypeName == QLatin1String("qint64")
+               || qtTypeName == QLatin1String("quint64")) {
+        return "QString::number(" + var + ")";
+    } else if (qtTypeName == QLatin1String("QDate")) {
+        return var + ".toString(Qt::ISODate)";
+    }
+    // QName needs prefixes, floating-point and time formatting is left to KDSoapValue
+    return QString();
+}
+
 QString KWSDL::TypeMap::serializeBuiltin(const QName &baseTypeName, const QName &elementName, const QString &var, const QString &name,
                                          const QString &typeNameSpace, const QString &typeName) const
 {
@@ -571,10 +685,13 @@ QString KWSDL::TypeMap::serializeBuiltin(const QName &baseTypeName, const QName
     const QName baseType = baseTypeName.isEmpty() ? baseTypeForElement(elementName) : baseTypeName;
     // variantToTextValue also has support for calling toHex/toBase64 at runtime, but this fails
     // when the type derives from hexBinary and is named differently, see Telegram testcase.
-    if (baseType.nameSpace() == XMLSchemaURI && baseType.localName() == "hexBinary") {
-        value = "QString::fromLatin1(" + var + ".toHex().constData())";
+    if (isStreamingBinary(baseType)) {
+        // KDSoapValue knows what to do with a KDSoapAttachment; the XML type is still xsd:base64Binary
+        return "KDSoapValue(" + name + ", QVariant::fromValue(" + var + "), KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1(\"base64Binary\"))";
+    } else if (baseType.nameSpace() == XMLSchemaURI && baseType.localName() == "hexBinary") {
+        value = "KDSoapBinaryCodec::toHex(" + var + ")";
     } else if (baseType.nameSpace() == XMLSchemaURI && baseType.localName() == "base64Binary") {
-        value = "QString::fromLatin1(" + var + ".toBase64().constData())";
+        value = "KDSoapBinaryCodec::toBase64(" + var + ")";
     } else if (baseType.nameSpace() == XMLSchemaURI && baseType.localName() == "dateTime") {
         value = var + ".toDateString()";
     } else if (baseType.nameSpace() == XMLSchemaURI && baseType.localName() == "QName") {
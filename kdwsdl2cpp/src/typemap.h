@@ -30,6 +30,12 @@ public:
 
     void setNSManager(NSManager *manager);
 
+    /**
+     * The type given to the xsd:base64Binary elements selected with -streaming-binary,
+     * which are represented by a KDSoapAttachment rather than a QByteArray.
+     */
+    static QName streamingBinaryType();
+
     /**
      * Returns true if @p typeName refers to a "plain old datatype", like int or char.
      * Example: @p typeName is "xsd:nonPositiveInteger".
@@ -95,9 +101,30 @@ public:
      * Return C++ code for converting the variant in "var" into the right type.
      */
     QString deserializeBuiltin(const QName &typeName, const QName &elementName, const QString &var, const QString &qtTypeName) const;
+    /**
+     * Return C++ code for converting the element text in the QString "textVar" into the right type,
+     * or an empty string if the conversion needs more than the text (e.g. namespaces, for xsd:QName).
+     */
+    QString deserializeBuiltinText(const QName &typeName, const QName &elementName, const QString &textVar, const QString &qtTypeName) const;
+    /**
+     * Return C++ code converting "var" into the QString written in the XML, without going through a QVariant,
+     * or an empty string if that's not supported for this type (then serializeBuiltin should be used).
+     */
+    QString serializeBuiltinText(const QName &typeName, const QName &elementName, const QString &var, const QString &qtTypeName) const;
+    /**
+     * Return true if the type (or the base type of the element) is xsd:base64Binary: such elements
+     * are sent as MTOM attachments when enabled, so they must be written by KDSoapValue.
+     */
+    bool isBase64Binary(const QName &typeName, const QName &elementName) const;
     QString serializeBuiltin(const QName &baseTypeName, const QName &elementName, const QString &var, const QString &name,
                              const QString &typeNameSpace, const QString &typeName) const;
 
+    /**
+     * Returns the item type of the typed array (KDSoapValue::toDoubleArray() or toInt64Array(), i.e. "double" or "qint64")
+     * which can hold values of the builtin type @p typeName, or an empty string if it isn't a numeric type.
+     */
+    QString numericArrayItemType(const QName &typeName) const;
+
     QString localTypeForAttribute(const QName &typeName) const;
     QStringList headersForAttribute(const QName &typeName) const;
     QStringList forwardDeclarationsForAttribute(const QName &typeName) const;
@@ -57,49 +57,248 @@ QString KDDateTime::timeZone() const
     return d->mTimeZone;
 }
 
+namespace {
+// A validating parser for the lexical representations of xsd:dateTime, xsd:date and xsd:time
+// (https://www.w3.org/TR/xmlschema-2/#dateTime), reading the characters in place.
+class XsdDateTimeParser
+{
+public:
+    explicit XsdDateTimeParser(const QString &text)
+        : m_pos(text.constData())
+        , m_end(text.constData() + text.size())
+    {
+        // The whiteSpace facet of these types is "collapse"
+        while (m_pos < m_end && isSpace(*m_pos)) {
+            ++m_pos;
+        }
+        while (m_end > m_pos && isSpace(*(m_end - 1))) {
+            --m_end;
+        }
+    }
+
+    bool atEnd() const
+    {
+        return m_pos == m_end;
+    }
+
+    bool accept(char c)
+    {
+        if (m_pos < m_end && *m_pos == QLatin1Char(c)) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    // '-'? yyyy '-' mm '-' dd, with at least four digits for the year, and no year 0000
+    bool parseDate(QDate *date)
+    {
+        const bool negative = accept('-');
+        const QChar *yearStart = m_pos;
+        int year = 0;
+        while (m_pos < m_end && isDigit(*m_pos)) {
+            // Years beyond what QDate can represent are rejected
+            if (m_pos - yearStart == 9) {
+                return false;
+            }
+            year = year * 10 + digitValue(*m_pos++);
+        }
+        const int yearDigits = int(m_pos - yearStart);
+        if (yearDigits < 4 || (yearDigits > 4 && *yearStart == QLatin1Char('0')) || year == 0) {
+            return false;
+        }
+        int month, day;
+        if (!accept('-') || !parseNumber(2, &month) || !accept('-') || !parseNumber(2, &day)) {
+            return false;
+        }
+        // QDate has no year 0 either: year -1 is 1 BC, like -0001 in XML Schema 1.0
+        *date = QDate(negative ? -year : year, month, day);
+        return date->isValid();
+    }
+
+    // hh ':' mm ':' ss ('.' s+)?, where 24:00:00 is the end of the day (returned as 00:00 and one extra day)
+    bool parseTime(QTime *time, int *extraDays)
+    {
+        int hour, minute, second;
+        if (!parseNumber(2, &hour) || !accept(':') || !parseNumber(2, &minute) || !accept(':') || !parseNumber(2, &second)) {
+            return false;
+        }
+        int msec = 0;
+        bool zeroFraction = true;
+        if (accept('.')) {
+            // Rounded to milliseconds from the first four digits, like QTime::fromString(Qt::ISODate)
+            int fraction = 0;
+            int count = 0;
+            while (m_pos < m_end && isDigit(*m_pos)) {
+                const int digit = digitValue(*m_pos++);
+                if (count < 4) {
+                    fraction = fraction * 10 + digit;
+                }
+                zeroFraction = zeroFraction && digit == 0;
+                ++count;
+            }
+            if (count == 0) {
+                return false;
+            }
+            for (int i = count; i < 4; ++i) {
+                fraction *= 10;
+            }
+            msec = qMin((fraction + 5) / 10, 999);
+        }
+        *extraDays = 0;
+        if (hour == 24 && minute == 0 && second == 0 && zeroFraction) {
+            hour = 0;
+            *extraDays = 1;
+        }
+        *time = QTime(hour, minute, second, msec);
+        return time->isValid();
+    }
+
+    // ('Z' | ('+' | '-') hh ':' mm)?; the offset is between -14:00 and +14:00.
+    // \p text points to the time zone in the parsed string, \p length is 0 if there is none.
+    bool parseTimeZone(int *offsetSeconds, const QChar **text, int *length)
+    {
+        *offsetSeconds = 0;
+        *text = m_pos;
+        *length = 0;
+        if (accept('Z')) {
+            *length = 1;
+            return true;
+        }
+        const bool negative = m_pos < m_end && *m_pos == QLatin1Char('-');
+        if (!accept('+') && !accept('-')) {
+            return true;
+        }
+        int hours, minutes;
+        if (!parseNumber(2, &hours) || !accept(':') || !parseNumber(2, &minutes) || minutes > 59 || hours * 60 + minutes > 14 * 60) {
+            return false;
+        }
+        *offsetSeconds = (negative ? -60 : 60) * (hours * 60 + minutes);
+        *length = 6;
+        return true;
+    }
+
+private:
+    static bool isSpace(QChar c)
+    {
+        return c == QLatin1Char(' ') || c == QLatin1Char('\t') || c == QLatin1Char('\n') || c == QLatin1Char('\r');
+    }
+    static bool isDigit(QChar c)
+    {
+        return c.unicode() >= '0' && c.unicode() <= '9';
+    }
+    static int digitValue(QChar c)
+    {
+        return c.unicode() - '0';
+    }
+
+    // Exactly \p count digits
+    bool parseNumber(int count, int *value)
+    {
+        if (m_end - m_pos < count) {
+            return false;
+        }
+        int result = 0;
+        for (int i = 0; i < count; ++i) {
+            if (!isDigit(m_pos[i])) {
+                return false;
+            }
+            result = result * 10 + digitValue(m_pos[i]);
+        }
+        m_pos += count;
+        *value = result;
+        return true;
+    }
+
+    const QChar *m_pos;
+    const QChar *m_end;
+};
+}
+
 void KDDateTime::setTimeZone(const QString &timeZone)
 {
     d->mTimeZone = timeZone;
 
     // Just in case someone cares: set the time spec in QDateTime accordingly.
     // We can't do this the other way round, there's no public API for the offset-from-utc case.
-    if (timeZone == QLatin1String("Z")) {
-        setTimeSpec(Qt::UTC);
-    } else if (timeZone.isEmpty()) {
+    if (timeZone.isEmpty()) {
         setTimeSpec(Qt::LocalTime);
+        return;
+    }
+    XsdDateTimeParser parser(timeZone);
+    int offset;
+    const QChar *text;
+    int length;
+    const bool valid = parser.parseTimeZone(&offset, &text, &length) && parser.atEnd();
+    if (valid && length == 1) {
+        setTimeSpec(Qt::UTC);
+    } else if (valid && length > 0) {
+        // Same as fromDateString(), e.g. -05:30 is 5.5 hours behind UTC
+        setOffsetFromUtc(offset);
     } else {
         setTimeSpec(Qt::OffsetFromUTC);
-        const int pos = timeZone.indexOf(QLatin1Char(':'));
-        if (pos > 0) {
-            const int hours = timeZone.left(pos).toInt();
-            const int minutes = timeZone.mid(pos + 1).toInt();
-            const int offset = hours * 3600 + minutes * 60;
-            setOffsetFromUtc(offset);
-        }
     }
 }
 
 KDDateTime KDDateTime::fromDateString(const QString &s)
 {
-    KDDateTime kdt;
-    QString tz;
-    QString baseString = s;
-    if (s.endsWith(QLatin1Char('Z'))) {
-        tz = QString::fromLatin1("Z");
-        baseString.chop(1);
-    } else {
-        QString maybeTz = s.right(6);
-        if (maybeTz.startsWith(QLatin1Char('+')) || maybeTz.startsWith(QLatin1Char('-'))) {
-            tz = maybeTz;
-            baseString.chop(6);
-        }
+    XsdDateTimeParser parser(s);
+    QDate date;
+    QTime time(0, 0);
+    int extraDays = 0;
+    if (!parser.parseDate(&date)) {
+        return KDDateTime();
+    }
+    // A date without time is accepted as well (midnight), like QDateTime::fromString(Qt::ISODate) does
+    if (parser.accept('T') && !parser.parseTime(&time, &extraDays)) {
+        return KDDateTime();
+    }
+    int offset;
+    const QChar *timeZone;
+    int timeZoneLength;
+    if (!parser.parseTimeZone(&offset, &timeZone, &timeZoneLength) || !parser.atEnd()) {
+        return KDDateTime();
+    }
+
+    KDDateTime kdt(QDateTime(extraDays ? date.addDays(extraDays) : date, time));
+    if (timeZoneLength == 1) {
+        kdt.setTimeSpec(Qt::UTC);
+    } else if (timeZoneLength > 0) {
+        kdt.setOffsetFromUtc(offset);
+    }
+    if (timeZoneLength > 0) {
+        kdt.d->mTimeZone = QString(timeZone, timeZoneLength);
     }
-    // qDebug() << "KDDateTime: Parsing" << baseString << "tz=" << tz;
-    kdt = QDateTime::fromString(baseString, Qt::ISODate);
-    kdt.setTimeZone(tz);
     return kdt;
 }
 
+QDate KDDateTime::dateFromString(const QString &s)
+{
+    XsdDateTimeParser parser(s);
+    QDate date;
+    int offset;
+    const QChar *timeZone;
+    int timeZoneLength;
+    if (!parser.parseDate(&date) || !parser.parseTimeZone(&offset, &timeZone, &timeZoneLength) || !parser.atEnd()) {
+        return QDate();
+    }
+    return date;
+}
+
+QTime KDDateTime::timeFromString(const QString &s)
+{
+    XsdDateTimeParser parser(s);
+    QTime time;
+    int extraDays;
+    int offset;
+    const QChar *timeZone;
+    int timeZoneLength;
+    if (!parser.parseTime(&time, &extraDays) || !parser.parseTimeZone(&offset, &timeZone, &timeZoneLength) || !parser.atEnd()) {
+        return QTime();
+    }
+    return time;
+}
+
 QString KDDateTime::toDateString() const
 {
     QString str;
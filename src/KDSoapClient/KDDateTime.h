@@ -55,10 +55,29 @@ public:
     void setTimeZone(const QString &timeZone);
 
     /**
-     * Creates a KDDateTime from a SOAP-compliant string representation.
+     * Creates a KDDateTime from a SOAP-compliant string representation,
+     * i.e. the lexical representation of xsd:dateTime, e.g. "2011-03-15T23:59:59.999+01:00".
+     * Fractional seconds are rounded to milliseconds.
+     * Returns an invalid KDDateTime if \p s isn't a valid xsd:dateTime.
      */
     static KDDateTime fromDateString(const QString &s);
 
+    /**
+     * Parses the lexical representation of xsd:date, e.g. "2011-03-15".
+     * A time zone is accepted, but ignored, since QDate has none.
+     * Returns an invalid QDate if \p s isn't a valid xsd:date.
+     * \since 2.2
+     */
+    static QDate dateFromString(const QString &s);
+
+    /**
+     * Parses the lexical representation of xsd:time, e.g. "23:59:59.999".
+     * Fractional seconds are rounded to milliseconds, and a time zone is accepted, but ignored.
+     * Returns an invalid QTime if \p s isn't a valid xsd:time.
+     * \since 2.2
+     */
+    static QTime timeFromString(const QString &s);
+
     /**
      * Returns a SOAP-compliant string representation of the date/time object.
      */
@@ -0,0 +1,150 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapAttachment.h"
+#include "KDSoapAttachment_p.h"
+
+KDSoapAttachment::KDSoapAttachment()
+{
+}
+
+KDSoapAttachment::KDSoapAttachment(const QByteArray &data, const QString &contentType)
+    : d(new Private)
+{
+    d->setData(data);
+    if (!contentType.isEmpty()) {
+        d->contentType = contentType;
+    }
+}
+
+KDSoapAttachment::KDSoapAttachment(QIODevice *device, const QString &contentType)
+    : d(new Private)
+{
+    Q_ASSERT(device);
+    if (!device->isOpen()) {
+        device->open(QIODevice::ReadOnly);
+    }
+    d->device.reset(device);
+    if (!contentType.isEmpty()) {
+        d->contentType = contentType;
+    }
+}
+
+KDSoapAttachment::KDSoapAttachment(const KDSoapAttachment &other)
+    : d(other.d)
+{
+}
+
+KDSoapAttachment &KDSoapAttachment::operator=(const KDSoapAttachment &other)
+{
+    d = other.d;
+    return *this;
+}
+
+KDSoapAttachment::~KDSoapAttachment()
+{
+}
+
+bool KDSoapAttachment::isNull() const
+{
+    return !d;
+}
+
+QString KDSoapAttachment::contentId() const
+{
+    return d ? d->contentId : QString();
+}
+
+void KDSoapAttachment::setContentId(const QString &contentId)
+{
+    if (!d) {
+        d = new Private;
+    }
+    d->contentId = contentId;
+}
+
+QString KDSoapAttachment::contentType() const
+{
+    return d ? d->contentType : QString();
+}
+
+void KDSoapAttachment::setContentType(const QString &contentType)
+{
+    if (!d) {
+        d = new Private;
+    }
+    d->contentType = contentType;
+}
+
+QIODevice *KDSoapAttachment::device() const
+{
+    return d ? d->device.data() : nullptr;
+}
+
+QByteArray KDSoapAttachment::data() const
+{
+    if (!d) {
+        return QByteArray();
+    }
+    const_cast<Private *>(d.constData())->readSequentialDevice();
+    if (d->inMemory) {
+        if (d->storage.isNull()) {
+            return d->data;
+        }
+        // Don't hand out a pointer into the received message, it could outlive it
+        return QByteArray(d->data.constData(), d->data.size());
+    }
+    QIODevice *device = d->device.data();
+    const qint64 pos = device->pos();
+    device->seek(0);
+    const QByteArray contents = device->readAll();
+    device->seek(pos);
+    return contents;
+}
+
+bool KDSoapAttachment::writeTo(QIODevice *sink) const
+{
+    if (!d) {
+        return true;
+    }
+    if (d->inMemory) {
+        return sink->write(d->data) == d->data.size();
+    }
+    QIODevice *device = d->device.data();
+    const bool sequential = device->isSequential();
+    const qint64 pos = sequential ? 0 : device->pos();
+    if (!sequential) {
+        device->seek(0);
+    }
+    bool ok = true;
+    char block[16384];
+    while (ok && !device->atEnd()) {
+        const qint64 in = device->read(block, sizeof(block));
+        if (in <= 0) {
+            ok = in == 0;
+            break;
+        }
+        ok = sink->write(block, in) == in;
+    }
+    if (!sequential) {
+        device->seek(pos);
+    }
+    return ok;
+}
+
+qint64 KDSoapAttachment::size() const
+{
+    if (!d) {
+        return 0;
+    }
+    if (d->inMemory) {
+        return d->data.size();
+    }
+    return d->device->isSequential() ? -1 : d->device->size();
+}
@@ -0,0 +1,129 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPATTACHMENT_H
+#define KDSOAPATTACHMENT_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QMetaType>
+#include <QtCore/QSharedDataPointer>
+#include <QtCore/QString>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+/**
+ * A binary attachment, sent or received as a MIME part of a MTOM/XOP message
+ * (https://www.w3.org/TR/soap12-mtom/), rather than as base64 text inside the XML.
+ *
+ * To send an attachment, use it as the value of a KDSoapValue:
+ * \code
+ *  message.addArgument(QLatin1String("document"), QVariant::fromValue(KDSoapAttachment(new QFile(fileName))));
+ * \endcode
+ * When MTOM is enabled (see KDSoapClientInterface::setMtomEnabled()), the element then contains
+ * an xop:Include reference, and the contents of the device are streamed after the envelope.
+ * Otherwise the attachment is written as base64 text, like a QByteArray value.
+ * With MTOM enabled, QByteArray values are sent as attachments as well, except for xsd:hexBinary values.
+ *
+ * In a MTOM response (or, on the server side, request), the elements containing an xop:Include
+ * have a KDSoapAttachment as value. Its device() reads the received data in place, without copying it.
+ * QVariant::toByteArray() also works on such values, for code expecting the data of a base64Binary.
+ *
+ * Copies of an attachment share the same device, including its current position.
+ * data() and writeTo() read random-access devices from the start, and restore the position.
+ *
+ * \since 2.2
+ */
+class KDSOAP_EXPORT KDSoapAttachment
+{
+public:
+    /**
+     * Constructs a null attachment.
+     */
+    KDSoapAttachment();
+    /**
+     * Constructs an attachment holding \p data.
+     */
+    explicit KDSoapAttachment(const QByteArray &data, const QString &contentType = QString());
+    /**
+     * Constructs an attachment whose contents are read from \p device when the message is sent.
+     * The attachment takes ownership of the device, which must not have a parent.
+     * The device is opened for reading if it isn't open yet.
+     *
+     * Random-access devices (e.g. QFile) are streamed. Sequential devices are read in memory
+     * when the message is sent, since the size of each part has to be known in advance.
+     */
+    explicit KDSoapAttachment(QIODevice *device, const QString &contentType = QString());
+    KDSoapAttachment(const KDSoapAttachment &other);
+    KDSoapAttachment &operator=(const KDSoapAttachment &other);
+    ~KDSoapAttachment();
+
+    /**
+     * Returns true if this attachment was default-constructed.
+     */
+    bool isNull() const;
+
+    /**
+     * Returns the Content-ID of the MIME part, without angle brackets.
+     * A unique one is generated when the attachment is created.
+     */
+    QString contentId() const;
+    /**
+     * Sets the Content-ID of the MIME part.
+     */
+    void setContentId(const QString &contentId);
+
+    /**
+     * Returns the MIME type of the attachment. The default is "application/octet-stream".
+     */
+    QString contentType() const;
+    /**
+     * Sets the MIME type of the attachment.
+     */
+    void setContentType(const QString &contentType);
+
+    /**
+     * Returns the device for reading the contents of the attachment.
+     * For received attachments, this reads from the response (or request) data directly.
+     */
+    QIODevice *device() const;
+
+    /**
+     * Returns the contents of the attachment.
+     * This reads the whole device in memory. The contents of a sequential device are then kept,
+     * so that data() can be called again, also on copies of this attachment, and device()
+     * returns a buffer reading them from then on.
+     */
+    QByteArray data() const;
+
+    /**
+     * Writes the contents of the attachment into \p sink, block by block, without reading the whole
+     * device in memory. A sequential device can only be written once this way, unless data() was called.
+     * This is the way to save a large attachment (e.g. into a QFile), in particular one created by
+     * KDSoapBinaryCodec::toAttachment(), which decodes the base64 text while it's being read.
+     * Returns false if reading the attachment or writing into \p sink failed.
+     */
+    bool writeTo(QIODevice *sink) const;
+
+    /**
+     * Returns the size of the contents, or -1 if it isn't known (sequential devices, until data() is called).
+     */
+    qint64 size() const;
+
+private:
+    friend class KDSoapMultipart;
+    class Private;
+    QSharedDataPointer<Private> d;
+};
+
+Q_DECLARE_METATYPE(KDSoapAttachment)
+
+#endif // KDSOAPATTACHMENT_H
@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPATTACHMENT_P_H
+#define KDSOAPATTACHMENT_P_H
+
+#include "KDSoapAttachment.h"
+#include <QBuffer>
+#include <QSharedData>
+#include <QSharedPointer>
+#include <QUuid>
+
+class KDSoapAttachment::Private : public QSharedData
+{
+public:
+    Private()
+        : contentType(QStringLiteral("application/octet-stream"))
+        , contentId(QUuid::createUuid().toString().mid(1, 36) + QLatin1String("@kdsoap"))
+    {
+    }
+
+    void setData(const QByteArray &bytes)
+    {
+        data = bytes;
+        inMemory = true;
+        QBuffer *buffer = new QBuffer;
+        buffer->setData(data);
+        buffer->open(QIODevice::ReadOnly);
+        device.reset(buffer);
+    }
+
+    // A sequential device can only be read once: its contents are then kept in memory, for all the copies
+    // of the attachment, so that data() can be called again and the attachment sent again (e.g. by a retried call)
+    void readSequentialDevice()
+    {
+        if (!inMemory && device->isSequential()) {
+            sequentialDevice = device; // kept alive, in case something still uses it
+            setData(device->readAll());
+        }
+    }
+
+    QString contentType;
+    QString contentId;
+    // For a received attachment, data points into the whole multipart body, which storage keeps alive.
+    // Declared before the device, which reads from it.
+    QByteArray storage;
+    QByteArray data;
+    bool inMemory = false;
+    QSharedPointer<QIODevice> device;
+    QSharedPointer<QIODevice> sequentialDevice; // the original device, once read by readSequentialDevice()
+};
+
+#endif // KDSOAPATTACHMENT_P_H
@@ -0,0 +1,448 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapBinaryCodec.h"
+#include "KDSoapAttachment.h"
+#include <QIODevice>
+#include <QVariant>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KDSOAP_BINARYCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+static const char s_base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char s_hexDigits[] = "0123456789abcdef";
+
+// Value of each ASCII character in base64 and hex, -1 if invalid
+namespace {
+struct DecodingTables
+{
+    DecodingTables()
+    {
+        for (int i = 0; i < 128; ++i) {
+            base64[i] = -1;
+            hex[i] = -1;
+        }
+        for (int i = 0; i < 64; ++i) {
+            base64[int(s_base64Alphabet[i])] = static_cast<signed char>(i);
+        }
+        for (int i = 0; i < 10; ++i) {
+            hex['0' + i] = static_cast<signed char>(i);
+        }
+        for (int i = 0; i < 6; ++i) {
+            hex['a' + i] = static_cast<signed char>(10 + i);
+            hex['A' + i] = static_cast<signed char>(10 + i);
+        }
+    }
+    signed char base64[128];
+    signed char hex[128];
+};
+}
+
+static const DecodingTables s_tables;
+
+// Characters outside of ASCII are invalid, like after QString::toLatin1()
+static inline int base64Value(ushort ch)
+{
+    return ch < 128 ? s_tables.base64[ch] : -1;
+}
+
+static inline int hexValue(ushort ch)
+{
+    return ch < 128 ? s_tables.hex[ch] : -1;
+}
+
+static inline ushort charCode(QChar ch)
+{
+    return ch.unicode();
+}
+
+static inline ushort charCode(char ch)
+{
+    return uchar(ch);
+}
+
+#ifdef KDSOAP_BINARYCODEC_SSE2
+// Loads 16 characters as bytes. Anything outside of Latin-1 ends up as 0x00 or 0xff, which are invalid anyway.
+static inline __m128i loadChars(const QChar *text)
+{
+    const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+    const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 8));
+    return _mm_packus_epi16(first, second);
+}
+
+static inline __m128i loadChars(const char *text)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+}
+
+// Mask of the bytes of chars within [first, last]. Bytes >= 0x80 are negative, so never within an ASCII range.
+static inline __m128i inRange(__m128i chars, char first, char last)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(char(first - 1))), _mm_cmplt_epi8(chars, _mm_set1_epi8(char(last + 1))));
+}
+
+// Decodes 16 base64 characters into 12 bytes. Returns false, without writing anything,
+// if there's any character outside of the base64 alphabet (padding, whitespace...).
+template<typename Char>
+static inline bool decodeBase64Block(const Char *text, uchar *out)
+{
+    const __m128i chars = loadChars(text);
+    const __m128i upper = inRange(chars, 'A', 'Z');
+    const __m128i lower = inRange(chars, 'a', 'z');
+    const __m128i digit = inRange(chars, '0', '9');
+    const __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+    const __m128i valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)), slash);
+    if (_mm_movemask_epi8(valid) != 0xffff) {
+        return false;
+    }
+    __m128i offset = _mm_and_si128(upper, _mm_set1_epi8(char(0 - 'A')));
+    offset = _mm_or_si128(offset, _mm_and_si128(lower, _mm_set1_epi8(char(26 - 'a'))));
+    offset = _mm_or_si128(offset, _mm_and_si128(digit, _mm_set1_epi8(char(52 - '0'))));
+    offset = _mm_or_si128(offset, _mm_and_si128(plus, _mm_set1_epi8(char(62 - '+'))));
+    offset = _mm_or_si128(offset, _mm_and_si128(slash, _mm_set1_epi8(char(63 - '/'))));
+    const __m128i values = _mm_add_epi8(chars, offset);
+
+    // Two 6-bit values per 16-bit lane -> 12 bits, then two of those per 32-bit lane -> 24 bits
+    const __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 6), _mm_srli_epi16(values, 8));
+    const __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+    alignas(16) quint32 words[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(words), quads);
+    for (int i = 0; i < 4; ++i) {
+        out[0] = uchar(words[i] >> 16);
+        out[1] = uchar(words[i] >> 8);
+        out[2] = uchar(words[i]);
+        out += 3;
+    }
+    return true;
+}
+
+// Decodes 16 hex digits into 8 bytes, returns false if any of them isn't a hex digit
+template<typename Char>
+static inline bool decodeHexBlock(const Char *text, uchar *out)
+{
+    const __m128i chars = loadChars(text);
+    const __m128i digit = inRange(chars, '0', '9');
+    const __m128i lower = inRange(chars, 'a', 'f');
+    const __m128i upper = inRange(chars, 'A', 'F');
+    if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, lower), upper)) != 0xffff) {
+        return false;
+    }
+    __m128i offset = _mm_and_si128(digit, _mm_set1_epi8(char(0 - '0')));
+    offset = _mm_or_si128(offset, _mm_and_si128(lower, _mm_set1_epi8(char(10 - 'a'))));
+    offset = _mm_or_si128(offset, _mm_and_si128(upper, _mm_set1_epi8(char(10 - 'A'))));
+    const __m128i values = _mm_add_epi8(chars, offset);
+
+    const __m128i bytes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(values, 8));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(bytes, bytes));
+    return true;
+}
+
+// Encodes 8 bytes into 16 hex digits
+static inline void encodeHexBlock(const uchar *data, ushort *out)
+{
+    const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data));
+    const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0f));
+    const __m128i low = _mm_and_si128(bytes, _mm_set1_epi8(0x0f));
+    const __m128i nibbles = _mm_unpacklo_epi8(high, low);
+    // '0' + n, plus the distance between '9' + 1 and 'a' for n > 9
+    const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '9' - 1));
+    const __m128i digits = _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+    const __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(digits, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(digits, zero));
+}
+#endif
+
+template<typename Char>
+static QByteArray decodeBase64(const Char *text, int length)
+{
+    QByteArray result;
+    result.resize(int((qint64(length) * 3) / 4));
+    uchar *const begin = reinterpret_cast<uchar *>(result.data());
+    uchar *out = begin;
+    uint buffer = 0;
+    int bits = 0;
+    int i = 0;
+    while (i < length) {
+#ifdef KDSOAP_BINARYCODEC_SSE2
+        // Whole blocks of valid characters don't leave any pending bits
+        if (bits == 0) {
+            while (i + 16 <= length && decodeBase64Block(text + i, out)) {
+                i += 16;
+                out += 12;
+            }
+        }
+#endif
+        const int end = qMin(length, i + 16);
+        for (; i < end; ++i) {
+            const int value = base64Value(charCode(text[i]));
+            if (value < 0) {
+                continue;
+            }
+            buffer = (buffer << 6) | uint(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                *out++ = uchar(buffer >> bits);
+                buffer &= (1u << bits) - 1;
+            }
+        }
+    }
+    result.truncate(int(out - begin));
+    return result;
+}
+
+// Same as QByteArray::fromHex: digits are paired from the end, invalid characters are skipped
+template<typename Char>
+static QByteArray decodeHexLenient(const Char *text, int length)
+{
+    QByteArray result;
+    result.resize((length + 1) / 2);
+    uchar *const begin = reinterpret_cast<uchar *>(result.data());
+    uchar *out = begin + result.size();
+    bool oddDigit = true;
+    for (int i = length - 1; i >= 0; --i) {
+        const int value = hexValue(charCode(text[i]));
+        if (value < 0) {
+            continue;
+        }
+        if (oddDigit) {
+            *--out = uchar(value);
+            oddDigit = false;
+        } else {
+            *out |= uchar(value << 4);
+            oddDigit = true;
+        }
+    }
+    result.remove(0, int(out - begin));
+    return result;
+}
+
+template<typename Char>
+static QByteArray decodeHex(const Char *text, int length)
+{
+    if (length % 2 != 0) {
+        return decodeHexLenient(text, length);
+    }
+    QByteArray result;
+    result.resize(length / 2);
+    uchar *out = reinterpret_cast<uchar *>(result.data());
+    int i = 0;
+#ifdef KDSOAP_BINARYCODEC_SSE2
+    for (; i + 16 <= length; i += 16) {
+        if (!decodeHexBlock(text + i, out)) {
+            return decodeHexLenient(text, length);
+        }
+        out += 8;
+    }
+#endif
+    for (; i < length; i += 2) {
+        const int high = hexValue(charCode(text[i]));
+        const int low = hexValue(charCode(text[i + 1]));
+        if (high < 0 || low < 0) {
+            return decodeHexLenient(text, length);
+        }
+        *out++ = uchar((high << 4) | low);
+    }
+    return result;
+}
+
+QString KDSoapBinaryCodec::toBase64(const QByteArray &data)
+{
+    const int size = data.size();
+    QString result(((size + 2) / 3) * 4, Qt::Uninitialized);
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData());
+    ushort *out = reinterpret_cast<ushort *>(result.data());
+    int i = 0;
+    for (; i + 3 <= size; i += 3) {
+        const uint triplet = (uint(in[i]) << 16) | (uint(in[i + 1]) << 8) | uint(in[i + 2]);
+        out[0] = ushort(s_base64Alphabet[triplet >> 18]);
+        out[1] = ushort(s_base64Alphabet[(triplet >> 12) & 0x3f]);
+        out[2] = ushort(s_base64Alphabet[(triplet >> 6) & 0x3f]);
+        out[3] = ushort(s_base64Alphabet[triplet & 0x3f]);
+        out += 4;
+    }
+    if (i < size) {
+        const bool two = i + 1 < size;
+        const uint triplet = (uint(in[i]) << 16) | (two ? uint(in[i + 1]) << 8 : 0u);
+        out[0] = ushort(s_base64Alphabet[triplet >> 18]);
+        out[1] = ushort(s_base64Alphabet[(triplet >> 12) & 0x3f]);
+        out[2] = two ? ushort(s_base64Alphabet[(triplet >> 6) & 0x3f]) : ushort('=');
+        out[3] = ushort('=');
+    }
+    return result;
+}
+
+QString KDSoapBinaryCodec::toHex(const QByteArray &data)
+{
+    const int size = data.size();
+    QString result(size * 2, Qt::Uninitialized);
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData());
+    ushort *out = reinterpret_cast<ushort *>(result.data());
+    int i = 0;
+#ifdef KDSOAP_BINARYCODEC_SSE2
+    for (; i + 8 <= size; i += 8) {
+        encodeHexBlock(in + i, out);
+        out += 16;
+    }
+#endif
+    for (; i < size; ++i) {
+        *out++ = ushort(s_hexDigits[in[i] >> 4]);
+        *out++ = ushort(s_hexDigits[in[i] & 0xf]);
+    }
+    return result;
+}
+
+QByteArray KDSoapBinaryCodec::fromBase64(const QChar *text, int length)
+{
+    return decodeBase64(text, length);
+}
+
+QByteArray KDSoapBinaryCodec::fromBase64(const char *text, int length)
+{
+    return decodeBase64(text, length);
+}
+
+QByteArray KDSoapBinaryCodec::fromBase64(const QString &text)
+{
+    return decodeBase64(text.constData(), int(text.size()));
+}
+
+QByteArray KDSoapBinaryCodec::fromBase64Value(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<KDSoapAttachment>()) {
+        // Received with MTOM, already binary
+        return value.value<KDSoapAttachment>().data();
+    }
+    if (value.userType() == QMetaType::QByteArray) {
+        const QByteArray text = value.toByteArray();
+        return decodeBase64(text.constData(), int(text.size()));
+    }
+    return fromBase64(value.toString());
+}
+
+namespace {
+// Decodes base64 text while it is read, for KDSoapBinaryCodec::toAttachment()
+class Base64DecodingDevice : public QIODevice
+{
+public:
+    explicit Base64DecodingDevice(const QString &text)
+        : m_text(text)
+    {
+        open(QIODevice::ReadOnly);
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+    bool atEnd() const override
+    {
+        return QIODevice::bytesAvailable() == 0 && m_decodedPos == m_decoded.size() && m_textPos == m_text.size();
+    }
+    qint64 bytesAvailable() const override
+    {
+        // Upper bound, whitespace and padding don't count
+        return QIODevice::bytesAvailable() + (m_decoded.size() - m_decodedPos) + (qint64(m_text.size() - m_textPos) * 3) / 4;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        qint64 total = 0;
+        while (total < maxSize) {
+            if (m_decodedPos == m_decoded.size() && !decodeNextChunk()) {
+                break;
+            }
+            const qint64 count = qMin(maxSize - total, qint64(m_decoded.size() - m_decodedPos));
+            memcpy(data + total, m_decoded.constData() + m_decodedPos, size_t(count));
+            m_decodedPos += int(count);
+            total += count;
+        }
+        return total;
+    }
+    qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+
+private:
+    bool decodeNextChunk()
+    {
+        // decodeBase64 drops the bits of an incomplete group, so each chunk ends after a multiple of 4 valid characters
+        const int length = m_text.size();
+        const QChar *text = m_text.constData();
+        m_decodedPos = 0;
+        while (m_textPos < length) {
+            const int start = m_textPos;
+            int validChars = 0;
+            while (m_textPos < length && validChars < s_charsPerChunk) {
+                if (base64Value(charCode(text[m_textPos++])) >= 0) {
+                    ++validChars;
+                }
+            }
+            m_decoded = decodeBase64(text + start, m_textPos - start);
+            if (!m_decoded.isEmpty()) {
+                return true;
+            }
+        }
+        m_decoded.clear();
+        return false;
+    }
+
+    static const int s_charsPerChunk = 65536; // multiple of 4
+    const QString m_text;
+    int m_textPos = 0;
+    QByteArray m_decoded;
+    int m_decodedPos = 0;
+};
+}
+
+KDSoapAttachment KDSoapBinaryCodec::toAttachment(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<KDSoapAttachment>()) {
+        return value.value<KDSoapAttachment>();
+    }
+    if (value.isNull()) {
+        return KDSoapAttachment();
+    }
+    // With use=encoded, the text comes as UTF-8 in a QByteArray, see fromBase64Value
+    const QString text = value.userType() == QMetaType::QByteArray ? QString::fromLatin1(value.toByteArray()) : value.toString();
+    return KDSoapAttachment(new Base64DecodingDevice(text));
+}
+
+QByteArray KDSoapBinaryCodec::fromHex(const QChar *text, int length)
+{
+    return decodeHex(text, length);
+}
+
+QByteArray KDSoapBinaryCodec::fromHex(const char *text, int length)
+{
+    return decodeHex(text, length);
+}
+
+QByteArray KDSoapBinaryCodec::fromHex(const QString &text)
+{
+    return decodeHex(text.constData(), int(text.size()));
+}
+
+QByteArray KDSoapBinaryCodec::fromHexValue(const QVariant &value)
+{
+    if (value.userType() == QMetaType::QByteArray) {
+        const QByteArray text = value.toByteArray();
+        return decodeHex(text.constData(), int(text.size()));
+    }
+    return fromHex(value.toString());
+}
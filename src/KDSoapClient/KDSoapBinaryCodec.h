@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPBINARYCODEC_H
+#define KDSOAPBINARYCODEC_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+QT_BEGIN_NAMESPACE
+class QVariant;
+QT_END_NAMESPACE
+class KDSoapAttachment;
+
+/**
+ * Conversions between binary data and the text of xsd:base64Binary and xsd:hexBinary values.
+ *
+ * The results are the same as with QByteArray::toBase64(), QByteArray::fromBase64(),
+ * QByteArray::toHex() and QByteArray::fromHex(), but the text is read and written
+ * directly as UTF-16 (as used by QXmlStreamReader and QXmlStreamWriter), without
+ * going through an intermediate Latin-1 QByteArray. Where available (x86 with SSE2),
+ * the conversions process 16 characters at a time.
+ *
+ * This is used by KDSoapValue and by the code generated by kdwsdl2cpp.
+ *
+ * \since 2.2
+ */
+class KDSOAP_EXPORT KDSoapBinaryCodec // krazy:exclude=dpointer
+{
+public:
+    /**
+     * Returns the base64 encoding of \p data, with padding.
+     */
+    static QString toBase64(const QByteArray &data);
+    /**
+     * Returns the hexadecimal encoding of \p data, with lowercase letters.
+     */
+    static QString toHex(const QByteArray &data);
+
+    /**
+     * Decodes the base64 \p text of \p length characters.
+     * Like QByteArray::fromBase64(), characters which aren't part of the base64 alphabet
+     * (e.g. whitespace and padding) are skipped.
+     */
+    static QByteArray fromBase64(const QChar *text, int length);
+    /**
+     * \overload
+     */
+    static QByteArray fromBase64(const char *text, int length);
+    /**
+     * \overload
+     */
+    static QByteArray fromBase64(const QString &text);
+    /**
+     * Decodes the base64 text held by \p value, as returned by KDSoapValue::value():
+     * either a QString, or (with use=encoded) its UTF-8 representation in a QByteArray.
+     * For a KDSoapAttachment received with MTOM, returns its data.
+     */
+    static QByteArray fromBase64Value(const QVariant &value);
+    /**
+     * Returns the base64Binary \p value as an attachment, without decoding it in memory:
+     * a KDSoapAttachment received with MTOM is returned as is, base64 text is decoded
+     * on the fly while reading the (sequential) device of the returned attachment.
+     * Returns a null attachment if \p value is null.
+     *
+     * \note The base64 text itself was read in memory with the rest of the message:
+     * only the decoded data is produced block by block.
+     *
+     * This is used by the code generated by kdwsdl2cpp for the elements mapped
+     * to KDSoapAttachment with the -streaming-binary option.
+     */
+    static KDSoapAttachment toAttachment(const QVariant &value);
+
+    /**
+     * Decodes the hexadecimal \p text of \p length characters.
+     * Like QByteArray::fromHex(), invalid characters are skipped.
+     */
+    static QByteArray fromHex(const QChar *text, int length);
+    /**
+     * \overload
+     */
+    static QByteArray fromHex(const char *text, int length);
+    /**
+     * \overload
+     */
+    static QByteArray fromHex(const QString &text);
+    /**
+     * Decodes the hexadecimal text held by \p value, see fromBase64Value().
+     */
+    static QByteArray fromHexValue(const QVariant &value);
+
+private:
+    KDSoapBinaryCodec();
+};
+
+#endif // KDSOAPBINARYCODEC_H
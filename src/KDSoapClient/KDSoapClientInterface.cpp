@@ -9,40 +9,44 @@
 ****************************************************************************/
 #include "KDSoapClientInterface.h"
 #include "KDSoapClientInterface_p.h"
+#include "KDSoapCompression_p.h"
 #include "KDSoapMessageWriter_p.h"
+#include "KDSoapMultipart_p.h"
 #include "KDSoapNamespaceManager.h"
 #ifndef QT_NO_SSL
 #include "KDSoapReplySslHandler_p.h"
 #include "KDSoapSslHandler.h"
 #endif
 #include "KDSoapPendingCall_p.h"
+#include "KDSoapTimeoutScheduler_p.h"
 #include <QAuthenticator>
 #include <QBuffer>
 #include <QDebug>
+#include <QHttpMultiPart>
 #include <QNetworkProxy>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QScopedPointer>
 #include <QSslConfiguration>
-#include <QTimer>
 
 KDSoapClientInterface::KDSoapClientInterface(const QString &endPoint, const QString &messageNamespace)
     : d(new KDSoapClientInterfacePrivate)
 {
-    d->m_endPoint = endPoint;
+    d->m_loadBalancer.setEndPoints(QStringList(endPoint));
     d->m_messageNamespace = messageNamespace;
     d->m_version = KDSoap::SOAP1_1;
 }
 
 KDSoapClientInterface::~KDSoapClientInterface()
 {
-    d->m_thread.stop();
-    d->m_thread.wait();
+    d->m_threadPool.stop();
     delete d;
 }
 
 void KDSoapClientInterface::setSoapVersion(KDSoapClientInterface::SoapVersion version)
 {
     d->m_version = static_cast<KDSoap::SoapVersion>(version);
+    d->invalidateEnvelopeTemplate();
 }
 
 KDSoapClientInterface::SoapVersion KDSoapClientInterface::soapVersion() const
@@ -65,6 +69,8 @@ KDSoapClientInterfacePrivate::KDSoapClientInterfacePrivate()
 
 KDSoapClientInterfacePrivate::~KDSoapClientInterfacePrivate()
 {
+    // The replies in progress use m_retryState and m_loadBalancer when they are aborted
+    delete m_accessManager;
 #ifndef QT_NO_SSL
     delete m_sslHandler;
 #endif
@@ -74,19 +80,60 @@ QNetworkAccessManager *KDSoapClientInterfacePrivate::accessManager()
 {
     if (!m_accessManager) {
         m_accessManager = new QNetworkAccessManager(this);
+        // The asynchronous calls use the cookie jar under the same lock as the threads, see KDSoapSharedCookieJar
+        KDSoapSharedCookieJar *jar = m_threadPool.cookieJar();
+        if (!jar->target()) {
+            jar->setTarget(new QNetworkCookieJar(this));
+        }
+        m_accessManager->setCookieJar(jar);
+        jar->setParent(nullptr); // it belongs to m_threadPool, see comment in QNAM::setCookieJar...
         connect(m_accessManager, &QNetworkAccessManager::authenticationRequired, this, &KDSoapClientInterfacePrivate::_kd_slotAuthenticationRequired);
     }
     return m_accessManager;
 }
 
-QNetworkRequest KDSoapClientInterfacePrivate::prepareRequest(const QString &method, const QString &action)
-{
-    QNetworkRequest request(QUrl(this->m_endPoint));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+static const QNetworkRequest::Attribute s_http2AllowedAttribute = QNetworkRequest::Http2AllowedAttribute;
+#else
+static const QNetworkRequest::Attribute s_http2AllowedAttribute = QNetworkRequest::HTTP2AllowedAttribute;
+#endif
 
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    // HTTP/2 (on by default since Qt 6) creates trouble, disable it for now (https://github.com/KDAB/KDSoap/issues/246)
-    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+void KDSoapClientInterfacePrivate::setRequestEndPoint(QNetworkRequest &request, const QString &endPoint) const
+{
+    request.setUrl(QUrl(endPoint));
+
+    switch (m_http2Mode) {
+    case KDSoapClientInterface::Http2Disabled:
+        request.setAttribute(s_http2AllowedAttribute, false);
+        break;
+    case KDSoapClientInterface::Http2Negotiated:
+        // Only over TLS: before Qt 6.3, allowing HTTP/2 also meant upgrading plain HTTP connections ("h2c"),
+        // which creates trouble with SOAP servers (https://github.com/KDAB/KDSoap/issues/246)
+        request.setAttribute(s_http2AllowedAttribute, request.url().scheme().compare(QLatin1String("https"), Qt::CaseInsensitive) == 0);
+        break;
+    case KDSoapClientInterface::Http2PriorKnowledge:
+        request.setAttribute(s_http2AllowedAttribute, true);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        request.setAttribute(QNetworkRequest::Http2DirectAttribute, true);
 #endif
+        break;
+    }
+}
+
+QString KDSoapClientInterfacePrivate::balanceRequest(QNetworkRequest &request)
+{
+    if (!m_loadBalancer.isBalancing()) {
+        return QString();
+    }
+    const QString endPoint = m_loadBalancer.acquire();
+    setRequestEndPoint(request, endPoint);
+    return endPoint;
+}
+
+QNetworkRequest KDSoapClientInterfacePrivate::prepareRequest(const QString &method, const QString &action)
+{
+    QNetworkRequest request;
+    setRequestEndPoint(request, m_loadBalancer.firstEndPoint());
 
     QString soapAction = action;
 
@@ -114,13 +161,11 @@ QNetworkRequest KDSoapClientInterfacePrivate::prepareRequest(const QString &meth
 
     request.setHeader(QNetworkRequest::ContentTypeHeader, soapHeader.toUtf8());
 
-    // FIXME need to find out which version of Qt this is no longer necessary
-    // without that the server might respond with gzip compressed data and
-    // Qt 4.6.2 fails to decode that properly
-    //
-    // happens with retrieval calls in against SugarCRM 5.5.1 running on Apache 2.2.15
-    // when the response seems to reach a certain size threshold
-    request.setRawHeader("Accept-Encoding", "compress");
+    // Without an Accept-Encoding header, QNetworkAccessManager asks for gzip or deflate and decompresses the response,
+    // and so does KDSoapHttpTransport (when built with zlib)
+    if (!m_responseCompressionEnabled) {
+        request.setRawHeader("Accept-Encoding", "identity");
+    }
 
     for (QMap<QByteArray, QByteArray>::const_iterator it = m_httpHeaders.constBegin(); it != m_httpHeaders.constEnd(); ++it) {
         request.setRawHeader(it.key(), it.value());
@@ -135,17 +180,38 @@ QNetworkRequest KDSoapClientInterfacePrivate::prepareRequest(const QString &meth
     return request;
 }
 
-QBuffer *KDSoapClientInterfacePrivate::prepareRequestBuffer(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers)
+QBuffer *KDSoapClientInterfacePrivate::prepareRequestBuffer(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers,
+                                                            KDSoapRequestAttachments *attachments)
 {
     KDSoapMessageWriter msgWriter;
     msgWriter.setMessageNamespace(m_messageNamespace);
     msgWriter.setVersion(m_version);
+    if (attachments->mtom) {
+        msgWriter.setXopAttachments(&attachments->xopAttachments);
+    } else {
+        msgWriter.setStreamedAttachments(&attachments->streamedAttachments);
+    }
     QBuffer *buffer = new QBuffer;
     auto setBufferData = [=](const KDSoapMessage &msg) {
-        buffer->setData(msgWriter.messageToXml(msg,
-                                               (m_style == KDSoapClientInterface::RPCStyle) ? method : QString(),
-                                               headers, m_persistentHeaders,
-                                               m_authentication));
+        const QString methodName = (m_style == KDSoapClientInterface::RPCStyle) ? method : QString();
+        const QString operation = methodName.isEmpty() ? msg.name() : methodName;
+        int sizeHint;
+        {
+            QMutexLocker locker(&m_requestSizeHintsMutex);
+            sizeHint = m_requestSizeHints.value(operation);
+        }
+        // The QBuffer keeps the data until the upload is done, so each request gets its own byte array
+        QByteArray data;
+        if (KDSoapMessageWriter::supportsEnvelopeTemplate(msg, headers, m_authentication)) {
+            msgWriter.messageToXml(data, sizeHint, msg, methodName, envelopeTemplate(msgWriter, msg));
+        } else {
+            msgWriter.messageToXml(data, sizeHint, msg, methodName, headers, m_persistentHeaders, m_authentication);
+        }
+        {
+            QMutexLocker locker(&m_requestSizeHintsMutex);
+            m_requestSizeHints.insert(operation, data.size());
+        }
+        buffer->setData(data);
     };
 
     if (m_sendSoapActionInWsAddressingHeader) {
@@ -164,13 +230,101 @@ QBuffer *KDSoapClientInterfacePrivate::prepareRequestBuffer(const QString &metho
     return buffer;
 }
 
+QNetworkReply *KDSoapClientInterfacePrivate::post(QNetworkAccessManager *accessManager, QNetworkRequest request, QBuffer *buffer,
+                                                  const KDSoapRequestAttachments &attachments)
+{
+    const QString endPoint = balanceRequest(request);
+    QNetworkReply *reply = postBody(accessManager, request, buffer, attachments);
+    if (!endPoint.isEmpty()) {
+        KDSoapLoadBalancer *loadBalancer = &m_loadBalancer;
+        // In the thread of the reply, which can be the one of a blocking call
+        QObject::connect(reply, &QNetworkReply::finished, reply, [loadBalancer, reply, endPoint]() {
+            loadBalancer->release(endPoint, KDSoapLoadBalancer::outcome(reply));
+        });
+    }
+    return reply;
+}
+
+QNetworkReply *KDSoapClientInterfacePrivate::postBody(QNetworkAccessManager *accessManager, QNetworkRequest request, QBuffer *buffer,
+                                                      const KDSoapRequestAttachments &attachments)
+{
+    if (attachments.mtom) {
+        const QByteArray soapContentType = request.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+        const QByteArray boundary = KDSoapMultipart::generateBoundary();
+        request.setHeader(QNetworkRequest::ContentTypeHeader, KDSoapMultipart::contentType(soapContentType, boundary));
+        QHttpMultiPart *multiPart = KDSoapMultipart::createHttpMultiPart(buffer->data(), soapContentType, boundary, attachments.xopAttachments);
+        QNetworkReply *reply = accessManager->post(request, multiPart);
+        multiPart->setParent(reply); // deleted along with the reply
+        return reply;
+    }
+    if (!attachments.streamedAttachments.isEmpty()) {
+        KDSoapStreamingBody *body = new KDSoapStreamingBody(buffer->data(), attachments.streamedAttachments);
+        body->open(QIODevice::ReadOnly);
+        QNetworkReply *reply = accessManager->post(request, body);
+        body->setParent(reply); // deleted along with the reply
+        return reply;
+    }
+    if (shouldCompressRequest(buffer->size())) {
+        // buffer keeps the XML, for debugging output
+        QBuffer *compressed = new QBuffer;
+        compressed->setData(KDSoapCompression::compress(buffer->data(), KDSoapCompression::Gzip, m_compressionLevel));
+        compressed->open(QIODevice::ReadOnly);
+        request.setRawHeader("Content-Encoding", "gzip");
+        QNetworkReply *reply = accessManager->post(request, compressed);
+        compressed->setParent(reply); // deleted along with the reply
+        return reply;
+    }
+    return accessManager->post(request, buffer);
+}
+
+QNetworkReply *KDSoapClientInterfacePrivate::postCall(QNetworkAccessManager *accessManager, const QString &method, const QNetworkRequest &request,
+                                                      QBuffer *buffer, const KDSoapRequestAttachments &attachments)
+{
+    if (attachments.mtom || !attachments.streamedAttachments.isEmpty()) {
+        return post(accessManager, request, buffer, attachments);
+    }
+    const KDSoapRetryPolicy policy = m_retryState.policy(method);
+    if (policy.isNull()) {
+        return post(accessManager, request, buffer, attachments);
+    }
+    return new KDSoapRetryingReply(this, accessManager, request, buffer->data(), method, policy);
+}
+
+bool KDSoapClientInterfacePrivate::shouldCompressRequest(qint64 size) const
+{
+    return m_requestCompressionThreshold >= 0 && size >= m_requestCompressionThreshold && KDSoapCompression::isAvailable();
+}
+
+void KDSoapClientInterfacePrivate::invalidateEnvelopeTemplate()
+{
+    QMutexLocker locker(&m_envelopeTemplateMutex);
+    m_envelopeTemplate = KDSoapEnvelopeTemplate();
+}
+
+KDSoapEnvelopeTemplate KDSoapClientInterfacePrivate::envelopeTemplate(const KDSoapMessageWriter &msgWriter, const KDSoapMessage &message)
+{
+    QMutexLocker locker(&m_envelopeTemplateMutex);
+    if (!msgWriter.matchesEnvelopeTemplate(m_envelopeTemplate, message)) {
+        m_envelopeTemplate = msgWriter.envelopeTemplate(message, m_persistentHeaders, m_authentication);
+    }
+    return m_envelopeTemplate;
+}
+
 KDSoapPendingCall KDSoapClientInterface::asyncCall(const QString &method, const KDSoapMessage &message, const QString &soapAction,
                                                    const KDSoapHeaders &headers)
 {
-    QBuffer *buffer = d->prepareRequestBuffer(method, message, soapAction, headers);
+    return asyncCall(method, message, d->timeoutDeadline(), soapAction, headers);
+}
+
+KDSoapPendingCall KDSoapClientInterface::asyncCall(const QString &method, const KDSoapMessage &message, const QDeadlineTimer &deadline,
+                                                   const QString &soapAction, const KDSoapHeaders &headers)
+{
+    KDSoapRequestAttachments attachments;
+    attachments.mtom = d->m_mtomEnabled;
+    QBuffer *buffer = d->prepareRequestBuffer(method, message, soapAction, headers, &attachments);
     QNetworkRequest request = d->prepareRequest(method, soapAction);
-    QNetworkReply *reply = d->accessManager()->post(request, buffer);
-    d->setupReply(reply);
+    QNetworkReply *reply = d->postCall(d->accessManager(), method, request, buffer, attachments);
+    d->setupReply(reply, deadline);
     maybeDebugRequest(buffer->data(), reply->request(), reply);
     KDSoapPendingCall call(reply, buffer);
     call.d->soapVersion = d->m_version;
@@ -181,28 +335,113 @@ KDSoapMessage KDSoapClientInterface::call(const QString &method, const KDSoapMes
                                           const KDSoapHeaders &headers)
 {
     d->accessManager()->cookieJar(); // create it in the right thread, the secondary thread will use it
+    if (d->m_blockingCallTransport == NativeTransport) {
+        KDSoapHeaders responseHeaders;
+        KDSoapMessage ret = d->nativeCall(method, message, soapAction, headers, &responseHeaders);
+        QMutexLocker locker(&d->m_lastResponseHeadersMutex);
+        d->m_lastResponseHeaders = responseHeaders;
+        return ret;
+    }
     // Problem is: I don't want a nested event loop here. Too dangerous for GUI programs.
     // I wanted a socket->waitFor... but we don't have access to the actual socket in QNetworkAccess.
     // So the only option that remains is a thread and acquiring a semaphore...
     KDSoapThreadTaskData *task = new KDSoapThreadTaskData(this, method, message, soapAction, headers);
     task->m_authentication = d->m_authentication;
-    d->m_thread.enqueue(task);
-    if (!d->m_thread.isRunning()) {
-        d->m_thread.start();
-    }
+    d->m_threadPool.enqueue(task);
     task->waitForCompletion();
-    KDSoapMessage ret = task->response();
-    d->m_lastResponseHeaders = task->responseHeaders();
+    KDSoapMessage ret = std::move(task->m_response);
+    {
+        QMutexLocker locker(&d->m_lastResponseHeadersMutex);
+        d->m_lastResponseHeaders = task->responseHeaders();
+    }
     delete task;
     return ret;
 }
 
+KDSoapHttpTransport::Settings KDSoapClientInterfacePrivate::httpTransportSettings()
+{
+    KDSoapHttpTransport::Settings settings;
+    settings.proxy = accessManager()->proxy();
+    // The cookie jar is shared with the other threads making calls, and locked, see KDSoapSharedCookieJar
+    settings.cookieJar = m_threadPool.cookieJar();
+    settings.authentication = m_authentication;
+    settings.timeout = m_timeout;
+    settings.requestCompressionThreshold = m_requestCompressionThreshold;
+    settings.compressionLevel = m_compressionLevel;
+#ifndef QT_NO_SSL
+    settings.sslConfiguration = m_sslConfiguration;
+    settings.ignoreAllSslErrors = m_ignoreSslErrors;
+    settings.ignoredSslErrors = m_ignoreErrorsList;
+    settings.tlsKey = m_tlsKey;
+#endif
+    return settings;
+}
+
+KDSoapMessage KDSoapClientInterfacePrivate::nativeCall(const QString &method, const KDSoapMessage &message, const QString &soapAction,
+                                                       const KDSoapHeaders &headers, KDSoapHeaders *responseHeaders)
+{
+    // Headers should be always qualified, see KDSoapThreadTask::process
+    KDSoapHeaders qualifiedHeaders = headers;
+    for (KDSoapMessage &header : qualifiedHeaders) {
+        header.setQualified(true);
+    }
+
+    KDSoapRequestAttachments attachments;
+    attachments.mtom = m_mtomEnabled;
+    const QScopedPointer<QBuffer> buffer(prepareRequestBuffer(method, message, soapAction, qualifiedHeaders, &attachments));
+    QNetworkRequest request = prepareRequest(method, soapAction);
+    const QString endPoint = balanceRequest(request);
+    maybeDebugRequest(buffer->data(), request, nullptr);
+
+    const KDSoapHttpResponse response = m_httpTransport.post(request, buffer->data(), attachments, httpTransportSettings());
+    if (!endPoint.isEmpty()) {
+        m_loadBalancer.release(endPoint, KDSoapLoadBalancer::outcome(response.error, response.statusCode, response.header("Content-Type")));
+    }
+    maybeDebugResponse(response.body, response.headers);
+
+    KDSoapMessage replyMessage;
+    KDSoapPendingCall::Private::parseReplyData(response.body, response.header("Content-Type"), m_version, &replyMessage, responseHeaders);
+    if (response.error != QNetworkReply::NoError && !replyMessage.isFault()) {
+        responseHeaders->clear();
+        replyMessage.createFaultMessage(QString::number(response.error), response.errorString, m_version);
+    }
+    return replyMessage;
+}
+
+int KDSoapClientInterface::warmUp(int connections)
+{
+    int count = 0;
+    const QStringList endPoints = d->m_loadBalancer.endPoints();
+    for (const QString &endPoint : endPoints) {
+        const QUrl url(endPoint);
+        if (d->m_blockingCallTransport == NativeTransport) {
+            KDSoapHttpResponse response; // the error is reported by the next call
+            count += d->m_httpTransport.warmUp(url, connections, d->httpTransportSettings(), &response);
+            continue;
+        }
+        // QNetworkAccessManager opens the connections in the background, and keeps them for asyncCall() and callNoReply()
+        for (int i = 0; i < connections; ++i) {
+#ifndef QT_NO_SSL
+            if (url.scheme().compare(QLatin1String("https"), Qt::CaseInsensitive) == 0) {
+                d->accessManager()->connectToHostEncrypted(url.host(), url.port(443),
+                                                           d->m_sslConfiguration.isNull() ? QSslConfiguration::defaultConfiguration() : d->m_sslConfiguration);
+                continue;
+            }
+#endif
+            d->accessManager()->connectToHost(url.host(), url.port(80));
+        }
+    }
+    return count;
+}
+
 void KDSoapClientInterface::callNoReply(const QString &method, const KDSoapMessage &message,
                                         const QString &soapAction, const KDSoapHeaders &headers)
 {
-    QBuffer *buffer = d->prepareRequestBuffer(method, message, soapAction, headers);
+    KDSoapRequestAttachments attachments;
+    attachments.mtom = d->m_mtomEnabled;
+    QBuffer *buffer = d->prepareRequestBuffer(method, message, soapAction, headers, &attachments);
     QNetworkRequest request = d->prepareRequest(method, soapAction);
-    QNetworkReply *reply = d->accessManager()->post(request, buffer);
+    QNetworkReply *reply = d->post(d->accessManager(), request, buffer, attachments);
     d->setupReply(reply);
     maybeDebugRequest(buffer->data(), reply->request(), reply);
     QObject::connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
@@ -217,65 +456,58 @@ void KDSoapClientInterfacePrivate::_kd_slotAuthenticationRequired(QNetworkReply
 void KDSoapClientInterface::setAuthentication(const KDSoapAuthentication &authentication)
 {
     d->m_authentication = authentication;
+    d->invalidateEnvelopeTemplate();
 }
 
 QString KDSoapClientInterface::endPoint() const
 {
-    return d->m_endPoint;
+    return d->m_loadBalancer.firstEndPoint();
 }
 
 void KDSoapClientInterface::setEndPoint(const QString &endPoint)
 {
-    d->m_endPoint = endPoint;
+    d->m_loadBalancer.setEndPoints(QStringList(endPoint));
+}
+
+QStringList KDSoapClientInterface::endPoints() const
+{
+    return d->m_loadBalancer.endPoints();
+}
+
+void KDSoapClientInterface::setEndPoints(const QStringList &endPoints)
+{
+    d->m_loadBalancer.setEndPoints(endPoints);
 }
 
 void KDSoapClientInterface::setHeader(const QString &name, const KDSoapMessage &header)
 {
     d->m_persistentHeaders[name] = header;
     d->m_persistentHeaders[name].setQualified(true);
+    d->invalidateEnvelopeTemplate();
 }
 
 void KDSoapClientInterface::ignoreSslErrors()
 {
     d->m_ignoreSslErrors = true;
+#ifndef QT_NO_SSL
+    d->updateTlsKey();
+#endif
 }
 
 #ifndef QT_NO_SSL
 void KDSoapClientInterface::ignoreSslErrors(const QList<QSslError> &errors)
 {
     d->m_ignoreErrorsList = errors;
+    d->updateTlsKey();
 }
-#endif
 
-// Workaround for lack of connect-to-lambdas in Qt4
-// The pure Qt5 code could read like
-/*
-    QTimer *timeoutTimer = new QTimer(reply);
-    timeoutTimer->setSingleShot(true);
-    connect(timeoutTimer, &QTimer::timeout, reply, [reply]() { contents_of_the_slot });
-*/
-class TimeoutHandler : public QTimer // this way a single QObject is needed
-{
-    Q_OBJECT
-public:
-    TimeoutHandler(QNetworkReply *reply)
-        : QTimer(reply)
-    {
-        setSingleShot(true);
-    }
-public Q_SLOTS:
-    void replyTimeout()
-    {
-        QNetworkReply *reply = qobject_cast<QNetworkReply *>(parent());
-        Q_ASSERT(reply);
-
-        // contents_of_the_slot:
-        reply->setProperty("kdsoap_reply_timed_out", true); // see KDSoapPendingCall.cpp
-        reply->abort();
-    }
-};
+void KDSoapClientInterfacePrivate::updateTlsKey()
+{
+    m_tlsKey = KDSoapHttpTransport::tlsKey(m_sslConfiguration, m_ignoreSslErrors, m_ignoreErrorsList);
+}
+#endif
 
-void KDSoapClientInterfacePrivate::setupReply(QNetworkReply *reply)
+void KDSoapClientInterfacePrivate::setupReply(QNetworkReply *reply, const QDeadlineTimer &deadline)
 {
 #ifndef QT_NO_SSL
     if (m_ignoreSslErrors) {
@@ -290,18 +522,72 @@ void KDSoapClientInterfacePrivate::setupReply(QNetworkReply *reply)
         }
     }
 #endif
-    if (m_timeout >= 0) {
-        TimeoutHandler *timeoutHandler = new TimeoutHandler(reply);
-        connect(timeoutHandler, &TimeoutHandler::timeout, timeoutHandler, &TimeoutHandler::replyTimeout);
-        timeoutHandler->start(m_timeout);
+    if (!deadline.isForever()) {
+        KDSoapTimeoutScheduler::instance()->add(reply, deadline);
     }
 }
 
+QDeadlineTimer KDSoapClientInterfacePrivate::timeoutDeadline() const
+{
+    return m_timeout >= 0 ? QDeadlineTimer(m_timeout) : QDeadlineTimer(QDeadlineTimer::Forever);
+}
+
 KDSoapHeaders KDSoapClientInterface::lastResponseHeaders() const
 {
+    QMutexLocker locker(&d->m_lastResponseHeadersMutex);
     return d->m_lastResponseHeaders;
 }
 
+void KDSoapClientInterface::setMaxBlockingCallThreads(int count)
+{
+    d->m_threadPool.setMaxThreadCount(count);
+}
+
+int KDSoapClientInterface::maxBlockingCallThreads() const
+{
+    return d->m_threadPool.maxThreadCount();
+}
+
+void KDSoapClientInterface::setBlockingCallTransport(BlockingCallTransport transport)
+{
+    d->m_blockingCallTransport = transport;
+}
+
+KDSoapClientInterface::BlockingCallTransport KDSoapClientInterface::blockingCallTransport() const
+{
+    return d->m_blockingCallTransport;
+}
+
+void KDSoapClientInterface::setMaxConnectionsPerHost(int count)
+{
+    d->m_httpTransport.setMaxConnectionsPerHost(count);
+}
+
+int KDSoapClientInterface::maxConnectionsPerHost() const
+{
+    return d->m_httpTransport.maxConnectionsPerHost();
+}
+
+void KDSoapClientInterface::setConnectionIdleTimeout(int msecs)
+{
+    d->m_httpTransport.setIdleTimeout(msecs);
+}
+
+int KDSoapClientInterface::connectionIdleTimeout() const
+{
+    return d->m_httpTransport.idleTimeout();
+}
+
+KDSoapClientInterface::ConnectionPoolStatistics KDSoapClientInterface::connectionPoolStatistics() const
+{
+    return d->m_httpTransport.statistics();
+}
+
+void KDSoapClientInterface::resetConnectionPoolStatistics()
+{
+    d->m_httpTransport.resetStatistics();
+}
+
 void KDSoapClientInterface::setStyle(KDSoapClientInterface::Style style)
 {
     d->m_style = style;
@@ -314,14 +600,14 @@ KDSoapClientInterface::Style KDSoapClientInterface::style() const
 
 QNetworkCookieJar *KDSoapClientInterface::cookieJar() const
 {
-    return d->accessManager()->cookieJar();
+    d->accessManager(); // creates the default one
+    return d->m_threadPool.cookieJar()->target();
 }
 
 void KDSoapClientInterface::setCookieJar(QNetworkCookieJar *jar)
 {
-    QObject *oldParent = jar->parent();
-    d->accessManager()->setCookieJar(jar);
-    jar->setParent(oldParent); // see comment in QNAM::setCookieJar...
+    d->accessManager();
+    d->m_threadPool.cookieJar()->setTarget(jar);
 }
 
 void KDSoapClientInterface::setRawHTTPHeaders(const QMap<QByteArray, QByteArray> &headers)
@@ -369,6 +655,111 @@ void KDSoapClientInterface::setSendSoapActionInWsAddressingHeader(bool sendInWsA
     d->m_sendSoapActionInWsAddressingHeader = sendInWsAddressingHeader;
 }
 
+void KDSoapClientInterface::setMtomEnabled(bool enabled)
+{
+    d->m_mtomEnabled = enabled;
+}
+
+bool KDSoapClientInterface::isMtomEnabled() const
+{
+    return d->m_mtomEnabled;
+}
+
+void KDSoapClientInterface::setHttp2Mode(Http2Mode mode)
+{
+    d->m_http2Mode = mode;
+}
+
+KDSoapClientInterface::Http2Mode KDSoapClientInterface::http2Mode() const
+{
+    return d->m_http2Mode;
+}
+
+void KDSoapClientInterface::setResponseCompressionEnabled(bool enabled)
+{
+    d->m_responseCompressionEnabled = enabled;
+}
+
+bool KDSoapClientInterface::isResponseCompressionEnabled() const
+{
+    return d->m_responseCompressionEnabled;
+}
+
+void KDSoapClientInterface::setRequestCompressionThreshold(int bytes)
+{
+    d->m_requestCompressionThreshold = bytes;
+}
+
+int KDSoapClientInterface::requestCompressionThreshold() const
+{
+    return d->m_requestCompressionThreshold;
+}
+
+void KDSoapClientInterface::setCompressionLevel(int level)
+{
+    d->m_compressionLevel = level;
+}
+
+int KDSoapClientInterface::compressionLevel() const
+{
+    return d->m_compressionLevel;
+}
+
+void KDSoapClientInterface::setRetryPolicy(const QString &method, const KDSoapRetryPolicy &policy)
+{
+    d->m_retryState.setPolicy(method, policy);
+}
+
+KDSoapRetryPolicy KDSoapClientInterface::retryPolicy(const QString &method) const
+{
+    return d->m_retryState.policy(method);
+}
+
+void KDSoapClientInterface::setRetryBudget(int maxTokens, double tokenRatio)
+{
+    d->m_retryState.setBudget(maxTokens, tokenRatio);
+}
+
+int KDSoapClientInterface::retryBudgetMaxTokens() const
+{
+    return d->m_retryState.budgetMaxTokens();
+}
+
+double KDSoapClientInterface::retryBudgetTokenRatio() const
+{
+    return d->m_retryState.budgetTokenRatio();
+}
+
+void KDSoapClientInterface::setLoadBalancing(LoadBalancing loadBalancing)
+{
+    d->m_loadBalancer.setPolicy(loadBalancing);
+}
+
+KDSoapClientInterface::LoadBalancing KDSoapClientInterface::loadBalancing() const
+{
+    return d->m_loadBalancer.policy();
+}
+
+void KDSoapClientInterface::setEndPointEjection(int consecutiveFailures, int msecs)
+{
+    d->m_loadBalancer.setEjection(consecutiveFailures, msecs);
+}
+
+int KDSoapClientInterface::endPointEjectionFailures() const
+{
+    return d->m_loadBalancer.failureThreshold();
+}
+
+int KDSoapClientInterface::endPointEjectionTime() const
+{
+    return d->m_loadBalancer.ejectionTime();
+}
+
+QStringList KDSoapClientInterface::ejectedEndPoints() const
+{
+    return d->m_loadBalancer.ejectedEndPoints();
+}
+
 #ifndef QT_NO_OPENSSL
 QSslConfiguration KDSoapClientInterface::sslConfiguration() const
 {
@@ -378,6 +769,7 @@ QSslConfiguration KDSoapClientInterface::sslConfiguration() const
 void KDSoapClientInterface::setSslConfiguration(const QSslConfiguration &config)
 {
     d->m_sslConfiguration = config;
+    d->updateTlsKey();
 }
 
 KDSoapSslHandler *KDSoapClientInterface::sslHandler() const
@@ -389,5 +781,4 @@ KDSoapSslHandler *KDSoapClientInterface::sslHandler() const
 }
 #endif
 
-#include "KDSoapClientInterface.moc"
 #include "moc_KDSoapClientInterface_p.cpp"
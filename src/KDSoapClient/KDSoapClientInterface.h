@@ -12,7 +12,10 @@
 
 #include "KDSoapMessage.h"
 #include "KDSoapPendingCall.h"
+#include "KDSoapRetryPolicy.h"
+#include <QtCore/QDeadlineTimer>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QtGlobal>
 
 class KDSoapAuthentication;
@@ -129,6 +132,18 @@ public:
     KDSoapPendingCall asyncCall(const QString &method, const KDSoapMessage &message, const QString &soapAction = QString(),
                                 const KDSoapHeaders &headers = KDSoapHeaders());
 
+    /**
+     * Calls the method \p method on this interface, like asyncCall() above, but with its own \p deadline
+     * instead of the timeout(): if the response isn't complete when \p deadline expires, the call
+     * finishes with an "Operation timed out" fault. QDeadlineTimer::Forever disables the timeout of this call.
+     *
+     * The deadlines of all the calls made from a thread are handled together, at a 10ms granularity,
+     * so that thousands of calls in flight don't need a timer each.
+     * \since 2.2
+     */
+    KDSoapPendingCall asyncCall(const QString &method, const KDSoapMessage &message, const QDeadlineTimer &deadline,
+                                const QString &soapAction = QString(), const KDSoapHeaders &headers = KDSoapHeaders());
+
     /**
      * Calls the method \p method on this interface and passes the parameters specified in \p message
      * to the method.
@@ -188,7 +203,7 @@ public:
     KDSoapClientInterface::SoapVersion soapVersion() const;
 
     /**
-     * Returns the end point of the SOAP service.
+     * Returns the end point of the SOAP service (the first one, if several were set with setEndPoints()).
      * \since 1.2
      */
     QString endPoint() const;
@@ -201,6 +216,21 @@ public:
      */
     void setEndPoint(const QString &endPoint);
 
+    /**
+     * Returns the end points of the SOAP service.
+     * \since 2.2
+     */
+    QStringList endPoints() const;
+
+    /**
+     * Sets the end points of replicas of the SOAP service: the requests are spread over them,
+     * as set by setLoadBalancing(). Duplicates are ignored.
+     *
+     * An end point where requests keep failing is ejected for a while, see setEndPointEjection().
+     * \since 2.2
+     */
+    void setEndPoints(const QStringList &endPoints);
+
     /**
      * Returns the cookie jar to use for the HTTP requests.
      * If no cookie jar was set by setCookieJar previously, a default
@@ -376,6 +406,367 @@ public:
      */
     bool sendSoapActionInWsAddressingHeader() const;
 
+    /**
+     * Enables MTOM/XOP (https://www.w3.org/TR/soap12-mtom/) for the requests: the binary values
+     * of the message (KDSoapAttachment and QByteArray values, except for xsd:hexBinary) are sent as
+     * MIME parts of a multipart/related request, rather than as base64 text in the envelope.
+     * Attachments given as a QIODevice are streamed from the device.
+     * The requests are then always multipart/related messages, even without any binary values,
+     * which lets KDSoap servers know that they can reply with MTOM as well.
+     *
+     * MTOM responses are always accepted: the binary values of the response are then
+     * KDSoapAttachment values, which read the data where it was received.
+     *
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setMtomEnabled(bool enabled);
+
+    /**
+     * Returns true if MTOM/XOP is used for the requests.
+     * \since 2.2
+     */
+    bool isMtomEnabled() const;
+
+    /**
+     * How HTTP/2 is used by the QNetworkAccessManager sending the requests.
+     * \see setHttp2Mode()
+     * \since 2.2
+     */
+    enum Http2Mode
+    {
+        /** HTTP/1.1 only */
+        Http2Disabled,
+        /** HTTP/2 over TLS if the server offers it (ALPN), HTTP/1.1 otherwise */
+        Http2Negotiated,
+        /** HTTP/2 right away, including over plain HTTP ("prior knowledge"): the server has to support it */
+        Http2PriorKnowledge
+    };
+
+    /**
+     * Sets how HTTP/2 is used. With HTTP/2, the calls made at the same time to the same server (e.g. with asyncCall())
+     * are multiplexed over a single connection, instead of using up to six connections and waiting for one of them to be free.
+     *
+     * Plain HTTP connections are never upgraded to HTTP/2 with Http2Negotiated, since most SOAP servers don't expect the
+     * upgrade request: use Http2PriorKnowledge for servers which support HTTP/2 without TLS, such as KDSoapServer
+     * with the KDSoapServer::Http2 feature.
+     *
+     * This has no effect on call() with NativeTransport, which always uses HTTP/1.1.
+     * Http2PriorKnowledge requires Qt 5.11.
+     * \since 2.2
+     */
+    void setHttp2Mode(Http2Mode mode);
+
+    /**
+     * Returns how HTTP/2 is used. The default is Http2Disabled, as HTTP/2 was always disabled before KDSoap 2.2,
+     * even with Qt 6, where QNetworkAccessManager negotiates it by default.
+     * \since 2.2
+     */
+    Http2Mode http2Mode() const;
+
+    /**
+     * Sets whether compressed responses are accepted. When enabled, the requests offer gzip and deflate
+     * in their Accept-Encoding header, and the compressed responses are decompressed as they are received,
+     * by QNetworkAccessManager or by NativeTransport. When disabled, the requests ask for uncompressed
+     * responses ("Accept-Encoding: identity").
+     *
+     * An Accept-Encoding header set with setRawHTTPHeaders() takes precedence; QNetworkAccessManager then
+     * leaves the response as is.
+     *
+     * This option is enabled by default. NativeTransport only decompresses responses when KD Soap was built with zlib.
+     * \since 2.2
+     */
+    void setResponseCompressionEnabled(bool enabled);
+
+    /**
+     * Returns true if compressed responses are accepted.
+     * \since 2.2
+     */
+    bool isResponseCompressionEnabled() const;
+
+    /**
+     * Sets the size, in bytes, from which the requests are compressed with gzip (and sent with "Content-Encoding: gzip").
+     * The server has to support compressed requests, as KDSoapServer does.
+     *
+     * MTOM requests, and requests with attachments streamed from a QIODevice, are never compressed.
+     * Compression requires KD Soap to be built with zlib.
+     *
+     * The default value, -1, disables the compression of requests.
+     * \since 2.2
+     */
+    void setRequestCompressionThreshold(int bytes);
+
+    /**
+     * Returns the size from which the requests are compressed, -1 if they are never compressed.
+     * \since 2.2
+     */
+    int requestCompressionThreshold() const;
+
+    /**
+     * Sets the compression level used for the requests, from 1 (fastest) to 9 (smallest).
+     * The default value, -1, uses the default level of zlib (6).
+     * \since 2.2
+     */
+    void setCompressionLevel(int level);
+
+    /**
+     * Returns the compression level used for the requests.
+     * \since 2.2
+     */
+    int compressionLevel() const;
+
+    /**
+     * Sets the maximum number of threads processing blocking calls.
+     *
+     * call() sends the request from a secondary thread, which has its own QNetworkAccessManager.
+     * By default there is a single such thread, so blocking calls made from several threads at
+     * the same time are processed one after the other. With a higher \p count, they are processed
+     * concurrently, each thread taking the next queued call when it's done with the previous one.
+     * Threads are only started when all the existing ones are busy, and are kept until the
+     * client interface is deleted. A lower count only affects the threads started afterwards.
+     *
+     * All the threads use the cookie jar and the proxy of this client interface.
+     * With concurrent calls, lastResponseHeaders() returns the headers of the call which finished last.
+     *
+     * \since 2.2
+     */
+    void setMaxBlockingCallThreads(int count);
+
+    /**
+     * Returns the maximum number of threads processing blocking calls. The default is 1.
+     * \since 2.2
+     */
+    int maxBlockingCallThreads() const;
+
+    /**
+     * How blocking calls are sent.
+     * \see setBlockingCallTransport()
+     * \since 2.2
+     */
+    enum BlockingCallTransport
+    {
+        /** In a secondary thread, with a QNetworkAccessManager (the default) */
+        QNetworkAccessManagerTransport,
+        /** On the calling thread, with a built-in HTTP/1.1 client */
+        NativeTransport
+    };
+
+    /**
+     * Sets how call() sends the request.
+     *
+     * With NativeTransport, the request is written and the response read on the thread calling call(),
+     * with a built-in HTTP/1.1 client, over a connection which is kept alive and pooled for the next calls,
+     * made by any thread (see setMaxConnectionsPerHost()). This avoids handing each call over to another
+     * thread, which matters for programs making many small blocking calls, e.g. batch tools.
+     *
+     * The timeout, the proxy, the cookie jar, the HTTP headers and the SSL configuration of this client
+     * interface are used as with QNetworkAccessManager, but only Basic authentication is supported,
+     * redirections aren't followed, and the signals of sslHandler() aren't emitted: use ignoreSslErrors()
+     * or the list of expected errors instead.
+     *
+     * This has no effect on asyncCall() and callNoReply().
+     * \since 2.2
+     */
+    void setBlockingCallTransport(BlockingCallTransport transport);
+
+    /**
+     * Returns how call() sends the request. The default is QNetworkAccessManagerTransport.
+     * \since 2.2
+     */
+    BlockingCallTransport blockingCallTransport() const;
+
+    /**
+     * Counters of the connection pool used by call() with NativeTransport.
+     * \see connectionPoolStatistics()
+     * \since 2.2
+     */
+    struct ConnectionPoolStatistics
+    {
+        /** The number of calls which reused an idle connection */
+        quint64 hits = 0;
+        /** The number of calls which had to open a new connection */
+        quint64 misses = 0;
+        /** The number of TLS handshakes made when opening connections */
+        quint64 tlsHandshakes = 0;
+        /** The number of connections currently open, idle or in use */
+        int openConnections = 0;
+        /** The number of connections currently open and waiting for a call */
+        int idleConnections = 0;
+    };
+
+    /**
+     * Sets the maximum number of connections opened by call() with NativeTransport to the same
+     * host, port and proxy, whether they are in use or idle. When all of them are in use, a call waits
+     * (within its timeout) for one of them to be released. 0 means no limit.
+     *
+     * The pool is shared by all the threads calling call() on this client interface, but not with
+     * asyncCall(), callNoReply() and call() with QNetworkAccessManagerTransport, whose connections
+     * are managed by QNetworkAccessManager.
+     * \since 2.2
+     */
+    void setMaxConnectionsPerHost(int count);
+
+    /**
+     * Returns the maximum number of connections to the same host, port and proxy. The default is 6.
+     * \since 2.2
+     */
+    int maxConnectionsPerHost() const;
+
+    /**
+     * Sets the time, in milliseconds, after which a connection which wasn't used by call() with
+     * NativeTransport is closed. A negative value keeps idle connections open until the server closes them.
+     *
+     * There's no timer for this, since NativeTransport doesn't need an event loop: the expired connections
+     * are closed the next time the pool is used, by call() or warmUp(), and when the client interface is deleted.
+     * \since 2.2
+     */
+    void setConnectionIdleTimeout(int msecs);
+
+    /**
+     * Returns the time after which idle connections are closed (see setConnectionIdleTimeout()).
+     * The default is 60000 (one minute).
+     * \since 2.2
+     */
+    int connectionIdleTimeout() const;
+
+    /**
+     * Returns the counters of the connection pool used by call() with NativeTransport,
+     * e.g. to check how often connections are reused.
+     * \since 2.2
+     */
+    ConnectionPoolStatistics connectionPoolStatistics() const;
+
+    /**
+     * Resets the hits, misses and tlsHandshakes counters of connectionPoolStatistics() to 0.
+     * \since 2.2
+     */
+    void resetConnectionPoolStatistics();
+
+    /**
+     * Opens connections to endPoints() ahead of time, so that the first calls don't wait for
+     * the DNS lookup, the TCP connection and the TLS handshake.
+     *
+     * With NativeTransport, this blocks until \p connections connections (within maxConnectionsPerHost())
+     * to each end point are open and idle in the pool used by call(), and returns their total number. The idle connections which the
+     * server closed are replaced, and the others count as used, which resets their idle time: calling warmUp()
+     * regularly, e.g. from a QTimer with an interval shorter than connectionIdleTimeout(), keeps the
+     * connections ready. warmUp() doesn't send anything on the idle connections: TCP keep-alive is enabled
+     * on them, but with the intervals of the operating system, which are usually too long to keep NAT devices
+     * and firewalls from dropping them; the calls then have to open new connections.
+     *
+     * With QNetworkAccessManagerTransport, this only asks the QNetworkAccessManager used by asyncCall() and
+     * callNoReply() to open the connections to each end point in the background, and returns 0 right away.
+     * The threads of call() have their own QNetworkAccessManager, whose connections aren't opened ahead of time.
+     * \since 2.2
+     */
+    int warmUp(int connections = 1);
+
+    /**
+     * Sets the retry and hedging policy of the calls to \p method (the method name given to asyncCall() and call()),
+     * replacing the previous one. A null policy (the default) sends each request once.
+     *
+     * \warning Only set a policy for idempotent operations: the server can receive the same request more than once.
+     *
+     * The policy applies to asyncCall() and to call() with QNetworkAccessManagerTransport, but not to MTOM requests
+     * and requests with attachments streamed from a QIODevice, which are sent once. The timeout() (or deadline)
+     * of a call covers all of its requests.
+     *
+     * The code generated by kdwsdl2cpp sets KDSoapRetryPolicy::idempotentPolicy() for the operations given with -idempotent.
+     * \since 2.2
+     */
+    void setRetryPolicy(const QString &method, const KDSoapRetryPolicy &policy);
+
+    /**
+     * Returns the retry and hedging policy of the calls to \p method.
+     * \since 2.2
+     */
+    KDSoapRetryPolicy retryPolicy(const QString &method) const;
+
+    /**
+     * Sets the budget limiting the retried and hedged requests of all the operations, and refills it.
+     * The budget starts with \p maxTokens tokens. Each request which fails with a transport error takes one token,
+     * and each successful one gives back \p tokenRatio token. Requests are only retried or hedged while there are
+     * more than \p maxTokens / 2 tokens, so that retries don't add to the load of a server which keeps failing.
+     *
+     * The default is 10 tokens, with a ratio of 0.1.
+     * \since 2.2
+     */
+    void setRetryBudget(int maxTokens, double tokenRatio);
+
+    /**
+     * Returns the maximum number of tokens of the retry budget.
+     * \since 2.2
+     */
+    int retryBudgetMaxTokens() const;
+
+    /**
+     * Returns the number of tokens given back to the retry budget by each successful request.
+     * \since 2.2
+     */
+    double retryBudgetTokenRatio() const;
+
+    /**
+     * How the end point of each request is chosen, when there are several of them.
+     * \see setEndPoints(), setLoadBalancing()
+     * \since 2.2
+     */
+    enum LoadBalancing
+    {
+        /** Each end point in turn (the default) */
+        RoundRobin,
+        /** The end point with the fewest requests in progress, from this client interface */
+        LeastOutstandingRequests,
+        /** The one with the fewest requests in progress out of two end points picked at random,
+         *  which avoids sending bursts of requests to the same end point */
+        PowerOfTwoChoices
+    };
+
+    /**
+     * Sets how the end point of each request is chosen among endPoints().
+     *
+     * This applies to asyncCall(), callNoReply() and call() with both transports. Each request sent again
+     * because of a KDSoapRetryPolicy gets its own end point, so retries usually go to another replica.
+     * \since 2.2
+     */
+    void setLoadBalancing(LoadBalancing loadBalancing);
+
+    /**
+     * Returns how the end point of each request is chosen among endPoints().
+     * \since 2.2
+     */
+    LoadBalancing loadBalancing() const;
+
+    /**
+     * Sets when an end point is considered unhealthy: after \p consecutiveFailures requests failing in a row
+     * with a transport error (e.g. connection refused, host not found, timeout) or a 5xx HTTP status
+     * (other than a SOAP fault), no requests are sent to it for \p msecs milliseconds, unless all
+     * the end points are ejected. 0 disables ejection.
+     * Requests which are canceled before their end point answers, e.g. the request which lost the race
+     * when hedging (see KDSoapRetryPolicy), neither count as failures nor reset the count.
+     *
+     * The default is 3 failures, and 30000 milliseconds (30 seconds).
+     * \since 2.2
+     */
+    void setEndPointEjection(int consecutiveFailures, int msecs);
+
+    /**
+     * Returns the number of consecutive failures after which an end point is ejected.
+     * \since 2.2
+     */
+    int endPointEjectionFailures() const;
+
+    /**
+     * Returns the time during which an ejected end point doesn't get requests, in milliseconds.
+     * \since 2.2
+     */
+    int endPointEjectionTime() const;
+
+    /**
+     * Returns the end points which are currently ejected, see setEndPointEjection().
+     * \since 2.2
+     */
+    QStringList ejectedEndPoints() const;
+
 private:
     friend class KDSoapThreadTask;
     KDSoapClientInterfacePrivate *const d;
@@ -10,6 +10,9 @@
 #ifndef KDSOAPCLIENTINTERFACE_P_H
 #define KDSOAPCLIENTINTERFACE_P_H
 
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
 #include <QtCore/QXmlStreamWriter>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkCookieJar>
@@ -18,12 +21,26 @@
 #include "KDSoapAuthentication.h"
 #include "KDSoapClientInterface.h"
 #include "KDSoapClientThread_p.h"
+#include "KDSoapHttpTransport_p.h"
+#include "KDSoapLoadBalancer_p.h"
+#include "KDSoapMessageWriter_p.h"
+#include "KDSoapRetryingReply_p.h"
+#include "KDSoapStreamingBody_p.h"
 QT_BEGIN_NAMESPACE
 class QBuffer;
 QT_END_NAMESPACE
+class KDSoapAttachment;
 class KDSoapMessage;
 class KDSoapNamespacePrefixes;
 
+// The binary values of a request which aren't written into its envelope
+struct KDSoapRequestAttachments
+{
+    bool mtom = false;
+    QVector<KDSoapAttachment> xopAttachments; // sent as MIME parts, with MTOM
+    QVector<KDSoapStreamedAttachment> streamedAttachments; // encoded while sending, otherwise
+};
+
 class KDSoapClientInterfacePrivate : public QObject
 {
     Q_OBJECT
@@ -32,34 +49,84 @@ public:
     ~KDSoapClientInterfacePrivate();
 
     // Warning: this accessManager is only used by asyncCall and callNoReply.
-    // For blocking calls, the thread has its own accessManager.
+    // For blocking calls, each thread of the pool has its own accessManager.
     QNetworkAccessManager *m_accessManager;
-    QString m_endPoint;
+    KDSoapLoadBalancer m_loadBalancer;
     QString m_messageNamespace;
-    KDSoapClientThread m_thread;
+    KDSoapClientThreadPool m_threadPool;
     KDSoapAuthentication m_authentication;
     QMap<QString, KDSoapMessage> m_persistentHeaders;
     QMap<QByteArray, QByteArray> m_httpHeaders;
     KDSoap::SoapVersion m_version;
     KDSoapClientInterface::Style m_style;
     bool m_ignoreSslErrors;
+    QMutex m_lastResponseHeadersMutex; // call() can be used from several threads
     KDSoapHeaders m_lastResponseHeaders;
 #ifndef QT_NO_SSL
     QList<QSslError> m_ignoreErrorsList;
     QSslConfiguration m_sslConfiguration;
     KDSoapSslHandler *m_sslHandler;
+    QByteArray m_tlsKey; // see updateTlsKey()
 #endif
     int m_timeout;
     bool m_sendSoapActionInHttpHeader = true;
     bool m_sendSoapActionInWsAddressingHeader = false;
+    bool m_mtomEnabled = false;
+    KDSoapClientInterface::Http2Mode m_http2Mode = KDSoapClientInterface::Http2Disabled;
+    bool m_responseCompressionEnabled = true;
+    int m_requestCompressionThreshold = -1;
+    int m_compressionLevel = -1;
+    KDSoapClientInterface::BlockingCallTransport m_blockingCallTransport = KDSoapClientInterface::QNetworkAccessManagerTransport;
+    KDSoapHttpTransport m_httpTransport; // for NativeTransport
+    KDSoapRetryState m_retryState;
+
+    // Envelope up to <Body>, reused as long as the version, persistent headers and authentication don't change.
+    // Protected by a mutex since blocking calls prepare their request in the threads of the pool.
+    QMutex m_envelopeTemplateMutex;
+    KDSoapEnvelopeTemplate m_envelopeTemplate;
+    void invalidateEnvelopeTemplate();
+#ifndef QT_NO_SSL
+    // Called when the TLS settings change, so that the connections of NativeTransport aren't reused with other ones
+    void updateTlsKey();
+#endif
+    KDSoapEnvelopeTemplate envelopeTemplate(const KDSoapMessageWriter &msgWriter, const KDSoapMessage &message);
+
+    // Size of the last request for each operation, to allocate the next one in one go
+    QMutex m_requestSizeHintsMutex;
+    QHash<QString, int> m_requestSizeHints;
 
     QNetworkAccessManager *accessManager();
+    // The settings of this client interface, for m_httpTransport
+    KDSoapHttpTransport::Settings httpTransportSettings();
+    // Blocking call with NativeTransport, on the calling thread
+    KDSoapMessage nativeCall(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers,
+                             KDSoapHeaders *responseHeaders);
     QNetworkRequest prepareRequest(const QString &method, const QString &action);
-    QBuffer *prepareRequestBuffer(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers);
+    // Sets the URL of request, and the HTTP/2 attributes depending on its scheme
+    void setRequestEndPoint(QNetworkRequest &request, const QString &endPoint) const;
+    // When there are several end points, sends request to the next one and returns it, for m_loadBalancer.release()
+    QString balanceRequest(QNetworkRequest &request);
+    // Attachments are collected into attachments (as MTOM parts if attachments->mtom is set) instead of being written in the envelope
+    QBuffer *prepareRequestBuffer(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers,
+                                  KDSoapRequestAttachments *attachments);
+    // Posts the envelope in buffer (compressed if it's large enough), along with the attachments collected by prepareRequestBuffer,
+    // to the next end point
+    QNetworkReply *post(QNetworkAccessManager *accessManager, QNetworkRequest request, QBuffer *buffer, const KDSoapRequestAttachments &attachments);
+    QNetworkReply *postBody(QNetworkAccessManager *accessManager, QNetworkRequest request, QBuffer *buffer, const KDSoapRequestAttachments &attachments);
+    bool shouldCompressRequest(qint64 size) const;
+    // Posts like post(), but through a KDSoapRetryingReply if there's a retry policy for method, and the request can be sent again
+    QNetworkReply *postCall(QNetworkAccessManager *accessManager, const QString &method, const QNetworkRequest &request, QBuffer *buffer,
+                            const KDSoapRequestAttachments &attachments);
     void writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapValue &element, KDSoapMessage::Use use);
     void writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapValueList &args, KDSoapMessage::Use use);
     void writeAttributes(QXmlStreamWriter &writer, const QList<KDSoapValue> &attributes);
-    void setupReply(QNetworkReply *reply);
+    // The deadline of a call made now, from the timeout
+    QDeadlineTimer timeoutDeadline() const;
+    void setupReply(QNetworkReply *reply)
+    {
+        setupReply(reply, timeoutDeadline());
+    }
+    void setupReply(QNetworkReply *reply, const QDeadlineTimer &deadline);
 
 private Q_SLOTS:
     void _kd_slotAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator);
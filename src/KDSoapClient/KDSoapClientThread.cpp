@@ -8,6 +8,7 @@
 **
 ****************************************************************************/
 
+#include "KDSoapAttachment.h"
 #include "KDSoapClientInterface.h"
 #include "KDSoapClientInterface_p.h"
 #include "KDSoapClientThread_p.h"
@@ -21,43 +22,95 @@
 #include <QNetworkProxy>
 #include <QNetworkRequest>
 
-KDSoapClientThread::KDSoapClientThread(QObject *parent)
-    : QThread(parent)
-    , m_stopThread(false)
+KDSoapClientThreadPool::KDSoapClientThreadPool()
+    : m_busyThreads(0)
+    , m_maxThreadCount(1)
+    , m_stopThreads(false)
 {
 }
 
-// Called by the main thread
-void KDSoapClientThread::enqueue(KDSoapThreadTaskData *taskData)
+KDSoapClientThreadPool::~KDSoapClientThreadPool()
 {
-    // On hindsight, it would have been simpler to use signal/slots
-    // to communicate with secondary thread (turning this class
-    // into a simple QObject with a QThread internally)
+    stop();
+}
 
+void KDSoapClientThreadPool::setMaxThreadCount(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxThreadCount = qMax(1, count);
+}
+
+int KDSoapClientThreadPool::maxThreadCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxThreadCount;
+}
+
+// Called by the threads making blocking calls
+void KDSoapClientThreadPool::enqueue(KDSoapThreadTaskData *taskData)
+{
     QMutexLocker locker(&m_mutex);
     m_queue.append(taskData);
+    // Threads which aren't busy are either waiting for a task or about to take one
+    const int availableThreads = m_threads.count() - m_busyThreads;
+    if (availableThreads < m_queue.count() && m_threads.count() < m_maxThreadCount) {
+        KDSoapClientThread *thread = new KDSoapClientThread(this);
+        m_threads.append(thread);
+        thread->start();
+    }
     m_queueNotEmpty.wakeOne();
 }
 
+KDSoapThreadTaskData *KDSoapClientThreadPool::takeTask()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_stopThreads && m_queue.isEmpty()) {
+        m_queueNotEmpty.wait(&m_mutex);
+    }
+    if (m_stopThreads) {
+        return nullptr;
+    }
+    ++m_busyThreads;
+    return m_queue.dequeue();
+}
+
+void KDSoapClientThreadPool::taskDone()
+{
+    QMutexLocker locker(&m_mutex);
+    --m_busyThreads;
+}
+
+void KDSoapClientThreadPool::stop()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stopThreads = true;
+    m_queueNotEmpty.wakeAll();
+    const QVector<KDSoapClientThread *> threads = m_threads;
+    m_threads.clear();
+    locker.unlock();
+
+    for (KDSoapClientThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+KDSoapClientThread::KDSoapClientThread(KDSoapClientThreadPool *pool)
+    : m_pool(pool)
+{
+}
+
 void KDSoapClientThread::run()
 {
+    // Each thread has its own access manager, so that the calls of different threads
+    // are really processed in parallel
     QNetworkAccessManager accessManager;
     // Use own QEventLoop so its slot quit() is executed in this thread
     // (using QThread::exec/quit would try to call QThread::quit() in main thread,
     //  which is blocked on semaphore)
     QEventLoop eventLoop;
 
-    while (true) {
-        QMutexLocker locker(&m_mutex);
-        while (!m_stopThread && m_queue.isEmpty()) {
-            m_queueNotEmpty.wait(&m_mutex);
-        }
-        if (m_stopThread) {
-            break;
-        }
-        KDSoapThreadTaskData *taskData = m_queue.dequeue();
-        locker.unlock();
-
+    while (KDSoapThreadTaskData *taskData = m_pool->takeTask()) {
         KDSoapThreadTask task(taskData); // must be created here, so that it's in the right thread
         connect(&task, &KDSoapThreadTask::taskDone, &eventLoop, &QEventLoop::quit);
         connect(&accessManager, &QNetworkAccessManager::authenticationRequired, &task, &KDSoapThreadTask::slotAuthenticationRequired);
@@ -65,9 +118,52 @@ void KDSoapClientThread::run()
 
         // Process events until the task tells us the handling of that task is finished
         eventLoop.exec();
+        m_pool->taskDone();
     }
 }
 
+void KDSoapSharedCookieJar::setTarget(QNetworkCookieJar *jar)
+{
+    QMutexLocker locker(&m_mutex);
+    m_target = jar;
+}
+
+QNetworkCookieJar *KDSoapSharedCookieJar::target() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_target;
+}
+
+QList<QNetworkCookie> KDSoapSharedCookieJar::cookiesForUrl(const QUrl &url) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_target ? m_target->cookiesForUrl(url) : QList<QNetworkCookie>();
+}
+
+bool KDSoapSharedCookieJar::setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_target && m_target->setCookiesFromUrl(cookieList, url);
+}
+
+bool KDSoapSharedCookieJar::insertCookie(const QNetworkCookie &cookie)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_target && m_target->insertCookie(cookie);
+}
+
+bool KDSoapSharedCookieJar::updateCookie(const QNetworkCookie &cookie)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_target && m_target->updateCookie(cookie);
+}
+
+bool KDSoapSharedCookieJar::deleteCookie(const QNetworkCookie &cookie)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_target && m_target->deleteCookie(cookie);
+}
+
 void KDSoapThreadTask::process(QNetworkAccessManager &accessManager)
 {
     // Can't use m_iface->asyncCall, it would use the accessmanager from the main thread
@@ -78,17 +174,20 @@ void KDSoapThreadTask::process(QNetworkAccessManager &accessManager)
         header.setQualified(true);
     }
 
-    QNetworkCookieJar *jar = m_data->m_iface->d->accessManager()->cookieJar();
-    accessManager.setCookieJar(jar);
+    // The cookie jar of the interface is shared with the other threads, see KDSoapSharedCookieJar
+    accessManager.setCookieJar(m_data->m_iface->d->m_threadPool.cookieJar());
 
     accessManager.setProxy(m_data->m_iface->d->accessManager()->proxy());
 
+    KDSoapRequestAttachments attachments;
+    attachments.mtom = m_data->m_iface->d->m_mtomEnabled;
     QBuffer *buffer = m_data->m_iface->d->prepareRequestBuffer(m_data->m_method,
                                                                m_data->m_message,
                                                                m_data->m_action,
-                                                               m_data->m_headers);
+                                                               m_data->m_headers,
+                                                               &attachments);
     QNetworkRequest request = m_data->m_iface->d->prepareRequest(m_data->m_method, m_data->m_action);
-    QNetworkReply *reply = accessManager.post(request, buffer);
+    QNetworkReply *reply = m_data->m_iface->d->postCall(&accessManager, m_data->m_method, request, buffer, attachments);
     m_data->m_iface->d->setupReply(reply);
     maybeDebugRequest(buffer->data(), reply->request(), reply);
     KDSoapPendingCall pendingCall(reply, buffer);
@@ -110,13 +209,6 @@ void KDSoapThreadTask::slotFinished(KDSoapPendingCallWatcher *watcher)
     emit taskDone();
 }
 
-void KDSoapClientThread::stop()
-{
-    QMutexLocker locker(&m_mutex);
-    m_stopThread = true;
-    m_queueNotEmpty.wakeAll();
-}
-
 void KDSoapThreadTask::slotAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator)
 {
     m_data->m_authentication.handleAuthenticationRequired(reply, authenticator);
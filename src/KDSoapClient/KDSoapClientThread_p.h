@@ -18,10 +18,13 @@
 #include <QtCore/QSemaphore>
 #include <QtCore/QThread>
 #include <QtCore/QWaitCondition>
+#include <QtCore/QVector>
 #include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkCookieJar>
 
 class KDSoapPendingCallWatcher;
 class KDSoapClientInterface;
+class KDSoapClientThreadPool;
 QT_BEGIN_NAMESPACE
 class QEventLoop;
 QT_END_NAMESPACE
@@ -85,24 +88,75 @@ private:
     KDSoapThreadTaskData *m_data;
 };
 
+// The cookie jar set on the access managers of the interface and of the threads.
+// The cookie jar of the interface isn't thread-safe, while several threads can
+// now use it at the same time, so this forwards to it under a lock.
+class KDSoapSharedCookieJar : public QNetworkCookieJar
+{
+public:
+    void setTarget(QNetworkCookieJar *jar);
+    QNetworkCookieJar *target() const;
+
+    QList<QNetworkCookie> cookiesForUrl(const QUrl &url) const override;
+    bool setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url) override;
+    bool insertCookie(const QNetworkCookie &cookie) override;
+    bool updateCookie(const QNetworkCookie &cookie) override;
+    bool deleteCookie(const QNetworkCookie &cookie) override;
+
+private:
+    mutable QMutex m_mutex;
+    QNetworkCookieJar *m_target = nullptr;
+};
+
 class KDSoapClientThread : public QThread
 {
     Q_OBJECT
 public:
-    explicit KDSoapClientThread(QObject *parent = nullptr);
+    explicit KDSoapClientThread(KDSoapClientThreadPool *pool);
+
+protected:
+    virtual void run() override;
+
+private:
+    KDSoapClientThreadPool *m_pool;
+};
+
+// The threads processing the blocking calls of a KDSoapClientInterface.
+// They all take their tasks from the same queue; a new thread is started
+// when no thread is available for a task, up to maxThreadCount().
+class KDSoapClientThreadPool
+{
+public:
+    KDSoapClientThreadPool();
+    ~KDSoapClientThreadPool();
+
+    void setMaxThreadCount(int count);
+    int maxThreadCount() const;
 
     void enqueue(KDSoapThreadTaskData *taskData);
 
+    // Stops the threads after their current task, and waits for them
     void stop();
 
-protected:
-    virtual void run() override;
+    KDSoapSharedCookieJar *cookieJar()
+    {
+        return &m_cookieJar;
+    }
 
 private:
-    QMutex m_mutex;
+    friend class KDSoapClientThread;
+    // Called by the threads: returns the next task, or nullptr when stopping
+    KDSoapThreadTaskData *takeTask();
+    void taskDone();
+
+    mutable QMutex m_mutex;
     QQueue<KDSoapThreadTaskData *> m_queue;
     QWaitCondition m_queueNotEmpty;
-    bool m_stopThread;
+    QVector<KDSoapClientThread *> m_threads;
+    int m_busyThreads;
+    int m_maxThreadCount;
+    bool m_stopThreads;
+    KDSoapSharedCookieJar m_cookieJar;
 };
 
 #endif // KDSOAPCLIENTTHREAD_P_H
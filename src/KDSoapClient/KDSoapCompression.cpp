@@ -0,0 +1,290 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapCompression_p.h"
+#include <QList>
+
+#ifdef KDSOAP_HAVE_ZLIB
+#include <zlib.h>
+#include <cstring>
+
+// zlib's windowBits: the maximum window, plus 16 for the gzip format, or negated for raw deflate data
+static const int s_windowBits = 15;
+#endif
+
+bool KDSoapCompression::isAvailable()
+{
+#ifdef KDSOAP_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool KDSoapCompression::parseContentEncoding(const QByteArray &contentEncoding, Encoding *encoding)
+{
+    const QByteArray name = contentEncoding.trimmed().toLower();
+    if (name.isEmpty() || name == "identity") {
+        *encoding = Identity;
+        return true;
+    }
+    if (!isAvailable()) {
+        return false;
+    }
+    if (name == "gzip" || name == "x-gzip") {
+        *encoding = Gzip;
+        return true;
+    }
+    if (name == "deflate") {
+        *encoding = Deflate;
+        return true;
+    }
+    return false;
+}
+
+KDSoapCompression::Encoding KDSoapCompression::negotiate(const QByteArray &acceptEncoding)
+{
+    if (!isAvailable()) {
+        return Identity;
+    }
+    // e.g. "gzip;q=1.0, deflate;q=0.5, *;q=0"
+    double gzipQuality = -1;
+    double deflateQuality = -1;
+    double anyQuality = -1;
+    const QList<QByteArray> items = acceptEncoding.split(',');
+    for (const QByteArray &item : items) {
+        const QList<QByteArray> parameters = item.split(';');
+        const QByteArray coding = parameters.first().trimmed().toLower();
+        double quality = 1;
+        for (int i = 1; i < parameters.size(); ++i) {
+            const QByteArray parameter = parameters.at(i).trimmed().toLower();
+            if (parameter.startsWith("q=")) {
+                quality = parameter.mid(2).toDouble(); // 0 if invalid
+            }
+        }
+        if (coding == "gzip" || coding == "x-gzip") {
+            gzipQuality = quality;
+        } else if (coding == "deflate") {
+            deflateQuality = quality;
+        } else if (coding == "*") {
+            anyQuality = quality;
+        }
+    }
+    if (gzipQuality < 0) {
+        gzipQuality = anyQuality;
+    }
+    if (deflateQuality < 0) {
+        deflateQuality = anyQuality;
+    }
+    if (gzipQuality > 0 && gzipQuality >= deflateQuality) {
+        return Gzip;
+    }
+    if (deflateQuality > 0) {
+        return Deflate;
+    }
+    return Identity;
+}
+
+QByteArray KDSoapCompression::encodingName(Encoding encoding)
+{
+    switch (encoding) {
+    case Gzip:
+        return QByteArrayLiteral("gzip");
+    case Deflate:
+        return QByteArrayLiteral("deflate");
+    case Identity:
+        break;
+    }
+    return QByteArrayLiteral("identity");
+}
+
+QByteArray KDSoapCompression::compress(const QByteArray &data, Encoding encoding, int level)
+{
+    if (encoding == Identity) {
+        return data;
+    }
+#ifdef KDSOAP_HAVE_ZLIB
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level < 0 ? Z_DEFAULT_COMPRESSION : qMin(level, 9), Z_DEFLATED, encoding == Gzip ? s_windowBits + 16 : s_windowBits,
+                     8, Z_DEFAULT_STRATEGY)
+        != Z_OK) {
+        return QByteArray();
+    }
+    // deflateBound() is large enough for the whole output, which is then written in one call
+    QByteArray output;
+    output.resize(int(deflateBound(&stream, uLong(data.size()))));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(output.data());
+    stream.avail_out = uInt(output.size());
+    const int ret = deflate(&stream, Z_FINISH);
+    output.resize(output.size() - int(stream.avail_out));
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        return QByteArray();
+    }
+    return output;
+#else
+    Q_UNUSED(level);
+    return QByteArray();
+#endif
+}
+
+class KDSoapInflater::Private
+{
+public:
+    explicit Private(KDSoapCompression::Encoding encoding)
+        : m_encoding(encoding)
+    {
+#ifdef KDSOAP_HAVE_ZLIB
+        memset(&m_stream, 0, sizeof(m_stream));
+#endif
+    }
+
+#ifdef KDSOAP_HAVE_ZLIB
+    bool init(const char *start);
+    bool inflate(const char *data, uInt size, QByteArray *output);
+
+    z_stream m_stream;
+#endif
+    KDSoapCompression::Encoding m_encoding;
+    QByteArray m_start; // the first byte of a "deflate" body, until the format can be told
+    qint64 m_maxSize = -1;
+    qint64 m_size = 0; // produced so far
+    bool m_initialized = false;
+    bool m_finished = false;
+    bool m_error = false;
+    bool m_tooLarge = false;
+};
+
+#ifdef KDSOAP_HAVE_ZLIB
+// start points to the first two bytes of the body
+bool KDSoapInflater::Private::init(const char *start)
+{
+    int windowBits = s_windowBits + 16;
+    if (m_encoding == KDSoapCompression::Deflate) {
+        // A zlib header (RFC 1950 section 2.2) uses the "deflate" method, and is a multiple of 31
+        const uchar cmf = uchar(start[0]);
+        const uchar flg = uchar(start[1]);
+        const bool zlibFormat = (cmf & 0x0f) == Z_DEFLATED && ((cmf << 8) | flg) % 31 == 0;
+        windowBits = zlibFormat ? s_windowBits : -s_windowBits;
+    }
+    m_initialized = true;
+    return inflateInit2(&m_stream, windowBits) == Z_OK;
+}
+
+bool KDSoapInflater::Private::inflate(const char *data, uInt size, QByteArray *output)
+{
+    m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_stream.avail_in = size;
+    do {
+        // XML compresses well: make room for a few times the input
+        const int start = output->size();
+        int room = int(qBound<qint64>(16384, qint64(m_stream.avail_in) * 4, 1 << 22));
+        if (m_maxSize >= 0) {
+            // One byte more than allowed tells a body of exactly m_maxSize bytes from a larger one
+            room = int(qMin<qint64>(room, m_maxSize - m_size + 1));
+        }
+        output->resize(start + room);
+        m_stream.next_out = reinterpret_cast<Bytef *>(output->data() + start);
+        m_stream.avail_out = uInt(room);
+        const int ret = ::inflate(&m_stream, Z_NO_FLUSH);
+        const int produced = room - int(m_stream.avail_out);
+        output->resize(start + produced);
+        m_size += produced;
+        if (m_maxSize >= 0 && m_size > m_maxSize) {
+            m_tooLarge = true;
+            return false;
+        }
+        if (ret == Z_STREAM_END) {
+            m_finished = true; // anything after the end of the stream is ignored
+            return true;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+    } while (m_stream.avail_in > 0 || m_stream.avail_out == 0);
+    return true;
+}
+#endif
+
+KDSoapInflater::KDSoapInflater(KDSoapCompression::Encoding encoding)
+    : d(new Private(encoding))
+{
+}
+
+KDSoapInflater::~KDSoapInflater()
+{
+#ifdef KDSOAP_HAVE_ZLIB
+    if (d->m_initialized) {
+        inflateEnd(&d->m_stream);
+    }
+#endif
+    delete d;
+}
+
+bool KDSoapInflater::inflate(const char *data, qint64 size, QByteArray *output)
+{
+    if (d->m_error) {
+        return false;
+    }
+    if (d->m_finished || size == 0) {
+        return true;
+    }
+#ifdef KDSOAP_HAVE_ZLIB
+    QByteArray joined;
+    if (!d->m_initialized) {
+        if (!d->m_start.isEmpty() || size < 2) {
+            // Not enough data yet to tell the zlib format from raw deflate data
+            d->m_start.append(data, int(size));
+            if (d->m_start.size() < 2) {
+                return true;
+            }
+            joined = d->m_start;
+            d->m_start.clear();
+            data = joined.constData();
+            size = joined.size();
+        }
+        if (!d->init(data)) {
+            d->m_error = true;
+            return false;
+        }
+    }
+    // avail_in is an unsigned int
+    const qint64 maxBlock = 1 << 30;
+    for (qint64 done = 0; done < size && !d->m_finished; done += maxBlock) {
+        if (!d->inflate(data + done, uInt(qMin(size - done, maxBlock)), output)) {
+            d->m_error = true;
+            return false;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(output);
+    d->m_error = true;
+    return false;
+#endif
+}
+
+bool KDSoapInflater::isFinished() const
+{
+    return d->m_finished;
+}
+
+void KDSoapInflater::setMaxSize(qint64 bytes)
+{
+    d->m_maxSize = bytes;
+}
+
+bool KDSoapInflater::isTooLarge() const
+{
+    return d->m_tooLarge;
+}
@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPCOMPRESSION_P_H
+#define KDSOAPCOMPRESSION_P_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+
+/**
+ * \internal
+ * The "gzip" and "deflate" HTTP content codings (RFC 9110 section 8.4.1), for request and response bodies.
+ * They are only available when KD Soap was built with zlib.
+ *
+ * Internal class -- only exported for the server lib
+ */
+class KDSOAP_EXPORT KDSoapCompression
+{
+public:
+    enum Encoding
+    {
+        Identity,
+        Gzip,
+        Deflate
+    };
+
+    /**
+     * Returns true if KD Soap was built with zlib. Otherwise nothing is compressed,
+     * and compressed content can't be read.
+     */
+    static bool isAvailable();
+
+    /**
+     * Parses the value of a Content-Encoding header into \p encoding.
+     * Returns false if the encoding isn't supported (or if there's more than one).
+     */
+    static bool parseContentEncoding(const QByteArray &contentEncoding, Encoding *encoding);
+
+    /**
+     * Returns the encoding to use for a response to a request with the given Accept-Encoding header:
+     * gzip or deflate, whichever has the higher quality value, or Identity.
+     */
+    static Encoding negotiate(const QByteArray &acceptEncoding);
+
+    /**
+     * Returns the name of \p encoding, as used in the HTTP headers.
+     */
+    static QByteArray encodingName(Encoding encoding);
+
+    /**
+     * Returns \p data compressed with \p encoding, at the zlib compression \p level (1 to 9, -1 for the default).
+     */
+    static QByteArray compress(const QByteArray &data, Encoding encoding, int level = -1);
+};
+
+/**
+ * \internal
+ * Decompresses a body in the gzip or deflate encoding as it is received.
+ * For "deflate", both the zlib format and raw deflate data (sent by some servers) are accepted.
+ *
+ * Internal class -- only exported for the server lib
+ */
+class KDSOAP_EXPORT KDSoapInflater
+{
+public:
+    explicit KDSoapInflater(KDSoapCompression::Encoding encoding);
+    ~KDSoapInflater();
+
+    /**
+     * Decompresses the next \p size bytes of the body, appending the result to \p output.
+     * Returns false if the data is invalid; the inflater is unusable from then on.
+     */
+    bool inflate(const char *data, qint64 size, QByteArray *output);
+    bool inflate(const QByteArray &data, QByteArray *output)
+    {
+        return inflate(data.constData(), data.size(), output);
+    }
+
+    /**
+     * Returns true once the end of the compressed stream was decoded.
+     * Until then, the body is incomplete.
+     */
+    bool isFinished() const;
+
+    /**
+     * Limits the decompressed body to \p bytes (-1, the default, for no limit), against compression bombs:
+     * inflate() fails as soon as more would be produced, and isTooLarge() returns true from then on.
+     */
+    void setMaxSize(qint64 bytes);
+    bool isTooLarge() const;
+
+private:
+    Q_DISABLE_COPY(KDSoapInflater)
+    class Private;
+    Private *const d;
+};
+
+#endif // KDSOAPCOMPRESSION_P_H
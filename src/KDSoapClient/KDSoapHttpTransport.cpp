@@ -0,0 +1,1039 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapHttpTransport_p.h"
+#include "KDSoapClientInterface_p.h"
+#include "KDSoapCompression_p.h"
+#include "KDSoapMultipart_p.h"
+#include "KDSoapStreamingBody_p.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDeadlineTimer>
+#include <QNetworkCookie>
+#include <QNetworkCookieJar>
+#include <QNetworkProxyFactory>
+#include <QScopedPointer>
+#include <QTcpSocket>
+#include <QThread>
+#ifndef QT_NO_SSL
+#include <QSslCipher>
+#include <QSslKey>
+#include <QSslSocket>
+#endif
+
+#include <climits>
+#include <limits>
+
+namespace {
+
+// A longer status or header line means that the server isn't sending HTTP
+const qint64 s_maxLineLength = 64 * 1024;
+// The devices of the attachments are written block by block, waiting for the socket to send them
+const qint64 s_maxPendingWrite = 256 * 1024;
+
+int remainingMsecs(const QDeadlineTimer &deadline)
+{
+    const qint64 remaining = deadline.remainingTime();
+    if (remaining < 0) {
+        return -1;
+    }
+    return int(qMin<qint64>(remaining, std::numeric_limits<int>::max()));
+}
+
+bool isHttps(const QUrl &url)
+{
+    return url.scheme().compare(QLatin1String("https"), Qt::CaseInsensitive) == 0;
+}
+
+bool isSupportedScheme(const QUrl &url)
+{
+#ifndef QT_NO_SSL
+    if (isHttps(url)) {
+        return true;
+    }
+#endif
+    return url.scheme().compare(QLatin1String("http"), Qt::CaseInsensitive) == 0;
+}
+
+void setUnknownProtocolError(KDSoapHttpResponse *response, const QUrl &url)
+{
+    response->error = QNetworkReply::ProtocolUnknownError;
+    response->errorString = QCoreApplication::translate("QNetworkReply", "Protocol \"%1\" is unknown").arg(url.scheme());
+}
+
+// Whether the server closed an idle connection (or sent anything on it, which can't be the response to a request)
+bool isClosedByServer(QTcpSocket *socket)
+{
+    return socket->waitForReadyRead(0) || socket->state() != QAbstractSocket::ConnectedState;
+}
+
+// The proxy to use for url, like QNetworkAccessManager: its own proxy, or the application proxy
+QNetworkProxy proxyForUrl(const QNetworkProxy &proxy, const QUrl &url)
+{
+    QNetworkProxy result = proxy;
+    if (result.type() == QNetworkProxy::DefaultProxy) {
+        const QList<QNetworkProxy> proxies = QNetworkProxyFactory::proxyForQuery(QNetworkProxyQuery(url));
+        result = proxies.isEmpty() ? QNetworkProxy(QNetworkProxy::NoProxy) : proxies.first();
+    }
+    switch (result.type()) {
+    case QNetworkProxy::HttpProxy:
+    case QNetworkProxy::Socks5Proxy:
+        break;
+    case QNetworkProxy::HttpCachingProxy:
+        result.setType(QNetworkProxy::HttpProxy);
+        break;
+    default:
+        result = QNetworkProxy(QNetworkProxy::NoProxy);
+        break;
+    }
+    return result;
+}
+
+// Plain HTTP goes through a HTTP proxy by sending it the absolute URL, HTTPS through a tunnel
+bool isForwardingProxy(const QNetworkProxy &proxy, const QUrl &url)
+{
+    return proxy.type() == QNetworkProxy::HttpProxy && !isHttps(url);
+}
+
+// Identifies the connections which can be reused for url
+QByteArray connectionKey(const QUrl &url, const QNetworkProxy &proxy, const KDSoapHttpTransport::Settings &settings)
+{
+    QByteArray key = url.scheme().toLower().toLatin1() + "://" + url.host(QUrl::FullyEncoded).toLatin1() + ':'
+        + QByteArray::number(url.port(isHttps(url) ? 443 : 80));
+    if (proxy.type() != QNetworkProxy::NoProxy) {
+        key += " via " + QByteArray::number(proxy.type()) + ' ' + proxy.user().toUtf8() + '@' + proxy.hostName().toUtf8() + ':'
+            + QByteArray::number(proxy.port());
+    }
+#ifndef QT_NO_SSL
+    // A connection verified with other TLS settings mustn't be reused
+    if (isHttps(url) && !settings.tlsKey.isEmpty()) {
+        key += " tls " + settings.tlsKey;
+    }
+#else
+    Q_UNUSED(settings);
+#endif
+    return key;
+}
+
+// The error QNetworkAccessManager reports for a HTTP status code
+QNetworkReply::NetworkError statusError(int statusCode)
+{
+    switch (statusCode) {
+    case 400:
+    case 418:
+        return QNetworkReply::ProtocolInvalidOperationError;
+    case 401:
+        return QNetworkReply::AuthenticationRequiredError;
+    case 403:
+        return QNetworkReply::ContentAccessDenied;
+    case 404:
+        return QNetworkReply::ContentNotFoundError;
+    case 405:
+        return QNetworkReply::ContentOperationNotPermittedError;
+    case 407:
+        return QNetworkReply::ProxyAuthenticationRequiredError;
+    case 409:
+        return QNetworkReply::ContentConflictError;
+    case 410:
+        return QNetworkReply::ContentGoneError;
+    case 500:
+        return QNetworkReply::InternalServerError;
+    case 501:
+        return QNetworkReply::OperationNotImplementedError;
+    case 503:
+        return QNetworkReply::ServiceUnavailableError;
+    default:
+        return statusCode > 500 ? QNetworkReply::UnknownServerError : QNetworkReply::UnknownContentError;
+    }
+}
+
+// The error QNetworkAccessManager reports for a socket error
+QNetworkReply::NetworkError socketError(QAbstractSocket::SocketError error)
+{
+    switch (error) {
+    case QAbstractSocket::ConnectionRefusedError:
+        return QNetworkReply::ConnectionRefusedError;
+    case QAbstractSocket::RemoteHostClosedError:
+        return QNetworkReply::RemoteHostClosedError;
+    case QAbstractSocket::HostNotFoundError:
+        return QNetworkReply::HostNotFoundError;
+    case QAbstractSocket::SocketTimeoutError:
+        return QNetworkReply::TimeoutError;
+    case QAbstractSocket::SslHandshakeFailedError:
+        return QNetworkReply::SslHandshakeFailedError;
+    case QAbstractSocket::ProxyAuthenticationRequiredError:
+        return QNetworkReply::ProxyAuthenticationRequiredError;
+    case QAbstractSocket::ProxyConnectionRefusedError:
+        return QNetworkReply::ProxyConnectionRefusedError;
+    case QAbstractSocket::ProxyConnectionClosedError:
+        return QNetworkReply::ProxyConnectionClosedError;
+    case QAbstractSocket::ProxyConnectionTimeoutError:
+        return QNetworkReply::ProxyTimeoutError;
+    case QAbstractSocket::ProxyNotFoundError:
+        return QNetworkReply::ProxyNotFoundError;
+    default:
+        return QNetworkReply::UnknownNetworkError;
+    }
+}
+
+void setSocketError(KDSoapHttpResponse *response, QTcpSocket *socket, const QDeadlineTimer &deadline)
+{
+    if (deadline.hasExpired()) {
+        response->error = QNetworkReply::TimeoutError;
+        response->errorString = QStringLiteral("Operation timed out");
+    } else {
+        response->error = socketError(socket->error());
+        response->errorString = socket->errorString();
+    }
+}
+
+// The body of the request, which is prepared once and written again when the request has to be resent
+struct RequestBody
+{
+    QByteArray envelope;
+    // With MTOM: the parts of the multipart message, and the contents of the attachments which had to be read in memory
+    QByteArray rootPartHeader;
+    QVector<KDSoapAttachment> attachments;
+    QVector<QByteArray> partHeaders;
+    QVector<QByteArray> partData;
+    QByteArray closeDelimiter;
+    // Without MTOM: the envelope with the attachments inserted as base64 text
+    QScopedPointer<KDSoapStreamingBody> streamingBody;
+    qint64 size = 0;
+};
+
+// Reads the response and writes the request on a connection, until the deadline
+class HttpExchange
+{
+public:
+    HttpExchange(QTcpSocket *socket, const QDeadlineTimer &deadline, KDSoapHttpResponse *response)
+        : m_socket(socket)
+        , m_deadline(deadline)
+        , m_response(response)
+    {
+    }
+
+    // True once anything came back from the server, so that the request can't just be resent
+    bool receivedData() const
+    {
+        return m_receivedData;
+    }
+
+    bool write(const char *data, qint64 size)
+    {
+        if (m_socket->write(data, size) != size) {
+            return socketFailure();
+        }
+        while (m_socket->bytesToWrite() > s_maxPendingWrite) {
+            if (!waitForBytesWritten()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool write(const QByteArray &data)
+    {
+        return write(data.constData(), data.size());
+    }
+    bool writeDevice(QIODevice *device)
+    {
+        char block[16384];
+        while (!device->atEnd()) {
+            const qint64 in = device->read(block, sizeof(block));
+            if (in <= 0) {
+                return fail(QNetworkReply::UnknownNetworkError, device->errorString());
+            }
+            if (!write(block, in)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool writeBody(RequestBody &body)
+    {
+        if (body.streamingBody) {
+            body.streamingBody->seek(0);
+            return writeDevice(body.streamingBody.data());
+        }
+        if (body.rootPartHeader.isEmpty()) {
+            return write(body.envelope);
+        }
+        if (!write(body.rootPartHeader) || !write(body.envelope)) {
+            return false;
+        }
+        for (int i = 0; i < body.attachments.size(); ++i) {
+            if (!write(body.partHeaders.at(i))) {
+                return false;
+            }
+            if (body.partData.at(i).isNull()) {
+                QIODevice *device = body.attachments.at(i).device();
+                device->seek(0);
+                if (!writeDevice(device)) {
+                    return false;
+                }
+            } else if (!write(body.partData.at(i))) {
+                return false;
+            }
+        }
+        return write(body.closeDelimiter);
+    }
+    bool flush()
+    {
+        while (m_socket->bytesToWrite() > 0) {
+            if (!waitForBytesWritten()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Reads the status line and headers (skipping 1xx responses), then the body
+    bool readResponse(bool *keepAlive)
+    {
+        QByteArray version;
+        do {
+            QByteArray line;
+            if (!readLine(&line)) {
+                return false;
+            }
+            // e.g. "HTTP/1.1 404 Not Found"
+            const int space = line.indexOf(' ');
+            const int secondSpace = line.indexOf(' ', space + 1);
+            bool ok = false;
+            version = line.left(space);
+            m_response->statusCode = line.mid(space + 1, secondSpace < 0 ? -1 : secondSpace - space - 1).toInt(&ok);
+            if (!version.startsWith("HTTP/1.") || !ok) {
+                return protocolFailure();
+            }
+            m_response->reasonPhrase = secondSpace < 0 ? QByteArray() : line.mid(secondSpace + 1);
+            m_response->headers.clear();
+            while (true) {
+                if (!readLine(&line)) {
+                    return false;
+                }
+                if (line.isEmpty()) {
+                    break;
+                }
+                const int colon = line.indexOf(':');
+                if (colon <= 0) {
+                    return protocolFailure();
+                }
+                m_response->headers.append(QNetworkReply::RawHeaderPair(line.left(colon).trimmed(), line.mid(colon + 1).trimmed()));
+            }
+        } while (m_response->statusCode >= 100 && m_response->statusCode < 200);
+
+        const QByteArray connection = m_response->header("Connection").toLower();
+        *keepAlive = version == "HTTP/1.0" ? connection.contains("keep-alive") : !connection.contains("close");
+
+        if (m_response->statusCode == 204 || m_response->statusCode == 304) {
+            return true;
+        }
+        KDSoapCompression::Encoding encoding;
+        if (!KDSoapCompression::parseContentEncoding(m_response->header("Content-Encoding"), &encoding)) {
+            return fail(QNetworkReply::ProtocolFailure, QStringLiteral("Unsupported content encoding in the response"));
+        }
+        if (encoding != KDSoapCompression::Identity) {
+            m_inflater.reset(new KDSoapInflater(encoding));
+        }
+        if (!readBody(keepAlive)) {
+            return false;
+        }
+        if (m_inflater && !m_inflater->isFinished()) {
+            return compressionFailure();
+        }
+        return true;
+    }
+
+private:
+    bool fail(QNetworkReply::NetworkError error, const QString &errorString)
+    {
+        m_response->error = error;
+        m_response->errorString = errorString;
+        return false;
+    }
+    bool protocolFailure()
+    {
+        return fail(QNetworkReply::ProtocolFailure, QCoreApplication::translate("QHttp", "Invalid HTTP response"));
+    }
+    bool socketFailure()
+    {
+        setSocketError(m_response, m_socket, m_deadline);
+        return false;
+    }
+    bool compressionFailure()
+    {
+        return fail(QNetworkReply::ProtocolFailure, QStringLiteral("Invalid compressed response"));
+    }
+
+    bool waitForBytesWritten()
+    {
+        while (!m_socket->waitForBytesWritten(remainingMsecs(m_deadline))) {
+            if (m_socket->error() != QAbstractSocket::SocketTimeoutError || m_deadline.hasExpired()) {
+                return socketFailure();
+            }
+        }
+        return true;
+    }
+    // Returns false if the connection was closed, or on timeout
+    bool waitForData()
+    {
+        while (!m_socket->waitForReadyRead(remainingMsecs(m_deadline))) {
+            if (m_socket->error() != QAbstractSocket::SocketTimeoutError || m_deadline.hasExpired()) {
+                return socketFailure();
+            }
+        }
+        m_receivedData = true;
+        return true;
+    }
+
+    // Reads a line, without the line break
+    bool readLine(QByteArray *line)
+    {
+        while (!m_socket->canReadLine()) {
+            if (m_socket->bytesAvailable() > s_maxLineLength) {
+                return protocolFailure();
+            }
+            if (!waitForData()) {
+                return false;
+            }
+        }
+        m_receivedData = true;
+        *line = m_socket->readLine();
+        while (line->endsWith('\n') || line->endsWith('\r')) {
+            line->chop(1);
+        }
+        return true;
+    }
+
+    // Appends size bytes to data. size comes from the server, so data only grows as the bytes arrive
+    bool read(qint64 size, QByteArray *data)
+    {
+        if (size > std::numeric_limits<int>::max() - data->size()) {
+            return fail(QNetworkReply::ProtocolFailure, QStringLiteral("Response too large"));
+        }
+        while (size > 0) {
+            if (m_socket->bytesAvailable() == 0 && !waitForData()) {
+                return false;
+            }
+            const int start = data->size();
+            const qint64 available = qMin(size, m_socket->bytesAvailable());
+            data->resize(start + int(available));
+            const qint64 in = m_socket->read(data->data() + start, available);
+            if (in < 0) {
+                data->resize(start);
+                return socketFailure();
+            }
+            data->resize(start + int(in));
+            size -= in;
+        }
+        return true;
+    }
+
+    bool readBody(bool *keepAlive)
+    {
+        if (m_response->header("Transfer-Encoding").toLower().contains("chunked")) {
+            return readChunkedBody();
+        }
+        const QByteArray contentLength = m_response->header("Content-Length");
+        if (!contentLength.isNull()) {
+            bool ok = false;
+            const qint64 size = contentLength.trimmed().toLongLong(&ok);
+            if (!ok || size < 0) {
+                return protocolFailure();
+            }
+            return readBodyData(size);
+        }
+        // The body ends when the server closes the connection
+        *keepAlive = false;
+        return readToEnd();
+    }
+
+    // Reads size bytes of the body, decompressing them on the way
+    bool readBodyData(qint64 size)
+    {
+        if (!m_inflater) {
+            return read(size, &m_response->body);
+        }
+        char block[16384];
+        while (size > 0) {
+            if (m_socket->bytesAvailable() == 0 && !waitForData()) {
+                return false;
+            }
+            const qint64 in = m_socket->read(block, qMin<qint64>(size, sizeof(block)));
+            if (in < 0) {
+                return socketFailure();
+            }
+            if (!appendBody(block, in)) {
+                return false;
+            }
+            size -= in;
+        }
+        return true;
+    }
+    bool appendBody(const char *data, qint64 size)
+    {
+        if (!m_inflater) {
+            m_response->body.append(data, int(size));
+            return true;
+        }
+        if (!m_inflater->inflate(data, size, &m_response->body)) {
+            return compressionFailure();
+        }
+        return true;
+    }
+    bool appendBody(const QByteArray &data)
+    {
+        return appendBody(data.constData(), data.size());
+    }
+
+    bool readChunkedBody()
+    {
+        QByteArray line;
+        while (true) {
+            // e.g. "1a3f;extension"
+            if (!readLine(&line)) {
+                return false;
+            }
+            const int semicolon = line.indexOf(';');
+            if (semicolon >= 0) {
+                line.truncate(semicolon);
+            }
+            bool ok = false;
+            const qint64 size = line.trimmed().toLongLong(&ok, 16);
+            if (!ok || size < 0) {
+                return protocolFailure();
+            }
+            if (size == 0) {
+                break;
+            }
+            if (!readBodyData(size) || !readLine(&line)) {
+                return false;
+            }
+            if (!line.isEmpty()) {
+                return protocolFailure();
+            }
+        }
+        // Trailers, up to an empty line
+        do {
+            if (!readLine(&line)) {
+                return false;
+            }
+        } while (!line.isEmpty());
+        return true;
+    }
+
+    bool readToEnd()
+    {
+        while (true) {
+            if (!appendBody(m_socket->readAll())) {
+                return false;
+            }
+            if (m_socket->state() != QAbstractSocket::ConnectedState) {
+                return true;
+            }
+            if (!m_socket->waitForReadyRead(remainingMsecs(m_deadline))) {
+                if (m_socket->error() == QAbstractSocket::RemoteHostClosedError) {
+                    return appendBody(m_socket->readAll());
+                }
+                if (m_socket->error() != QAbstractSocket::SocketTimeoutError || m_deadline.hasExpired()) {
+                    return socketFailure();
+                }
+            }
+            m_receivedData = true;
+        }
+    }
+
+    QTcpSocket *m_socket;
+    const QDeadlineTimer &m_deadline;
+    KDSoapHttpResponse *m_response;
+    bool m_receivedData = false;
+    QScopedPointer<KDSoapInflater> m_inflater; // for a compressed response
+};
+
+} // namespace
+
+QByteArray KDSoapHttpResponse::header(const QByteArray &name) const
+{
+    for (const QNetworkReply::RawHeaderPair &header : headers) {
+        if (qstricmp(header.first.constData(), name.constData()) == 0) {
+            return header.second;
+        }
+    }
+    return QByteArray();
+}
+
+KDSoapHttpTransport::KDSoapHttpTransport()
+    : m_maxConnectionsPerHost(6) // like QNetworkAccessManager
+    , m_idleTimeout(60 * 1000)
+{
+}
+
+KDSoapHttpTransport::~KDSoapHttpTransport()
+{
+    // Idle sockets have no thread affinity, they can be deleted from any thread
+    for (const IdleConnection &connection : qAsConst(m_idleConnections)) {
+        delete connection.socket;
+    }
+}
+
+#ifndef QT_NO_SSL
+QByteArray KDSoapHttpTransport::tlsKey(const QSslConfiguration &sslConfiguration, bool ignoreAllSslErrors, const QList<QSslError> &ignoredSslErrors)
+{
+    if (sslConfiguration.isNull() && !ignoreAllSslErrors && ignoredSslErrors.isEmpty()) {
+        return QByteArray(); // the defaults
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!sslConfiguration.isNull()) {
+        hash.addData(QByteArray::number(int(sslConfiguration.protocol())) + ' ' + QByteArray::number(int(sslConfiguration.peerVerifyMode())) + ' '
+                     + QByteArray::number(sslConfiguration.peerVerifyDepth()) + '\n');
+        const QList<QSslCertificate> caCertificates = sslConfiguration.caCertificates();
+        for (const QSslCertificate &certificate : caCertificates) {
+            hash.addData(certificate.digest(QCryptographicHash::Sha1) + "ca\n");
+        }
+        const QList<QSslCertificate> localCertificateChain = sslConfiguration.localCertificateChain();
+        for (const QSslCertificate &certificate : localCertificateChain) {
+            hash.addData(certificate.digest(QCryptographicHash::Sha1) + "local\n");
+        }
+        hash.addData(QCryptographicHash::hash(sslConfiguration.privateKey().toDer(), QCryptographicHash::Sha1) + "key\n");
+        const QList<QSslCipher> ciphers = sslConfiguration.ciphers();
+        for (const QSslCipher &cipher : ciphers) {
+            hash.addData(cipher.name().toLatin1() + '\n');
+        }
+    }
+    if (ignoreAllSslErrors) {
+        hash.addData(QByteArray("ignore all\n"));
+    }
+    for (const QSslError &error : ignoredSslErrors) {
+        hash.addData("ignore " + QByteArray::number(int(error.error())) + ' ' + error.certificate().digest(QCryptographicHash::Sha1) + '\n');
+    }
+    return hash.result().toHex();
+}
+#endif
+
+void KDSoapHttpTransport::setMaxConnectionsPerHost(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxConnectionsPerHost = qMax(0, count);
+    m_connectionReleased.wakeAll();
+}
+
+int KDSoapHttpTransport::maxConnectionsPerHost() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxConnectionsPerHost;
+}
+
+void KDSoapHttpTransport::setIdleTimeout(int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_idleTimeout = msecs;
+}
+
+int KDSoapHttpTransport::idleTimeout() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_idleTimeout;
+}
+
+KDSoapClientInterface::ConnectionPoolStatistics KDSoapHttpTransport::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    KDSoapClientInterface::ConnectionPoolStatistics statistics = m_statistics;
+    statistics.idleConnections = m_idleConnections.count();
+    statistics.openConnections = 0;
+    for (const int count : m_openConnections) {
+        statistics.openConnections += count;
+    }
+    return statistics;
+}
+
+void KDSoapHttpTransport::resetStatistics()
+{
+    QMutexLocker locker(&m_mutex);
+    m_statistics = KDSoapClientInterface::ConnectionPoolStatistics();
+}
+
+QVector<QTcpSocket *> KDSoapHttpTransport::takeExpiredConnections()
+{
+    QVector<QTcpSocket *> expired;
+    if (m_idleTimeout < 0) {
+        return expired;
+    }
+    for (int i = m_idleConnections.count() - 1; i >= 0; --i) {
+        const IdleConnection &connection = m_idleConnections.at(i);
+        if (connection.idleTime.hasExpired(m_idleTimeout)) {
+            expired.append(connection.socket);
+            --m_openConnections[connection.key];
+            m_idleConnections.remove(i);
+        }
+    }
+    if (!expired.isEmpty()) {
+        m_connectionReleased.wakeAll();
+    }
+    return expired;
+}
+
+QTcpSocket *KDSoapHttpTransport::acquireConnection(const QByteArray &key, const QUrl &url, const QNetworkProxy &proxy, const Settings &settings,
+                                                   const QDeadlineTimer &deadline, bool *reused, KDSoapHttpResponse *response)
+{
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        const QVector<QTcpSocket *> expired = takeExpiredConnections();
+        if (!expired.isEmpty()) {
+            locker.unlock();
+            qDeleteAll(expired);
+            locker.relock();
+        }
+
+        // The most recently used connection is the least likely to have been closed by the server
+        int idleIndex = -1;
+        for (int i = m_idleConnections.count() - 1; i >= 0 && idleIndex < 0; --i) {
+            if (m_idleConnections.at(i).key == key) {
+                idleIndex = i;
+            }
+        }
+        if (idleIndex >= 0) {
+            QTcpSocket *socket = m_idleConnections.at(idleIndex).socket;
+            m_idleConnections.remove(idleIndex);
+            locker.unlock();
+            socket->moveToThread(QThread::currentThread());
+            if (isClosedByServer(socket)) {
+                closeConnection(key, socket);
+                locker.relock();
+                continue;
+            }
+            locker.relock();
+            ++m_statistics.hits;
+            *reused = true;
+            return socket;
+        }
+
+        int &openConnections = m_openConnections[key];
+        if (m_maxConnectionsPerHost == 0 || openConnections < m_maxConnectionsPerHost) {
+            ++openConnections;
+            ++m_statistics.misses;
+            locker.unlock();
+            QTcpSocket *socket = connectToServer(url, proxy, settings, deadline, response);
+            if (!socket) {
+                locker.relock();
+                --m_openConnections[key];
+                m_connectionReleased.wakeAll();
+            }
+            *reused = false;
+            return socket;
+        }
+
+        // All the connections to this server are in use
+        const int remaining = remainingMsecs(deadline);
+        if (!m_connectionReleased.wait(&m_mutex, remaining < 0 ? ULONG_MAX : static_cast<unsigned long>(remaining)) && deadline.hasExpired()) {
+            response->error = QNetworkReply::TimeoutError;
+            response->errorString = QStringLiteral("Operation timed out");
+            return nullptr;
+        }
+    }
+}
+
+void KDSoapHttpTransport::releaseConnection(const QByteArray &key, QTcpSocket *socket)
+{
+    // Let the next thread which needs a connection pull it
+    socket->moveToThread(nullptr);
+    QMutexLocker locker(&m_mutex);
+    IdleConnection connection {key, socket, QElapsedTimer()};
+    connection.idleTime.start();
+    m_idleConnections.append(connection);
+    m_connectionReleased.wakeAll();
+}
+
+void KDSoapHttpTransport::closeConnection(const QByteArray &key, QTcpSocket *socket)
+{
+    delete socket;
+    QMutexLocker locker(&m_mutex);
+    --m_openConnections[key];
+    m_connectionReleased.wakeAll();
+}
+
+int KDSoapHttpTransport::warmUp(const QUrl &url, int connections, const Settings &settings, KDSoapHttpResponse *response)
+{
+    if (!isSupportedScheme(url)) {
+        setUnknownProtocolError(response, url);
+        return 0;
+    }
+    const QDeadlineTimer deadline(settings.timeout < 0 ? qint64(-1) : qint64(settings.timeout));
+    const QNetworkProxy proxy = proxyForUrl(settings.proxy, url);
+    const QByteArray key = connectionKey(url, proxy, settings);
+
+    // Check the idle connections to this server first, they count towards the requested number
+    QVector<QTcpSocket *> ready;
+    QVector<QTcpSocket *> idle;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = m_idleConnections.count() - 1; i >= 0; --i) {
+            if (m_idleConnections.at(i).key == key) {
+                idle.append(m_idleConnections.at(i).socket);
+                m_idleConnections.remove(i);
+            }
+        }
+    }
+    for (QTcpSocket *socket : qAsConst(idle)) {
+        socket->moveToThread(QThread::currentThread());
+        if (isClosedByServer(socket)) {
+            closeConnection(key, socket);
+        } else {
+            ready.append(socket);
+        }
+    }
+
+    while (ready.count() < connections) {
+        {
+            QMutexLocker locker(&m_mutex);
+            int &openConnections = m_openConnections[key];
+            if (m_maxConnectionsPerHost != 0 && openConnections >= m_maxConnectionsPerHost) {
+                break;
+            }
+            ++openConnections;
+        }
+        QTcpSocket *socket = connectToServer(url, proxy, settings, deadline, response);
+        if (!socket) {
+            QMutexLocker locker(&m_mutex);
+            --m_openConnections[key];
+            m_connectionReleased.wakeAll();
+            break;
+        }
+        ready.append(socket);
+    }
+
+    // Released with a new idle time, so that warming up regularly keeps the connections in the pool
+    for (QTcpSocket *socket : qAsConst(ready)) {
+        releaseConnection(key, socket);
+    }
+    return ready.count();
+}
+
+QTcpSocket *KDSoapHttpTransport::connectToServer(const QUrl &url, const QNetworkProxy &proxy, const Settings &settings, const QDeadlineTimer &deadline,
+                                                 KDSoapHttpResponse *response)
+{
+    QTcpSocket *socket;
+#ifndef QT_NO_SSL
+    QSslSocket *sslSocket = nullptr;
+    if (isHttps(url)) {
+        sslSocket = new QSslSocket;
+        if (!settings.sslConfiguration.isNull()) {
+            sslSocket->setSslConfiguration(settings.sslConfiguration);
+        }
+        if (settings.ignoreAllSslErrors) {
+            // Emitted from waitForEncrypted(), in this thread
+            QObject::connect(sslSocket, QOverload<const QList<QSslError> &>::of(&QSslSocket::sslErrors), sslSocket,
+                             QOverload<>::of(&QSslSocket::ignoreSslErrors));
+        } else {
+            sslSocket->ignoreSslErrors(settings.ignoredSslErrors);
+        }
+        socket = sslSocket;
+    } else
+#else
+    Q_UNUSED(settings);
+#endif
+    {
+        socket = new QTcpSocket;
+    }
+
+    if (isForwardingProxy(proxy, url)) {
+        socket->setProxy(QNetworkProxy::NoProxy);
+        socket->connectToHost(proxy.hostName(), proxy.port());
+    } else {
+        socket->setProxy(proxy);
+#ifndef QT_NO_SSL
+        if (sslSocket) {
+            sslSocket->connectToHostEncrypted(url.host(), url.port(443));
+        } else
+#endif
+        {
+            socket->connectToHost(url.host(), url.port(80));
+        }
+    }
+
+    bool connected = socket->waitForConnected(remainingMsecs(deadline));
+#ifndef QT_NO_SSL
+    if (connected && sslSocket) {
+        connected = sslSocket->waitForEncrypted(remainingMsecs(deadline));
+    }
+#endif
+    if (!connected) {
+        setSocketError(response, socket, deadline);
+        delete socket;
+        return nullptr;
+    }
+#ifndef QT_NO_SSL
+    if (sslSocket) {
+        QMutexLocker locker(&m_mutex);
+        ++m_statistics.tlsHandshakes;
+    }
+#endif
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    // Lets the operating system detect dead peers; its default intervals are too long to keep NAT mappings alive
+    socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+    return socket;
+}
+
+KDSoapHttpResponse KDSoapHttpTransport::post(const QNetworkRequest &request, const QByteArray &envelope, const KDSoapRequestAttachments &attachments,
+                                             const Settings &settings)
+{
+    KDSoapHttpResponse response;
+    const QDeadlineTimer deadline(settings.timeout < 0 ? qint64(-1) : qint64(settings.timeout)); // -1 means forever
+    const QUrl url = request.url();
+    if (!isSupportedScheme(url)) {
+        setUnknownProtocolError(&response, url);
+        return response;
+    }
+    const QNetworkProxy proxy = proxyForUrl(settings.proxy, url);
+    const QByteArray key = connectionKey(url, proxy, settings);
+
+    RequestBody body;
+    QNetworkRequest sentRequest = request;
+    body.envelope = envelope;
+    if (attachments.mtom) {
+        const QByteArray soapContentType = request.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+        const QByteArray boundary = KDSoapMultipart::generateBoundary();
+        sentRequest.setHeader(QNetworkRequest::ContentTypeHeader, KDSoapMultipart::contentType(soapContentType, boundary));
+        body.rootPartHeader = KDSoapMultipart::rootPartHeader(soapContentType, boundary);
+        body.closeDelimiter = KDSoapMultipart::closeDelimiter(boundary);
+        body.attachments = attachments.xopAttachments;
+        body.size = body.rootPartHeader.size() + envelope.size() + body.closeDelimiter.size();
+        for (const KDSoapAttachment &attachment : attachments.xopAttachments) {
+            body.partHeaders.append(KDSoapMultipart::attachmentPartHeader(attachment, boundary));
+            QByteArray data;
+            body.size += body.partHeaders.last().size() + KDSoapMultipart::prepareForSending(attachment, &data);
+            body.partData.append(data);
+        }
+    } else if (!attachments.streamedAttachments.isEmpty()) {
+        body.streamingBody.reset(new KDSoapStreamingBody(envelope, attachments.streamedAttachments));
+        body.streamingBody->open(QIODevice::ReadOnly);
+        body.size = body.streamingBody->size();
+    } else {
+        if (settings.requestCompressionThreshold >= 0 && envelope.size() >= settings.requestCompressionThreshold && KDSoapCompression::isAvailable()) {
+            body.envelope = KDSoapCompression::compress(envelope, KDSoapCompression::Gzip, settings.compressionLevel);
+            sentRequest.setRawHeader("Content-Encoding", "gzip");
+        }
+        body.size = body.envelope.size();
+    }
+    if (!sentRequest.hasRawHeader("Accept-Encoding") && KDSoapCompression::isAvailable()) {
+        sentRequest.setRawHeader("Accept-Encoding", "gzip, deflate");
+    }
+
+    // The part of the request head which doesn't depend on authentication
+    QByteArray head = "POST ";
+    if (isForwardingProxy(proxy, url)) {
+        head += url.toEncoded(QUrl::RemoveUserInfo | QUrl::RemoveFragment);
+    } else {
+        const QByteArray target = url.toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment);
+        head += target.isEmpty() ? QByteArray("/") : target;
+    }
+    head += " HTTP/1.1\r\nHost: " + url.authority(QUrl::FullyEncoded | QUrl::RemoveUserInfo).toLatin1() + "\r\n";
+    const QList<QByteArray> headerNames = sentRequest.rawHeaderList();
+    for (const QByteArray &name : headerNames) {
+        if (qstricmp(name.constData(), "Host") == 0 || qstricmp(name.constData(), "Content-Length") == 0 || qstricmp(name.constData(), "Connection") == 0) {
+            continue;
+        }
+        head += name + ": " + sentRequest.rawHeader(name) + "\r\n";
+    }
+    head += "Content-Length: " + QByteArray::number(body.size) + "\r\nConnection: keep-alive\r\n";
+    if (isForwardingProxy(proxy, url) && !proxy.user().isEmpty()) {
+        head += "Proxy-Authorization: Basic " + (proxy.user() + QLatin1Char(':') + proxy.password()).toLatin1().toBase64() + "\r\n";
+    }
+    if (settings.cookieJar && !sentRequest.hasRawHeader("Cookie")) {
+        const QList<QNetworkCookie> cookies = settings.cookieJar->cookiesForUrl(url);
+        if (!cookies.isEmpty()) {
+            head += "Cookie: ";
+            for (int i = 0; i < cookies.count(); ++i) {
+                if (i > 0) {
+                    head += "; ";
+                }
+                head += cookies.at(i).toRawForm(QNetworkCookie::NameAndValueOnly);
+            }
+            head += "\r\n";
+        }
+    }
+
+    // Like QNetworkAccessManager, only answer a Basic challenge once; since there is no other way to know
+    // whether the server wants authentication, the credentials are then sent up front to this server
+    const bool canAuthenticate = settings.authentication.hasAuth() && !sentRequest.hasRawHeader("Authorization");
+    bool sendAuthorization;
+    {
+        QMutexLocker locker(&m_mutex);
+        sendAuthorization = canAuthenticate && m_basicAuthKeys.contains(key);
+    }
+    bool challengeAnswered = false;
+
+    while (true) {
+        response = KDSoapHttpResponse();
+        bool reused = false;
+        QTcpSocket *socket = acquireConnection(key, url, proxy, settings, deadline, &reused, &response);
+        if (!socket) {
+            return response;
+        }
+
+        QByteArray fullHead = head;
+        if (sendAuthorization) {
+            const QString credentials = settings.authentication.user() + QLatin1Char(':') + settings.authentication.password();
+            fullHead += "Authorization: Basic " + credentials.toLatin1().toBase64() + "\r\n";
+        }
+        fullHead += "\r\n";
+
+        HttpExchange exchange(socket, deadline, &response);
+        if (!exchange.write(fullHead) || !exchange.writeBody(body)) {
+            closeConnection(key, socket);
+            // The server can close a kept-alive connection at any time: send the request again on a new connection.
+            // Only while the request wasn't entirely written, otherwise the server might have processed it already
+            if (reused && !exchange.receivedData() && !deadline.hasExpired()) {
+                continue;
+            }
+            return response;
+        }
+        bool keepAlive = false;
+        if (!exchange.flush() || !exchange.readResponse(&keepAlive)) {
+            closeConnection(key, socket);
+            return response;
+        }
+        if (keepAlive) {
+            releaseConnection(key, socket);
+        } else {
+            closeConnection(key, socket);
+        }
+
+        if (settings.cookieJar) {
+            QList<QNetworkCookie> cookies;
+            for (const QNetworkReply::RawHeaderPair &header : qAsConst(response.headers)) {
+                if (qstricmp(header.first.constData(), "Set-Cookie") == 0) {
+                    cookies += QNetworkCookie::parseCookies(header.second);
+                }
+            }
+            if (!cookies.isEmpty()) {
+                settings.cookieJar->setCookiesFromUrl(cookies, url);
+            }
+        }
+
+        if (response.statusCode == 401 && canAuthenticate && !challengeAnswered
+            && response.header("WWW-Authenticate").trimmed().toLower().startsWith("basic")) {
+            challengeAnswered = true;
+            sendAuthorization = true;
+            continue;
+        }
+        break;
+    }
+
+    if (sendAuthorization && response.statusCode != 401) {
+        QMutexLocker locker(&m_mutex);
+        m_basicAuthKeys.insert(key);
+    }
+    if (response.statusCode >= 400) {
+        response.error = statusError(response.statusCode);
+        response.errorString = QCoreApplication::translate("QNetworkReply", "Error transferring %1 - server replied: %2")
+                                   .arg(url.toString(), QString::fromLatin1(response.reasonPhrase));
+    }
+    return response;
+}
@@ -0,0 +1,147 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPHTTPTRANSPORT_P_H
+#define KDSOAPHTTPTRANSPORT_P_H
+
+#include "KDSoapAuthentication.h"
+#include "KDSoapClientInterface.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <QtNetwork/QNetworkProxy>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#ifndef QT_NO_SSL
+#include <QtNetwork/QSslConfiguration>
+#include <QtNetwork/QSslError>
+#endif
+
+struct KDSoapRequestAttachments;
+QT_BEGIN_NAMESPACE
+class QDeadlineTimer;
+class QNetworkCookieJar;
+class QTcpSocket;
+QT_END_NAMESPACE
+
+/**
+ * \internal
+ * The response to a request sent by KDSoapHttpTransport.
+ * Errors use the codes and messages of QNetworkReply, so that they end up in the same faults.
+ */
+struct KDSoapHttpResponse
+{
+    QNetworkReply::NetworkError error = QNetworkReply::NoError;
+    QString errorString;
+    int statusCode = 0;
+    QByteArray reasonPhrase;
+    QList<QNetworkReply::RawHeaderPair> headers;
+    QByteArray body;
+
+    // Header lookup, ignoring the case of the name
+    QByteArray header(const QByteArray &name) const;
+};
+
+/**
+ * \internal
+ * A minimal HTTP/1.1 client, used by KDSoapClientInterface::call() with KDSoapClientInterface::NativeTransport.
+ * The request is written and the response read on the calling thread, with the blocking QAbstractSocket API.
+ * Responses in the gzip or deflate encoding are decompressed as they are read.
+ *
+ * Connections are kept in a pool, per host, port, proxy and TLS settings, and shared by all the calling threads:
+ * an idle connection has no thread affinity, and is pulled into the thread which takes it.
+ */
+class KDSoapHttpTransport
+{
+public:
+    struct Settings
+    {
+        QNetworkProxy proxy;
+        KDSoapAuthentication authentication;
+        QNetworkCookieJar *cookieJar = nullptr; // must be thread-safe
+        int timeout = -1;
+        int requestCompressionThreshold = -1; // envelopes from this size are sent with gzip
+        int compressionLevel = -1;
+#ifndef QT_NO_SSL
+        QSslConfiguration sslConfiguration;
+        bool ignoreAllSslErrors = false;
+        QList<QSslError> ignoredSslErrors;
+        QByteArray tlsKey; // tlsKey() of the three settings above
+#endif
+    };
+
+#ifndef QT_NO_SSL
+    // Identifies the TLS settings: HTTPS connections are only reused by requests with the same ones
+    static QByteArray tlsKey(const QSslConfiguration &sslConfiguration, bool ignoreAllSslErrors, const QList<QSslError> &ignoredSslErrors);
+#endif
+
+    KDSoapHttpTransport();
+    ~KDSoapHttpTransport();
+
+    /**
+     * Sends \p envelope (with its attachments) to the URL of \p request, with the headers of \p request,
+     * and waits for the response.
+     */
+    KDSoapHttpResponse post(const QNetworkRequest &request, const QByteArray &envelope, const KDSoapRequestAttachments &attachments,
+                            const Settings &settings);
+
+    /**
+     * Makes sure that \p connections connections to \p url are open and idle, opening the missing ones
+     * (within the connection limit) and dropping the idle ones which the server closed.
+     * Returns the number of connections ready; \p response holds the error if one couldn't be opened.
+     */
+    int warmUp(const QUrl &url, int connections, const Settings &settings, KDSoapHttpResponse *response);
+
+    // Connections per host, port, proxy and TLS settings, in use or idle (0 for no limit). Calls wait for a connection beyond that.
+    void setMaxConnectionsPerHost(int count);
+    int maxConnectionsPerHost() const;
+    // Idle connections are closed after this time (negative: never), the next time the pool is used
+    void setIdleTimeout(int msecs);
+    int idleTimeout() const;
+
+    KDSoapClientInterface::ConnectionPoolStatistics statistics() const;
+    void resetStatistics();
+
+private:
+    Q_DISABLE_COPY(KDSoapHttpTransport)
+
+    struct IdleConnection
+    {
+        QByteArray key;
+        QTcpSocket *socket;
+        QElapsedTimer idleTime;
+    };
+
+    // Returns an idle connection, or a new one if there's none and the limit isn't reached,
+    // waiting for a connection to be released otherwise
+    QTcpSocket *acquireConnection(const QByteArray &key, const QUrl &url, const QNetworkProxy &proxy, const Settings &settings,
+                                  const QDeadlineTimer &deadline, bool *reused, KDSoapHttpResponse *response);
+    void releaseConnection(const QByteArray &key, QTcpSocket *socket);
+    void closeConnection(const QByteArray &key, QTcpSocket *socket);
+    QTcpSocket *connectToServer(const QUrl &url, const QNetworkProxy &proxy, const Settings &settings, const QDeadlineTimer &deadline,
+                                KDSoapHttpResponse *response);
+    // Removes the connections which were idle for too long; the caller deletes them, without holding the mutex
+    QVector<QTcpSocket *> takeExpiredConnections();
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_connectionReleased;
+    QVector<IdleConnection> m_idleConnections;
+    QHash<QByteArray, int> m_openConnections; // per key, idle or in use
+    QSet<QByteArray> m_basicAuthKeys; // the servers which asked for Basic authentication
+    int m_maxConnectionsPerHost;
+    int m_idleTimeout;
+    KDSoapClientInterface::ConnectionPoolStatistics m_statistics;
+};
+
+#endif // KDSOAPHTTPTRANSPORT_P_H
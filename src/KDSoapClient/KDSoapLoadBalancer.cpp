@@ -0,0 +1,239 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapLoadBalancer_p.h"
+#include "KDSoapRetryingReply_p.h"
+#include <QNetworkRequest>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+
+#include <algorithm>
+
+static int randomIndex(int count)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return QRandomGenerator::global()->bounded(count);
+#else
+    return qrand() % count;
+#endif
+}
+
+KDSoapLoadBalancer::KDSoapLoadBalancer()
+{
+}
+
+void KDSoapLoadBalancer::setEndPoints(const QStringList &endPoints)
+{
+    QStringList urls = endPoints;
+    urls.removeDuplicates();
+
+    QMutexLocker locker(&m_mutex);
+    QVector<EndPoint> newEndPoints;
+    newEndPoints.reserve(urls.size());
+    for (const QString &url : qAsConst(urls)) {
+        auto it = std::find_if(m_endPoints.cbegin(), m_endPoints.cend(), [&url](const EndPoint &endPoint) {
+            return endPoint.url == url;
+        });
+        if (it != m_endPoints.cend()) {
+            newEndPoints.append(*it);
+        } else {
+            EndPoint endPoint;
+            endPoint.url = url;
+            newEndPoints.append(endPoint);
+        }
+    }
+    m_endPoints = newEndPoints;
+}
+
+QStringList KDSoapLoadBalancer::endPoints() const
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList urls;
+    urls.reserve(m_endPoints.size());
+    for (const EndPoint &endPoint : m_endPoints) {
+        urls.append(endPoint.url);
+    }
+    return urls;
+}
+
+QString KDSoapLoadBalancer::firstEndPoint() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_endPoints.isEmpty() ? QString() : m_endPoints.first().url;
+}
+
+bool KDSoapLoadBalancer::isBalancing() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_endPoints.size() > 1;
+}
+
+void KDSoapLoadBalancer::setPolicy(KDSoapClientInterface::LoadBalancing policy)
+{
+    QMutexLocker locker(&m_mutex);
+    m_policy = policy;
+}
+
+KDSoapClientInterface::LoadBalancing KDSoapLoadBalancer::policy() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_policy;
+}
+
+void KDSoapLoadBalancer::setEjection(int failureThreshold, int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_failureThreshold = failureThreshold;
+    m_ejectionTime = msecs;
+    if (failureThreshold <= 0 || msecs <= 0) {
+        for (EndPoint &endPoint : m_endPoints) {
+            endPoint.ejectedUntil = QDeadlineTimer();
+        }
+    }
+}
+
+int KDSoapLoadBalancer::failureThreshold() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_failureThreshold;
+}
+
+int KDSoapLoadBalancer::ejectionTime() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_ejectionTime;
+}
+
+QStringList KDSoapLoadBalancer::ejectedEndPoints() const
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList urls;
+    for (const EndPoint &endPoint : m_endPoints) {
+        if (!endPoint.ejectedUntil.hasExpired()) {
+            urls.append(endPoint.url);
+        }
+    }
+    return urls;
+}
+
+QString KDSoapLoadBalancer::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_endPoints.isEmpty()) {
+        return QString();
+    }
+    int index = 0;
+    if (m_endPoints.size() > 1) {
+        QVector<int> candidates;
+        candidates.reserve(m_endPoints.size());
+        for (int i = 0; i < m_endPoints.size(); ++i) {
+            if (m_endPoints.at(i).ejectedUntil.hasExpired()) {
+                candidates.append(i);
+            }
+        }
+        if (candidates.isEmpty()) {
+            // All of them were ejected: trying them is better than failing every call
+            for (int i = 0; i < m_endPoints.size(); ++i) {
+                candidates.append(i);
+            }
+        }
+        index = pick(candidates);
+    }
+    EndPoint &endPoint = m_endPoints[index];
+    ++endPoint.outstanding;
+    return endPoint.url;
+}
+
+int KDSoapLoadBalancer::pick(const QVector<int> &candidates)
+{
+    const int count = candidates.size();
+    const int start = int(m_next++ % uint(count));
+    switch (m_policy) {
+    case KDSoapClientInterface::RoundRobin:
+        break;
+    case KDSoapClientInterface::LeastOutstandingRequests: {
+        // Starting from the next one in turn, so that ties are spread
+        int best = candidates.at(start);
+        for (int i = 1; i < count; ++i) {
+            const int index = candidates.at((start + i) % count);
+            if (m_endPoints.at(index).outstanding < m_endPoints.at(best).outstanding) {
+                best = index;
+            }
+        }
+        return best;
+    }
+    case KDSoapClientInterface::PowerOfTwoChoices: {
+        if (count == 1) {
+            break;
+        }
+        const int first = randomIndex(count);
+        int second = randomIndex(count - 1);
+        if (second >= first) {
+            ++second;
+        }
+        const int a = candidates.at(first);
+        const int b = candidates.at(second);
+        return m_endPoints.at(b).outstanding < m_endPoints.at(a).outstanding ? b : a;
+    }
+    }
+    return candidates.at(start);
+}
+
+void KDSoapLoadBalancer::release(const QString &endPoint, Outcome outcome)
+{
+    QMutexLocker locker(&m_mutex);
+    for (EndPoint &ep : m_endPoints) {
+        if (ep.url != endPoint) {
+            continue;
+        }
+        ep.outstanding = qMax(0, ep.outstanding - 1);
+        switch (outcome) {
+        case Success:
+            ep.consecutiveFailures = 0;
+            break;
+        case Failure:
+            if (++ep.consecutiveFailures >= m_failureThreshold && m_failureThreshold > 0 && m_ejectionTime > 0) {
+                ep.consecutiveFailures = 0;
+                ep.ejectedUntil = QDeadlineTimer(m_ejectionTime);
+            }
+            break;
+        case Aborted:
+            break;
+        }
+        return;
+    }
+    // The end point was removed by setEndPoints() in the meantime
+}
+
+KDSoapLoadBalancer::Outcome KDSoapLoadBalancer::outcome(QNetworkReply *reply)
+{
+    if (reply->property("kdsoap_reply_timed_out").toBool()) {
+        // Aborted by KDSoapTimeoutScheduler (or by the retrying reply it aborted), hence OperationCanceledError
+        return Failure;
+    }
+    return outcome(reply->error(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+                   reply->header(QNetworkRequest::ContentTypeHeader).toByteArray());
+}
+
+KDSoapLoadBalancer::Outcome KDSoapLoadBalancer::outcome(QNetworkReply::NetworkError error, int statusCode, const QByteArray &contentType)
+{
+    if (error == QNetworkReply::OperationCanceledError) {
+        // A hedged request which lost the race, or a call aborted by the application
+        return Aborted;
+    }
+    if (KDSoapRetryingReply::isTransportError(error)) {
+        return Failure;
+    }
+    if (statusCode == 500) {
+        // A SOAP fault is the response of a healthy server, unlike e.g. an HTML error page
+        return contentType.contains("xml") ? Success : Failure;
+    }
+    return statusCode > 500 ? Failure : Success;
+}
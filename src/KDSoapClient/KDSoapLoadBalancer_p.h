@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPLOADBALANCER_P_H
+#define KDSOAPLOADBALANCER_P_H
+
+#include "KDSoapClientInterface.h"
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtNetwork/QNetworkReply>
+
+/**
+ * \internal
+ * The end points of a client interface, and the choice of the one each request is sent to.
+ * Shared by the calls made from the main thread and from the threads of blocking calls.
+ *
+ * Each end point counts its outstanding requests (for LeastOutstandingRequests and PowerOfTwoChoices)
+ * and its consecutive failures: after failureThreshold() of them, it's ejected for ejectionTime() milliseconds,
+ * i.e. skipped as long as other end points are available.
+ */
+class KDSoapLoadBalancer
+{
+public:
+    KDSoapLoadBalancer();
+
+    // Duplicates are removed. The counters of the end points which were already there are kept
+    void setEndPoints(const QStringList &endPoints);
+    QStringList endPoints() const;
+    // The first end point, or an empty string
+    QString firstEndPoint() const;
+    // True if there's more than one end point to choose from
+    bool isBalancing() const;
+
+    void setPolicy(KDSoapClientInterface::LoadBalancing policy);
+    KDSoapClientInterface::LoadBalancing policy() const;
+
+    void setEjection(int failureThreshold, int msecs);
+    int failureThreshold() const;
+    int ejectionTime() const;
+    QStringList ejectedEndPoints() const;
+
+    enum Outcome {
+        Success, // the end point answered
+        Failure, // the end point is unhealthy: a transport error, a timeout, or a 5xx status other than a SOAP fault
+        Aborted // the request was canceled before the end point answered, which says nothing about it
+    };
+
+    // Returns the end point of the next request, which is outstanding until release() is called
+    QString acquire();
+    // Records the outcome of a request sent to endPoint
+    void release(const QString &endPoint, Outcome outcome);
+
+    static Outcome outcome(QNetworkReply *reply);
+    static Outcome outcome(QNetworkReply::NetworkError error, int statusCode, const QByteArray &contentType);
+
+private:
+    struct EndPoint
+    {
+        QString url;
+        int outstanding = 0;
+        int consecutiveFailures = 0;
+        QDeadlineTimer ejectedUntil; // expired unless ejected
+    };
+
+    int pick(const QVector<int> &candidates);
+
+    mutable QMutex m_mutex;
+    QVector<EndPoint> m_endPoints;
+    KDSoapClientInterface::LoadBalancing m_policy = KDSoapClientInterface::RoundRobin;
+    int m_failureThreshold = 3;
+    int m_ejectionTime = 30000;
+    uint m_next = 0; // for RoundRobin, and to break ties
+};
+
+#endif // KDSOAPLOADBALANCER_P_H
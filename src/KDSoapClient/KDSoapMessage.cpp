@@ -14,6 +14,7 @@
 #include <QDebug>
 #include <QVariant>
 #include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
 class KDSoapMessageData : public QSharedData
 {
@@ -29,8 +30,20 @@ public:
     bool isFault;
     bool hasMessageAddressingProperties;
     KDSoapMessageAddressingProperties messageAddressingProperties;
+    std::function<void(QXmlStreamWriter &, const QString &)> contentsWriter;
 };
 
+// The data of moved-from messages, shared so that moving doesn't allocate. It's never deleted.
+static KDSoapMessageData *sharedNullMessageData()
+{
+    static KDSoapMessageData *const s_sharedNull = [] {
+        KDSoapMessageData *data = new KDSoapMessageData;
+        data->ref.ref();
+        return data;
+    }();
+    return s_sharedNull;
+}
+
 KDSoapMessage::KDSoapMessage()
     : d(new KDSoapMessageData)
 {
@@ -49,12 +62,32 @@ KDSoapMessage &KDSoapMessage::operator=(const KDSoapMessage &other)
     return *this;
 }
 
+KDSoapMessage::KDSoapMessage(KDSoapMessage &&other) noexcept
+    : KDSoapValue(std::move(other))
+    , d(std::move(other.d))
+{
+    other.d = sharedNullMessageData();
+}
+
+KDSoapMessage &KDSoapMessage::operator=(KDSoapMessage &&other) noexcept
+{
+    KDSoapValue::operator=(std::move(other));
+    d.swap(other.d);
+    return *this;
+}
+
 KDSoapMessage &KDSoapMessage::operator=(const KDSoapValue &other)
 {
     KDSoapValue::operator=(other);
     return *this;
 }
 
+KDSoapMessage &KDSoapMessage::operator=(KDSoapValue &&other) noexcept
+{
+    KDSoapValue::operator=(std::move(other));
+    return *this;
+}
+
 bool KDSoapMessage::operator==(const KDSoapMessage &other) const
 {
     return KDSoapValue::operator==(other) && d->use == other.d->use && d->isFault == other.d->isFault;
@@ -78,6 +111,16 @@ void KDSoapMessage::addArgument(const QString &argumentName, const QVariant &arg
     childValues().append(soapValue);
 }
 
+void KDSoapMessage::addArgument(const QString &argumentName, QVariant &&argumentValue, const QString &typeNameSpace, const QString &typeName)
+{
+    KDSoapValue soapValue(argumentName, QVariant(), typeNameSpace, typeName);
+    soapValue.setValue(std::move(argumentValue));
+    if (isQualified()) {
+        soapValue.setQualified(true);
+    }
+    childValues().append(std::move(soapValue));
+}
+
 void KDSoapMessage::addArgument(const QString &argumentName, const KDSoapValueList &argumentValueList, const QString &typeNameSpace,
                                 const QString &typeName)
 {
@@ -88,6 +131,16 @@ void KDSoapMessage::addArgument(const QString &argumentName, const KDSoapValueLi
     childValues().append(soapValue);
 }
 
+void KDSoapMessage::addArgument(const QString &argumentName, KDSoapValueList &&argumentValueList, const QString &typeNameSpace,
+                                const QString &typeName)
+{
+    KDSoapValue soapValue(argumentName, std::move(argumentValueList), typeNameSpace, typeName);
+    if (isQualified()) {
+        soapValue.setQualified(true);
+    }
+    childValues().append(std::move(soapValue));
+}
+
 // I'm leaving the arguments() method even though it's the same as childValues,
 // because it's the documented public API, needed even in the most simple case,
 // while childValues is the "somewhat internal" KDSoapValue stuff.
@@ -186,6 +239,11 @@ bool KDSoapMessage::hasMessageAddressingProperties() const
     return d->hasMessageAddressingProperties;
 }
 
+void KDSoapMessage::setContentsWriter(const std::function<void(QXmlStreamWriter &, const QString &)> &contentsWriter)
+{
+    d->contentsWriter = contentsWriter;
+}
+
 KDSoapMessage::Use KDSoapMessage::use() const
 {
     return d->use;
@@ -16,8 +16,11 @@
 #include "KDSoapMessageAddressingProperties.h"
 #include "KDSoapValue.h"
 
+#include <functional>
+
 QT_BEGIN_NAMESPACE
 class QString;
+class QXmlStreamWriter;
 QT_END_NAMESPACE
 class KDSoapMessageData;
 class KDSoapHeaders;
@@ -46,10 +49,27 @@ public:
      */
     KDSoapMessage &operator=(const KDSoapMessage &other);
 
+    /**
+     * Move constructor.
+     * \p other is left as an empty message.
+     * \since 2.2
+     */
+    KDSoapMessage(KDSoapMessage &&other) noexcept;
+    /**
+     * Move assignment operator.
+     * \since 2.2
+     */
+    KDSoapMessage &operator=(KDSoapMessage &&other) noexcept;
+
     /**
      * Fills in KDSoapMessage from a KDSoapValue.
      */
     KDSoapMessage &operator=(const KDSoapValue &other);
+    /**
+     * Fills in KDSoapMessage from a KDSoapValue, taking over its contents.
+     * \since 2.2
+     */
+    KDSoapMessage &operator=(KDSoapValue &&other) noexcept;
 
     /**
      * Compares two KDSoapMessages
@@ -89,6 +109,12 @@ public:
      */
     void addArgument(const QString &argumentName, const QVariant &argumentValue, const QString &typeNameSpace = QString(),
                      const QString &typeName = QString());
+    /**
+     * Same as above, moving \p argumentValue into the message.
+     * \since 2.2
+     */
+    void addArgument(const QString &argumentName, QVariant &&argumentValue, const QString &typeNameSpace = QString(),
+                     const QString &typeName = QString());
 
     /**
      * Adds a complex-type argument to the message.
@@ -107,6 +133,13 @@ public:
      */
     void addArgument(const QString &argumentName, const KDSoapValueList &argumentValueList, const QString &typeNameSpace = QString(),
                      const QString &typeName = QString());
+    /**
+     * Same as above, moving \p argumentValueList into the message, so that
+     * it can be modified afterwards through arguments() without being copied.
+     * \since 2.2
+     */
+    void addArgument(const QString &argumentName, KDSoapValueList &&argumentValueList, const QString &typeNameSpace = QString(),
+                     const QString &typeName = QString());
 
     /**
      * Returns the arguments for the message.
@@ -170,6 +203,19 @@ public:
      */
     KDSoapMessageAddressingProperties messageAddressingProperties() const;
 
+    /**
+     * Sets a function which writes the contents of the message element (its attributes
+     * and child elements) when the message is sent, instead of the child values of this message.
+     * The function is called with the XML writer, positioned inside the message element,
+     * and the namespace of the message.
+     *
+     * This is used by the code generated by kdwsdl2cpp with the -xml-stream-serializers option,
+     * in order to write the request directly into the XML, without building KDSoapValues first.
+     * It is only supported with #LiteralUse.
+     * \since 2.2
+     */
+    void setContentsWriter(const std::function<void(QXmlStreamWriter &writer, const QString &messageNamespace)> &contentsWriter);
+
 private:
     bool isNull() const;
     friend class KDSoapPendingCall;
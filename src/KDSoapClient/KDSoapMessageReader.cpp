@@ -10,12 +10,19 @@
 
 #include "KDDateTime.h"
 #include "KDSoapMessageReader_p.h"
+#include "KDSoapMultipart_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
+#include "KDSoapValueArena_p.h"
 
 #include <QDebug>
+#include <QScopedPointer>
+#include <QHash>
+#include <QUrl>
 #include <QXmlStreamReader>
 
+#include <algorithm>
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #define QStringView QStringRef
 #endif
@@ -30,47 +37,261 @@ static QStringView namespaceForPrefix(const QXmlStreamNamespaceDeclarations &dec
     return QStringView();
 }
 
-static int xmlTypeToMetaType(const QString &xmlType)
+namespace {
+// The builtin XML schema types for which we convert the element text to a native type
+enum XmlBuiltinType
+{
+    UnknownXmlType,
+    StringXmlType, // or QUrl
+    Base64BinaryXmlType,
+    BooleanXmlType,
+    DateXmlType,
+    DateTimeXmlType,
+    DoubleXmlType,
+    FloatXmlType,
+    IntXmlType, // or long, or uint, or longlong
+    TimeXmlType,
+    UnsignedIntXmlType
+};
+
+struct XmlTypeEntry
+{
+    const char *xml; // xsd: prefix assumed
+    XmlBuiltinType type;
+};
+
+// Reverse operation from variantToXmlType in KDSoapValue, keep in sync.
+// Must be sorted (in ASCII order), it's used for a binary search.
+const XmlTypeEntry s_xmlTypes[] = {{"base64Binary", Base64BinaryXmlType},
+                                   {"boolean", BooleanXmlType},
+                                   {"date", DateXmlType},
+                                   {"dateTime", DateTimeXmlType},
+                                   {"double", DoubleXmlType},
+                                   {"float", FloatXmlType},
+                                   {"int", IntXmlType},
+                                   {"string", StringXmlType},
+                                   {"time", TimeXmlType},
+                                   {"unsignedInt", UnsignedIntXmlType}};
+
+struct XmlTypeEntryLessThan
 {
-    // Reverse operation from variantToXmlType in KDSoapClientInterface, keep in sync
-    static const struct
+    bool operator()(const XmlTypeEntry &entry, QStringView xmlType) const
     {
-        const char *xml; // xsd: prefix assumed
-        const int metaTypeId;
-    } s_types[] = {{"string", QVariant::String}, // or QUrl
-                   {"base64Binary", QVariant::ByteArray},
-                   {"int", QVariant::Int}, // or long, or uint, or longlong
-                   {"unsignedInt", QVariant::ULongLong},
-                   {"boolean", QVariant::Bool},
-                   {"float", QMetaType::Float},
-                   {"double", QVariant::Double},
-                   {"time", QVariant::Time},
-                   {"date", QVariant::Date}};
-    // Speed: could be sorted and then we could use qBinaryFind
-    for (const auto &type : s_types) {
-        if (xmlType == QLatin1String(type.xml)) {
-            return type.metaTypeId;
-        }
-    }
-    if (xmlType == QLatin1String("dateTime")) {
-        return qMetaTypeId<KDDateTime>();
+        return xmlType.compare(QLatin1String(entry.xml)) > 0;
+    }
+};
+}
+
+static XmlBuiltinType xmlTypeFromName(QStringView xmlType)
+{
+    const XmlTypeEntry *end = s_xmlTypes + sizeof(s_xmlTypes) / sizeof(*s_xmlTypes);
+    const XmlTypeEntry *it = std::lower_bound(s_xmlTypes, end, xmlType, XmlTypeEntryLessThan());
+    if (it != end && xmlType == QLatin1String(it->xml)) {
+        return it->type;
     }
     // This will happen with any custom type, don't bother the user
-    // qDebug() << QString::fromLatin1("xmlTypeToMetaType: XML type %1 is not supported in "
+    // qDebug() << QString::fromLatin1("xmlTypeFromName: XML type %1 is not supported in "
     //                                "KDSoap, see the documentation").arg(xmlType);
-    return -1;
+    return UnknownXmlType;
+}
+
+// "Z" or an offset like "+05:00", at the end of an xsd:date or xsd:time
+static bool endsWithTimeZone(const QString &text)
+{
+    const int size = text.size();
+    if (size > 0 && text.at(size - 1) == QLatin1Char('Z')) {
+        return true;
+    }
+    return size >= 6 && text.at(size - 3) == QLatin1Char(':') && (text.at(size - 6) == QLatin1Char('+') || text.at(size - 6) == QLatin1Char('-'));
+}
+
+// So that value().toString() and value().toDateTime() keep working for callers which expect the text or a QDateTime
+static bool registerDateTimeConverters()
+{
+    QMetaType::registerConverter<KDDateTime, QString>(&KDDateTime::toDateString);
+    QMetaType::registerConverter<KDDateTime, QDateTime>();
+    return true;
+}
+
+static bool isDigitAt(const QString &text, int pos)
+{
+    const ushort c = text.at(pos).unicode();
+    return c >= '0' && c <= '9';
+}
+
+// Returns true if text is laid out like KDDateTime::toDateString() writes it:
+// yyyy-MM-ddThh:mm:ss, then three fractional digits (unless they are all 0), then the time zone if any.
+// The values themselves are validated by KDDateTime::fromDateString().
+static bool isCanonicalDateTime(const QString &text)
+{
+    const int size = text.size();
+    if (size < 19) {
+        return false;
+    }
+    static const char layout[] = "dddd-dd-ddTdd:dd:dd";
+    for (int i = 0; i < 19; ++i) {
+        if (layout[i] == 'd' ? !isDigitAt(text, i) : text.at(i) != QLatin1Char(layout[i])) {
+            return false;
+        }
+    }
+    if (text.at(11) == QLatin1Char('2') && text.at(12) == QLatin1Char('4')) {
+        return false; // 24:00:00 is written as 00:00:00 the next day
+    }
+    int pos = 19;
+    if (pos < size && text.at(pos) == QLatin1Char('.')) {
+        if (size < pos + 4 || !isDigitAt(text, pos + 1) || !isDigitAt(text, pos + 2) || !isDigitAt(text, pos + 3)
+            || (text.at(pos + 1) == QLatin1Char('0') && text.at(pos + 2) == QLatin1Char('0') && text.at(pos + 3) == QLatin1Char('0'))) {
+            return false;
+        }
+        pos += 4;
+    }
+    const int timeZoneSize = size - pos;
+    if (timeZoneSize == 0) {
+        return true;
+    }
+    if (timeZoneSize == 1) {
+        return text.at(pos) == QLatin1Char('Z');
+    }
+    if (timeZoneSize != 6 || !isDigitAt(text, pos + 1) || !isDigitAt(text, pos + 2) || text.at(pos + 3) != QLatin1Char(':')
+        || !isDigitAt(text, pos + 4) || !isDigitAt(text, pos + 5)) {
+        return false;
+    }
+    // A zero offset is stored as UTC, and written as Z
+    const bool zeroOffset = text.at(pos + 1) == QLatin1Char('0') && text.at(pos + 2) == QLatin1Char('0') && text.at(pos + 4) == QLatin1Char('0')
+        && text.at(pos + 5) == QLatin1Char('0');
+    return (text.at(pos) == QLatin1Char('+') || text.at(pos) == QLatin1Char('-')) && !zeroOffset;
+}
+
+// With use=encoded, we have type info, so we can convert the text to the native type right away.
+// Otherwise, for servers, we do it later, once we know the method's parameter types.
+// If the text can't be converted, the text is kept as is.
+static QVariant textToVariant(const QString &text, XmlBuiltinType type)
+{
+    bool ok = true;
+    switch (type) {
+    case UnknownXmlType:
+    case StringXmlType:
+        break;
+    case Base64BinaryXmlType:
+        // Not decoded here, that's up to the caller (e.g. generated code), like QVariant::convert did
+        return QVariant(text.toUtf8());
+    case BooleanXmlType:
+        // Same rules as QVariant::convert: anything but "0", "false" and empty is true
+        return QVariant(!(text == QLatin1String("0") || text.compare(QLatin1String("false"), Qt::CaseInsensitive) == 0));
+    case IntXmlType: {
+        const int i = text.toInt(&ok);
+        if (ok) {
+            return QVariant(i);
+        }
+        break;
+    }
+    case UnsignedIntXmlType: {
+        const qulonglong u = text.toULongLong(&ok);
+        if (ok) {
+            return QVariant(u);
+        }
+        break;
+    }
+    case DoubleXmlType: {
+        const double d = text.toDouble(&ok);
+        if (ok) {
+            return QVariant(d);
+        }
+        break;
+    }
+    case FloatXmlType: {
+        const float f = text.toFloat(&ok);
+        if (ok) {
+            return QVariant(f);
+        }
+        break;
+    }
+    case DateXmlType: {
+        // QDate has no time zone, keep the text if there's one
+        const QDate date = KDDateTime::dateFromString(text);
+        if (date.isValid() && !endsWithTimeZone(text)) {
+            return QVariant(date);
+        }
+        break;
+    }
+    case TimeXmlType: {
+        const QTime time = KDDateTime::timeFromString(text);
+        if (time.isValid() && !endsWithTimeZone(text)) {
+            return QVariant(time);
+        }
+        break;
+    }
+    case DateTimeXmlType: {
+        static const bool s_convertersRegistered = registerDateTimeConverters();
+        Q_UNUSED(s_convertersRegistered);
+        // Only keep the native value if it's lossless (e.g. more than 3 fractional digits aren't)
+        if (isCanonicalDateTime(text)) {
+            const KDDateTime dateTime = KDDateTime::fromDateString(text);
+            if (dateTime.isValid()) {
+                return QVariant::fromValue(dateTime);
+            }
+        }
+        break;
+    }
+    }
+    return QVariant(text);
+}
+
+namespace {
+// A message repeats the same element names and namespaces many times (e.g. one <item> per array entry):
+// let the parsed values share a single copy of each string.
+class StringPool
+{
+public:
+    QString intern(QStringView str)
+    {
+        // Keyed on the hash, so that looking up doesn't need a QString: only a miss allocates one
+        const Hash hash = qHash(str);
+        const auto range = m_strings.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (*it == str) {
+                return *it;
+            }
+        }
+        const QString string = str.toString();
+        m_strings.insert(hash, string);
+        return string;
+    }
+
+private:
+    typedef decltype(qHash(QStringView())) Hash;
+    QMultiHash<Hash, QString> m_strings;
+};
+}
+
+typedef QHash<QString, KDSoapAttachment> XopAttachments;
+
+// Returns the attachment referenced by the xop:Include element the reader is positioned on, if any
+static KDSoapAttachment xopAttachment(QXmlStreamReader &reader, const XopAttachments *xopAttachments)
+{
+    if (!xopAttachments || reader.name() != QLatin1String("Include") || reader.namespaceUri() != KDSoapMultipart::xopNamespace()) {
+        return KDSoapAttachment();
+    }
+    const QString href = reader.attributes().value(QLatin1String("href")).toString();
+    if (!href.startsWith(QLatin1String("cid:"))) {
+        return KDSoapAttachment();
+    }
+    return xopAttachments->value(QUrl::fromPercentEncoding(href.mid(4).toUtf8()));
 }
 
-static KDSoapValue parseElement(QXmlStreamReader &reader, const QXmlStreamNamespaceDeclarations &envNsDecls)
+static KDSoapValue parseElement(QXmlStreamReader &reader, const QXmlStreamNamespaceDeclarations &envNsDecls, StringPool &pool,
+                                const XopAttachments *xopAttachments)
 {
-    const QXmlStreamNamespaceDeclarations combinedNamespaceDeclarations = envNsDecls + reader.namespaceDeclarations();
-    const QString name = reader.name().toString();
-    KDSoapValue val(name, QVariant());
-    val.setNamespaceUri(reader.namespaceUri().toString());
-    val.setNamespaceDeclarations(reader.namespaceDeclarations());
+    const QXmlStreamNamespaceDeclarations localNamespaceDeclarations = reader.namespaceDeclarations();
+    // Share the parent's declarations when there's nothing to add
+    const QXmlStreamNamespaceDeclarations combinedNamespaceDeclarations =
+        localNamespaceDeclarations.isEmpty() ? envNsDecls : envNsDecls + localNamespaceDeclarations;
+    KDSoapValue val(pool.intern(reader.name()), QVariant());
+    val.setNamespaceUri(pool.intern(reader.namespaceUri()));
+    val.setNamespaceDeclarations(localNamespaceDeclarations);
     val.setEnvironmentNamespaceDeclarations(combinedNamespaceDeclarations);
     // qDebug() << "parsing" << name;
-    QVariant::Type metaTypeId = QVariant::Invalid;
+    XmlBuiltinType xmlType = UnknownXmlType;
 
     const QXmlStreamAttributes attributes = reader.attributes();
     for (const QXmlStreamAttribute &attribute : attributes) {
@@ -82,11 +303,10 @@ static KDSoapValue parseElement(QXmlStreamReader &reader, const QXmlStreamNamesp
         if (ns == KDSoapNamespaceManager::xmlSchemaInstance1999() || ns == KDSoapNamespaceManager::xmlSchemaInstance2001()) {
             if (name == QLatin1String("type")) {
                 // The type can be like xsd:float, resolve that
-                const QString type = attrValue.toString();
-                const int pos = type.indexOf(QLatin1Char(':'));
-                const QString dataType = type.mid(pos + 1);
-                val.setType(namespaceForPrefix(combinedNamespaceDeclarations, type.left(pos)).toString(), dataType);
-                metaTypeId = static_cast<QVariant::Type>(xmlTypeToMetaType(dataType));
+                const int pos = attrValue.indexOf(QLatin1Char(':'));
+                const QStringView dataType = attrValue.mid(pos + 1);
+                val.setType(namespaceForPrefix(combinedNamespaceDeclarations, attrValue.left(pos).toString()).toString(), dataType.toString());
+                xmlType = xmlTypeFromName(dataType);
             }
             continue;
         } else if (ns == KDSoapNamespaceManager::soapEncoding() || ns == KDSoapNamespaceManager::soapEncoding200305()
@@ -94,9 +314,10 @@ static KDSoapValue parseElement(QXmlStreamReader &reader, const QXmlStreamNamesp
             continue;
         }
         // qDebug() << "Got attribute:" << name << ns << "=" << attrValue;
-        val.childValues().attributes().append(KDSoapValue(name.toString(), attrValue.toString()));
+        val.childValues().attributes().append(KDSoapValue(pool.intern(name), attrValue.toString()));
     }
     QString text;
+    bool hasAttachment = false;
     while (reader.readNext() != QXmlStreamReader::Invalid) {
         if (reader.isEndElement()) {
             break;
@@ -105,29 +326,40 @@ static KDSoapValue parseElement(QXmlStreamReader &reader, const QXmlStreamNamesp
             text = reader.text().toString();
             // qDebug() << "text=" << text;
         } else if (reader.isStartElement()) {
-            const KDSoapValue subVal = parseElement(reader, combinedNamespaceDeclarations); // recurse
-            val.childValues().append(subVal);
+            const KDSoapAttachment attachment = xopAttachment(reader, xopAttachments);
+            if (!attachment.isNull()) {
+                // MTOM: the element's binary data is in a MIME part
+                static const bool s_converterRegistered = QMetaType::registerConverter<KDSoapAttachment, QByteArray>(&KDSoapAttachment::data);
+                Q_UNUSED(s_converterRegistered);
+                val.setValue(QVariant::fromValue(attachment));
+                hasAttachment = true;
+                reader.skipCurrentElement();
+                continue;
+            }
+            KDSoapValue subVal = parseElement(reader, combinedNamespaceDeclarations, pool, xopAttachments); // recurse
+            val.childValues().append(std::move(subVal));
         }
     }
 
-    if (!text.isEmpty()) {
-        QVariant variant(text);
-        // qDebug() << text << variant << metaTypeId;
-        // With use=encoded, we have type info, we can convert the variant here
-        // Otherwise, for servers, we do it later, once we know the method's parameter types.
-        if (metaTypeId != QVariant::Invalid) {
-            QVariant copy = variant;
-            if (!variant.convert(metaTypeId)) {
-                variant = copy;
-            }
-        }
-        val.setValue(variant);
+    if (!text.isEmpty() && !hasAttachment) {
+        val.setValue(textToVariant(text, xmlType));
     }
     return val;
 }
 
 KDSoapMessageReader::KDSoapMessageReader()
+    : m_useArena(false)
+{
+}
+
+void KDSoapMessageReader::setUseArena(bool useArena)
+{
+    m_useArena = useArena;
+}
+
+void KDSoapMessageReader::setXopAttachments(const QHash<QString, KDSoapAttachment> &attachments)
 {
+    m_xopAttachments = attachments;
 }
 
 static bool isInvalidCharRef(const QByteArray &charRef)
@@ -176,11 +408,29 @@ static QByteArray handleNotWellFormedError(const QByteArray &data, qint64 offset
     return dataCleanedUp;
 }
 
+KDSoapValue KDSoapMessageReader::readElement(QXmlStreamReader &reader)
+{
+    StringPool pool;
+    return parseElement(reader, QXmlStreamNamespaceDeclarations(), pool, nullptr);
+}
+
 KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray &data, KDSoapMessage *pMsg, QString *pMessageNamespace,
                                                                 KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion) const
+{
+    return xmlToMessage(data, pMsg, pMessageNamespace, pRequestHeaders, soapVersion, BodyReader());
+}
+
+KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray &data, KDSoapMessage *pMsg, QString *pMessageNamespace,
+                                                                KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion,
+                                                                const BodyReader &bodyReader) const
 {
     Q_ASSERT(pMsg);
     QXmlStreamReader reader(data);
+    StringPool pool;
+    const XopAttachments *xopAttachments = m_xopAttachments.isEmpty() ? nullptr : &m_xopAttachments;
+    // The values keep the arena's memory alive, it's released once the message is gone
+    QScopedPointer<KDSoapValueArena> arena(m_useArena ? new KDSoapValueArena : nullptr);
+    const KDSoapValueArena::Scope arenaScope(arena.data());
     if (reader.readNextStartElement()) {
         if (reader.name() == QLatin1String("Envelope")
             && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
@@ -193,11 +443,11 @@ KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray
                     KDSoapMessageAddressingProperties messageAddressingProperties;
                     while (reader.readNextStartElement()) {
                         if (KDSoapMessageAddressingProperties::isWSAddressingNamespace(reader.namespaceUri().toString())) {
-                            KDSoapValue value = parseElement(reader, envNsDecls);
+                            KDSoapValue value = parseElement(reader, envNsDecls, pool, xopAttachments);
                             messageAddressingProperties.readMessageAddressingProperty(value);
                         } else {
                             KDSoapMessage header;
-                            static_cast<KDSoapValue &>(header) = parseElement(reader, envNsDecls);
+                            static_cast<KDSoapValue &>(header) = parseElement(reader, envNsDecls, pool, xopAttachments);
                             pRequestHeaders->append(header);
                         }
                     }
@@ -208,14 +458,24 @@ KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray
                     && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
                         || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
                     if (reader.readNextStartElement()) {
-                        *pMsg = parseElement(reader, envNsDecls);
-                        if (pMessageNamespace) {
-                            *pMessageNamespace = pMsg->namespaceUri();
-                        }
-                        if (pMsg->name() == QLatin1String("Fault")
+                        const bool isFault = reader.name() == QLatin1String("Fault")
                             && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
-                                || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
-                            pMsg->setFault(true);
+                                || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305());
+                        // Let the caller deserialize the body straight from the XML stream.
+                        // Not with MTOM: the xop:Include elements are only resolved by parseElement()
+                        if (bodyReader && !isFault && !xopAttachments) {
+                            if (pMessageNamespace) {
+                                *pMessageNamespace = reader.namespaceUri().toString();
+                            }
+                            bodyReader(reader);
+                        } else {
+                            *pMsg = parseElement(reader, envNsDecls, pool, xopAttachments);
+                            if (pMessageNamespace) {
+                                *pMessageNamespace = pMsg->namespaceUri();
+                            }
+                            if (isFault) {
+                                pMsg->setFault(true);
+                            }
                         }
                     }
 
@@ -234,7 +494,7 @@ KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray
             qWarning() << "Handling a Not well Formed Error";
             QByteArray dataCleanedUp = handleNotWellFormedError(data, reader.characterOffset());
             if (!dataCleanedUp.isEmpty()) {
-                return xmlToMessage(dataCleanedUp, pMsg, pMessageNamespace, pRequestHeaders, soapVersion);
+                return xmlToMessage(dataCleanedUp, pMsg, pMessageNamespace, pRequestHeaders, soapVersion, bodyReader);
             }
         }
         QString faultText = QString::fromLatin1("XML error: [%1:%2] %3")
@@ -11,8 +11,16 @@
 #ifndef KDSOAPMESSAGEREADER_P_H
 #define KDSOAPMESSAGEREADER_P_H
 
+#include "KDSoapAttachment.h"
 #include "KDSoapClientInterface.h"
 #include "KDSoapMessage.h"
+#include <QtCore/QHash>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QXmlStreamReader;
+QT_END_NAMESPACE
 
 class KDSOAP_EXPORT KDSoapMessageReader
 {
@@ -26,8 +34,31 @@ public:
 
     KDSoapMessageReader();
 
+    // Allocates all the values of each parsed message from a single KDSoapValueArena
+    void setUseArena(bool useArena);
+
+    // The attachments of a MTOM message, by Content-ID. Elements with an xop:Include
+    // referencing one of them get the KDSoapAttachment as value.
+    void setXopAttachments(const QHash<QString, KDSoapAttachment> &attachments);
+
     XmlError xmlToMessage(const QByteArray &data, KDSoapMessage *pParsedMessage, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders,
                           KDSoap::SoapVersion soapVersion) const;
+
+    // Called with the reader positioned on the first child element of the SOAP body,
+    // must read up to (and including) the matching end element.
+    typedef std::function<void(QXmlStreamReader &)> BodyReader;
+
+    // Same as above, but a non-fault body is handed over to bodyReader rather than parsed into pParsedMessage.
+    // Except with XOP attachments (see setXopAttachments()): the body is then parsed into pParsedMessage as usual.
+    XmlError xmlToMessage(const QByteArray &data, KDSoapMessage *pParsedMessage, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders,
+                          KDSoap::SoapVersion soapVersion, const BodyReader &bodyReader) const;
+
+    // Parses the element the reader is positioned on, and all its children.
+    static KDSoapValue readElement(QXmlStreamReader &reader);
+
+private:
+    bool m_useArena;
+    QHash<QString, KDSoapAttachment> m_xopAttachments;
 };
 
 #endif
@@ -12,11 +12,14 @@
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
 #include "KDSoapValue.h"
+#include <QBuffer>
 #include <QDebug>
 #include <QVariant>
 
 KDSoapMessageWriter::KDSoapMessageWriter()
     : m_version(KDSoap::SOAP1_1)
+    , m_xopAttachments(nullptr)
+    , m_streamedAttachments(nullptr)
 {
 }
 
@@ -30,56 +33,162 @@ void KDSoapMessageWriter::setMessageNamespace(const QString &ns)
     m_messageNamespace = ns;
 }
 
+void KDSoapMessageWriter::setXopAttachments(QVector<KDSoapAttachment> *attachments)
+{
+    m_xopAttachments = attachments;
+}
+
+void KDSoapMessageWriter::setStreamedAttachments(QVector<KDSoapStreamedAttachment> *attachments)
+{
+    m_streamedAttachments = attachments;
+}
+
+QString KDSoapMessageWriter::messageNamespaceFor(const KDSoapMessage &message) const
+{
+    QString messageNamespace = m_messageNamespace;
+    if (!message.namespaceUri().isEmpty() && messageNamespace != message.namespaceUri()) {
+        messageNamespace = message.namespaceUri();
+    }
+    return messageNamespace;
+}
+
+QString KDSoapMessageWriter::soapEnvelopeNamespace() const
+{
+    if (m_version == KDSoap::SOAP1_2) {
+        return KDSoapNamespaceManager::soapEnvelope200305();
+    }
+    return KDSoapNamespaceManager::soapEnvelope();
+}
+
+void KDSoapMessageWriter::prepareOutput(QByteArray &output, int sizeHint)
+{
+    // reserve() first, so that resize(0) keeps the allocated memory
+    output.reserve(qMax(sizeHint, int(output.capacity())));
+    output.resize(0);
+}
+
 QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
                                              const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const
 {
     QByteArray data;
-    QXmlStreamWriter writer(&data);
-    writer.writeStartDocument();
+    messageToXml(data, 0, message, method, headers, persistentHeaders, authentication);
+    return data;
+}
+
+void KDSoapMessageWriter::messageToXml(QByteArray &output, int sizeHint, const KDSoapMessage &message, const QString &method,
+                                       const KDSoapHeaders &headers, const QMap<QString, KDSoapMessage> &persistentHeaders,
+                                       const KDSoapAuthentication &authentication) const
+{
+    prepareOutput(output, sizeHint);
+    QXmlStreamWriter writer(&output);
+    KDSoapNamespacePrefixes namespacePrefixes;
+    namespacePrefixes.setXopAttachments(m_xopAttachments);
+    namespacePrefixes.setStreamedAttachments(m_streamedAttachments);
+    namespacePrefixes.setDirectTextOutput(true);
+    const QString messageNamespace = messageNamespaceFor(message);
+    writeEnvelopeStart(namespacePrefixes, writer, message, messageNamespace, headers, persistentHeaders, authentication);
+    writeBody(namespacePrefixes, writer, message, method, messageNamespace);
+}
+
+bool KDSoapMessageWriter::supportsEnvelopeTemplate(const KDSoapMessage &message, const KDSoapHeaders &headers, const KDSoapAuthentication &authentication)
+{
+    return headers.isEmpty() && !message.hasMessageAddressingProperties() && !authentication.hasWSUsernameTokenHeader();
+}
+
+KDSoapEnvelopeTemplate KDSoapMessageWriter::envelopeTemplate(const KDSoapMessage &message, const QMap<QString, KDSoapMessage> &persistentHeaders,
+                                                             const KDSoapAuthentication &authentication) const
+{
+    KDSoapEnvelopeTemplate envelope;
+    envelope.m_messageNamespace = messageNamespaceFor(message);
+    envelope.m_version = m_version;
+    envelope.m_valid = true;
+    if (persistentHeaders.isEmpty()) {
+        return envelope;
+    }
+
+    // Written in the same context as in writeEnvelopeStart(), for the namespace prefixes in scope
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QXmlStreamWriter writer(&buffer);
+    KDSoapNamespacePrefixes namespacePrefixes;
+    namespacePrefixes.writeStandardNamespaces(writer, m_version);
+    writer.writeStartElement(soapEnvelopeNamespace(), QLatin1String("Envelope"));
+    namespacePrefixes.writeNamespace(writer, envelope.m_messageNamespace, QLatin1String("n1"));
+    writer.writeCharacters(QString()); // closes the Envelope start tag
+    const qint64 headerStart = buffer.pos();
+    writeHeader(namespacePrefixes, writer, KDSoapMessage(), envelope.m_messageNamespace, KDSoapHeaders(), persistentHeaders, authentication);
+    envelope.m_header = data.mid(int(headerStart));
+    return envelope;
+}
+
+bool KDSoapMessageWriter::matchesEnvelopeTemplate(const KDSoapEnvelopeTemplate &envelope, const KDSoapMessage &message) const
+{
+    return !envelope.isNull() && envelope.m_version == m_version && envelope.m_messageNamespace == messageNamespaceFor(message);
+}
+
+QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const QString &method, const KDSoapEnvelopeTemplate &envelope) const
+{
+    QByteArray data;
+    messageToXml(data, 0, message, method, envelope);
+    return data;
+}
+
+void KDSoapMessageWriter::messageToXml(QByteArray &output, int sizeHint, const KDSoapMessage &message, const QString &method,
+                                       const KDSoapEnvelopeTemplate &envelope) const
+{
+    Q_ASSERT(matchesEnvelopeTemplate(envelope, message));
+    const QString messageNamespace = envelope.m_messageNamespace;
+    const QString soapEnvelope = soapEnvelopeNamespace();
 
+    prepareOutput(output, sizeHint);
+    QBuffer buffer(&output);
+    buffer.open(QIODevice::WriteOnly);
+    QXmlStreamWriter writer(&buffer);
     KDSoapNamespacePrefixes namespacePrefixes;
+    namespacePrefixes.setXopAttachments(m_xopAttachments);
+    namespacePrefixes.setStreamedAttachments(m_streamedAttachments);
+    namespacePrefixes.setDirectTextOutput(true);
+
+    // Same as writeEnvelopeStart, except for the Header element, which is copied from the template
+    writer.writeStartDocument();
+    namespacePrefixes.writeStandardNamespaces(writer, m_version);
+    writer.writeStartElement(soapEnvelope, QLatin1String("Envelope"));
+    if (!envelope.m_header.isEmpty()) {
+        namespacePrefixes.writeNamespace(writer, messageNamespace, QLatin1String("n1"));
+        writer.writeCharacters(QString()); // closes the Envelope start tag, the Header element goes right after it
+        buffer.write(envelope.m_header);
+    } else {
+        namespacePrefixes.insert(messageNamespace, QString::fromLatin1("n1"));
+    }
+    writer.writeStartElement(soapEnvelope, QLatin1String("Body"));
+    writeBody(namespacePrefixes, writer, message, method, messageNamespace);
+    buffer.close();
+}
+
+void KDSoapMessageWriter::writeEnvelopeStart(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapMessage &message,
+                                             const QString &messageNamespace, const KDSoapHeaders &headers,
+                                             const QMap<QString, KDSoapMessage> &persistentHeaders,
+                                             const KDSoapAuthentication &authentication) const
+{
+    writer.writeStartDocument();
+
     namespacePrefixes.writeStandardNamespaces(writer, m_version, message.hasMessageAddressingProperties(),
                                               message.messageAddressingProperties().addressingNamespace());
 
-    QString soapEnvelope;
-    QString soapEncoding;
-    if (m_version == KDSoap::SOAP1_1) {
-        soapEnvelope = KDSoapNamespaceManager::soapEnvelope();
-        soapEncoding = KDSoapNamespaceManager::soapEncoding();
-    } else if (m_version == KDSoap::SOAP1_2) {
-        soapEnvelope = KDSoapNamespaceManager::soapEnvelope200305();
-        soapEncoding = KDSoapNamespaceManager::soapEncoding200305();
-    }
+    const QString soapEnvelope = soapEnvelopeNamespace();
 
     writer.writeStartElement(soapEnvelope, QLatin1String("Envelope"));
 
     // This has been removed, see https://msdn.microsoft.com/en-us/library/ms995710.aspx for details
     // writer.writeAttribute(soapEnvelope, QLatin1String("encodingStyle"), soapEncoding);
 
-    QString messageNamespace = m_messageNamespace;
-    if (!message.namespaceUri().isEmpty() && messageNamespace != message.namespaceUri()) {
-        messageNamespace = message.namespaceUri();
-    }
-
     if (!headers.isEmpty() || !persistentHeaders.isEmpty() || message.hasMessageAddressingProperties() || authentication.hasWSUsernameTokenHeader()) {
         // This writeNamespace line adds the xmlns:n1 to <Envelope>, which looks ugly and unusual (and breaks all unittests)
         // However it's the best solution in case of headers, otherwise we get n1 in the header and n2 in the body,
         // and xsi:type attributes that refer to n1, which isn't defined in the body...
         namespacePrefixes.writeNamespace(writer, messageNamespace, QLatin1String("n1") /*make configurable?*/);
-        writer.writeStartElement(soapEnvelope, QLatin1String("Header"));
-        for (const KDSoapMessage &header : qAsConst(persistentHeaders)) {
-            header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
-        }
-        for (const KDSoapMessage &header : qAsConst(headers)) {
-            header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
-        }
-        if (message.hasMessageAddressingProperties()) {
-            message.messageAddressingProperties().writeMessageAddressingProperties(namespacePrefixes, writer, messageNamespace, true);
-        }
-        if (authentication.hasWSUsernameTokenHeader()) {
-            authentication.writeWSUsernameTokenHeader(writer);
-        }
-        writer.writeEndElement(); // Header
+        writeHeader(namespacePrefixes, writer, message, messageNamespace, headers, persistentHeaders, authentication);
     } else {
         // So in the standard case (no headers) we just rely on Qt calling it n1 and insert it into the map.
         // Calling this after the writeStartElement(ns, elementName) below leads to a double-definition of n1.
@@ -87,7 +196,31 @@ QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const
     }
 
     writer.writeStartElement(soapEnvelope, QLatin1String("Body"));
+}
+
+void KDSoapMessageWriter::writeHeader(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapMessage &message,
+                                      const QString &messageNamespace, const KDSoapHeaders &headers,
+                                      const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const
+{
+    writer.writeStartElement(soapEnvelopeNamespace(), QLatin1String("Header"));
+    for (const KDSoapMessage &header : qAsConst(persistentHeaders)) {
+        header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
+    }
+    for (const KDSoapMessage &header : qAsConst(headers)) {
+        header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
+    }
+    if (message.hasMessageAddressingProperties()) {
+        message.messageAddressingProperties().writeMessageAddressingProperties(namespacePrefixes, writer, messageNamespace, true);
+    }
+    if (authentication.hasWSUsernameTokenHeader()) {
+        authentication.writeWSUsernameTokenHeader(writer);
+    }
+    writer.writeEndElement(); // Header
+}
 
+void KDSoapMessageWriter::writeBody(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapMessage &message,
+                                    const QString &method, const QString &messageNamespace) const
+{
     const QString elementName = !method.isEmpty() ? method : message.name();
     if (elementName.isEmpty()) {
         if (message.isNull()) {
@@ -103,14 +236,18 @@ QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const
             writer.writeStartElement(messageNamespace, elementName);
         } else {
             // Fault element should be inside soap namespace
-            writer.writeStartElement(soapEnvelope, elementName);
+            writer.writeStartElement(soapEnvelopeNamespace(), elementName);
+        }
+        if (message.d->contentsWriter) {
+            // The generated code writing the contents uses the prefixes, attachments and text settings of this message
+            const KDSoapNamespacePrefixes::CurrentScope scope(namespacePrefixes, writer);
+            message.d->contentsWriter(writer, messageNamespace);
+        } else {
+            message.writeElementContents(namespacePrefixes, writer, message.use(), messageNamespace);
         }
-        message.writeElementContents(namespacePrefixes, writer, message.use(), messageNamespace);
         writer.writeEndElement();
     }
     writer.writeEndElement(); // Body
     writer.writeEndElement(); // Envelope
     writer.writeEndDocument();
-
-    return data;
 }
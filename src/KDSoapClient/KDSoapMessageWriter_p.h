@@ -16,13 +16,43 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QMap>
 #include <QtCore/QString>
+#include <QtCore/QVector>
 #include <QtCore/QXmlStreamWriter>
+class KDSoapAttachment;
+struct KDSoapStreamedAttachment;
 class KDSoapMessage;
 class KDSoapHeaders;
 class KDSoapNamespacePrefixes;
 class KDSoapValue;
 class KDSoapValueList;
 
+/**
+ * \internal
+ * The Header element of an envelope, rendered once for a given SOAP version, message namespace
+ * and set of persistent headers. Created by KDSoapMessageWriter::envelopeTemplate().
+ */
+class KDSoapEnvelopeTemplate
+{
+public:
+    KDSoapEnvelopeTemplate()
+        : m_version(KDSoap::SOAP1_1)
+        , m_valid(false)
+    {
+    }
+
+    bool isNull() const
+    {
+        return !m_valid;
+    }
+
+private:
+    friend class KDSoapMessageWriter;
+    QByteArray m_header; // empty without persistent headers
+    QString m_messageNamespace;
+    KDSoap::SoapVersion m_version;
+    bool m_valid;
+};
+
 /**
  * \internal
  * Internal class -- only exported for the server lib
@@ -35,14 +65,81 @@ public:
     void setVersion(KDSoap::SoapVersion version);
     void setMessageNamespace(const QString &ns);
 
+    /**
+     * Writes the binary values of the messages as MTOM/XOP attachments, appending them to \p attachments,
+     * rather than as base64 text. Use nullptr (the default) to disable.
+     */
+    void setXopAttachments(QVector<KDSoapAttachment> *attachments);
+
+    /**
+     * Leaves out the base64 text of the attachment values whose device can be streamed, appending their position
+     * in the XML to \p attachments instead, for sending the message through a KDSoapStreamingBody.
+     * Use nullptr (the default) to disable. Ignored for the attachments sent with MTOM.
+     */
+    void setStreamedAttachments(QVector<KDSoapStreamedAttachment> *attachments);
+
     QByteArray messageToXml(const KDSoapMessage &message, const QString &method /*empty in document style*/,
                             const KDSoapHeaders &headers,
                             const QMap<QString, KDSoapMessage> &persistentHeaders,
                             const KDSoapAuthentication &authentication = KDSoapAuthentication()) const;
 
+    /**
+     * Same as messageToXml, but writes into \p output, reusing the memory it already allocated.
+     * \p sizeHint is the expected size of the message, e.g. the size of the previous message
+     * for the same operation, so that the memory is allocated once up front.
+     */
+    void messageToXml(QByteArray &output, int sizeHint, const KDSoapMessage &message, const QString &method /*empty in document style*/,
+                      const KDSoapHeaders &headers, const QMap<QString, KDSoapMessage> &persistentHeaders,
+                      const KDSoapAuthentication &authentication = KDSoapAuthentication()) const;
+
+    /**
+     * Returns true if the envelope for \p message only depends on the persistent headers,
+     * i.e. if it can be written with an envelope template.
+     * This isn't the case with per-call headers, WS-Addressing properties or a WS-UsernameToken (which changes for every call).
+     */
+    static bool supportsEnvelopeTemplate(const KDSoapMessage &message, const KDSoapHeaders &headers, const KDSoapAuthentication &authentication);
+
+    /**
+     * Renders the Header element of the envelope, for the message namespace of \p message.
+     */
+    KDSoapEnvelopeTemplate envelopeTemplate(const KDSoapMessage &message, const QMap<QString, KDSoapMessage> &persistentHeaders,
+                                            const KDSoapAuthentication &authentication) const;
+
+    /**
+     * Returns true if \p envelope was created for the same SOAP version and message namespace as \p message would use.
+     */
+    bool matchesEnvelopeTemplate(const KDSoapEnvelopeTemplate &envelope, const KDSoapMessage &message) const;
+
+    /**
+     * Same as the other messageToXml, but copies the Header element from \p envelope
+     * instead of serializing the persistent headers.
+     */
+    QByteArray messageToXml(const KDSoapMessage &message, const QString &method /*empty in document style*/,
+                            const KDSoapEnvelopeTemplate &envelope) const;
+
+    /**
+     * Same as the above, but writes into \p output, like the messageToXml overload taking a size hint.
+     */
+    void messageToXml(QByteArray &output, int sizeHint, const KDSoapMessage &message, const QString &method /*empty in document style*/,
+                      const KDSoapEnvelopeTemplate &envelope) const;
+
 private:
+    static void prepareOutput(QByteArray &output, int sizeHint);
+    QString messageNamespaceFor(const KDSoapMessage &message) const;
+    QString soapEnvelopeNamespace() const;
+    void writeEnvelopeStart(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapMessage &message,
+                            const QString &messageNamespace, const KDSoapHeaders &headers,
+                            const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const;
+    void writeHeader(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapMessage &message,
+                     const QString &messageNamespace, const KDSoapHeaders &headers, const QMap<QString, KDSoapMessage> &persistentHeaders,
+                     const KDSoapAuthentication &authentication) const;
+    void writeBody(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapMessage &message,
+                   const QString &method, const QString &messageNamespace) const;
+
     QString m_messageNamespace;
     KDSoap::SoapVersion m_version;
+    QVector<KDSoapAttachment> *m_xopAttachments;
+    QVector<KDSoapStreamedAttachment> *m_streamedAttachments;
 };
 
 #endif // KDSOAPMESSAGEWRITER_P_H
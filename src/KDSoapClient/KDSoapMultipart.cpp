@@ -0,0 +1,306 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapMultipart_p.h"
+#include "KDSoapAttachment_p.h"
+#include "KDSoapBinaryCodec.h"
+#include <QHttpMultiPart>
+#include <QNetworkRequest>
+#include <QUuid>
+
+static const char s_rootContentId[] = "root.message@kdsoap";
+
+namespace {
+// Keeps the attachments (and therefore their devices) alive until the upload is done
+class MtomHttpMultiPart : public QHttpMultiPart
+{
+public:
+    explicit MtomHttpMultiPart(const QVector<KDSoapAttachment> &attachments)
+        : QHttpMultiPart(QHttpMultiPart::RelatedType)
+        , m_attachments(attachments)
+    {
+    }
+
+private:
+    QVector<KDSoapAttachment> m_attachments;
+};
+}
+
+static QByteArray quoted(const QByteArray &value)
+{
+    QByteArray result;
+    result.reserve(value.size() + 2);
+    result += '"';
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    result += '"';
+    return result;
+}
+
+static QByteArray mediaType(const QByteArray &contentType)
+{
+    const int sep = contentType.indexOf(';');
+    return (sep < 0 ? contentType : contentType.left(sep)).trimmed();
+}
+
+static QByteArray stripAngleBrackets(const QByteArray &contentId)
+{
+    const QByteArray id = contentId.trimmed();
+    if (id.startsWith('<') && id.endsWith('>')) {
+        return id.mid(1, id.size() - 2);
+    }
+    return id;
+}
+
+QString KDSoapMultipart::xopNamespace()
+{
+    return QStringLiteral("http://www.w3.org/2004/08/xop/include");
+}
+
+bool KDSoapMultipart::isMultipartRelated(const QByteArray &contentType)
+{
+    return qstricmp(mediaType(contentType).constData(), "multipart/related") == 0;
+}
+
+QByteArray KDSoapMultipart::headerParameter(const QByteArray &headerValue, const QByteArray &name)
+{
+    const int length = headerValue.size();
+    int pos = headerValue.indexOf(';');
+    while (pos >= 0 && pos < length) {
+        const int eq = headerValue.indexOf('=', pos + 1);
+        if (eq < 0) {
+            break;
+        }
+        const QByteArray paramName = headerValue.mid(pos + 1, eq - pos - 1).trimmed();
+        pos = eq + 1;
+        while (pos < length && (headerValue.at(pos) == ' ' || headerValue.at(pos) == '\t')) {
+            ++pos;
+        }
+        QByteArray value;
+        if (pos < length && headerValue.at(pos) == '"') {
+            ++pos;
+            while (pos < length && headerValue.at(pos) != '"') {
+                if (headerValue.at(pos) == '\\' && pos + 1 < length) {
+                    ++pos;
+                }
+                value += headerValue.at(pos);
+                ++pos;
+            }
+            pos = headerValue.indexOf(';', pos);
+        } else {
+            const int end = headerValue.indexOf(';', pos);
+            value = headerValue.mid(pos, end < 0 ? length - pos : end - pos).trimmed();
+            pos = end;
+        }
+        if (qstricmp(paramName.constData(), name.constData()) == 0) {
+            return value;
+        }
+    }
+    return QByteArray();
+}
+
+QByteArray KDSoapMultipart::generateBoundary()
+{
+    return "MIMEBoundary_" + QUuid::createUuid().toRfc4122().toHex();
+}
+
+QByteArray KDSoapMultipart::contentType(const QByteArray &soapContentType, const QByteArray &boundary)
+{
+    QByteArray result = "multipart/related; type=\"application/xop+xml\"; boundary=" + quoted(boundary);
+    result += "; start=\"<";
+    result += s_rootContentId;
+    result += ">\"; start-info=" + quoted(mediaType(soapContentType));
+    // SOAP 1.2 passes the action as a parameter of the Content-Type
+    const QByteArray action = headerParameter(soapContentType, "action");
+    if (!action.isEmpty()) {
+        result += "; action=" + quoted(action);
+    }
+    return result;
+}
+
+QByteArray KDSoapMultipart::rootContentType(const QByteArray &soapContentType)
+{
+    return "application/xop+xml; charset=UTF-8; type=" + quoted(mediaType(soapContentType));
+}
+
+QByteArray KDSoapMultipart::rootPartHeader(const QByteArray &soapContentType, const QByteArray &boundary)
+{
+    QByteArray header = "--" + boundary;
+    header += "\r\nContent-Type: " + rootContentType(soapContentType);
+    header += "\r\nContent-Transfer-Encoding: binary\r\nContent-ID: <";
+    header += s_rootContentId;
+    header += ">\r\n\r\n";
+    return header;
+}
+
+QByteArray KDSoapMultipart::attachmentPartHeader(const KDSoapAttachment &attachment, const QByteArray &boundary)
+{
+    QByteArray header = "\r\n--" + boundary;
+    header += "\r\nContent-Type: " + attachment.contentType().toLatin1();
+    header += "\r\nContent-Transfer-Encoding: binary\r\nContent-ID: <" + attachment.contentId().toUtf8();
+    header += ">\r\n\r\n";
+    return header;
+}
+
+QByteArray KDSoapMultipart::closeDelimiter(const QByteArray &boundary)
+{
+    return "\r\n--" + boundary + "--\r\n";
+}
+
+qint64 KDSoapMultipart::prepareForSending(const KDSoapAttachment &attachment, QByteArray *data)
+{
+    const_cast<KDSoapAttachment::Private *>(attachment.d.constData())->readSequentialDevice();
+    if (attachment.d->inMemory) {
+        *data = attachment.d->data;
+        return data->size();
+    }
+    QIODevice *device = attachment.device();
+    device->seek(0);
+    return device->size();
+}
+
+QHttpMultiPart *KDSoapMultipart::createHttpMultiPart(const QByteArray &envelope, const QByteArray &soapContentType, const QByteArray &boundary,
+                                                      const QVector<KDSoapAttachment> &attachments)
+{
+    QHttpMultiPart *multiPart = new MtomHttpMultiPart(attachments);
+    multiPart->setBoundary(boundary);
+
+    QHttpPart rootPart;
+    rootPart.setHeader(QNetworkRequest::ContentTypeHeader, rootContentType(soapContentType));
+    rootPart.setRawHeader("Content-Transfer-Encoding", "binary");
+    rootPart.setRawHeader("Content-ID", QByteArray("<") + s_rootContentId + '>');
+    rootPart.setBody(envelope);
+    multiPart->append(rootPart);
+
+    for (const KDSoapAttachment &attachment : attachments) {
+        QHttpPart part;
+        part.setHeader(QNetworkRequest::ContentTypeHeader, attachment.contentType().toLatin1());
+        part.setRawHeader("Content-Transfer-Encoding", "binary");
+        part.setRawHeader("Content-ID", '<' + attachment.contentId().toUtf8() + '>');
+        QByteArray data;
+        prepareForSending(attachment, &data);
+        if (data.isNull()) {
+            part.setBodyDevice(attachment.device());
+        } else {
+            part.setBody(data);
+        }
+        multiPart->append(part);
+    }
+    return multiPart;
+}
+
+bool KDSoapMultipart::parse(const QByteArray &contentType, const QByteArray &body, QByteArray *envelope, QByteArray *soapContentType,
+                            QHash<QString, KDSoapAttachment> *attachments)
+{
+    const QByteArray boundary = headerParameter(contentType, "boundary");
+    if (boundary.isEmpty()) {
+        return false;
+    }
+    const QByteArray delimiter = "\r\n--" + boundary;
+    const QByteArray start = stripAngleBrackets(headerParameter(contentType, "start"));
+
+    // The first delimiter may come without the preceding CRLF
+    int pos;
+    if (body.startsWith(delimiter.mid(2))) {
+        pos = delimiter.size() - 2;
+    } else {
+        pos = body.indexOf(delimiter);
+        if (pos < 0) {
+            return false;
+        }
+        pos += delimiter.size();
+    }
+
+    bool foundRoot = false;
+    QByteArray rootType;
+    while (pos + 1 < body.size() && !(body.at(pos) == '-' && body.at(pos + 1) == '-')) {
+        // Skip the rest of the delimiter line, then the part headers
+        const int lineEnd = body.indexOf("\r\n", pos);
+        if (lineEnd < 0) {
+            return false;
+        }
+        const int headersEnd = body.indexOf("\r\n\r\n", lineEnd);
+        if (headersEnd < 0) {
+            return false;
+        }
+        const int contentStart = headersEnd + 4;
+        const int contentEnd = body.indexOf(delimiter, contentStart);
+        if (contentEnd < 0) {
+            return false;
+        }
+
+        QByteArray partContentType;
+        QByteArray contentId;
+        QByteArray transferEncoding;
+        QList<QByteArray> headerLines;
+        // headersEnd == lineEnd when the delimiter line is directly followed by the empty line: no headers
+        if (headersEnd > lineEnd) {
+            headerLines = body.mid(lineEnd + 2, headersEnd - lineEnd - 2).split('\n');
+        }
+        for (const QByteArray &line : headerLines) {
+            const int colon = line.indexOf(':');
+            if (colon <= 0) {
+                continue;
+            }
+            const QByteArray name = line.left(colon).trimmed().toLower();
+            const QByteArray value = line.mid(colon + 1).trimmed();
+            if (name == "content-type") {
+                partContentType = value;
+            } else if (name == "content-id") {
+                contentId = stripAngleBrackets(value);
+            } else if (name == "content-transfer-encoding") {
+                transferEncoding = value.toLower();
+            }
+        }
+
+        if (!foundRoot && (start.isEmpty() || contentId == start)) {
+            foundRoot = true;
+            *envelope = body.mid(contentStart, contentEnd - contentStart);
+            rootType = partContentType;
+        } else {
+            KDSoapAttachment attachment;
+            attachment.d = new KDSoapAttachment::Private;
+            attachment.d->contentId = QString::fromUtf8(contentId);
+            if (!partContentType.isEmpty()) {
+                attachment.d->contentType = QString::fromLatin1(partContentType);
+            }
+            if (transferEncoding == "base64") {
+                attachment.d->setData(KDSoapBinaryCodec::fromBase64(body.constData() + contentStart, contentEnd - contentStart));
+            } else {
+                // binary or 8bit: read the data where it is
+                attachment.d->storage = body;
+                attachment.d->setData(QByteArray::fromRawData(body.constData() + contentStart, contentEnd - contentStart));
+            }
+            attachments->insert(attachment.d->contentId, attachment);
+        }
+        pos = contentEnd + delimiter.size();
+    }
+    if (!foundRoot) {
+        return false;
+    }
+
+    // The type of the envelope is in start-info, or else in the type parameter of the root part
+    QByteArray type = headerParameter(contentType, "start-info");
+    if (type.isEmpty()) {
+        type = headerParameter(rootType, "type");
+    }
+    if (type.isEmpty()) {
+        type = "text/xml";
+    }
+    const QByteArray action = headerParameter(contentType, "action");
+    if (!action.isEmpty() && headerParameter(type, "action").isEmpty()) {
+        type += ";action=" + quoted(action);
+    }
+    *soapContentType = type;
+    return true;
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPMULTIPART_P_H
+#define KDSOAPMULTIPART_P_H
+
+#include "KDSoapAttachment.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+QT_BEGIN_NAMESPACE
+class QHttpMultiPart;
+QT_END_NAMESPACE
+
+/**
+ * \internal
+ * Reading and writing of MTOM/XOP messages, i.e. multipart/related MIME messages whose root part
+ * is the SOAP envelope and whose other parts are the attachments referenced by xop:Include elements.
+ *
+ * Internal class -- only exported for the server lib
+ */
+class KDSOAP_EXPORT KDSoapMultipart
+{
+public:
+    static QString xopNamespace();
+
+    /**
+     * Returns true if \p contentType is a multipart/related content type.
+     */
+    static bool isMultipartRelated(const QByteArray &contentType);
+
+    /**
+     * Returns the value of the parameter \p name in the header value \p headerValue,
+     * e.g. the boundary in "multipart/related; boundary=abc", without quotes.
+     */
+    static QByteArray headerParameter(const QByteArray &headerValue, const QByteArray &name);
+
+    static QByteArray generateBoundary();
+
+    /**
+     * Returns the Content-Type of a MTOM message, for an envelope of type \p soapContentType
+     * (e.g. "application/soap+xml;charset=utf-8;action=foo").
+     */
+    static QByteArray contentType(const QByteArray &soapContentType, const QByteArray &boundary);
+
+    /**
+     * Returns the Content-Type of the root part, for an envelope of type \p soapContentType.
+     */
+    static QByteArray rootContentType(const QByteArray &soapContentType);
+
+    /**
+     * The delimiter and headers of the root part, the headers of each attachment part (including
+     * the delimiter preceding it) and the close delimiter, for writing a message by hand.
+     */
+    static QByteArray rootPartHeader(const QByteArray &soapContentType, const QByteArray &boundary);
+    static QByteArray attachmentPartHeader(const KDSoapAttachment &attachment, const QByteArray &boundary);
+    static QByteArray closeDelimiter(const QByteArray &boundary);
+
+    /**
+     * Creates the multipart body of a request for QNetworkAccessManager::post().
+     * The request must use contentType(soapContentType, boundary) as Content-Type header.
+     */
+    static QHttpMultiPart *createHttpMultiPart(const QByteArray &envelope, const QByteArray &soapContentType, const QByteArray &boundary,
+                                               const QVector<KDSoapAttachment> &attachments);
+
+    /**
+     * Splits the MTOM message \p body of type \p contentType into the SOAP envelope and the attachments,
+     * indexed by Content-ID. \p soapContentType is set to the type of the envelope, including the action
+     * if there's one, so that it can be handled like the Content-Type of a plain SOAP message.
+     * The attachments point into \p body rather than copying it.
+     * Returns false if the message can't be parsed.
+     */
+    static bool parse(const QByteArray &contentType, const QByteArray &body, QByteArray *envelope, QByteArray *soapContentType,
+                      QHash<QString, KDSoapAttachment> *attachments);
+
+    /**
+     * Prepares the device of \p attachment for being sent: rewinds it, or reads it in memory if it is sequential.
+     * Returns the in-memory contents (if any) in \p data, and the number of bytes to send.
+     */
+    static qint64 prepareForSending(const KDSoapAttachment &attachment, QByteArray *data);
+};
+
+#endif // KDSOAPMULTIPART_P_H
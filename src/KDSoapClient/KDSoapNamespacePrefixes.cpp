@@ -34,3 +34,31 @@ void KDSoapNamespacePrefixes::writeStandardNamespaces(QXmlStreamWriter &writer,
     insert(KDSoapNamespaceManager::xmlSchema1999(), QString::fromLatin1("xsd"));
     insert(KDSoapNamespaceManager::xmlSchemaInstance1999(), QString::fromLatin1("xsi"));
 }
+
+namespace {
+struct CurrentPrefixes
+{
+    KDSoapNamespacePrefixes *prefixes;
+    const QXmlStreamWriter *writer;
+};
+}
+static thread_local CurrentPrefixes s_current = {nullptr, nullptr};
+
+KDSoapNamespacePrefixes::CurrentScope::CurrentScope(KDSoapNamespacePrefixes &prefixes, const QXmlStreamWriter &writer)
+    : m_previousPrefixes(s_current.prefixes)
+    , m_previousWriter(s_current.writer)
+{
+    s_current.prefixes = &prefixes;
+    s_current.writer = &writer;
+}
+
+KDSoapNamespacePrefixes::CurrentScope::~CurrentScope()
+{
+    s_current.prefixes = m_previousPrefixes;
+    s_current.writer = m_previousWriter;
+}
+
+KDSoapNamespacePrefixes *KDSoapNamespacePrefixes::current(const QXmlStreamWriter &writer)
+{
+    return s_current.writer == &writer ? s_current.prefixes : nullptr;
+}
@@ -11,14 +11,25 @@
 #define KDSOAPNAMESPACEPREFIXES_P_H
 
 #include <QtCore/QMap>
+#include <QtCore/QVector>
 #include <QtCore/QXmlStreamWriter>
 
 #include "KDSoapClientInterface.h"
 #include "KDSoapMessageAddressingProperties.h"
 
+class KDSoapAttachment;
+struct KDSoapStreamedAttachment;
+
 class KDSoapNamespacePrefixes : public QMap<QString /*ns*/, QString /*prefix*/>
 {
 public:
+    KDSoapNamespacePrefixes()
+        : m_xopAttachments(nullptr)
+        , m_streamedAttachments(nullptr)
+        , m_directTextOutput(false)
+    {
+    }
+
     void writeStandardNamespaces(QXmlStreamWriter &writer, KDSoap::SoapVersion version = KDSoap::SOAP1_1, bool messageAddressingEnabled = false,
                                  KDSoapMessageAddressingProperties::KDSoapAddressingNamespace messageAddressingNamespace =
                                      KDSoapMessageAddressingProperties::Addressing200508);
@@ -37,6 +48,59 @@ public:
         }
         return prefix + QLatin1Char(':') + localName;
     }
+
+    // When set, binary values are written as xop:Include references to MIME parts, and appended to this list (MTOM)
+    void setXopAttachments(QVector<KDSoapAttachment> *attachments)
+    {
+        m_xopAttachments = attachments;
+    }
+    QVector<KDSoapAttachment> *xopAttachments() const
+    {
+        return m_xopAttachments;
+    }
+
+    // When set, attachments with a random-access device are not written in the XML, only their position is recorded,
+    // for KDSoapStreamingBody to insert their base64 text while sending
+    void setStreamedAttachments(QVector<KDSoapStreamedAttachment> *attachments)
+    {
+        m_streamedAttachments = attachments;
+    }
+    QVector<KDSoapStreamedAttachment> *streamedAttachments() const
+    {
+        return m_streamedAttachments;
+    }
+
+    // When set, the device of the writer is known to take UTF-8, so numbers, booleans, dates and times
+    // are formatted straight into it rather than going through a QString
+    void setDirectTextOutput(bool direct)
+    {
+        m_directTextOutput = direct;
+    }
+    bool directTextOutput() const
+    {
+        return m_directTextOutput;
+    }
+
+    // Makes these prefixes and settings available to KDSoapValue::writeXml() and writeXmlContents() while the
+    // contents writer of a message (see KDSoapMessage::setContentsWriter) writes into writer, on this thread
+    class CurrentScope
+    {
+    public:
+        CurrentScope(KDSoapNamespacePrefixes &prefixes, const QXmlStreamWriter &writer);
+        ~CurrentScope();
+
+    private:
+        Q_DISABLE_COPY(CurrentScope)
+        KDSoapNamespacePrefixes *m_previousPrefixes;
+        const QXmlStreamWriter *m_previousWriter;
+    };
+    // The prefixes of the message this thread is writing into writer, or nullptr
+    static KDSoapNamespacePrefixes *current(const QXmlStreamWriter &writer);
+
+private:
+    QVector<KDSoapAttachment> *m_xopAttachments;
+    QVector<KDSoapStreamedAttachment> *m_streamedAttachments;
+    bool m_directTextOutput;
 };
 
 #endif // KDSOAPNAMESPACESPREFIXES_H
@@ -9,79 +9,29 @@
 ****************************************************************************/
 #include "KDSoapPendingCall.h"
 #include "KDSoapMessageReader_p.h"
+#include "KDSoapMultipart_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapPendingCall_p.h"
+#include "KDSoapTrace_p.h"
 #include <QDebug>
 #include <QNetworkReply>
 
-static void debugHelper(const QByteArray &data, const QList<QNetworkReply::RawHeaderPair> &headerList)
-{
-    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
-    const QList<QByteArray> options = doDebug.toLower().split(',');
-    const bool optEscape = options.contains("escape");
-    const bool optHttp = options.contains("http") || options.contains("https");
-    const bool optReformat = options.contains("reformat");
-    quint8 indentation = 4;
-    for (const QByteArray &opt : qAsConst(options)) {
-        if (opt.startsWith("indent=")) { // krazy:exclude=strings
-            indentation = opt.mid(7).toUShort();
-        }
-    }
-
-    QByteArray toOutput;
-    if (optHttp) {
-        for (const QNetworkReply::RawHeaderPair &header : qAsConst(headerList)) {
-            if (!header.first.isEmpty()) {
-                toOutput += header.first + ": ";
-            }
-            toOutput += header.second + "\n";
-        }
-        toOutput += "\n";
-    }
-
-    if (optReformat) {
-        QByteArray reformatted;
-        QXmlStreamReader reader(data);
-        QXmlStreamWriter writer(&reformatted);
-        writer.setAutoFormatting(true);
-        writer.setAutoFormattingIndent(indentation);
-
-        while (!reader.atEnd()) {
-            reader.readNext();
-            if (!reader.hasError() && !reader.isWhitespace()) {
-                writer.writeCurrentToken(reader);
-            }
-        }
-
-        toOutput += reader.hasError() ? data : reformatted;
-    } else {
-        toOutput += data;
-    }
-
-    if (optEscape) {
-        qDebug() << toOutput;
-    } else {
-        qDebug().noquote() << toOutput;
-    }
-}
-
 // Log the HTTP and XML of a response from the server.
-static void maybeDebugResponse(const QByteArray &data, QNetworkReply *reply)
+// (not static, because this is used in KDSoapClientInterface)
+void maybeDebugResponse(const QByteArray &data, const QList<QNetworkReply::RawHeaderPair> &headers)
 {
-    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
-    if (doDebug.trimmed().isEmpty() || doDebug == "0") {
+    if (!KDSoapTrace::isEnabled()) {
         return;
     }
 
-    debugHelper(data, reply->rawHeaderPairs());
+    kdsoapTraceMessage(data, headers);
 }
 
 // Log the HTTP and XML of a request.
 // (not static, because this is used in KDSoapClientInterface)
 void maybeDebugRequest(const QByteArray &data, const QNetworkRequest &request, QNetworkReply *reply)
 {
-    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
-    if (doDebug.trimmed().isEmpty() || doDebug == "0") {
+    if (!KDSoapTrace::isEnabled()) {
         return;
     }
 
@@ -116,7 +66,7 @@ void maybeDebugRequest(const QByteArray &data, const QNetworkRequest &request, Q
     for (const QByteArray &h : rawHeaders) {
         headerList << QNetworkReply::RawHeaderPair {h, request.rawHeader(h)};
     }
-    debugHelper(data, headerList);
+    kdsoapTraceMessage(data, headerList);
 }
 
 KDSoapPendingCall::Private::~Private()
@@ -167,6 +117,20 @@ KDSoapHeaders KDSoapPendingCall::returnHeaders() const
     return d->replyHeaders;
 }
 
+bool KDSoapPendingCall::readReturnMessage(const std::function<void(QXmlStreamReader &)> &bodyReader) const
+{
+    if (d->parsed) {
+        qWarning("KDSoap: readReturnMessage called after the reply was already parsed");
+        return false;
+    }
+    bool bodyRead = false;
+    d->parseReply([&bodyRead, &bodyReader](QXmlStreamReader &reader) {
+        bodyRead = true;
+        bodyReader(reader);
+    });
+    return bodyRead && !d->replyMessage.isFault();
+}
+
 QVariant KDSoapPendingCall::returnValue() const
 {
     d->parseReply();
@@ -176,7 +140,7 @@ QVariant KDSoapPendingCall::returnValue() const
     return QVariant();
 }
 
-void KDSoapPendingCall::Private::parseReply()
+void KDSoapPendingCall::Private::parseReply(const std::function<void(QXmlStreamReader &)> &bodyReader)
 {
     if (parsed) {
         return;
@@ -190,12 +154,9 @@ void KDSoapPendingCall::Private::parseReply()
 
     // Don't try to read from an aborted (closed) reply
     const QByteArray data = reply->isOpen() ? reply->readAll() : QByteArray();
-    maybeDebugResponse(data, reply);
+    maybeDebugResponse(data, reply->rawHeaderPairs());
 
-    if (!data.isEmpty()) {
-        KDSoapMessageReader reader;
-        reader.xmlToMessage(data, &replyMessage, nullptr, &replyHeaders, this->soapVersion);
-    }
+    parseReplyData(data, reply->rawHeader("Content-Type"), soapVersion, &replyMessage, &replyHeaders, bodyReader);
 
     if (reply->error()) {
         if (!replyMessage.isFault()) {
@@ -209,3 +170,28 @@ void KDSoapPendingCall::Private::parseReply()
         }
     }
 }
+
+void KDSoapPendingCall::Private::parseReplyData(const QByteArray &data, const QByteArray &contentType, KDSoap::SoapVersion soapVersion,
+                                                KDSoapMessage *replyMessage, KDSoapHeaders *replyHeaders,
+                                                const std::function<void(QXmlStreamReader &)> &bodyReader)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+    KDSoapMessageReader reader;
+    if (KDSoapMultipart::isMultipartRelated(contentType)) {
+        // MTOM: the envelope is the root part, the attachments keep pointing into data
+        QByteArray envelope;
+        QByteArray soapContentType;
+        QHash<QString, KDSoapAttachment> attachments;
+        if (KDSoapMultipart::parse(contentType, data, &envelope, &soapContentType, &attachments)) {
+            reader.setXopAttachments(attachments);
+            reader.xmlToMessage(envelope, replyMessage, nullptr, replyHeaders, soapVersion, bodyReader);
+        } else {
+            replyMessage->createFaultMessage(QString::number(QNetworkReply::ProtocolFailure), QLatin1String("Invalid multipart/related response"),
+                                             soapVersion);
+        }
+    } else {
+        reader.xmlToMessage(data, replyMessage, nullptr, replyHeaders, soapVersion, bodyReader);
+    }
+}
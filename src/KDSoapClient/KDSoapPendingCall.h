@@ -12,9 +12,13 @@
 
 #include "KDSoapMessage.h"
 #include <QtCore/QExplicitlySharedDataPointer>
+
+#include <functional>
+
 QT_BEGIN_NAMESPACE
 class QNetworkReply;
 class QBuffer;
+class QXmlStreamReader;
 QT_END_NAMESPACE
 class KDSoapPendingCallWatcher;
 
@@ -79,6 +83,26 @@ public:
      */
     KDSoapHeaders returnHeaders() const;
 
+    /**
+     * Reads the response sent by the server directly from its XML, instead of
+     * building a KDSoapMessage for it.
+     *
+     * \p bodyReader is called with the reader positioned on the start element of the response
+     * (the first child of the SOAP body), and must read up to the matching end element.
+     * It isn't called if the server sent a fault or if a network error happened; in that case
+     * this method returns \c false and returnMessage() returns the fault.
+     * It isn't called either for a MTOM response with attachments: this method then returns \c false
+     * and returnMessage() returns the response, parsed as usual.
+     * \p bodyReader might be called more than once, if the XML had to be cleaned up from invalid characters.
+     *
+     * The response can only be parsed once: after calling this method, returnMessage()
+     * only returns an empty message (or the fault), while returnHeaders() works as usual.
+     *
+     * This is used by the code generated by kdwsdl2cpp with the -xml-stream-deserializers option.
+     * \since 2.2
+     */
+    bool readReturnMessage(const std::function<void(QXmlStreamReader &)> &bodyReader) const;
+
     /**
      * Returns \c true if the pending call has finished processing and the reply has been received.
      *
@@ -21,6 +21,7 @@
 class KDSoapValue;
 
 void maybeDebugRequest(const QByteArray &data, const QNetworkRequest &request, QNetworkReply *reply);
+void maybeDebugResponse(const QByteArray &data, const QList<QNetworkReply::RawHeaderPair> &headers);
 
 class KDSoapPendingCall::Private : public QSharedData
 {
@@ -34,8 +35,12 @@ public:
     }
     ~Private();
 
-    void parseReply();
+    void parseReply(const std::function<void(QXmlStreamReader &)> &bodyReader = std::function<void(QXmlStreamReader &)>());
     KDSoapValue parseReplyElement(QXmlStreamReader &reader);
+    // Parses the body of a response, of type contentType; also used for the responses of KDSoapHttpTransport
+    static void parseReplyData(const QByteArray &data, const QByteArray &contentType, KDSoap::SoapVersion soapVersion, KDSoapMessage *replyMessage,
+                               KDSoapHeaders *replyHeaders,
+                               const std::function<void(QXmlStreamReader &)> &bodyReader = std::function<void(QXmlStreamReader &)>());
 
     // Can be deleted under us if the KDSoapClientInterface (and its QNetworkAccessManager)
     // are deleted before the KDSoapPendingCall.
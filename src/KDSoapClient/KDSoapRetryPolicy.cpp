@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapRetryPolicy.h"
+
+class KDSoapRetryPolicyData : public QSharedData
+{
+public:
+    int m_maxRetries = 0;
+    int m_initialBackoff = 50;
+    int m_maxBackoff = 2000;
+    int m_hedgeDelay = -1;
+    double m_hedgePercentile = 95;
+};
+
+KDSoapRetryPolicy::KDSoapRetryPolicy()
+    : d(new KDSoapRetryPolicyData)
+{
+}
+
+KDSoapRetryPolicy::KDSoapRetryPolicy(const KDSoapRetryPolicy &other)
+    : d(other.d)
+{
+}
+
+KDSoapRetryPolicy &KDSoapRetryPolicy::operator=(const KDSoapRetryPolicy &other)
+{
+    d = other.d;
+    return *this;
+}
+
+KDSoapRetryPolicy::~KDSoapRetryPolicy()
+{
+}
+
+KDSoapRetryPolicy KDSoapRetryPolicy::idempotentPolicy()
+{
+    KDSoapRetryPolicy policy;
+    policy.setMaxRetries(2);
+    policy.setHedgeDelay(500);
+    return policy;
+}
+
+bool KDSoapRetryPolicy::isNull() const
+{
+    return d->m_maxRetries <= 0 && d->m_hedgeDelay < 0;
+}
+
+int KDSoapRetryPolicy::maxRetries() const
+{
+    return d->m_maxRetries;
+}
+
+void KDSoapRetryPolicy::setMaxRetries(int retries)
+{
+    d->m_maxRetries = retries;
+}
+
+int KDSoapRetryPolicy::initialBackoff() const
+{
+    return d->m_initialBackoff;
+}
+
+void KDSoapRetryPolicy::setInitialBackoff(int msecs)
+{
+    d->m_initialBackoff = msecs;
+}
+
+int KDSoapRetryPolicy::maxBackoff() const
+{
+    return d->m_maxBackoff;
+}
+
+void KDSoapRetryPolicy::setMaxBackoff(int msecs)
+{
+    d->m_maxBackoff = msecs;
+}
+
+int KDSoapRetryPolicy::hedgeDelay() const
+{
+    return d->m_hedgeDelay;
+}
+
+void KDSoapRetryPolicy::setHedgeDelay(int msecs)
+{
+    d->m_hedgeDelay = msecs;
+}
+
+double KDSoapRetryPolicy::hedgePercentile() const
+{
+    return d->m_hedgePercentile;
+}
+
+void KDSoapRetryPolicy::setHedgePercentile(double percentile)
+{
+    d->m_hedgePercentile = percentile;
+}
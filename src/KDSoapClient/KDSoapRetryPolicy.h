@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPRETRYPOLICY_H
+#define KDSOAPRETRYPOLICY_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QSharedDataPointer>
+
+class KDSoapRetryPolicyData;
+
+/**
+ * KDSoapRetryPolicy describes how the calls to an operation are retried and hedged,
+ * see KDSoapClientInterface::setRetryPolicy().
+ *
+ * This must only be used for idempotent operations, since the server may receive the same request
+ * more than once: a request which failed at the transport level may have been processed anyway,
+ * and a hedged request is sent while the first one is still in progress.
+ *
+ * \li Retries: when a request fails with a transport error (e.g. connection refused or closed,
+ *     host not found, or 503 Service Unavailable), it is sent again, up to maxRetries() times,
+ *     after an exponential backoff with full jitter: a random delay between 0 and
+ *     initialBackoff() * 2^n milliseconds for the n-th retry, capped to maxBackoff().
+ *     SOAP faults and other HTTP errors are never retried.
+ * \li Hedging: when the response takes longer than the hedgePercentile() percentile of the recent latencies
+ *     of the operation (or hedgeDelay() while there are too few of them), a second request is sent.
+ *     The first good response wins, and the other request is aborted.
+ *
+ * Retries and hedges are limited by the retry budget of the client interface, see KDSoapClientInterface::setRetryBudget().
+ *
+ * \since 2.2
+ */
+class KDSOAP_EXPORT KDSoapRetryPolicy
+{
+public:
+    /**
+     * Constructs a null policy: no retries and no hedging.
+     */
+    KDSoapRetryPolicy();
+    KDSoapRetryPolicy(const KDSoapRetryPolicy &other);
+    KDSoapRetryPolicy &operator=(const KDSoapRetryPolicy &other);
+    ~KDSoapRetryPolicy();
+
+    /**
+     * Returns the policy used by the code generated by kdwsdl2cpp for the operations given with -idempotent:
+     * up to 2 retries with a backoff from 50ms to 2s, and hedging at the 95th percentile of the latencies,
+     * or after 500ms while they aren't known yet.
+     */
+    static KDSoapRetryPolicy idempotentPolicy();
+
+    /**
+     * Returns true if this policy neither retries nor hedges requests.
+     */
+    bool isNull() const;
+
+    /**
+     * Returns the maximum number of times a request is sent again after a transport error. The default is 0.
+     */
+    int maxRetries() const;
+    /**
+     * Sets the maximum number of times a request is sent again after a transport error.
+     */
+    void setMaxRetries(int retries);
+
+    /**
+     * Returns the upper bound of the delay before the first retry, in milliseconds. The default is 50.
+     */
+    int initialBackoff() const;
+    /**
+     * Sets the upper bound of the delay before the first retry, in milliseconds. It doubles with each retry.
+     */
+    void setInitialBackoff(int msecs);
+
+    /**
+     * Returns the maximum delay before a retry, in milliseconds. The default is 2000.
+     */
+    int maxBackoff() const;
+    /**
+     * Sets the maximum delay before a retry, in milliseconds.
+     */
+    void setMaxBackoff(int msecs);
+
+    /**
+     * Returns the delay after which a second request is sent when there isn't enough latency data,
+     * in milliseconds, or -1 if requests aren't hedged (the default).
+     */
+    int hedgeDelay() const;
+    /**
+     * Enables hedging: a second request is sent when there isn't any response after \p msecs milliseconds,
+     * until enough latencies were measured for hedgePercentile() to be used. -1 disables hedging.
+     */
+    void setHedgeDelay(int msecs);
+
+    /**
+     * Returns the percentile of the latencies of the operation after which a second request is sent.
+     * The default is 95. 0 means that hedgeDelay() is always used.
+     */
+    double hedgePercentile() const;
+    /**
+     * Sets the percentile (between 0 and 100) of the latencies of the operation after which a second request is sent.
+     * The latencies of the last 100 successful requests of the operation are taken into account.
+     */
+    void setHedgePercentile(double percentile);
+
+private:
+    QSharedDataPointer<KDSoapRetryPolicyData> d;
+};
+
+#endif // KDSOAPRETRYPOLICY_H
@@ -0,0 +1,323 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapRetryingReply_p.h"
+#include "KDSoapClientInterface_p.h"
+#include <QBuffer>
+#include <QNetworkAccessManager>
+#include <QTimerEvent>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+// The number of latencies kept for each operation, and the number needed before using the percentile
+static const int s_maxLatencies = 100;
+static const int s_minLatencies = 20;
+
+KDSoapRetryPolicy KDSoapRetryState::policy(const QString &method) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_policies.value(method);
+}
+
+void KDSoapRetryState::setPolicy(const QString &method, const KDSoapRetryPolicy &policy)
+{
+    QMutexLocker locker(&m_mutex);
+    if (policy.isNull()) {
+        m_policies.remove(method);
+    } else {
+        m_policies.insert(method, policy);
+    }
+}
+
+void KDSoapRetryState::setBudget(int maxTokens, double tokenRatio)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxTokens = maxTokens;
+    m_tokenRatio = tokenRatio;
+    m_tokens = maxTokens;
+}
+
+int KDSoapRetryState::budgetMaxTokens() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxTokens;
+}
+
+double KDSoapRetryState::budgetTokenRatio() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_tokenRatio;
+}
+
+void KDSoapRetryState::addFailure()
+{
+    QMutexLocker locker(&m_mutex);
+    m_tokens = qMax(0.0, m_tokens - 1);
+}
+
+void KDSoapRetryState::addSuccess(const QString &method, qint64 latency)
+{
+    QMutexLocker locker(&m_mutex);
+    m_tokens = qMin(double(m_maxTokens), m_tokens + m_tokenRatio);
+
+    Latencies &latencies = m_latencies[method];
+    if (latencies.samples.size() < s_maxLatencies) {
+        latencies.samples.append(latency);
+    } else {
+        latencies.samples[latencies.next] = latency;
+        latencies.next = (latencies.next + 1) % s_maxLatencies;
+    }
+}
+
+bool KDSoapRetryState::canRetry() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_tokens > m_maxTokens / 2.0;
+}
+
+qint64 KDSoapRetryState::hedgeDelay(const QString &method, const KDSoapRetryPolicy &policy) const
+{
+    if (policy.hedgeDelay() < 0) {
+        return -1;
+    }
+    if (policy.hedgePercentile() > 0) {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_latencies.constFind(method);
+        if (it != m_latencies.constEnd() && it->samples.size() >= s_minLatencies) {
+            QVector<qint64> samples = it->samples;
+            const int rank = qBound(0, int(std::ceil(qMin(policy.hedgePercentile(), 100.0) / 100 * samples.size())) - 1, samples.size() - 1);
+            std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+            return samples.at(rank);
+        }
+    }
+    return policy.hedgeDelay();
+}
+
+KDSoapRetryingReply::KDSoapRetryingReply(KDSoapClientInterfacePrivate *iface, QNetworkAccessManager *accessManager, const QNetworkRequest &request,
+                                         const QByteArray &body, const QString &method, const KDSoapRetryPolicy &policy)
+    : QNetworkReply(accessManager)
+    , m_iface(iface)
+    , m_state(&iface->m_retryState)
+    , m_accessManager(accessManager)
+    , m_body(body)
+    , m_method(method)
+    , m_policy(policy)
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(QNetworkAccessManager::PostOperation);
+    open(QIODevice::ReadOnly);
+    m_clock.start();
+    sendRequest();
+}
+
+KDSoapRetryingReply::~KDSoapRetryingReply()
+{
+    abortRequests(nullptr);
+}
+
+void KDSoapRetryingReply::sendRequest()
+{
+    QBuffer *buffer = new QBuffer;
+    buffer->setData(m_body);
+    buffer->open(QIODevice::ReadOnly);
+    QNetworkReply *reply = m_iface->post(m_accessManager, request(), buffer, KDSoapRequestAttachments());
+    buffer->setParent(reply); // deleted along with the reply
+    // The deadline of the call is watched on this reply, rather than on each request
+    m_iface->setupReply(reply, QDeadlineTimer(QDeadlineTimer::Forever));
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        requestFinished(reply);
+    });
+    m_requests.append({reply, m_clock.elapsed()});
+
+    if (!m_hedged) {
+        const qint64 delay = m_state->hedgeDelay(m_method, m_policy);
+        if (delay >= 0) {
+            m_hedgeTimer.start(int(qMin(delay, qint64(INT_MAX))), this);
+        }
+    }
+}
+
+bool KDSoapRetryingReply::isTransportError(QNetworkReply::NetworkError error)
+{
+    switch (error) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::HostNotFoundError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyConnectionRefusedError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyNotFoundError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+    case QNetworkReply::ServiceUnavailableError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void KDSoapRetryingReply::requestFinished(QNetworkReply *reply)
+{
+    qint64 startTime = 0;
+    for (int i = 0; i < m_requests.size(); ++i) {
+        if (m_requests.at(i).reply == reply) {
+            startTime = m_requests.at(i).startTime;
+            m_requests.remove(i);
+            break;
+        }
+    }
+
+    if (!isTransportError(reply->error())) {
+        // A response, even a fault
+        if (reply->error() == QNetworkReply::NoError) {
+            m_state->addSuccess(m_method, m_clock.elapsed() - startTime);
+        }
+        finish(reply);
+        return;
+    }
+
+    m_state->addFailure();
+    if (!m_requests.isEmpty()) {
+        // The other request may still succeed
+        reply->deleteLater();
+        return;
+    }
+    if (m_retries < m_policy.maxRetries() && m_state->canRetry()) {
+        ++m_retries;
+        reply->deleteLater();
+        m_hedgeTimer.stop();
+        m_retryTimer.start(backoff(), this);
+        return;
+    }
+    finish(reply);
+}
+
+int KDSoapRetryingReply::backoff() const
+{
+    // Full jitter: uniformly distributed up to the exponential backoff
+    const int maxDelay = int(qMin(qint64(m_policy.maxBackoff()), qint64(m_policy.initialBackoff()) << qMin(m_retries - 1, 30)));
+    if (maxDelay <= 0) {
+        return 0;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return QRandomGenerator::global()->bounded(maxDelay + 1);
+#else
+    return qrand() % (maxDelay + 1);
+#endif
+}
+
+void KDSoapRetryingReply::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_retryTimer.timerId()) {
+        m_retryTimer.stop();
+        sendRequest();
+    } else if (event->timerId() == m_hedgeTimer.timerId()) {
+        m_hedgeTimer.stop();
+        if (m_requests.size() == 1 && m_state->canRetry()) {
+            m_hedged = true;
+            sendRequest();
+        }
+    } else {
+        QNetworkReply::timerEvent(event);
+    }
+}
+
+void KDSoapRetryingReply::abortRequests(QNetworkReply *except, bool timedOut)
+{
+    for (const Request &request : qAsConst(m_requests)) {
+        QNetworkReply *reply = request.reply.data();
+        if (reply && reply != except) {
+            disconnect(reply, nullptr, this, nullptr);
+            if (timedOut) {
+                // So that the load balancer counts it as a failure of its end point, see KDSoapLoadBalancer::outcome()
+                reply->setProperty("kdsoap_reply_timed_out", true);
+            }
+            reply->abort();
+            reply->deleteLater();
+        }
+    }
+    m_requests.clear();
+}
+
+void KDSoapRetryingReply::finish(QNetworkReply *reply)
+{
+    m_retryTimer.stop();
+    m_hedgeTimer.stop();
+    abortRequests(reply);
+
+    if (reply) {
+        const QList<RawHeaderPair> headers = reply->rawHeaderPairs();
+        for (const RawHeaderPair &header : headers) {
+            setRawHeader(header.first, header.second);
+        }
+        for (QNetworkRequest::Attribute attribute :
+             {QNetworkRequest::HttpStatusCodeAttribute, QNetworkRequest::HttpReasonPhraseAttribute, QNetworkRequest::ConnectionEncryptedAttribute}) {
+            setAttribute(attribute, reply->attribute(attribute));
+        }
+        if (reply->isOpen()) {
+            m_data = reply->readAll();
+        }
+        if (reply->error() != QNetworkReply::NoError) {
+            setError(reply->error(), reply->errorString());
+        }
+        reply->deleteLater();
+    }
+
+    setFinished(true);
+    emit metaDataChanged();
+    if (!m_data.isEmpty()) {
+        emit readyRead();
+    }
+    if (error() != QNetworkReply::NoError) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        emit errorOccurred(error());
+#else
+        emit QNetworkReply::error(error());
+#endif
+    }
+    emit finished();
+}
+
+void KDSoapRetryingReply::abort()
+{
+    if (isFinished()) {
+        return;
+    }
+    abortRequests(nullptr, property("kdsoap_reply_timed_out").toBool());
+    close();
+    setError(QNetworkReply::OperationCanceledError, tr("Operation canceled"));
+    finish(nullptr);
+}
+
+qint64 KDSoapRetryingReply::bytesAvailable() const
+{
+    return m_data.size() - m_readPos + QNetworkReply::bytesAvailable();
+}
+
+qint64 KDSoapRetryingReply::readData(char *data, qint64 maxSize)
+{
+    if (m_readPos >= m_data.size()) {
+        return isFinished() ? -1 : 0;
+    }
+    const qint64 size = qMin(maxSize, m_data.size() - m_readPos);
+    memcpy(data, m_data.constData() + m_readPos, size_t(size));
+    m_readPos += size;
+    return size;
+}
+
+#include "moc_KDSoapRetryingReply_p.cpp"
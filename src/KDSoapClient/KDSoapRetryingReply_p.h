@@ -0,0 +1,127 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPRETRYINGREPLY_P_H
+#define KDSOAPRETRYINGREPLY_P_H
+
+#include "KDSoapRetryPolicy.h"
+#include <QtCore/QBasicTimer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QPointer>
+#include <QtCore/QVector>
+#include <QtNetwork/QNetworkReply>
+
+class KDSoapClientInterfacePrivate;
+QT_BEGIN_NAMESPACE
+class QNetworkAccessManager;
+QT_END_NAMESPACE
+
+/**
+ * \internal
+ * The retry policies of a client interface, the latencies of its operations and its retry budget.
+ * Shared by the calls made from the main thread and from the threads of blocking calls.
+ *
+ * The budget works like gRPC's retry throttling: it starts with maxTokens tokens, each failed request
+ * takes one, and each successful one gives back tokenRatio. Requests are only retried (or hedged)
+ * while more than half of the tokens are left, so that retries stop adding load to a failing server.
+ */
+class KDSoapRetryState
+{
+public:
+    KDSoapRetryPolicy policy(const QString &method) const;
+    void setPolicy(const QString &method, const KDSoapRetryPolicy &policy);
+
+    void setBudget(int maxTokens, double tokenRatio);
+    int budgetMaxTokens() const;
+    double budgetTokenRatio() const;
+
+    // Records the outcome of a request, for the budget (and its latency, if it succeeded)
+    void addFailure();
+    void addSuccess(const QString &method, qint64 latency);
+    // Returns true if the budget allows one more request
+    bool canRetry() const;
+
+    // The time after which a request for method is hedged, or -1
+    qint64 hedgeDelay(const QString &method, const KDSoapRetryPolicy &policy) const;
+
+private:
+    struct Latencies
+    {
+        QVector<qint64> samples; // the last ones, circular
+        int next = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, KDSoapRetryPolicy> m_policies;
+    QHash<QString, Latencies> m_latencies;
+    int m_maxTokens = 10;
+    double m_tokenRatio = 0.1;
+    double m_tokens = 10;
+};
+
+/**
+ * \internal
+ * A reply standing for the requests of a call with a KDSoapRetryPolicy: it sends the request (with the
+ * QNetworkAccessManager and the settings of the client interface), sends it again after a transport error
+ * or when hedging, and finishes with the first response which isn't a transport error, aborting the other request.
+ * Its headers, attributes, error and data are then the ones of that response.
+ *
+ * The body is only kept as a QByteArray, so this isn't used for requests with streamed attachments or MTOM.
+ */
+class KDSoapRetryingReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    // The reply is a child of accessManager, like the replies of the requests
+    KDSoapRetryingReply(KDSoapClientInterfacePrivate *iface, QNetworkAccessManager *accessManager, const QNetworkRequest &request,
+                        const QByteArray &body, const QString &method, const KDSoapRetryPolicy &policy);
+    ~KDSoapRetryingReply() override;
+
+    void abort() override;
+    qint64 bytesAvailable() const override;
+
+    // Returns true if the error of a request is worth sending it again
+    static bool isTransportError(QNetworkReply::NetworkError error);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void sendRequest();
+    void requestFinished(QNetworkReply *reply);
+    void finish(QNetworkReply *reply);
+    void abortRequests(QNetworkReply *except, bool timedOut = false);
+    int backoff() const;
+
+    struct Request
+    {
+        QPointer<QNetworkReply> reply;
+        qint64 startTime;
+    };
+
+    KDSoapClientInterfacePrivate *m_iface;
+    KDSoapRetryState *m_state;
+    QNetworkAccessManager *m_accessManager;
+    QByteArray m_body;
+    QString m_method;
+    KDSoapRetryPolicy m_policy;
+    QElapsedTimer m_clock;
+    QVector<Request> m_requests; // in progress
+    int m_retries = 0;
+    bool m_hedged = false;
+    QBasicTimer m_retryTimer;
+    QBasicTimer m_hedgeTimer;
+    QByteArray m_data;
+    qint64 m_readPos = 0;
+};
+
+#endif // KDSOAPRETRYINGREPLY_P_H
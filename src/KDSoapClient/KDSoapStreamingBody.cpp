@@ -0,0 +1,125 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapStreamingBody_p.h"
+#include <cstring>
+
+// Number of base64 groups (3 bytes, 4 characters) encoded at once
+static const qint64 s_groupsPerChunk = 16384;
+
+static qint64 base64Length(qint64 size)
+{
+    return ((size + 2) / 3) * 4;
+}
+
+KDSoapStreamingBody::KDSoapStreamingBody(const QByteArray &xml, const QVector<KDSoapStreamedAttachment> &attachments, QObject *parent)
+    : QIODevice(parent)
+    , m_xml(xml)
+    , m_attachments(attachments)
+    , m_size(0)
+{
+    qint64 xmlPos = 0;
+    for (int i = 0; i < m_attachments.size(); ++i) {
+        const qint64 position = m_attachments.at(i).position;
+        Q_ASSERT(position >= xmlPos && position <= m_xml.size());
+        const Segment xmlSegment = {m_size, position - xmlPos, xmlPos, -1};
+        m_segments.append(xmlSegment);
+        m_size += xmlSegment.length;
+        xmlPos = position;
+
+        const Segment base64Segment = {m_size, base64Length(m_attachments.at(i).attachment.size()), 0, i};
+        m_segments.append(base64Segment);
+        m_size += base64Segment.length;
+    }
+    const Segment lastSegment = {m_size, m_xml.size() - xmlPos, xmlPos, -1};
+    m_segments.append(lastSegment);
+    m_size += lastSegment.length;
+}
+
+bool KDSoapStreamingBody::canStream(const KDSoapAttachment &attachment)
+{
+    return attachment.size() > 0;
+}
+
+bool KDSoapStreamingBody::open(OpenMode mode)
+{
+    if (mode & WriteOnly) {
+        return false;
+    }
+    // Reads go straight to the segments, like QBuffer
+    return QIODevice::open(mode | Unbuffered);
+}
+
+bool KDSoapStreamingBody::isSequential() const
+{
+    return false;
+}
+
+qint64 KDSoapStreamingBody::size() const
+{
+    return m_size;
+}
+
+qint64 KDSoapStreamingBody::readData(char *data, qint64 maxSize)
+{
+    qint64 pos = this->pos();
+    qint64 total = 0;
+    for (const Segment &segment : qAsConst(m_segments)) {
+        if (total == maxSize) {
+            break;
+        }
+        const qint64 offset = pos - segment.start;
+        if (offset < 0 || offset >= segment.length) {
+            continue;
+        }
+        const qint64 wanted = qMin(segment.length - offset, maxSize - total);
+        qint64 read;
+        if (segment.attachment < 0) {
+            memcpy(data + total, m_xml.constData() + segment.xmlPos + offset, size_t(wanted));
+            read = wanted;
+        } else {
+            read = readBase64(segment, offset, data + total, wanted);
+            if (read < 0) {
+                return total > 0 ? total : -1;
+            }
+        }
+        total += read;
+        pos += read;
+        if (read < wanted) {
+            break;
+        }
+    }
+    return total;
+}
+
+qint64 KDSoapStreamingBody::readBase64(const Segment &segment, qint64 offset, char *data, qint64 maxSize)
+{
+    QIODevice *device = m_attachments.at(segment.attachment).attachment.device();
+    // Encode whole groups, starting with the one containing offset
+    const qint64 firstGroup = offset / 4;
+    const qint64 skip = offset % 4;
+    const qint64 groups = qMin((skip + maxSize + 3) / 4, s_groupsPerChunk);
+    if (!device->seek(firstGroup * 3)) {
+        return -1;
+    }
+    const QByteArray encoded = device->read(groups * 3).toBase64();
+    if (encoded.size() <= skip) {
+        return -1; // the device got shorter
+    }
+    const qint64 count = qMin(maxSize, qint64(encoded.size()) - skip);
+    memcpy(data, encoded.constData() + skip, size_t(count));
+    return count;
+}
+
+qint64 KDSoapStreamingBody::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPSTREAMINGBODY_P_H
+#define KDSOAPSTREAMINGBODY_P_H
+
+#include "KDSoapAttachment.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QIODevice>
+#include <QtCore/QVector>
+
+/**
+ * \internal
+ * An attachment written as base64 text at \p position in the XML of a message
+ * (the position where the text of its element starts).
+ */
+struct KDSoapStreamedAttachment
+{
+    qint64 position;
+    KDSoapAttachment attachment;
+};
+
+/**
+ * \internal
+ * The body of a message whose attachments are sent inline, as base64 text, without MTOM.
+ * The XML written by KDSoapMessageWriter only records where the text of each attachment goes;
+ * this device returns that XML with the base64 encoding of the attachments inserted,
+ * encoding them chunk by chunk while the body is read, so that large devices are never
+ * held in memory, neither as binary data nor as text.
+ *
+ * Only attachments with a random-access device can be streamed, since the size of the
+ * body has to be known up front and the body may have to be sent again (e.g. after a redirect).
+ *
+ * Internal class -- only exported for the server lib
+ */
+class KDSOAP_EXPORT KDSoapStreamingBody : public QIODevice
+{
+public:
+    KDSoapStreamingBody(const QByteArray &xml, const QVector<KDSoapStreamedAttachment> &attachments, QObject *parent = nullptr);
+
+    /**
+     * Returns true if the value of \p attachment can be written by this class.
+     */
+    static bool canStream(const KDSoapAttachment &attachment);
+
+    bool open(OpenMode mode) override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    struct Segment
+    {
+        qint64 start; // in the body
+        qint64 length;
+        qint64 xmlPos; // for XML segments
+        int attachment; // -1 for XML segments
+    };
+    qint64 readBase64(const Segment &segment, qint64 offset, char *data, qint64 maxSize);
+
+    QByteArray m_xml;
+    QVector<KDSoapStreamedAttachment> m_attachments;
+    QVector<Segment> m_segments;
+    qint64 m_size;
+};
+
+#endif // KDSOAPSTREAMINGBODY_P_H
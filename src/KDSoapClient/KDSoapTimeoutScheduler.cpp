@@ -0,0 +1,170 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapTimeoutScheduler_p.h"
+#include <QNetworkReply>
+#include <QPointer>
+#include <QThreadStorage>
+#include <QTimerEvent>
+
+#include <climits>
+
+// A revolution of the wheel lasts about ten seconds; longer timeouts stay in their slot for several revolutions
+static const qint64 s_tickMsecs = 10;
+static const int s_slotCount = 1024;
+
+typedef QThreadStorage<KDSoapTimeoutScheduler *> KDSoapTimeoutSchedulers;
+Q_GLOBAL_STATIC(KDSoapTimeoutSchedulers, s_schedulers)
+
+KDSoapTimeoutScheduler *KDSoapTimeoutScheduler::instance()
+{
+    KDSoapTimeoutSchedulers *schedulers = s_schedulers();
+    if (!schedulers->hasLocalData()) {
+        schedulers->setLocalData(new KDSoapTimeoutScheduler); // deleted when the thread finishes
+    }
+    return schedulers->localData();
+}
+
+KDSoapTimeoutScheduler::KDSoapTimeoutScheduler()
+    : m_slots(s_slotCount, nullptr)
+{
+    m_clock.start();
+}
+
+KDSoapTimeoutScheduler::~KDSoapTimeoutScheduler()
+{
+    // The connections go away with this object
+    qDeleteAll(m_entries);
+}
+
+void KDSoapTimeoutScheduler::add(QNetworkReply *reply, const QDeadlineTimer &deadline)
+{
+    remove(reply);
+    if (deadline.isForever()) {
+        return;
+    }
+    const qint64 now = m_clock.elapsed();
+    if (m_entries.isEmpty()) {
+        m_currentTick = now / s_tickMsecs; // nothing to catch up with
+    }
+    // Rounded up, so that a reply is never aborted early
+    const qint64 expiry = now + qMax(qint64(0), deadline.remainingTime());
+    const qint64 expiryTick = qMax(m_currentTick + 1, (expiry + s_tickMsecs - 1) / s_tickMsecs);
+
+    Entry *entry = new Entry;
+    entry->reply = reply;
+    entry->expiryTick = expiryTick;
+    entry->previous = nullptr;
+    Entry *&head = m_slots[int(expiryTick % s_slotCount)];
+    entry->next = head;
+    if (head) {
+        head->previous = entry;
+    }
+    head = entry;
+    entry->finishedConnection = connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        remove(reply);
+    });
+    entry->destroyedConnection = connect(reply, &QObject::destroyed, this, [this, reply]() {
+        remove(reply);
+    });
+    m_entries.insert(reply, entry);
+
+    scheduleWakeUp(expiryTick);
+}
+
+void KDSoapTimeoutScheduler::remove(QNetworkReply *reply)
+{
+    Entry *entry = m_entries.take(reply);
+    if (!entry) {
+        return;
+    }
+    unlink(entry);
+    delete entry;
+    if (m_entries.isEmpty()) {
+        m_timer.stop();
+    }
+}
+
+void KDSoapTimeoutScheduler::unlink(Entry *entry)
+{
+    disconnect(entry->finishedConnection);
+    disconnect(entry->destroyedConnection);
+    if (entry->previous) {
+        entry->previous->next = entry->next;
+    } else {
+        m_slots[int(entry->expiryTick % s_slotCount)] = entry->next;
+    }
+    if (entry->next) {
+        entry->next->previous = entry->previous;
+    }
+}
+
+void KDSoapTimeoutScheduler::scheduleWakeUp(qint64 tick)
+{
+    if (m_timer.isActive() && m_wakeUpTick <= tick) {
+        return;
+    }
+    m_wakeUpTick = tick;
+    const qint64 interval = qMax(qint64(0), tick * s_tickMsecs - m_clock.elapsed());
+    m_timer.start(int(qMin(interval, qint64(INT_MAX))), Qt::PreciseTimer, this);
+}
+
+void KDSoapTimeoutScheduler::scheduleNextWakeUp()
+{
+    if (m_entries.isEmpty()) {
+        return;
+    }
+    for (int i = 1; i <= s_slotCount; ++i) {
+        const qint64 tick = m_currentTick + i;
+        if (m_slots.at(int(tick % s_slotCount))) {
+            // The entries of this slot may belong to a later revolution: they're checked again then
+            scheduleWakeUp(tick);
+            return;
+        }
+    }
+}
+
+void KDSoapTimeoutScheduler::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_timer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+    m_timer.stop();
+
+    // Visit the slots of the ticks elapsed since the last time, at most once each
+    const qint64 nowTick = m_clock.elapsed() / s_tickMsecs;
+    const qint64 lastTick = qMin(nowTick, m_currentTick + s_slotCount);
+    QVector<QPointer<QNetworkReply>> expired;
+    for (qint64 tick = m_currentTick + 1; tick <= lastTick; ++tick) {
+        Entry *entry = m_slots.at(int(tick % s_slotCount));
+        while (entry) {
+            Entry *next = entry->next;
+            if (entry->expiryTick <= nowTick) {
+                expired.append(entry->reply);
+                m_entries.remove(entry->reply);
+                unlink(entry);
+                delete entry;
+            }
+            entry = next;
+        }
+    }
+    m_currentTick = nowTick;
+
+    // Aborting a reply runs the slots connected to it, which can make new calls
+    for (const QPointer<QNetworkReply> &reply : qAsConst(expired)) {
+        if (reply) {
+            reply->setProperty("kdsoap_reply_timed_out", true); // see KDSoapPendingCall.cpp
+            reply->abort();
+        }
+    }
+    scheduleNextWakeUp();
+}
+
+#include "moc_KDSoapTimeoutScheduler_p.cpp"
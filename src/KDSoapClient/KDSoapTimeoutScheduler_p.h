@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPTIMEOUTSCHEDULER_P_H
+#define KDSOAPTIMEOUTSCHEDULER_P_H
+
+#include <QtCore/QBasicTimer>
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMetaObject>
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+
+QT_BEGIN_NAMESPACE
+class QNetworkReply;
+QT_END_NAMESPACE
+
+/**
+ * \internal
+ * Aborts the replies which didn't finish before their deadline, for all the calls made from one thread.
+ *
+ * The deadlines are kept in a hashed timing wheel: a ring of slots, each one holding the replies whose deadline
+ * falls on that tick (modulo the size of the ring). A single timer wakes the scheduler up at the next non-empty
+ * slot, so that adding and removing a reply is O(1) and doesn't register a timer, whatever the number of calls in flight.
+ * Deadlines are rounded up to the next tick.
+ */
+class KDSoapTimeoutScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * Returns the scheduler of the current thread, created on first use.
+     */
+    static KDSoapTimeoutScheduler *instance();
+
+    ~KDSoapTimeoutScheduler() override;
+
+    /**
+     * Aborts \p reply when \p deadline expires, unless it finished (or was deleted) before.
+     * The reply then has the "kdsoap_reply_timed_out" property, which turns the error into a timeout fault.
+     * \p reply must live in the thread of the scheduler.
+     */
+    void add(QNetworkReply *reply, const QDeadlineTimer &deadline);
+
+    /**
+     * Forgets about \p reply. This is done automatically when it finishes.
+     */
+    void remove(QNetworkReply *reply);
+
+    /**
+     * Returns the number of replies being watched.
+     */
+    int count() const
+    {
+        return m_entries.count();
+    }
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    KDSoapTimeoutScheduler();
+
+    struct Entry
+    {
+        QNetworkReply *reply;
+        qint64 expiryTick;
+        Entry *previous;
+        Entry *next;
+        QMetaObject::Connection finishedConnection;
+        QMetaObject::Connection destroyedConnection;
+    };
+
+    void unlink(Entry *entry);
+    // Starts the timer for the next non-empty slot, if it's earlier than the current one
+    void scheduleWakeUp(qint64 tick);
+    void scheduleNextWakeUp();
+
+    QElapsedTimer m_clock; // the ticks are counted from its start
+    qint64 m_currentTick = 0; // the last tick processed
+    QVector<Entry *> m_slots; // the head of the list of entries of each slot
+    QHash<QNetworkReply *, Entry *> m_entries;
+    QBasicTimer m_timer;
+    qint64 m_wakeUpTick = 0;
+};
+
+#endif // KDSOAPTIMEOUTSCHEDULER_P_H
@@ -0,0 +1,285 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapTrace_p.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEvent>
+#include <QMutex>
+#include <QVector>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+// Holds the entries, and prints them in the thread of the application object
+class KDSoapTraceBuffer : public QObject
+{
+public:
+    KDSoapTraceBuffer();
+    ~KDSoapTraceBuffer() override;
+
+    void append(const QByteArray &entry);
+    QList<QByteArray> takeEntries();
+    void setCapacity(int capacity);
+    void printEntries();
+
+    // Read once, from KDSOAP_DEBUG
+    bool m_initiallyEnabled = false;
+    QAtomicInt m_options;
+    QAtomicInt m_indentation;
+    QAtomicInt m_outputEnabled;
+
+    QMutex m_mutex;
+    // Circular: m_count entries, starting at m_first
+    QVector<QByteArray> m_ring;
+    int m_first = 0;
+    int m_count = 0;
+    qint64 m_dropped = 0;
+    bool m_printPending = false;
+
+protected:
+    bool event(QEvent *event) override;
+};
+
+KDSoapTraceBuffer::KDSoapTraceBuffer()
+    : m_indentation(4)
+    , m_ring(256)
+{
+    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
+    m_initiallyEnabled = !doDebug.trimmed().isEmpty() && doDebug != "0";
+    m_outputEnabled.storeRelease(m_initiallyEnabled);
+
+    KDSoapTrace::Options options;
+    const QList<QByteArray> optionList = doDebug.toLower().split(',');
+    for (const QByteArray &opt : optionList) {
+        if (opt == "escape") {
+            options |= KDSoapTrace::Escape;
+        } else if (opt == "http" || opt == "https") {
+            options |= KDSoapTrace::HttpHeaders;
+        } else if (opt == "reformat") {
+            options |= KDSoapTrace::Reformat;
+        } else if (opt.startsWith("indent=")) { // krazy:exclude=strings
+            m_indentation.storeRelease(opt.mid(7).toUShort());
+        }
+    }
+    m_options.storeRelease(int(options));
+
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+    }
+}
+
+KDSoapTraceBuffer::~KDSoapTraceBuffer()
+{
+    printEntries();
+}
+
+void KDSoapTraceBuffer::append(const QByteArray &entry)
+{
+    bool schedulePrint = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_ring.isEmpty()) {
+            ++m_dropped;
+            return;
+        }
+        if (m_count == m_ring.size()) {
+            m_ring[m_first] = entry;
+            m_first = (m_first + 1) % m_ring.size();
+            ++m_dropped;
+        } else {
+            m_ring[(m_first + m_count) % m_ring.size()] = entry;
+            ++m_count;
+        }
+        if (m_outputEnabled.loadAcquire() && !m_printPending) {
+            m_printPending = true;
+            schedulePrint = true;
+        }
+    }
+    if (schedulePrint) {
+        QCoreApplication::postEvent(this, new QEvent(QEvent::User), Qt::LowEventPriority);
+    }
+}
+
+QList<QByteArray> KDSoapTraceBuffer::takeEntries()
+{
+    QMutexLocker locker(&m_mutex);
+    QList<QByteArray> entries;
+    entries.reserve(m_count);
+    for (int i = 0; i < m_count; ++i) {
+        QByteArray &entry = m_ring[(m_first + i) % m_ring.size()];
+        entries.append(entry);
+        entry = QByteArray();
+    }
+    m_first = 0;
+    m_count = 0;
+    return entries;
+}
+
+void KDSoapTraceBuffer::setCapacity(int capacity)
+{
+    const QList<QByteArray> entries = takeEntries();
+    QMutexLocker locker(&m_mutex);
+    m_ring = QVector<QByteArray>(qMax(0, capacity));
+    // Keep the newest entries
+    const int kept = qMin(entries.size(), m_ring.size());
+    m_dropped += entries.size() - kept;
+    for (int i = 0; i < kept; ++i) {
+        m_ring[i] = entries.at(entries.size() - kept + i);
+    }
+    m_count = kept;
+}
+
+void KDSoapTraceBuffer::printEntries()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_printPending = false;
+    }
+    if (!m_outputEnabled.loadAcquire()) {
+        return;
+    }
+    const bool escape = KDSoapTrace::Options(m_options.loadAcquire()) & KDSoapTrace::Escape;
+    const QList<QByteArray> entries = takeEntries();
+    for (const QByteArray &entry : entries) {
+        if (escape) {
+            qCDebug(KDSOAP_LOG_MESSAGES) << entry;
+        } else {
+            qCDebug(KDSOAP_LOG_MESSAGES).noquote() << entry;
+        }
+    }
+}
+
+bool KDSoapTraceBuffer::event(QEvent *event)
+{
+    if (event->type() == QEvent::User) {
+        printEntries();
+        return true;
+    }
+    return QObject::event(event);
+}
+
+Q_GLOBAL_STATIC(KDSoapTraceBuffer, s_buffer)
+
+const QLoggingCategory &KDSOAP_LOG_MESSAGES()
+{
+    // Never deleted: the entries left are printed when the buffer is destroyed, at exit
+    static const QLoggingCategory *category = new QLoggingCategory("kdsoap.messages", s_buffer()->m_initiallyEnabled ? QtDebugMsg : QtInfoMsg);
+    return *category;
+}
+
+void kdsoapTraceMessage(const QByteArray &data, const QList<QPair<QByteArray, QByteArray>> &headers)
+{
+    const KDSoapTrace::Options options = KDSoapTrace::options();
+
+    QByteArray entry;
+    if (options & KDSoapTrace::HttpHeaders) {
+        for (const QPair<QByteArray, QByteArray> &header : headers) {
+            if (!header.first.isEmpty()) {
+                entry += header.first + ": ";
+            }
+            entry += header.second + "\n";
+        }
+        entry += "\n";
+    }
+
+    if (options & KDSoapTrace::Reformat) {
+        QByteArray reformatted;
+        QXmlStreamReader reader(data);
+        QXmlStreamWriter writer(&reformatted);
+        writer.setAutoFormatting(true);
+        writer.setAutoFormattingIndent(KDSoapTrace::indentation());
+
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (!reader.hasError() && !reader.isWhitespace()) {
+                writer.writeCurrentToken(reader);
+            }
+        }
+
+        entry += reader.hasError() ? data : reformatted;
+    } else {
+        entry += data;
+    }
+
+    s_buffer()->append(entry);
+}
+
+bool KDSoapTrace::isEnabled()
+{
+    return KDSOAP_LOG_MESSAGES().isDebugEnabled();
+}
+
+void KDSoapTrace::setEnabled(bool enabled)
+{
+    // Q_LOGGING_CATEGORY also hands out a const reference to a category which can be reconfigured
+    const_cast<QLoggingCategory &>(KDSOAP_LOG_MESSAGES()).setEnabled(QtDebugMsg, enabled);
+}
+
+KDSoapTrace::Options KDSoapTrace::options()
+{
+    return Options(s_buffer()->m_options.loadAcquire());
+}
+
+void KDSoapTrace::setOptions(Options options)
+{
+    s_buffer()->m_options.storeRelease(int(options));
+}
+
+int KDSoapTrace::indentation()
+{
+    return s_buffer()->m_indentation.loadAcquire();
+}
+
+void KDSoapTrace::setIndentation(int indentation)
+{
+    s_buffer()->m_indentation.storeRelease(indentation);
+}
+
+int KDSoapTrace::capacity()
+{
+    KDSoapTraceBuffer *buffer = s_buffer();
+    QMutexLocker locker(&buffer->m_mutex);
+    return buffer->m_ring.size();
+}
+
+void KDSoapTrace::setCapacity(int capacity)
+{
+    s_buffer()->setCapacity(capacity);
+}
+
+bool KDSoapTrace::isOutputEnabled()
+{
+    return s_buffer()->m_outputEnabled.loadAcquire();
+}
+
+void KDSoapTrace::setOutputEnabled(bool enabled)
+{
+    KDSoapTraceBuffer *buffer = s_buffer();
+    buffer->m_outputEnabled.storeRelease(enabled);
+    if (enabled) {
+        // Print what was recorded so far
+        QMutexLocker locker(&buffer->m_mutex);
+        if (buffer->m_count > 0 && !buffer->m_printPending) {
+            buffer->m_printPending = true;
+            QCoreApplication::postEvent(buffer, new QEvent(QEvent::User), Qt::LowEventPriority);
+        }
+    }
+}
+
+QList<QByteArray> KDSoapTrace::takeEntries()
+{
+    return s_buffer()->takeEntries();
+}
+
+qint64 KDSoapTrace::droppedEntryCount()
+{
+    KDSoapTraceBuffer *buffer = s_buffer();
+    QMutexLocker locker(&buffer->m_mutex);
+    return buffer->m_dropped;
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPTRACE_H
+#define KDSOAPTRACE_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QFlags>
+#include <QtCore/QList>
+
+/**
+ * Tracing of the SOAP messages sent and received by the client and server libraries.
+ *
+ * When tracing is enabled, the HTTP headers and XML of every request and response are recorded into
+ * a bounded ring buffer (the oldest entries are dropped when it's full), which can be read with
+ * takeEntries(). With output enabled, the entries are also printed, from the main thread's event loop,
+ * with the "kdsoap.messages" logging category rather than while the message is being sent.
+ *
+ * Tracing is enabled exactly when debug output is enabled for the "kdsoap.messages" logging category,
+ * so it can also be switched with QLoggingCategory::setFilterRules() or the QT_LOGGING_RULES environment
+ * variable. When it's disabled, checking it costs a single atomic load per message.
+ *
+ * The initial configuration comes from the KDSOAP_DEBUG environment variable, which is read once:
+ * any value other than "0" enables tracing and output, and it can contain a comma-separated list
+ * of options: "http" for HttpHeaders, "escape" for Escape, "reformat" for Reformat and "indent=N"
+ * for the indentation.
+ *
+ * All the functions of this class are thread-safe.
+ *
+ * \since 2.2
+ */
+class KDSOAP_EXPORT KDSoapTrace // krazy:exclude=dpointer
+{
+public:
+    enum Option
+    {
+        NoOptions = 0,
+        /** Record the HTTP headers of the messages, besides their XML */
+        HttpHeaders = 1,
+        /** Print the entries as quoted C strings, with non-printable characters escaped */
+        Escape = 2,
+        /** Indent the XML of the messages, one element per line */
+        Reformat = 4
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    /**
+     * Returns true if the messages are being traced.
+     */
+    static bool isEnabled();
+    /**
+     * Enables or disables tracing the messages.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * Returns the options used to record (and print) the messages.
+     */
+    static Options options();
+    /**
+     * Sets the options used to record (and print) the messages.
+     */
+    static void setOptions(Options options);
+
+    /**
+     * Returns the indentation used by the Reformat option. The default is 4.
+     */
+    static int indentation();
+    /**
+     * Sets the indentation used by the Reformat option.
+     */
+    static void setIndentation(int indentation);
+
+    /**
+     * Returns the maximum number of entries kept in the ring buffer. The default is 256.
+     */
+    static int capacity();
+    /**
+     * Sets the maximum number of entries kept in the ring buffer.
+     * If there are more entries than that, the oldest ones are dropped.
+     */
+    static void setCapacity(int capacity);
+
+    /**
+     * Returns true if the entries are printed.
+     */
+    static bool isOutputEnabled();
+    /**
+     * Enables or disables printing the entries, with qDebug() in the "kdsoap.messages" logging category.
+     * They're printed in batches, when the event loop of the main thread runs, and then removed
+     * from the ring buffer. Remaining entries are printed when the application exits.
+     */
+    static void setOutputEnabled(bool enabled);
+
+    /**
+     * Returns the entries of the ring buffer, oldest first, and empties it.
+     */
+    static QList<QByteArray> takeEntries();
+
+    /**
+     * Returns the number of entries dropped so far because the ring buffer was full.
+     */
+    static qint64 droppedEntryCount();
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KDSoapTrace::Options)
+
+#endif // KDSOAPTRACE_H
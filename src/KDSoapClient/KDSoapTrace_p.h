@@ -0,0 +1,35 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPTRACE_P_H
+#define KDSOAPTRACE_P_H
+
+#include "KDSoapTrace.h"
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QPair>
+
+/**
+ * \internal
+ * The logging category whose debug output enables KDSoapTrace.
+ *
+ * Only exported for the server lib
+ */
+KDSOAP_EXPORT const QLoggingCategory &KDSOAP_LOG_MESSAGES();
+
+/**
+ * \internal
+ * Records a message of \p data (its XML) into the trace, with \p headers if the HttpHeaders option is set.
+ * A header with an empty name is recorded as is (e.g. the request or status line).
+ * The caller is expected to check KDSoapTrace::isEnabled() first, so that nothing is formatted when it's disabled.
+ *
+ * Only exported for the server lib
+ */
+KDSOAP_EXPORT void kdsoapTraceMessage(const QByteArray &data, const QList<QPair<QByteArray, QByteArray>> &headers);
+
+#endif // KDSOAPTRACE_P_H
@@ -9,41 +9,152 @@
 ****************************************************************************/
 #include "KDSoapValue.h"
 #include "KDDateTime.h"
+#include "KDSoapAttachment.h"
+#include "KDSoapBinaryCodec.h"
+#include "KDSoapMessageReader_p.h"
+#include "KDSoapMultipart_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
+#include "KDSoapStreamingBody_p.h"
+#include "KDSoapValueArena_p.h"
 #include <QDateTime>
 #include <QDebug>
+#include <QHash>
+#include <QLocale>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QStringList>
 #include <QUrl>
+#include <QtNumeric>
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+// Most values are leaves, like <id>42</id>: they have no children, attributes, type information
+// or local namespace declarations. Those are only allocated when set.
 class KDSoapValue::Private : public QSharedData
 {
 public:
     Private()
         : m_qualified(false)
         , m_nillable(false)
+        , m_childValues(nullptr)
+        , m_extra(nullptr)
     {
     }
     Private(const QString &n, const QVariant &v, const QString &typeNameSpace, const QString &typeName)
         : m_name(n)
         , m_value(v)
-        , m_typeNamespace(typeNameSpace)
-        , m_typeName(typeName)
         , m_qualified(false)
         , m_nillable(false)
+        , m_childValues(nullptr)
+        , m_extra(nullptr)
+    {
+        setType(typeNameSpace, typeName);
+    }
+    Private(const Private &other)
+        : QSharedData(other)
+        , m_name(other.m_name)
+        , m_nameNamespace(other.m_nameNamespace)
+        , m_value(other.m_value)
+        , m_qualified(other.m_qualified)
+        , m_nillable(other.m_nillable)
+        , m_environmentNamespaceDeclarations(other.m_environmentNamespaceDeclarations)
+        , m_childValues(other.m_childValues.loadAcquire() ? new KDSoapValueList(*other.m_childValues.loadAcquire()) : nullptr)
+        , m_extra(other.m_extra ? new Extra(*other.m_extra) : nullptr)
+    {
+    }
+    ~Private()
+    {
+        delete m_childValues.loadAcquire();
+        delete m_extra;
+    }
+
+    // Allocated from the current KDSoapValueArena, if any
+    static void *operator new(std::size_t size)
+    {
+        return KDSoapValueArena::allocate(size);
+    }
+    static void operator delete(void *ptr)
+    {
+        KDSoapValueArena::deallocate(ptr);
+    }
+
+    // The data of moved-from values, shared so that moving doesn't allocate.
+    // It's outside of any arena and never deleted. Setters detach from it, and so does childValues().
+    static Private *sharedNull()
+    {
+        static Private *const s_sharedNull = [] {
+            alignas(Private) static char storage[sizeof(Private)];
+            Private *data = ::new (storage) Private;
+            data->ref.ref();
+            return data;
+        }();
+        return s_sharedNull;
+    }
+
+    // The children, without allocating them
+    const KDSoapValueList &children() const
     {
+        const KDSoapValueList *list = m_childValues.loadAcquire();
+        return list ? *list : emptyList();
+    }
+    KDSoapValueList &childrenForWriting() const
+    {
+        KDSoapValueList *list = m_childValues.loadAcquire();
+        if (!list) {
+            // childValues() is const, so this can happen from several threads at the same time
+            KDSoapValueList *newList = new KDSoapValueList;
+            if (m_childValues.testAndSetOrdered(nullptr, newList)) {
+                list = newList;
+            } else {
+                delete newList;
+                list = m_childValues.loadAcquire();
+            }
+        }
+        return *list;
+    }
+    static const KDSoapValueList &emptyList()
+    {
+        static const KDSoapValueList s_emptyList;
+        return s_emptyList;
+    }
+
+    void setType(const QString &typeNameSpace, const QString &typeName)
+    {
+        if (m_extra || !typeNameSpace.isEmpty() || !typeName.isEmpty()) {
+            extra().m_typeNamespace = typeNameSpace;
+            extra().m_typeName = typeName;
+        }
+    }
+
+    struct Extra
+    {
+        QString m_typeNamespace;
+        QString m_typeName;
+        QXmlStreamNamespaceDeclarations m_localNamespaceDeclarations;
+    };
+    Extra &extra()
+    {
+        if (!m_extra) {
+            m_extra = new Extra;
+        }
+        return *m_extra;
     }
 
     QString m_name;
     QString m_nameNamespace;
     QVariant m_value;
-    QString m_typeNamespace;
-    QString m_typeName;
-    KDSoapValueList m_childValues;
     bool m_qualified;
     bool m_nillable;
     QXmlStreamNamespaceDeclarations m_environmentNamespaceDeclarations;
-    QXmlStreamNamespaceDeclarations m_localNamespaceDeclarations;
+    mutable QAtomicPointer<KDSoapValueList> m_childValues;
+    Extra *m_extra;
+
+private:
+    Private &operator=(const Private &) = delete;
 };
 
 uint qHash(const KDSoapValue &value)
@@ -64,7 +175,13 @@ KDSoapValue::KDSoapValue(const QString &n, const QVariant &v, const QString &typ
 KDSoapValue::KDSoapValue(const QString &n, const KDSoapValueList &children, const QString &typeNameSpace, const QString &typeName)
     : d(new Private(n, QVariant(), typeNameSpace, typeName))
 {
-    d->m_childValues = children;
+    d->childrenForWriting() = children;
+}
+
+KDSoapValue::KDSoapValue(const QString &n, KDSoapValueList &&children, const QString &typeNameSpace, const QString &typeName)
+    : d(new Private(n, QVariant(), typeNameSpace, typeName))
+{
+    d->childrenForWriting() = std::move(children);
 }
 
 KDSoapValue::~KDSoapValue()
@@ -76,6 +193,12 @@ KDSoapValue::KDSoapValue(const KDSoapValue &other)
 {
 }
 
+KDSoapValue::KDSoapValue(KDSoapValue &&other) noexcept
+    : d(std::move(other.d))
+{
+    other.d = Private::sharedNull();
+}
+
 bool KDSoapValue::isNull() const
 {
     return d->m_name.isEmpty() && isNil();
@@ -83,7 +206,8 @@ bool KDSoapValue::isNull() const
 
 bool KDSoapValue::isNil() const
 {
-    return d->m_value.isNull() && d->m_childValues.isEmpty() && d->m_childValues.attributes().isEmpty();
+    const KDSoapValueList &children = d->children();
+    return d->m_value.isNull() && children.isEmpty() && children.attributes().isEmpty();
 }
 
 void KDSoapValue::setNillable(bool nillable)
@@ -111,6 +235,11 @@ void KDSoapValue::setValue(const QVariant &value)
     d->m_value = value;
 }
 
+void KDSoapValue::setValue(QVariant &&value)
+{
+    d->m_value = std::move(value);
+}
+
 bool KDSoapValue::isQualified() const
 {
     return d->m_qualified;
@@ -123,17 +252,20 @@ void KDSoapValue::setQualified(bool qualified)
 
 void KDSoapValue::setNamespaceDeclarations(const QXmlStreamNamespaceDeclarations &namespaceDeclarations)
 {
-    d->m_localNamespaceDeclarations = namespaceDeclarations;
+    if (namespaceDeclarations.isEmpty() && !d->m_extra) {
+        return;
+    }
+    d->extra().m_localNamespaceDeclarations = namespaceDeclarations;
 }
 
 void KDSoapValue::addNamespaceDeclaration(const QXmlStreamNamespaceDeclaration &namespaceDeclaration)
 {
-    d->m_localNamespaceDeclarations.append(namespaceDeclaration);
+    d->extra().m_localNamespaceDeclarations.append(namespaceDeclaration);
 }
 
 QXmlStreamNamespaceDeclarations KDSoapValue::namespaceDeclarations() const
 {
-    return d->m_localNamespaceDeclarations;
+    return d->m_extra ? d->m_extra->m_localNamespaceDeclarations : QXmlStreamNamespaceDeclarations();
 }
 
 void KDSoapValue::setEnvironmentNamespaceDeclarations(const QXmlStreamNamespaceDeclarations &environmentNamespaceDeclarations)
@@ -148,8 +280,12 @@ QXmlStreamNamespaceDeclarations KDSoapValue::environmentNamespaceDeclarations()
 
 KDSoapValueList &KDSoapValue::childValues() const
 {
+    if (d.constData() == Private::sharedNull()) {
+        // The returned list may be modified, which must not change all the moved-from values
+        const_cast<KDSoapValue *>(this)->d.detach();
+    }
     // I want to fool the QSharedDataPointer mechanism here...
-    return const_cast<KDSoapValueList &>(d->m_childValues);
+    return d->childrenForWriting();
 }
 
 bool KDSoapValue::operator==(const KDSoapValue &other) const
@@ -176,13 +312,11 @@ static QString variantToTextValue(const QVariant &value, const QString &typeNs,
         const QByteArray data = value.toByteArray();
         if (typeNs == KDSoapNamespaceManager::xmlSchema1999() || typeNs == KDSoapNamespaceManager::xmlSchema2001()) {
             if (type == QLatin1String("hexBinary")) {
-                const QByteArray hb = data.toHex();
-                return QString::fromLatin1(hb.constData(), hb.size());
+                return KDSoapBinaryCodec::toHex(data);
             }
         }
         // default to base64Binary, like variantToXMLType() does.
-        const QByteArray b64 = value.toByteArray().toBase64();
-        return QString::fromLatin1(b64.constData(), b64.size());
+        return KDSoapBinaryCodec::toBase64(data);
     }
     case QVariant::Int:
     // fall-through
@@ -217,6 +351,11 @@ static QString variantToTextValue(const QVariant &value, const QString &typeNs,
             return value.value<KDDateTime>().toDateString();
         }
 
+        if (value.userType() == qMetaTypeId<KDSoapAttachment>()) {
+            // Not sent as MTOM: inline it like a QByteArray
+            return KDSoapBinaryCodec::toBase64(value.value<KDSoapAttachment>().data());
+        }
+
         if (value.userType() == qMetaTypeId<float>()) {
             return QString::number(value.value<float>());
         }
@@ -267,6 +406,9 @@ static QString variantToXMLType(const QVariant &value)
         if (value.canConvert<KDDateTime>()) {
             return QLatin1String("xsd:dateTime");
         }
+        if (value.userType() == qMetaTypeId<KDSoapAttachment>()) {
+            return QLatin1String("xsd:base64Binary");
+        }
 
         qDebug() << value;
 
@@ -277,35 +419,295 @@ static QString variantToXMLType(const QVariant &value)
     }
 }
 
+// With MTOM, attachments and base64Binary data are sent as MIME parts
+static bool isXopValue(const QVariant &value, const QString &typeNs, const QString &type)
+{
+    if (value.userType() == qMetaTypeId<KDSoapAttachment>()) {
+        return true;
+    }
+    if (value.userType() != QVariant::ByteArray) {
+        return false;
+    }
+    const bool isHexBinary = (typeNs == KDSoapNamespaceManager::xmlSchema1999() || typeNs == KDSoapNamespaceManager::xmlSchema2001())
+        && type == QLatin1String("hexBinary");
+    return !isHexBinary;
+}
+
+static void writeXopInclude(QVector<KDSoapAttachment> &attachments, QXmlStreamWriter &writer, const QVariant &value)
+{
+    const KDSoapAttachment attachment =
+        value.userType() == qMetaTypeId<KDSoapAttachment>() ? value.value<KDSoapAttachment>() : KDSoapAttachment(value.toByteArray());
+    const QString contentId = attachment.contentId();
+    writer.writeNamespace(KDSoapMultipart::xopNamespace(), QStringLiteral("xop"));
+    writer.writeEmptyElement(KDSoapMultipart::xopNamespace(), QStringLiteral("Include"));
+    writer.writeAttribute(QStringLiteral("href"), QLatin1String("cid:") + QString::fromLatin1(QUrl::toPercentEncoding(contentId, "@")));
+    // The same attachment can be referenced more than once, but is only sent once
+    const bool alreadySent = std::any_of(attachments.cbegin(), attachments.cend(), [&](const KDSoapAttachment &other) {
+        return other.contentId() == contentId;
+    });
+    if (!alreadySent) {
+        attachments.append(attachment);
+    }
+}
+
+namespace {
+// The text of a number, boolean, date or time, formatted without going through a QString
+class SimpleTextValue
+{
+public:
+    SimpleTextValue()
+        : m_size(0)
+    {
+    }
+
+    const char *data() const
+    {
+        return m_data;
+    }
+    int size() const
+    {
+        return m_size;
+    }
+
+    void append(char c)
+    {
+        m_data[m_size++] = c;
+    }
+    void append(const char *str, int length)
+    {
+        memcpy(m_data + m_size, str, length);
+        m_size += length;
+    }
+    // Zero-padded to width digits
+    void appendDigits(int value, int width)
+    {
+        for (int i = width - 1; i >= 0; --i) {
+            m_data[m_size + i] = char('0' + value % 10);
+            value /= 10;
+        }
+        m_size += width;
+    }
+    void appendUnsigned(quint64 value)
+    {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = char('0' + value % 10);
+            value /= 10;
+        } while (value);
+        while (count) {
+            m_data[m_size++] = digits[--count];
+        }
+    }
+    void appendSigned(qint64 value)
+    {
+        if (value < 0) {
+            append('-');
+            appendUnsigned(quint64(0) - quint64(value));
+        } else {
+            appendUnsigned(quint64(value));
+        }
+    }
+    void appendDouble(double value)
+    {
+        // Same as QVariant::toString(), i.e. the shortest text which reads back as the same double
+        const QByteArray text = QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+        if (text.size() > int(sizeof(m_data)) - m_size) {
+            return;
+        }
+        append(text.constData(), text.size());
+    }
+    // yyyy-MM-dd, like QDate::toString(Qt::ISODate). Years which don't have four digits are left to Qt.
+    bool appendDate(const QDate &date)
+    {
+        int year, month, day;
+        date.getDate(&year, &month, &day);
+        if (!date.isValid() || year < 1 || year > 9999) {
+            return false;
+        }
+        appendDigits(year, 4);
+        append('-');
+        appendDigits(month, 2);
+        append('-');
+        appendDigits(day, 2);
+        return true;
+    }
+    // hh:mm:ss, followed by .zzz if there are milliseconds
+    bool appendTime(const QTime &time)
+    {
+        if (!time.isValid()) {
+            return false;
+        }
+        appendDigits(time.hour(), 2);
+        append(':');
+        appendDigits(time.minute(), 2);
+        append(':');
+        appendDigits(time.second(), 2);
+        if (time.msec()) {
+            append('.');
+            appendDigits(time.msec(), 3);
+        }
+        return true;
+    }
+    // Same as KDDateTime::toDateString()
+    bool appendDateTime(const QDateTime &dateTime, const QString &timeZone)
+    {
+        if (!dateTime.isValid() || !appendDate(dateTime.date())) {
+            return false;
+        }
+        append('T');
+        const QTime time = dateTime.time();
+        appendTime(time);
+        if (time.msec()) {
+            // The time zone as given to KDDateTime::setTimeZone(); anything unusual is left to the QString path, which escapes it
+            if (timeZone.size() > 6) {
+                return false;
+            }
+            for (const QChar c : timeZone) {
+                const ushort u = c.unicode();
+                if (!((u >= '0' && u <= '9') || u == '+' || u == '-' || u == ':' || u == 'Z')) {
+                    return false;
+                }
+                append(char(u));
+            }
+            return true;
+        }
+        // Like QDateTime::toString(Qt::ISODate)
+        switch (dateTime.timeSpec()) {
+        case Qt::LocalTime:
+            return true;
+        case Qt::UTC:
+            append('Z');
+            return true;
+        case Qt::OffsetFromUTC: {
+            const int offset = dateTime.offsetFromUtc();
+            const int absOffset = qAbs(offset);
+            if (absOffset >= 100 * 3600) {
+                return false;
+            }
+            append(offset >= 0 ? '+' : '-');
+            appendDigits(absOffset / 3600, 2);
+            append(':');
+            appendDigits((absOffset / 60) % 60, 2);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+private:
+    char m_data[64];
+    int m_size;
+};
+}
+
+// Formats the same text as variantToTextValue() for the most common simple types.
+// Returns false for the other types, and for the values which Qt formats in an unusual way.
+static bool formatSimpleTextValue(const QVariant &value, SimpleTextValue *text)
+{
+    switch (value.userType()) {
+    case QVariant::Int:
+    case QVariant::LongLong:
+    case QVariant::UInt:
+        text->appendSigned(value.toLongLong());
+        return true;
+    case QVariant::ULongLong:
+        text->appendUnsigned(value.toULongLong());
+        return true;
+    case QVariant::Bool:
+        if (value.toBool()) {
+            text->append("true", 4);
+        } else {
+            text->append("false", 5);
+        }
+        return true;
+    case QVariant::Double:
+        text->appendDouble(value.toDouble());
+        return text->size() > 0;
+    case QVariant::Time:
+        return text->appendTime(value.toTime());
+    case QVariant::Date:
+        return text->appendDate(value.toDate());
+    case QVariant::DateTime:
+        return text->appendDateTime(value.toDateTime(), QString());
+    default:
+        if (value.userType() == qMetaTypeId<KDDateTime>()) {
+            const KDDateTime dateTime = value.value<KDDateTime>();
+            return text->appendDateTime(dateTime, dateTime.timeZone());
+        }
+        return false;
+    }
+}
+
 void KDSoapValue::writeElement(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
                                const QString &messageNamespace, bool forceQualified) const
 {
     Q_ASSERT(!name().isEmpty());
-    if (!d->m_nameNamespace.isEmpty() && d->m_nameNamespace != messageNamespace) {
-        forceQualified = true;
+    writeXmlStartElement(writer, d->m_nameNamespace, name(), d->m_qualified || forceQualified, messageNamespace);
+    writeElementContents(namespacePrefixes, writer, use, messageNamespace);
+    writer.writeEndElement();
+}
+
+void KDSoapValue::writeXmlStartElement(QXmlStreamWriter &writer, const QString &nameSpace, const QString &name, bool qualified,
+                                       const QString &messageNamespace)
+{
+    if (!nameSpace.isEmpty() && nameSpace != messageNamespace) {
+        qualified = true;
     }
 
-    if (d->m_qualified || forceQualified) {
-        const QString ns = d->m_nameNamespace.isEmpty() ? messageNamespace : d->m_nameNamespace;
+    if (qualified) {
+        const QString ns = nameSpace.isEmpty() ? messageNamespace : nameSpace;
 
         // TODO: if the prefix is new, we want to do namespacePrefixes.insert()
         // But this means figuring out n2/n3/n4 the same way Qt does...
 
-        writer.writeStartElement(ns, name());
+        writer.writeStartElement(ns, name);
     } else {
-        writer.writeStartElement(name());
+        writer.writeStartElement(name);
+    }
+}
+
+void KDSoapValue::writeXmlElement(QXmlStreamWriter &writer, const QString &nameSpace, const QString &name, bool qualified,
+                                  const QString &messageNamespace, const QString &text)
+{
+    writeXmlStartElement(writer, nameSpace, name, qualified, messageNamespace);
+    if (!text.isEmpty()) {
+        writer.writeCharacters(text);
     }
-    writeElementContents(namespacePrefixes, writer, use, messageNamespace);
     writer.writeEndElement();
 }
 
+void KDSoapValue::writeXml(QXmlStreamWriter &writer, const QString &messageNamespace) const
+{
+    // When called while a message is written, use its prefixes and settings (MTOM, streamed attachments, direct text)
+    if (KDSoapNamespacePrefixes *namespacePrefixes = KDSoapNamespacePrefixes::current(writer)) {
+        writeElement(*namespacePrefixes, writer, LiteralUse, messageNamespace, false);
+        return;
+    }
+    KDSoapNamespacePrefixes namespacePrefixes;
+    writeElement(namespacePrefixes, writer, LiteralUse, messageNamespace, false);
+}
+
+void KDSoapValue::writeXmlContents(QXmlStreamWriter &writer, const QString &messageNamespace) const
+{
+    if (KDSoapNamespacePrefixes *namespacePrefixes = KDSoapNamespacePrefixes::current(writer)) {
+        writeElementContents(*namespacePrefixes, writer, LiteralUse, messageNamespace);
+        return;
+    }
+    KDSoapNamespacePrefixes namespacePrefixes;
+    writeElementContents(namespacePrefixes, writer, LiteralUse, messageNamespace);
+}
+
 void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
                                        const QString &messageNamespace) const
 {
     const QVariant value = this->value();
 
-    for (const QXmlStreamNamespaceDeclaration &decl : qAsConst(d->m_localNamespaceDeclarations)) {
-        writer.writeNamespace(decl.namespaceUri().toString(), decl.prefix().toString());
+    if (d->m_extra) {
+        for (const QXmlStreamNamespaceDeclaration &decl : qAsConst(d->m_extra->m_localNamespaceDeclarations)) {
+            writer.writeNamespace(decl.namespaceUri().toString(), decl.prefix().toString());
+        }
     }
 
     if (isNil() && d->m_nillable) {
@@ -325,7 +727,7 @@ void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixe
             writer.writeAttribute(KDSoapNamespaceManager::xmlSchemaInstance2001(), QLatin1String("type"), type);
         }
 
-        const KDSoapValueList list = this->childValues();
+        const KDSoapValueList &list = d->children();
         const bool isArray = !list.arrayType().isEmpty();
         if (isArray) {
             writer.writeAttribute(KDSoapNamespaceManager::soapEncoding(), QLatin1String("arrayType"),
@@ -336,6 +738,27 @@ void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixe
     writeChildren(namespacePrefixes, writer, use, messageNamespace, false);
 
     if (!value.isNull()) {
+        if (namespacePrefixes.xopAttachments() && isXopValue(value, this->typeNs(), this->type())) {
+            writeXopInclude(*namespacePrefixes.xopAttachments(), writer, value);
+            return;
+        }
+        if (namespacePrefixes.streamedAttachments() && value.userType() == qMetaTypeId<KDSoapAttachment>() && writer.device()) {
+            const KDSoapAttachment attachment = value.value<KDSoapAttachment>();
+            if (KDSoapStreamingBody::canStream(attachment)) {
+                writer.writeCharacters(QString()); // closes the start tag, the text goes right after it
+                const KDSoapStreamedAttachment streamed = {writer.device()->pos(), attachment};
+                namespacePrefixes.streamedAttachments()->append(streamed);
+                return;
+            }
+        }
+        if (namespacePrefixes.directTextOutput() && writer.device()) {
+            SimpleTextValue text;
+            if (formatSimpleTextValue(value, &text)) {
+                writer.writeCharacters(QString()); // closes the start tag, the text goes right after it
+                writer.device()->write(text.data(), text.size());
+                return;
+            }
+        }
         const QString txt = variantToTextValue(value, this->typeNs(), this->type());
         if (!txt.isEmpty()) { // In Qt6, a null string doesn't lead to a null variant anymore
             writer.writeCharacters(txt);
@@ -346,7 +769,7 @@ void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixe
 void KDSoapValue::writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
                                 const QString &messageNamespace, bool forceQualified) const
 {
-    const KDSoapValueList &args = childValues();
+    const KDSoapValueList &args = d->children();
     const auto attributes = args.attributes();
     for (const KDSoapValue &attr : attributes) {
         // Q_ASSERT(!attr.value().isNull());
@@ -393,18 +816,17 @@ QDebug operator<<(QDebug dbg, const KDSoapValue &value)
 
 void KDSoapValue::setType(const QString &nameSpace, const QString &type)
 {
-    d->m_typeNamespace = nameSpace;
-    d->m_typeName = type;
+    d->setType(nameSpace, type);
 }
 
 QString KDSoapValue::typeNs() const
 {
-    return d->m_typeNamespace;
+    return d->m_extra ? d->m_extra->m_typeNamespace : QString();
 }
 
 QString KDSoapValue::type() const
 {
-    return d->m_typeName;
+    return d->m_extra ? d->m_extra->m_typeName : QString();
 }
 
 KDSoapValueList KDSoapValue::split() const
@@ -424,6 +846,189 @@ KDSoapValueList KDSoapValue::split() const
     return valueList;
 }
 
+static bool isListSeparator(QChar c)
+{
+    return c == QLatin1Char(' ') || c == QLatin1Char('\t') || c == QLatin1Char('\n') || c == QLatin1Char('\r');
+}
+
+// xsd:long and the other integer types, with an optional sign
+static bool parseNumber(const QString &text, int pos, int length, qint64 *result)
+{
+    const QChar *it = text.constData() + pos;
+    const QChar *end = it + length;
+    const bool negative = *it == QLatin1Char('-');
+    if (negative || *it == QLatin1Char('+')) {
+        ++it;
+    }
+    if (it == end) {
+        return false;
+    }
+    const quint64 limit = quint64(std::numeric_limits<qint64>::max()) + (negative ? 1 : 0);
+    quint64 value = 0;
+    for (; it != end; ++it) {
+        const ushort c = it->unicode();
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        const quint64 digit = c - '0';
+        if (value > (limit - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    *result = negative ? qint64(quint64(0) - value) : qint64(value);
+    return true;
+}
+
+// xsd:double, including the special values INF, -INF and NaN
+static bool parseNumber(const QString &text, int pos, int length, double *result)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    const QStringView number = QStringView(text).mid(pos, length);
+#else
+    const QStringRef number = text.midRef(pos, length);
+#endif
+    if (number == QLatin1String("INF") || number == QLatin1String("+INF")) {
+        *result = qInf();
+        return true;
+    }
+    if (number == QLatin1String("-INF")) {
+        *result = -qInf();
+        return true;
+    }
+    if (number == QLatin1String("NaN")) {
+        *result = qQNaN();
+        return true;
+    }
+    // Reject what the C locale parser would accept on top of the XML Schema syntax (e.g. "inf")
+    const ushort last = number.at(length - 1).unicode();
+    if (last != '.' && (last < '0' || last > '9')) {
+        return false;
+    }
+    bool ok;
+    *result = number.toDouble(&ok);
+    return ok;
+}
+
+// Parses the whitespace-separated items of \p text, in one pass
+template<typename T>
+static QVector<T> parseNumberList(const QString &text, bool *ok)
+{
+    QVector<T> result;
+    const int size = text.size();
+    int pos = 0;
+    while (true) {
+        while (pos < size && isListSeparator(text.at(pos))) {
+            ++pos;
+        }
+        if (pos == size) {
+            break;
+        }
+        int end = pos + 1;
+        while (end < size && !isListSeparator(text.at(end))) {
+            ++end;
+        }
+        T number;
+        if (!parseNumber(text, pos, end - pos, &number)) {
+            if (ok) {
+                *ok = false;
+            }
+            return QVector<T>();
+        }
+        result.append(number);
+        pos = end;
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return result;
+}
+
+// Values already converted by the message reader (use=encoded) are taken as is
+static bool numberFromVariant(const QVariant &value, double *result)
+{
+    switch (value.userType()) {
+    case QVariant::Double:
+    case QMetaType::Float:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        *result = value.toDouble();
+        return true;
+    default:
+        break;
+    }
+    bool ok;
+    const QVector<double> numbers = parseNumberList<double>(value.toString(), &ok);
+    if (!ok || numbers.size() != 1) {
+        return false;
+    }
+    *result = numbers.first();
+    return true;
+}
+
+static bool numberFromVariant(const QVariant &value, qint64 *result)
+{
+    switch (value.userType()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+        *result = value.toLongLong();
+        return true;
+    default:
+        break;
+    }
+    bool ok;
+    const QVector<qint64> numbers = parseNumberList<qint64>(value.toString(), &ok);
+    if (!ok || numbers.size() != 1) {
+        return false;
+    }
+    *result = numbers.first();
+    return true;
+}
+
+template<typename T>
+static QVector<T> childNumbers(const KDSoapValueList &list, bool *ok)
+{
+    QVector<T> result;
+    result.reserve(list.count());
+    for (const KDSoapValue &child : list) {
+        T number;
+        if (!numberFromVariant(child.value(), &number)) {
+            if (ok) {
+                *ok = false;
+            }
+            return QVector<T>();
+        }
+        result.append(number);
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return result;
+}
+
+QVector<double> KDSoapValue::toDoubleArray(bool *ok) const
+{
+    return parseNumberList<double>(value().toString(), ok);
+}
+
+QVector<qint64> KDSoapValue::toInt64Array(bool *ok) const
+{
+    return parseNumberList<qint64>(value().toString(), ok);
+}
+
+QVector<double> KDSoapValueList::toDoubleArray(bool *ok) const
+{
+    return childNumbers<double>(*this, ok);
+}
+
+QVector<qint64> KDSoapValueList::toInt64Array(bool *ok) const
+{
+    return childNumbers<qint64>(*this, ok);
+}
+
 KDSoapValue KDSoapValueList::child(const QString &name) const
 {
     for (const KDSoapValue &val : qAsConst(*this)) {
@@ -434,6 +1039,53 @@ KDSoapValue KDSoapValueList::child(const QString &name) const
     return KDSoapValue();
 }
 
+namespace {
+// Name index built by KDSoapValueList::childIndexes(), kept in the d slot of the list.
+// The snapshot shares the list data it was built from: any modification of the
+// list detaches it, which is how a stale index is detected. Copies of the list share
+// the slot, and the index as long as they share the data.
+struct ChildIndex
+{
+    QList<KDSoapValue> snapshot;
+    QHash<QString, QVector<int>> positions;
+};
+typedef QSharedPointer<const ChildIndex> ChildIndexPtr;
+
+// Protect the slot, since childIndexes() is const and may be called from several threads.
+// One mutex per group of lists, so that unrelated lists don't contend for the same one.
+QBasicMutex s_childIndexMutexes[16];
+
+QBasicMutex *childIndexMutex(const KDSoapValueList *list)
+{
+    return &s_childIndexMutexes[(quintptr(list) / sizeof(void *)) % 16];
+}
+}
+
+Q_DECLARE_METATYPE(ChildIndexPtr)
+
+QVector<int> KDSoapValueList::childIndexes(const QString &name) const
+{
+    ChildIndexPtr index;
+    {
+        QMutexLocker locker(childIndexMutex(this));
+        if (d.userType() == qMetaTypeId<ChildIndexPtr>()) {
+            index = d.value<ChildIndexPtr>();
+        }
+    }
+    if (!index || !index->snapshot.isSharedWith(*this)) {
+        QSharedPointer<ChildIndex> newIndex(new ChildIndex);
+        newIndex->snapshot = *this;
+        newIndex->positions.reserve(count());
+        for (int i = 0; i < count(); ++i) {
+            newIndex->positions[at(i).name()].append(i);
+        }
+        index = newIndex;
+        QMutexLocker locker(childIndexMutex(this));
+        d = QVariant::fromValue(index);
+    }
+    return index->positions.value(name);
+}
+
 void KDSoapValueList::setArrayType(const QString &nameSpace, const QString &type)
 {
     m_arrayType = qMakePair(nameSpace, type);
@@ -454,6 +1106,13 @@ void KDSoapValueList::addArgument(const QString &argumentName, const QVariant &a
     append(KDSoapValue(argumentName, argumentValue, typeNameSpace, typeName));
 }
 
+void KDSoapValueList::addArgument(const QString &argumentName, QVariant &&argumentValue, const QString &typeNameSpace, const QString &typeName)
+{
+    KDSoapValue value(argumentName, QVariant(), typeNameSpace, typeName);
+    value.setValue(std::move(argumentValue));
+    append(std::move(value));
+}
+
 QString KDSoapValue::namespaceUri() const
 {
     return d->m_nameNamespace;
@@ -478,3 +1137,8 @@ QByteArray KDSoapValue::toXml(KDSoapValue::Use use, const QString &messageNamesp
 
     return data;
 }
+
+KDSoapValue KDSoapValue::fromXml(QXmlStreamReader &reader)
+{
+    return KDSoapMessageReader::readElement(reader);
+}
@@ -27,6 +27,7 @@
 class KDSoapValueList;
 class KDSoapNamespacePrefixes;
 QT_BEGIN_NAMESPACE
+class QXmlStreamReader;
 class QXmlStreamWriter;
 QT_END_NAMESPACE
 
@@ -88,12 +89,37 @@ public:
      */
     KDSoapValue(const QString &name, const KDSoapValueList &childValues, const QString &typeNameSpace = QString(),
                 const QString &typeName = QString());
+    /**
+     * Constructs a "complex" value, taking over the child values from \p childValues.
+     * Unlike the constructor taking a const reference, this guarantees that later
+     * modifications of childValues() don't need to copy the list.
+     * \since 2.2
+     */
+    KDSoapValue(const QString &name, KDSoapValueList &&childValues, const QString &typeNameSpace = QString(), const QString &typeName = QString());
 
     /**
      * Copy constructor
      */
     KDSoapValue(const KDSoapValue &other);
 
+    /**
+     * Move constructor.
+     * \p other is left as a null value.
+     * \since 2.2
+     */
+    KDSoapValue(KDSoapValue &&other) noexcept;
+
+    /**
+     * Move assignment operator.
+     * \p other gets the previous contents of this value.
+     * \since 2.2
+     */
+    KDSoapValue &operator=(KDSoapValue &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
     /**
      * Assignment operator
      */
@@ -157,6 +183,11 @@ public:
      * Sets the \p value of the argument.
      */
     void setValue(const QVariant &value);
+    /**
+     * Sets the \p value of the argument, without copying it.
+     * \since 2.2
+     */
+    void setValue(QVariant &&value);
 
     /**
      * Whether the element should be qualified in the XML. See setQualified()
@@ -258,6 +289,22 @@ public:
      */
     KDSoapValueList split() const;
 
+    /**
+     * Parses the value as an xsd:list of numbers, e.g. "1.5 -2 3E4 INF", in a single pass,
+     * without splitting it into strings first (unlike split()).
+     * If an item isn't a valid xsd:double, an empty vector is returned and \p ok (if not null) is set to false.
+     * \since 2.2
+     */
+    QVector<double> toDoubleArray(bool *ok = nullptr) const;
+
+    /**
+     * Parses the value as an xsd:list of integers, e.g. "1 -2 +3", in a single pass.
+     * If an item isn't an integer or doesn't fit in a qint64, an empty vector is returned
+     * and \p ok (if not null) is set to false.
+     * \since 2.2
+     */
+    QVector<qint64> toInt64Array(bool *ok = nullptr) const;
+
     /**
      * Defines the way the message should be serialized.
      * See the "use" attribute for soap:body, in the WSDL file.
@@ -270,6 +317,52 @@ public:
 
     QByteArray toXml(Use use = LiteralUse, const QString &messageNamespace = QString()) const;
 
+    /**
+     * Reads a value from \p reader, which must be positioned on the start element of the value.
+     * The element, its attributes and its child elements are read, up to the matching end element.
+     *
+     * This is used by the code generated by kdwsdl2cpp for deserializing directly from the XML stream.
+     * \note Namespace declarations made by enclosing elements are not known here, so the namespace
+     * of an \c xsi:type attribute using such a prefix cannot be resolved.
+     * \since 2.2
+     */
+    static KDSoapValue fromXml(QXmlStreamReader &reader);
+
+    /**
+     * Writes this value as an XML element into \p writer, in literal use.
+     * As when sending a message, the element is qualified if isQualified() is true,
+     * or if its namespace isn't \p messageNamespace.
+     *
+     * This is used by the code generated by kdwsdl2cpp for serializing directly to XML.
+     * When called from the contents writer of a message being sent (see KDSoapMessage::setContentsWriter()),
+     * the settings of that message apply, e.g. binary values become MTOM attachments when enabled.
+     * \since 2.2
+     */
+    void writeXml(QXmlStreamWriter &writer, const QString &messageNamespace) const;
+
+    /**
+     * Writes the contents of this value (its attributes, child elements and text) into \p writer, in literal use.
+     * The start element must have been written already.
+     * \since 2.2
+     */
+    void writeXmlContents(QXmlStreamWriter &writer, const QString &messageNamespace) const;
+
+    /**
+     * Writes the start element \p name into \p writer, qualified with \p nameSpace
+     * if \p qualified is true or if \p nameSpace isn't \p messageNamespace, like writeXml() does.
+     * \since 2.2
+     */
+    static void writeXmlStartElement(QXmlStreamWriter &writer, const QString &nameSpace, const QString &name, bool qualified,
+                                     const QString &messageNamespace);
+
+    /**
+     * Writes the element \p name containing \p text into \p writer.
+     * \see writeXmlStartElement
+     * \since 2.2
+     */
+    static void writeXmlElement(QXmlStreamWriter &writer, const QString &nameSpace, const QString &name, bool qualified,
+                                const QString &messageNamespace, const QString &text);
+
 protected: // for KDSoapMessage
     void setName(const QString &name);
 
@@ -337,6 +430,12 @@ public:
      */
     void addArgument(const QString &argumentName, const QVariant &argumentValue, const QString &typeNameSpace = QString(),
                      const QString &typeName = QString());
+    /**
+     * Same as above, moving \p argumentValue into the new value.
+     * \since 2.2
+     */
+    void addArgument(const QString &argumentName, QVariant &&argumentValue, const QString &typeNameSpace = QString(),
+                     const QString &typeName = QString());
 
     /**
      * Convenience method for extracting a child argument by \p name.
@@ -347,6 +446,37 @@ public:
      */
     KDSoapValue child(const QString &name) const;
 
+    /**
+     * Returns the positions of all arguments called \p name, in document order.
+     *
+     * Unlike child(), which scans the list on every call, this builds a name index
+     * the first time it is called and reuses it for subsequent lookups, which makes
+     * deserializing wide types (types with many elements) linear rather than quadratic.
+     * The index is dropped automatically as soon as the list is modified.
+     *
+     * Note that keeping the index alive holds a reference to the list data, so
+     * modifying the list after calling this method causes it to be copied once.
+     * \since 2.2
+     */
+    QVector<int> childIndexes(const QString &name) const;
+
+    /**
+     * Returns the values of all the elements in this list as numbers, e.g. for the items of a SOAP array of xsd:double.
+     * This converts the whole array into contiguous storage at once, instead of converting each QVariant.
+     * If an element has no value, or a value which isn't a number, an empty vector is returned
+     * and \p ok (if not null) is set to false.
+     * \since 2.2
+     */
+    QVector<double> toDoubleArray(bool *ok = nullptr) const;
+
+    /**
+     * Returns the values of all the elements in this list as integers, e.g. for the items of a SOAP array of xsd:int.
+     * If an element has no value, or a value which isn't an integer fitting in a qint64, an empty vector
+     * is returned and \p ok (if not null) is set to false.
+     * \since 2.2
+     */
+    QVector<qint64> toInt64Array(bool *ok = nullptr) const;
+
     /**
      * Sets the type of the elements in this array.
      *
@@ -388,7 +518,7 @@ private:
     QPair<QString, QString> m_arrayType;
     QList<KDSoapValue> m_attributes;
 
-    QVariant d; // for extensions
+    mutable QVariant d; // for extensions (currently: the cached name index used by childIndexes())
 };
 
 typedef QListIterator<KDSoapValue> KDSoapValueListIterator;
@@ -0,0 +1,141 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapValueArena_p.h"
+
+#include <QAtomicInt>
+#include <QVector>
+
+#include <cstdlib>
+#include <new>
+
+// Every block starts with a header pointing to its region (or null for heap blocks),
+// padded so that the object after it is suitably aligned.
+static const std::size_t s_headerSize = alignof(std::max_align_t) > sizeof(void *) ? alignof(std::max_align_t) : sizeof(void *);
+static const std::size_t s_chunkSize = 16 * 1024;
+
+static std::size_t alignedSize(std::size_t size)
+{
+    return (size + s_headerSize - 1) / s_headerSize * s_headerSize;
+}
+
+class KDSoapValueArenaRegion
+{
+public:
+    KDSoapValueArenaRegion()
+        : m_ref(1)
+        , m_current(nullptr)
+        , m_available(0)
+    {
+    }
+    ~KDSoapValueArenaRegion()
+    {
+        for (char *chunk : qAsConst(m_chunks)) {
+            std::free(chunk);
+        }
+    }
+
+    // Only called from the thread which has this region in scope
+    void *allocate(std::size_t size)
+    {
+        const std::size_t needed = s_headerSize + alignedSize(size);
+        if (needed > m_available) {
+            const std::size_t chunkSize = needed > s_chunkSize ? needed : s_chunkSize;
+            char *chunk = static_cast<char *>(std::malloc(chunkSize));
+            if (!chunk) {
+                throw std::bad_alloc();
+            }
+            m_chunks.append(chunk);
+            m_current = chunk;
+            m_available = chunkSize;
+        }
+        char *block = m_current;
+        m_current += needed;
+        m_available -= needed;
+        *reinterpret_cast<KDSoapValueArenaRegion **>(block) = this;
+        m_ref.ref();
+        return block + s_headerSize;
+    }
+
+    void deref()
+    {
+        if (!m_ref.deref()) {
+            delete this;
+        }
+    }
+
+private:
+    QAtomicInt m_ref; // one for the arena, one per allocated block
+    QVector<char *> m_chunks;
+    char *m_current;
+    std::size_t m_available;
+};
+
+static thread_local KDSoapValueArenaRegion *s_currentRegion = nullptr;
+#ifdef KDSOAP_COUNT_VALUE_ALLOCATIONS
+static thread_local quint64 s_allocationCount = 0;
+#endif
+
+KDSoapValueArena::KDSoapValueArena()
+    : m_region(new KDSoapValueArenaRegion)
+{
+}
+
+KDSoapValueArena::~KDSoapValueArena()
+{
+    m_region->deref();
+}
+
+KDSoapValueArena::Scope::Scope(KDSoapValueArena *arena)
+    : m_previous(s_currentRegion)
+{
+    s_currentRegion = arena ? arena->m_region : nullptr;
+}
+
+KDSoapValueArena::Scope::~Scope()
+{
+    s_currentRegion = m_previous;
+}
+
+void *KDSoapValueArena::allocate(std::size_t size)
+{
+#ifdef KDSOAP_COUNT_VALUE_ALLOCATIONS
+    ++s_allocationCount;
+#endif
+    if (s_currentRegion) {
+        return s_currentRegion->allocate(size);
+    }
+    char *block = static_cast<char *>(std::malloc(s_headerSize + size));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<KDSoapValueArenaRegion **>(block) = nullptr;
+    return block + s_headerSize;
+}
+
+#ifdef KDSOAP_COUNT_VALUE_ALLOCATIONS
+quint64 KDSoapValueArena::allocationCount()
+{
+    return s_allocationCount;
+}
+#endif
+
+void KDSoapValueArena::deallocate(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    char *block = static_cast<char *>(ptr) - s_headerSize;
+    KDSoapValueArenaRegion *region = *reinterpret_cast<KDSoapValueArenaRegion **>(block);
+    if (region) {
+        region->deref();
+    } else {
+        std::free(block);
+    }
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPVALUEARENA_P_H
+#define KDSOAPVALUEARENA_P_H
+
+#include "KDSoapGlobal.h"
+
+#include <cstddef>
+
+class KDSoapValueArenaRegion;
+
+/**
+ * \internal
+ * A monotonic memory region for the KDSoapValues of one message.
+ *
+ * While a KDSoapValueArena::Scope is alive, the KDSoapValues created in that thread
+ * are allocated from the arena, one after the other, instead of individually on the heap.
+ * Each of them keeps the region alive: the memory is released in one go, when the arena
+ * and all the values allocated from it are gone (typically once the request was answered).
+ * Values can still be copied, modified and destroyed from any thread.
+ *
+ * Only the values themselves go into the region; their names, strings, child lists and attributes
+ * are allocated by Qt, which has no allocator hook for them. Since the region is released as a whole,
+ * a single value retained after the message was handled keeps all of it alive.
+ */
+class KDSOAP_EXPORT KDSoapValueArena
+{
+public:
+    KDSoapValueArena();
+    ~KDSoapValueArena();
+
+    /**
+     * Makes this arena the one used for new KDSoapValues in the current thread,
+     * until the scope is destroyed.
+     */
+    class KDSOAP_EXPORT Scope
+    {
+    public:
+        explicit Scope(KDSoapValueArena *arena);
+        ~Scope();
+
+    private:
+        Q_DISABLE_COPY(Scope)
+        KDSoapValueArenaRegion *m_previous;
+    };
+
+    /**
+     * Allocates \p size bytes from the arena of the current thread, if any, otherwise from the heap.
+     */
+    static void *allocate(std::size_t size);
+    /**
+     * Releases memory returned by allocate(), from any thread.
+     */
+    static void deallocate(void *ptr);
+#ifdef KDSOAP_COUNT_VALUE_ALLOCATIONS
+    /**
+     * Returns the number of values allocated so far by the current thread,
+     * including copies made when a shared value is detached.
+     * Only available when building the unittests.
+     */
+    static quint64 allocationCount();
+#endif
+
+private:
+    Q_DISABLE_COPY(KDSoapValueArena)
+    KDSoapValueArenaRegion *m_region;
+};
+
+#endif // KDSOAPVALUEARENA_P_H
@@ -18,10 +18,13 @@ class KDSoapDelayedResponseHandleData : public QSharedData
 public:
     KDSoapDelayedResponseHandleData(KDSoapServerSocket *s)
         : socket(s)
+        , http2StreamId(0)
     {
     }
     // QPointer in case the client disconnects during a delayed response
     QPointer<KDSoapServerSocket> socket;
+    // The stream to answer, on an HTTP/2 connection
+    quint32 http2StreamId;
 };
 
 KDSoapDelayedResponseHandle::KDSoapDelayedResponseHandle()
@@ -49,10 +52,15 @@ KDSoapDelayedResponseHandle::~KDSoapDelayedResponseHandle()
 KDSoapDelayedResponseHandle::KDSoapDelayedResponseHandle(KDSoapServerSocket *socket)
     : data(new KDSoapDelayedResponseHandleData(socket))
 {
-    socket->setResponseDelayed();
+    data->http2StreamId = socket->setResponseDelayed();
 }
 
 KDSoapServerSocket *KDSoapDelayedResponseHandle::serverSocket() const
 {
     return data->socket;
 }
+
+quint32 KDSoapDelayedResponseHandle::http2StreamId() const
+{
+    return data->http2StreamId;
+}
@@ -38,6 +38,7 @@ private:
     friend class KDSoapServerObjectInterface;
     explicit KDSoapDelayedResponseHandle(KDSoapServerSocket *socket);
     KDSoapServerSocket *serverSocket() const;
+    quint32 http2StreamId() const;
     QSharedDataPointer<KDSoapDelayedResponseHandleData> data;
 };
 
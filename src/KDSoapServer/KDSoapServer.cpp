@@ -29,6 +29,9 @@ public:
         , m_logLevel(KDSoapServer::LogNothing)
         , m_path(QString::fromLatin1("/"))
         , m_maxConnections(-1)
+        , m_compressionThreshold(-1)
+        , m_compressionLevel(-1)
+        , m_maxDecompressedRequestSize(64 * 1024 * 1024)
         , m_portBeforeSuspend(0)
     {
     }
@@ -53,6 +56,9 @@ public:
     QString m_wsdlPathInUrl;
     QString m_path;
     int m_maxConnections;
+    int m_compressionThreshold;
+    int m_compressionLevel;
+    int m_maxDecompressedRequestSize;
 
     QHostAddress m_addressBeforeSuspend;
     quint16 m_portBeforeSuspend;
@@ -338,6 +344,42 @@ int KDSoapServer::maxConnections() const
     return d->m_maxConnections;
 }
 
+void KDSoapServer::setCompressionThreshold(int bytes)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_compressionThreshold = bytes;
+}
+
+int KDSoapServer::compressionThreshold() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_compressionThreshold;
+}
+
+void KDSoapServer::setCompressionLevel(int level)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_compressionLevel = level;
+}
+
+int KDSoapServer::compressionLevel() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_compressionLevel;
+}
+
+void KDSoapServer::setMaxDecompressedRequestSize(int bytes)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_maxDecompressedRequestSize = bytes;
+}
+
+int KDSoapServer::maxDecompressedRequestSize() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_maxDecompressedRequestSize;
+}
+
 void KDSoapServer::setFeatures(Features features)
 {
     QMutexLocker lock(&d->m_serverDataMutex);
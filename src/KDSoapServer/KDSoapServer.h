@@ -47,8 +47,16 @@ public:
     {
         Public = 0, ///< HTTP with no ssl and no authentication needed (default)
         Ssl = 1, ///< HTTPS
-        AuthRequired = 2 ///< Requires authentication. Currently not implemented, patches welcome.
-                         // bitfield, next item is 4
+        AuthRequired = 2, ///< Requires authentication. Currently not implemented, patches welcome.
+        ArenaAllocation = 4, ///< Allocates the values of each request from a single memory region, released in one go once the
+                             ///< request is done, instead of node by node. Only the value nodes are in the region: their names,
+                             ///< strings, child lists and attributes are still allocated by Qt. A value kept after the request
+                             ///< (e.g. stored by the server object) keeps the whole region alive. Since KDSoap 2.2.
+        Http2 = 8 ///< Accepts HTTP/2 connections, from clients using "prior knowledge" over plain TCP, and offers HTTP/2
+                  ///< with ALPN over TLS. The requests of a connection are handled one after the other by its server object,
+                  ///< and their responses are sent as soon as they are ready, multiplexed on the connection: a delayed
+                  ///< response doesn't hold up the other requests. Since KDSoap 2.2.
+                  // bitfield, next item is 16
     };
     Q_DECLARE_FLAGS(Features, Feature)
 
@@ -184,6 +192,55 @@ public:
      */
     int maxConnections() const;
 
+    /**
+     * Sets the size, in bytes, from which the responses are compressed, for the clients which accept it:
+     * the response is then sent in the gzip or deflate encoding, whichever the client prefers in its Accept-Encoding header.
+     * MTOM responses, and responses with attachments streamed from a QIODevice, are never compressed.
+     *
+     * The special value -1 (the default) disables the compression of responses.
+     * Compression requires KD Soap to be built with zlib.
+     *
+     * Requests compressed with gzip or deflate (Content-Encoding header) are always accepted, and decompressed as they are received,
+     * up to maxDecompressedRequestSize().
+     * \since 2.2
+     */
+    void setCompressionThreshold(int bytes);
+
+    /**
+     * Returns the size from which the responses are compressed, as set by setCompressionThreshold.
+     * \since 2.2
+     */
+    int compressionThreshold() const;
+
+    /**
+     * Sets the compression level used for the responses, from 1 (fastest) to 9 (smallest).
+     * The special value -1 (the default) uses the default level of zlib (6).
+     * \since 2.2
+     */
+    void setCompressionLevel(int level);
+
+    /**
+     * Returns the compression level used for the responses, as set by setCompressionLevel.
+     * \since 2.2
+     */
+    int compressionLevel() const;
+
+    /**
+     * Sets the maximum size, in bytes, of the body of a compressed request once decompressed. A request which
+     * decompresses to more than that is answered with "413 Payload Too Large" and its connection is closed (only
+     * its stream, with HTTP/2), so that a small compressed request can't fill the memory of the server.
+     *
+     * The special value -1 disables the limit. The default is 64 MB.
+     * \since 2.2
+     */
+    void setMaxDecompressedRequestSize(int bytes);
+
+    /**
+     * Returns the maximum size of a decompressed request body, as set by setMaxDecompressedRequestSize.
+     * \since 2.2
+     */
+    int maxDecompressedRequestSize() const;
+
     /**
      * Sets the number of expected sockets (connections) in this process.
      * This is necessary in order to increase system limits when a large number of clients
@@ -0,0 +1,891 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapServerHttp2_p.h"
+
+#include <QIODevice>
+#include <QVector>
+
+namespace {
+
+enum FrameType {
+    DataFrame = 0x0,
+    HeadersFrame = 0x1,
+    PriorityFrame = 0x2,
+    RstStreamFrame = 0x3,
+    SettingsFrame = 0x4,
+    PushPromiseFrame = 0x5,
+    PingFrame = 0x6,
+    GoAwayFrame = 0x7,
+    WindowUpdateFrame = 0x8,
+    ContinuationFrame = 0x9
+};
+
+enum FrameFlag {
+    EndStreamFlag = 0x1,
+    AckFlag = 0x1,
+    EndHeadersFlag = 0x4,
+    PaddedFlag = 0x8,
+    PriorityFlag = 0x20
+};
+
+enum ErrorCode {
+    ProtocolError = 0x1,
+    InternalError = 0x2,
+    FlowControlError = 0x3,
+    FrameSizeError = 0x6,
+    RefusedStream = 0x7,
+    CompressionError = 0x9
+};
+
+enum Setting {
+    MaxConcurrentStreamsSetting = 0x3,
+    InitialWindowSizeSetting = 0x4,
+    MaxFrameSizeSetting = 0x5
+};
+
+const int s_frameHeaderSize = 9;
+// SETTINGS_MAX_FRAME_SIZE of the server, left at its default
+const int s_maxReceivedFrameSize = 16384;
+const int s_maxConcurrentStreams = 100;
+const int s_maxHeaderBlockSize = 64 * 1024;
+// Total size of the decoded fields of a block, against blocks repeating large indexed fields
+const int s_maxHeaderListSize = 256 * 1024;
+const qint64 s_maxWindowSize = 0x7fffffff;
+
+// RFC 7541, appendix A
+const char *const s_staticTable[][2] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+const int s_staticTableSize = sizeof(s_staticTable) / sizeof(s_staticTable[0]);
+
+// RFC 7541, appendix B: the code of each octet, most significant bit first
+const quint32 s_huffmanCodes[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+const quint8 s_huffmanCodeLengths[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+const quint32 s_eosCode = 0x3fffffff;
+const int s_eosCodeLength = 30;
+
+// A node of the Huffman decoding tree: for each bit, the next node, or -(symbol + 1) for a leaf
+struct HuffmanNode
+{
+    qint16 next[2] = {0, 0};
+};
+
+QVector<HuffmanNode> buildHuffmanTree()
+{
+    QVector<HuffmanNode> nodes(1);
+    for (int symbol = 0; symbol <= 256; ++symbol) {
+        const quint32 code = symbol < 256 ? s_huffmanCodes[symbol] : s_eosCode;
+        const int length = symbol < 256 ? s_huffmanCodeLengths[symbol] : s_eosCodeLength;
+        int node = 0;
+        for (int bit = length - 1; bit > 0; --bit) {
+            const int branch = (code >> bit) & 1;
+            if (nodes.at(node).next[branch] == 0) {
+                nodes[node].next[branch] = qint16(nodes.size());
+                nodes.append(HuffmanNode());
+            }
+            node = nodes.at(node).next[branch];
+        }
+        nodes[node].next[code & 1] = qint16(-(symbol + 1));
+    }
+    return nodes;
+}
+
+bool huffmanDecode(const uchar *data, int length, QByteArray *result)
+{
+    static const QVector<HuffmanNode> tree = buildHuffmanTree();
+    result->clear();
+    result->reserve(length * 8 / 5);
+    int node = 0;
+    int pendingBits = 0;
+    bool pendingOnes = true;
+    for (int i = 0; i < length; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            const int branch = (data[i] >> bit) & 1;
+            const int next = tree.at(node).next[branch];
+            ++pendingBits;
+            pendingOnes = pendingOnes && branch;
+            if (next < 0) {
+                const int symbol = -next - 1;
+                if (symbol == 256) {
+                    return false; // EOS must not be encoded
+                }
+                result->append(char(symbol));
+                node = 0;
+                pendingBits = 0;
+                pendingOnes = true;
+            } else {
+                node = next;
+            }
+        }
+    }
+    // The padding is made of the most significant bits of EOS, less than an octet
+    return pendingBits < 8 && pendingOnes;
+}
+
+bool decodeInteger(const uchar *&p, const uchar *end, int prefixBits, quint32 *value)
+{
+    if (p == end) {
+        return false;
+    }
+    const quint32 mask = (1u << prefixBits) - 1;
+    quint64 result = *p++ & mask;
+    if (result < mask) {
+        *value = quint32(result);
+        return true;
+    }
+    for (int shift = 0; p != end && shift <= 28; shift += 7) {
+        const uchar byte = *p++;
+        result += quint64(byte & 0x7f) << shift;
+        if (result > quint64(s_maxWindowSize)) {
+            return false;
+        }
+        if (!(byte & 0x80)) {
+            *value = quint32(result);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool decodeString(const uchar *&p, const uchar *end, QByteArray *string)
+{
+    if (p == end) {
+        return false;
+    }
+    const bool huffman = *p & 0x80;
+    quint32 length;
+    if (!decodeInteger(p, end, 7, &length) || length > quint32(end - p)) {
+        return false;
+    }
+    if (huffman) {
+        if (!huffmanDecode(p, int(length), string)) {
+            return false;
+        }
+    } else {
+        *string = QByteArray(reinterpret_cast<const char *>(p), int(length));
+    }
+    p += length;
+    return true;
+}
+
+void encodeInteger(uchar flags, int prefixBits, quint32 value, QByteArray *block)
+{
+    const quint32 mask = (1u << prefixBits) - 1;
+    if (value < mask) {
+        block->append(char(flags | value));
+        return;
+    }
+    block->append(char(flags | mask));
+    value -= mask;
+    while (value >= 0x80) {
+        block->append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    block->append(char(value));
+}
+
+void encodeString(const QByteArray &string, QByteArray *block)
+{
+    encodeInteger(0, 7, quint32(string.size()), block);
+    block->append(string);
+}
+
+void appendUInt32(quint32 value, QByteArray *data)
+{
+    data->append(char(value >> 24));
+    data->append(char(value >> 16));
+    data->append(char(value >> 8));
+    data->append(char(value));
+}
+
+quint32 readUInt32(const char *data)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+// The payload of a DATA or HEADERS frame, without the padding, or false if the padding is invalid
+bool removePadding(quint8 flags, const QByteArray &payload, int *start, int *end)
+{
+    *start = 0;
+    *end = payload.size();
+    if (flags & PaddedFlag) {
+        if (payload.isEmpty()) {
+            return false;
+        }
+        *start = 1;
+        *end -= uchar(payload.at(0));
+    }
+    return *start <= *end;
+}
+
+bool isConnectionSpecificHeader(const QByteArray &name)
+{
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" || name == "upgrade";
+}
+
+}
+
+bool KDSoapHpackDecoder::decode(const QByteArray &block, QList<HeaderField> *fields)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(block.constData());
+    const uchar *end = p + block.size();
+    bool fieldDecoded = false;
+    int headerListSize = 0;
+    while (p != end) {
+        const uchar first = *p;
+        HeaderField field;
+        if (first & 0x80) {
+            // Indexed header field
+            quint32 index;
+            if (!decodeInteger(p, end, 7, &index) || !lookup(index, &field)) {
+                return false;
+            }
+        } else if ((first & 0xe0) == 0x20) {
+            // Dynamic table size update, only allowed before the first field
+            quint32 size;
+            if (fieldDecoded || !decodeInteger(p, end, 5, &size) || size > 4096) {
+                return false;
+            }
+            m_maxDynamicTableSize = int(size);
+            evict(m_maxDynamicTableSize);
+            continue;
+        } else {
+            // Literal header field, with incremental indexing (01), without indexing (0000) or never indexed (0001)
+            const bool indexing = first & 0x40;
+            quint32 index;
+            if (!decodeInteger(p, end, indexing ? 6 : 4, &index)) {
+                return false;
+            }
+            if (index != 0) {
+                if (!lookup(index, &field)) {
+                    return false;
+                }
+            } else if (!decodeString(p, end, &field.first)) {
+                return false;
+            }
+            if (!decodeString(p, end, &field.second)) {
+                return false;
+            }
+            if (indexing) {
+                insert(field);
+            }
+        }
+        headerListSize += field.first.size() + field.second.size() + 32;
+        if (headerListSize > s_maxHeaderListSize) {
+            return false;
+        }
+        fields->append(field);
+        fieldDecoded = true;
+    }
+    return true;
+}
+
+bool KDSoapHpackDecoder::lookup(quint32 index, HeaderField *field) const
+{
+    if (index == 0) {
+        return false;
+    }
+    if (index <= quint32(s_staticTableSize)) {
+        *field = HeaderField(s_staticTable[index - 1][0], s_staticTable[index - 1][1]);
+        return true;
+    }
+    const quint32 dynamicIndex = index - s_staticTableSize - 1;
+    if (dynamicIndex >= quint32(m_dynamicTable.size())) {
+        return false;
+    }
+    *field = m_dynamicTable.at(int(dynamicIndex));
+    return true;
+}
+
+void KDSoapHpackDecoder::insert(const HeaderField &field)
+{
+    const int size = field.first.size() + field.second.size() + 32;
+    if (size > m_maxDynamicTableSize) {
+        // Not an error: the table is just emptied
+        evict(0);
+        return;
+    }
+    evict(m_maxDynamicTableSize - size);
+    m_dynamicTable.prepend(field);
+    m_dynamicTableSize += size;
+}
+
+void KDSoapHpackDecoder::evict(int maxSize)
+{
+    while (m_dynamicTableSize > maxSize) {
+        const HeaderField &oldest = m_dynamicTable.last();
+        m_dynamicTableSize -= oldest.first.size() + oldest.second.size() + 32;
+        m_dynamicTable.removeLast();
+    }
+}
+
+void KDSoapHpackDecoder::encodeField(const QByteArray &name, const QByteArray &value, QByteArray *block)
+{
+    // Literal header field without indexing, with the index of the name in the static table if it's there
+    quint32 nameIndex = 0;
+    for (int i = 0; i < s_staticTableSize && nameIndex == 0; ++i) {
+        if (name == s_staticTable[i][0]) {
+            nameIndex = quint32(i + 1);
+        }
+    }
+    encodeInteger(0, 4, nameIndex, block);
+    if (nameIndex == 0) {
+        encodeString(name, block);
+    }
+    encodeString(value, block);
+}
+
+QByteArray KDSoapHpackDecoder::encodeStatus(int statusCode)
+{
+    QByteArray block;
+    const QByteArray status = QByteArray::number(statusCode);
+    // :status 200 to 500, entries 8 to 14 of the static table
+    for (int i = 7; i < 14; ++i) {
+        if (status == s_staticTable[i][1]) {
+            encodeInteger(0x80, 7, quint32(i + 1), &block);
+            return block;
+        }
+    }
+    encodeField(":status", status, &block);
+    return block;
+}
+
+KDSoapServerHttp2Connection::KDSoapServerHttp2Connection(QIODevice *device)
+    : m_device(device)
+{
+    // The server preface
+    QByteArray settings;
+    settings.append(char(0));
+    settings.append(char(MaxConcurrentStreamsSetting));
+    appendUInt32(s_maxConcurrentStreams, &settings);
+    writeFrame(SettingsFrame, 0, 0, settings);
+}
+
+QByteArray KDSoapServerHttp2Connection::clientPreface()
+{
+    return QByteArrayLiteral("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+}
+
+bool KDSoapServerHttp2Connection::processData(const QByteArray &data)
+{
+    if (m_closed) {
+        return false;
+    }
+    m_buffer += data;
+    if (!m_prefaceReceived) {
+        const QByteArray preface = clientPreface();
+        if (m_buffer.size() < preface.size()) {
+            return true;
+        }
+        if (!m_buffer.startsWith(preface)) {
+            return connectionError(ProtocolError);
+        }
+        m_buffer.remove(0, preface.size());
+        m_prefaceReceived = true;
+    }
+
+    int pos = 0;
+    while (m_buffer.size() - pos >= s_frameHeaderSize) {
+        const uchar *header = reinterpret_cast<const uchar *>(m_buffer.constData()) + pos;
+        const int length = (int(header[0]) << 16) | (int(header[1]) << 8) | int(header[2]);
+        if (length > s_maxReceivedFrameSize) {
+            m_buffer.clear();
+            return connectionError(FrameSizeError);
+        }
+        if (m_buffer.size() - pos - s_frameHeaderSize < length) {
+            break; // incomplete frame, wait for more data
+        }
+        const quint8 type = header[3];
+        const quint8 flags = header[4];
+        const quint32 streamId = readUInt32(reinterpret_cast<const char *>(header) + 5) & 0x7fffffff;
+        const QByteArray payload = m_buffer.mid(pos + s_frameHeaderSize, length);
+        pos += s_frameHeaderSize + length;
+        if (!processFrame(type, flags, streamId, payload)) {
+            m_buffer.clear();
+            return false;
+        }
+    }
+    m_buffer.remove(0, pos);
+    return true;
+}
+
+bool KDSoapServerHttp2Connection::processFrame(quint8 type, quint8 flags, quint32 streamId, const QByteArray &payload)
+{
+    // A header block is sent as a contiguous sequence of frames
+    if (m_headerBlockStreamId != 0 && (type != ContinuationFrame || streamId != m_headerBlockStreamId)) {
+        return connectionError(ProtocolError);
+    }
+
+    switch (type) {
+    case DataFrame:
+        return processDataFrame(flags, streamId, payload);
+    case HeadersFrame:
+        return processHeaders(flags, streamId, payload);
+    case PriorityFrame:
+        return true;
+    case RstStreamFrame:
+        if (streamId == 0) {
+            return connectionError(ProtocolError);
+        }
+        // The request may have been handed over already, its response will be dropped
+        m_streams.remove(streamId);
+        return true;
+    case SettingsFrame:
+        return processSettings(flags, streamId, payload);
+    case PushPromiseFrame:
+        return connectionError(ProtocolError); // only sent by servers
+    case PingFrame:
+        if (streamId != 0) {
+            return connectionError(ProtocolError);
+        }
+        if (payload.size() != 8) {
+            return connectionError(FrameSizeError);
+        }
+        if (!(flags & AckFlag)) {
+            writeFrame(PingFrame, AckFlag, 0, payload);
+        }
+        return true;
+    case GoAwayFrame:
+        // The client won't open new streams, the pending ones are still answered
+        return true;
+    case WindowUpdateFrame:
+        return processWindowUpdate(streamId, payload);
+    case ContinuationFrame:
+        if (m_headerBlockStreamId == 0) {
+            return connectionError(ProtocolError);
+        }
+        m_headerBlock += payload;
+        if (m_headerBlock.size() > s_maxHeaderBlockSize) {
+            return connectionError(ProtocolError);
+        }
+        return !(flags & EndHeadersFlag) || processHeaderBlock();
+    default:
+        return true; // unknown frame types are ignored
+    }
+}
+
+bool KDSoapServerHttp2Connection::processHeaders(quint8 flags, quint32 streamId, const QByteArray &payload)
+{
+    // Streams opened by the client have odd ids
+    if (streamId == 0 || !(streamId & 1)) {
+        return connectionError(ProtocolError);
+    }
+    int start;
+    int end;
+    if (!removePadding(flags, payload, &start, &end)) {
+        return connectionError(ProtocolError);
+    }
+    if (flags & PriorityFlag) {
+        start += 5; // stream dependency and weight, ignored
+        if (start > end) {
+            return connectionError(ProtocolError);
+        }
+    }
+    m_headerBlockStreamId = streamId;
+    m_headerBlockEndStream = flags & EndStreamFlag;
+    m_headerBlock = payload.mid(start, end - start);
+    return !(flags & EndHeadersFlag) || processHeaderBlock();
+}
+
+bool KDSoapServerHttp2Connection::processHeaderBlock()
+{
+    const quint32 streamId = m_headerBlockStreamId;
+    m_headerBlockStreamId = 0;
+    // Decoded even if the stream is ignored, to keep the dynamic table in sync with the client
+    QList<KDSoapHpackDecoder::HeaderField> fields;
+    const bool decoded = m_decoder.decode(m_headerBlock, &fields);
+    m_headerBlock.clear();
+    if (!decoded) {
+        return connectionError(CompressionError);
+    }
+
+    QMap<quint32, Stream>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end()) {
+        if (streamId <= m_lastStreamId) {
+            return true; // a stream which was reset or answered already
+        }
+        m_lastStreamId = streamId;
+        if (m_streams.size() >= s_maxConcurrentStreams) {
+            QByteArray errorCode;
+            appendUInt32(RefusedStream, &errorCode);
+            writeFrame(RstStreamFrame, 0, streamId, errorCode);
+            return true;
+        }
+        Stream stream;
+        stream.fields = fields;
+        stream.sendWindow = m_initialSendWindow;
+        m_streams.insert(streamId, stream);
+    } else if (it->requestComplete) {
+        return true;
+    }
+    // Otherwise these are trailers, which are ignored, like the trailers of chunked HTTP/1.1 requests
+
+    if (m_headerBlockEndStream) {
+        completeRequest(streamId);
+    }
+    return true;
+}
+
+bool KDSoapServerHttp2Connection::processDataFrame(quint8 flags, quint32 streamId, const QByteArray &payload)
+{
+    if (streamId == 0) {
+        return connectionError(ProtocolError);
+    }
+    int start;
+    int end;
+    if (!removePadding(flags, payload, &start, &end)) {
+        return connectionError(ProtocolError);
+    }
+    // The data was read, the client can send as much again (padding included)
+    if (!payload.isEmpty()) {
+        writeWindowUpdate(0, quint32(payload.size()));
+    }
+    QMap<quint32, Stream>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end() || it->requestComplete) {
+        return true;
+    }
+    it->body.append(payload.constData() + start, end - start);
+    if (flags & EndStreamFlag) {
+        completeRequest(streamId);
+    } else if (!payload.isEmpty()) {
+        writeWindowUpdate(streamId, quint32(payload.size()));
+    }
+    return true;
+}
+
+bool KDSoapServerHttp2Connection::processSettings(quint8 flags, quint32 streamId, const QByteArray &payload)
+{
+    if (streamId != 0) {
+        return connectionError(ProtocolError);
+    }
+    if (flags & AckFlag) {
+        return payload.isEmpty() || connectionError(FrameSizeError);
+    }
+    if (payload.size() % 6 != 0) {
+        return connectionError(FrameSizeError);
+    }
+    for (int pos = 0; pos < payload.size(); pos += 6) {
+        const int id = (int(uchar(payload.at(pos))) << 8) | int(uchar(payload.at(pos + 1)));
+        const quint32 value = readUInt32(payload.constData() + pos + 2);
+        switch (id) {
+        case InitialWindowSizeSetting: {
+            if (value > quint32(s_maxWindowSize)) {
+                return connectionError(FlowControlError);
+            }
+            const qint64 delta = qint64(value) - m_initialSendWindow;
+            for (Stream &stream : m_streams) {
+                stream.sendWindow += delta;
+            }
+            m_initialSendWindow = value;
+            break;
+        }
+        case MaxFrameSizeSetting:
+            if (value < 16384 || value > 16777215) {
+                return connectionError(ProtocolError);
+            }
+            m_maxSendFrameSize = int(value);
+            break;
+        default:
+            break;
+        }
+    }
+    writeFrame(SettingsFrame, AckFlag, 0, QByteArray());
+    sendPendingData();
+    return true;
+}
+
+bool KDSoapServerHttp2Connection::processWindowUpdate(quint32 streamId, const QByteArray &payload)
+{
+    if (payload.size() != 4) {
+        return connectionError(FrameSizeError);
+    }
+    const quint32 increment = readUInt32(payload.constData()) & 0x7fffffff;
+    if (streamId == 0) {
+        if (increment == 0) {
+            return connectionError(ProtocolError);
+        }
+        m_connectionSendWindow += increment;
+        if (m_connectionSendWindow > s_maxWindowSize) {
+            return connectionError(FlowControlError);
+        }
+    } else {
+        QMap<quint32, Stream>::iterator it = m_streams.find(streamId);
+        if (it != m_streams.end()) {
+            it->sendWindow += increment;
+        }
+    }
+    sendPendingData();
+    return true;
+}
+
+void KDSoapServerHttp2Connection::completeRequest(quint32 streamId)
+{
+    Stream &stream = m_streams[streamId];
+    stream.requestComplete = true;
+
+    Request request;
+    request.streamId = streamId;
+    for (const KDSoapHpackDecoder::HeaderField &field : qAsConst(stream.fields)) {
+        QByteArray name = field.first;
+        if (name.startsWith(':')) {
+            if (name == ":method") {
+                name = "_requestType";
+            } else if (name == ":path") {
+                name = "_path";
+            } else if (name == ":authority") {
+                name = "host";
+            } else {
+                continue;
+            }
+        }
+        QMap<QByteArray, QByteArray>::iterator it = request.headers.find(name);
+        if (it == request.headers.end()) {
+            request.headers.insert(name, field.second);
+        } else {
+            // HTTP/2 clients may split cookies into several fields
+            *it += (name == "cookie" ? "; " : ", ") + field.second;
+        }
+    }
+    request.headers.insert("_httpVersion", "HTTP/2");
+    request.body = stream.body;
+    stream.fields.clear();
+    stream.body = QByteArray();
+    m_requests.enqueue(request);
+}
+
+void KDSoapServerHttp2Connection::sendResponse(quint32 streamId, const QByteArray &http1Response)
+{
+    QMap<quint32, Stream>::iterator it = m_streams.find(streamId);
+    if (m_closed || it == m_streams.end()) {
+        return; // reset by the client
+    }
+
+    QByteArray block;
+    QByteArray body;
+    const int headerEnd = http1Response.indexOf("\r\n\r\n");
+    if (headerEnd >= 0) {
+        const QList<QByteArray> lines = http1Response.left(headerEnd).split('\n');
+        const int statusCode = lines.first().split(' ').value(1).toInt();
+        block = KDSoapHpackDecoder::encodeStatus(statusCode >= 100 ? statusCode : 500);
+        for (int i = 1; i < lines.count(); ++i) {
+            const QByteArray &line = lines.at(i);
+            const int colon = line.indexOf(':');
+            if (colon <= 0) {
+                continue;
+            }
+            const QByteArray name = line.left(colon).trimmed().toLower();
+            if (!isConnectionSpecificHeader(name)) {
+                KDSoapHpackDecoder::encodeField(name, line.mid(colon + 1).trimmed(), &block);
+            }
+        }
+        body = http1Response.mid(headerEnd + 4);
+    } else {
+        // Nothing (valid) was written for this request
+        block = KDSoapHpackDecoder::encodeStatus(500);
+        KDSoapHpackDecoder::encodeField("content-length", "0", &block);
+    }
+
+    const bool endStream = body.isEmpty();
+    int pos = 0;
+    do {
+        const QByteArray fragment = block.mid(pos, m_maxSendFrameSize);
+        const bool first = pos == 0;
+        pos += fragment.size();
+        quint8 flags = pos >= block.size() ? quint8(EndHeadersFlag) : quint8(0);
+        if (first && endStream) {
+            flags |= EndStreamFlag;
+        }
+        writeFrame(first ? HeadersFrame : ContinuationFrame, flags, streamId, fragment);
+    } while (pos < block.size());
+
+    if (endStream) {
+        m_streams.erase(it);
+        return;
+    }
+    it->response = body;
+    it->responding = true;
+    sendPendingData();
+}
+
+void KDSoapServerHttp2Connection::resetStream(quint32 streamId)
+{
+    if (m_closed || !m_streams.remove(streamId)) {
+        return; // reset by the client
+    }
+    QByteArray errorCode;
+    appendUInt32(InternalError, &errorCode);
+    writeFrame(RstStreamFrame, 0, streamId, errorCode);
+}
+
+void KDSoapServerHttp2Connection::sendPendingData()
+{
+    QMap<quint32, Stream>::iterator it = m_streams.begin();
+    while (it != m_streams.end() && m_connectionSendWindow > 0) {
+        Stream &stream = it.value();
+        if (stream.responding) {
+            while (stream.responseSent < stream.response.size() && stream.sendWindow > 0 && m_connectionSendWindow > 0) {
+                const qint64 window = qMin(stream.sendWindow, m_connectionSendWindow);
+                const int size = int(qMin<qint64>(qMin<qint64>(stream.response.size() - stream.responseSent, m_maxSendFrameSize), window));
+                const bool last = stream.responseSent + size == stream.response.size();
+                writeFrame(DataFrame, last ? quint8(EndStreamFlag) : quint8(0), it.key(), stream.response.mid(stream.responseSent, size));
+                stream.responseSent += size;
+                stream.sendWindow -= size;
+                m_connectionSendWindow -= size;
+            }
+            if (stream.responseSent == stream.response.size()) {
+                it = m_streams.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+}
+
+bool KDSoapServerHttp2Connection::connectionError(quint32 errorCode)
+{
+    QByteArray payload;
+    appendUInt32(m_lastStreamId, &payload);
+    appendUInt32(errorCode, &payload);
+    writeFrame(GoAwayFrame, 0, 0, payload);
+    m_closed = true;
+    return false;
+}
+
+void KDSoapServerHttp2Connection::writeFrame(quint8 type, quint8 flags, quint32 streamId, const QByteArray &payload)
+{
+    QByteArray frame;
+    frame.reserve(s_frameHeaderSize + payload.size());
+    frame.append(char(payload.size() >> 16));
+    frame.append(char(payload.size() >> 8));
+    frame.append(char(payload.size()));
+    frame.append(char(type));
+    frame.append(char(flags));
+    appendUInt32(streamId, &frame);
+    frame += payload;
+    m_device->write(frame);
+}
+
+void KDSoapServerHttp2Connection::writeWindowUpdate(quint32 streamId, quint32 increment)
+{
+    QByteArray payload;
+    appendUInt32(increment, &payload);
+    writeFrame(WindowUpdateFrame, 0, streamId, payload);
+}
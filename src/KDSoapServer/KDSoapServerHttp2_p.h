@@ -0,0 +1,136 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPSERVERHTTP2_P_H
+#define KDSOAPSERVERHTTP2_P_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QPair>
+#include <QtCore/QQueue>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+/**
+ * \internal
+ * HPACK (RFC 7541) decoder, for the header blocks received on an HTTP/2 connection.
+ */
+class KDSoapHpackDecoder
+{
+public:
+    typedef QPair<QByteArray, QByteArray> HeaderField;
+
+    // Appends the fields of block to fields. Returns false on a compression error, which is fatal to the connection.
+    bool decode(const QByteArray &block, QList<HeaderField> *fields);
+
+    // Encodes a field as a literal which doesn't change the state of the decoder at the other end
+    static void encodeField(const QByteArray &name, const QByteArray &value, QByteArray *block);
+    static QByteArray encodeStatus(int statusCode);
+
+private:
+    bool lookup(quint32 index, HeaderField *field) const;
+    void insert(const HeaderField &field);
+    void evict(int maxSize);
+
+    QList<HeaderField> m_dynamicTable; // newest first
+    int m_dynamicTableSize = 0;
+    int m_maxDynamicTableSize = 4096; // at most SETTINGS_HEADER_TABLE_SIZE, which the server leaves at its default
+};
+
+/**
+ * \internal
+ * The server side of an HTTP/2 (RFC 7540) connection, started by the client with the connection preface,
+ * either directly over TCP ("prior knowledge") or after negotiating "h2" with ALPN over TLS.
+ *
+ * The requests are handed over one by one, with the same headers as HTTP/1.1 requests, so that
+ * KDSoapServerSocket handles them the same way; the responses, written as HTTP/1.1 responses, are
+ * sent back as HEADERS and DATA frames, within the flow control windows of the client.
+ */
+class KDSoapServerHttp2Connection
+{
+public:
+    struct Request
+    {
+        quint32 streamId = 0;
+        // Like the headers of an HTTP/1.1 request: _requestType, _path (not cleaned), _httpVersion, and lowercase names
+        QMap<QByteArray, QByteArray> headers;
+        QByteArray body;
+    };
+
+    explicit KDSoapServerHttp2Connection(QIODevice *device);
+
+    // "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", the first bytes sent by HTTP/2 clients
+    static QByteArray clientPreface();
+
+    // Processes the received frames. Returns false on a connection error: GOAWAY was sent, the connection should be closed.
+    bool processData(const QByteArray &data);
+
+    bool hasRequest() const
+    {
+        return !m_requests.isEmpty();
+    }
+    Request takeRequest()
+    {
+        return m_requests.dequeue();
+    }
+
+    // Sends the response of streamId, given in the HTTP/1.1 format
+    void sendResponse(quint32 streamId, const QByteArray &http1Response);
+    // Closes streamId with an INTERNAL_ERROR, when its response can't be sent
+    void resetStream(quint32 streamId);
+
+private:
+    struct Stream
+    {
+        QList<KDSoapHpackDecoder::HeaderField> fields;
+        QByteArray body;
+        bool requestComplete = false;
+        qint64 sendWindow = 0;
+        QByteArray response;
+        int responseSent = 0;
+        bool responding = false;
+    };
+
+    bool processFrame(quint8 type, quint8 flags, quint32 streamId, const QByteArray &payload);
+    bool processHeaders(quint8 flags, quint32 streamId, const QByteArray &payload);
+    bool processHeaderBlock();
+    bool processDataFrame(quint8 flags, quint32 streamId, const QByteArray &payload);
+    bool processSettings(quint8 flags, quint32 streamId, const QByteArray &payload);
+    bool processWindowUpdate(quint32 streamId, const QByteArray &payload);
+    void completeRequest(quint32 streamId);
+    bool connectionError(quint32 errorCode);
+
+    void writeFrame(quint8 type, quint8 flags, quint32 streamId, const QByteArray &payload);
+    void writeWindowUpdate(quint32 streamId, quint32 increment);
+    void sendPendingData();
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    bool m_prefaceReceived = false;
+    bool m_closed = false;
+    KDSoapHpackDecoder m_decoder;
+    QMap<quint32, Stream> m_streams; // open streams, by id, so that responses are sent in order
+    quint32 m_lastStreamId = 0;
+    QQueue<Request> m_requests;
+
+    // Header block being received in HEADERS and CONTINUATION frames
+    quint32 m_headerBlockStreamId = 0;
+    bool m_headerBlockEndStream = false;
+    QByteArray m_headerBlock;
+
+    // Settings of the client
+    qint64 m_initialSendWindow = 65535;
+    int m_maxSendFrameSize = 16384;
+    qint64 m_connectionSendWindow = 65535;
+};
+
+#endif // KDSOAPSERVERHTTP2_P_H
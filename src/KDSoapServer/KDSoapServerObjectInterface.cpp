@@ -185,7 +185,7 @@ void KDSoapServerObjectInterface::sendDelayedResponse(const KDSoapDelayedRespons
 {
     KDSoapServerSocket *socket = responseHandle.serverSocket();
     if (socket) {
-        socket->sendDelayedReply(this, response);
+        socket->sendDelayedReply(this, response, responseHandle.http2StreamId());
     }
 }
 
@@ -10,14 +10,19 @@
 #include "KDSoapServer.h"
 #include "KDSoapServerAuthInterface.h"
 #include "KDSoapServerCustomVerbRequestInterface.h"
+#include "KDSoapServerHttp2_p.h"
 #include "KDSoapServerObjectInterface.h"
 #include "KDSoapServerRawXMLInterface.h"
 #include "KDSoapServerSocket_p.h"
 #include "KDSoapSocketList_p.h"
+#include <KDSoapClient/KDSoapCompression_p.h>
 #include <KDSoapClient/KDSoapMessage.h>
 #include <KDSoapClient/KDSoapMessageReader_p.h>
 #include <KDSoapClient/KDSoapMessageWriter_p.h>
+#include <KDSoapClient/KDSoapMultipart_p.h>
 #include <KDSoapClient/KDSoapNamespaceManager.h>
+#include <KDSoapClient/KDSoapStreamingBody_p.h>
+#include <KDSoapClient/KDSoapTrace_p.h>
 #include <QBuffer>
 #include <QDir>
 #include <QFile>
@@ -27,6 +32,8 @@
 #include <QVarLengthArray>
 
 static const char s_forbidden[] = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+static const char s_badRequest[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+static const char s_payloadTooLarge[] = "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\n"; // without the end of the headers
 
 KDSoapServerSocket::KDSoapServerSocket(KDSoapSocketList *owner, QObject *serverObject)
 #ifndef QT_NO_SSL
@@ -44,9 +51,11 @@ KDSoapServerSocket::KDSoapServerSocket(KDSoapSocketList *owner, QObject *serverO
     , m_useRawXML(false)
     , m_bytesReceived(0)
     , m_chunkStart(0)
+    , m_requestUsedMtom(false)
+    , m_http2StreamId(0)
+    , m_http2ResponseAborted(false)
 {
     connect(this, &QIODevice::readyRead, this, &KDSoapServerSocket::slotReadyRead);
-    m_doDebug = qEnvironmentVariableIsSet("KDSOAP_DEBUG");
 }
 
 // The socket is deleted when it emits disconnected() (see KDSoapSocketList::handleIncomingConnection).
@@ -56,6 +65,20 @@ KDSoapServerSocket::~KDSoapServerSocket()
     emit socketDeleted(this);
 }
 
+// Grammar from https://datatracker.ietf.org/doc/html/rfc7230#section-5.3.1
+//  origin-form    = absolute-path [ "?" query ]
+// and https://datatracker.ietf.org/doc/html/rfc3986#section-3.3
+// says the path ends at the first '?' or '#' character
+static QByteArray cleanRequestPath(const QByteArray &target)
+{
+    const int queryPos = target.indexOf('?');
+    const QByteArray path = queryPos >= 0 ? target.left(queryPos) : target;
+    const QByteArray query = queryPos >= 0 ? target.mid(queryPos) : QByteArray();
+    // Unfortunately QDir::cleanPath works with QString
+    const QByteArray cleanedPath = QDir::cleanPath(QString::fromUtf8(path)).toUtf8();
+    return cleanedPath + query;
+}
+
 typedef QMap<QByteArray, QByteArray> HeadersMap;
 static HeadersMap parseHeaders(const QByteArray &headerData)
 {
@@ -72,17 +95,7 @@ static HeadersMap parseHeaders(const QByteArray &headerData)
     const QByteArray &requestType = firstLine.at(0);
     headersMap.insert("_requestType", requestType);
 
-    // Grammar from https://datatracker.ietf.org/doc/html/rfc7230#section-5.3.1
-    //  origin-form    = absolute-path [ "?" query ]
-    // and https://datatracker.ietf.org/doc/html/rfc3986#section-3.3
-    // says the path ends at the first '?' or '#' character
-    const QByteArray arg1 = firstLine.at(1);
-    const int queryPos = arg1.indexOf('?');
-    const QByteArray path = queryPos >= 0 ? arg1.left(queryPos) : arg1;
-    const QByteArray query = queryPos >= 0 ? arg1.mid(queryPos) : QByteArray();
-    // Unfortunately QDir::cleanPath works with QString
-    const QByteArray cleanedPath = QDir::cleanPath(QString::fromUtf8(path)).toUtf8();
-    headersMap.insert("_path", cleanedPath + query);
+    headersMap.insert("_path", cleanRequestPath(firstLine.at(1)));
 
     const QByteArray &httpVersion = firstLine.at(2);
     headersMap.insert("_httpVersion", httpVersion);
@@ -123,7 +136,27 @@ static QByteArray stripQuotes(const QByteArray &bar)
     return bar;
 }
 
-static QByteArray httpResponseHeaders(bool fault, const QByteArray &contentType, int responseDataSize, QObject *serverObject)
+// For KDSoapTrace: the request line, then the headers
+static QList<QPair<QByteArray, QByteArray>> traceHeaders(const QMap<QByteArray, QByteArray> &httpHeaders)
+{
+    QList<QPair<QByteArray, QByteArray>> headers;
+    headers.append(qMakePair(QByteArray(), httpHeaders.value("_requestType") + ' ' + httpHeaders.value("_path")));
+    for (auto it = httpHeaders.constBegin(); it != httpHeaders.constEnd(); ++it) {
+        if (!it.key().startsWith('_')) {
+            headers.append(qMakePair(it.key(), it.value()));
+        }
+    }
+    return headers;
+}
+
+// For KDSoapTrace: the status line and headers of a response, as written
+static QList<QPair<QByteArray, QByteArray>> traceHeaders(const QByteArray &httpResponseHeaders)
+{
+    return {qMakePair(QByteArray(), httpResponseHeaders.trimmed())};
+}
+
+static QByteArray httpResponseHeaders(bool fault, const QByteArray &contentType, qint64 responseDataSize, QObject *serverObject,
+                                      const QByteArray &contentEncoding = QByteArray())
 {
     QByteArray httpResponse;
     httpResponse.reserve(50);
@@ -141,6 +174,11 @@ static QByteArray httpResponseHeaders(bool fault, const QByteArray &contentType,
     httpResponse += "\r\nContent-Length: ";
     httpResponse += QByteArray::number(responseDataSize);
     httpResponse += "\r\n";
+    if (!contentEncoding.isEmpty()) {
+        httpResponse += "Content-Encoding: ";
+        httpResponse += contentEncoding;
+        httpResponse += "\r\n";
+    }
 
     KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(serverObject);
     if (serverObjectInterface) {
@@ -163,6 +201,22 @@ void KDSoapServerSocket::slotReadyRead()
         return;
     }
 
+    // HTTP/2 clients start the connection with a preface, which can't be mistaken for an HTTP/1.1 request
+    if (!m_http2 && m_httpHeaders.isEmpty() && m_requestBuffer.isEmpty() && m_owner->server()->features().testFlag(KDSoapServer::Http2)) {
+        const QByteArray preface = KDSoapServerHttp2Connection::clientPreface();
+        const QByteArray start = peek(preface.size());
+        if (!start.isEmpty() && preface.startsWith(start)) {
+            if (start.size() < preface.size()) {
+                return; // wait for the rest of the preface
+            }
+            m_http2.reset(new KDSoapServerHttp2Connection(this));
+        }
+    }
+    if (m_http2) {
+        handleHttp2Data();
+        return;
+    }
+
     // QNAM in Qt 5.x tends to connect additional sockets in advance and not use them
     // So only count the sockets which actually sent us data (for the servertest unittest).
     if (!m_receivedData) {
@@ -199,6 +253,14 @@ void KDSoapServerSocket::slotReadyRead()
         // Leave only the actual data in the buffer
         m_requestBuffer = receivedData;
         m_bytesReceived = receivedData.size();
+        m_acceptEncoding = m_httpHeaders.value("accept-encoding");
+        if (!setupRequestDecoding(m_httpHeaders)) {
+            // The body can't be read, and therefore skipped: close the connection after replying
+            write(unsupportedEncodingResponse() + "Connection: close\r\n\r\n");
+            disconnectFromHost();
+            setSocketEnabled(false);
+            return;
+        }
         m_useRawXML = false;
         if (rawXmlInterface) {
             KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(m_serverObject);
@@ -207,15 +269,26 @@ void KDSoapServerSocket::slotReadyRead()
         }
     }
 
-    if (m_doDebug) {
-        qDebug() << "headers:" << m_httpHeaders;
-        qDebug() << "data received:" << m_requestBuffer;
+    if (KDSoapTrace::isEnabled()) {
+        kdsoapTraceMessage(m_requestBuffer, traceHeaders(m_httpHeaders));
     }
 
     if (m_httpHeaders.value("transfer-encoding") != "chunked") {
         if (m_useRawXML) {
-            rawXmlInterface->processXML(m_requestBuffer);
+            const QByteArray xmlChunk = decodeRequestData(m_requestBuffer);
+            if (isRequestTooLarge()) {
+                rejectTooLargeRequest();
+                return;
+            }
+            rawXmlInterface->processXML(xmlChunk);
+            m_requestBuffer.clear();
+        } else if (m_requestInflater) {
+            m_decodedRequestBuffer += decodeRequestData(m_requestBuffer);
             m_requestBuffer.clear();
+            if (isRequestTooLarge()) {
+                rejectTooLargeRequest();
+                return;
+            }
         }
 
         const QByteArray contentLength = m_httpHeaders.value("content-length");
@@ -223,11 +296,14 @@ void KDSoapServerSocket::slotReadyRead()
             return; // incomplete request, wait for more data
         }
 
-        if (m_useRawXML) {
+        if (!isRequestDecoded()) {
+            write(s_badRequest);
+        } else if (m_useRawXML) {
             rawXmlInterface->endRequest();
         } else {
-            handleRequest(m_httpHeaders, m_requestBuffer);
+            handleRequest(m_httpHeaders, m_requestInflater ? m_decodedRequestBuffer : m_requestBuffer);
         }
+        m_decodedRequestBuffer.clear();
     } else {
         // qDebug() << "requestBuffer has " << m_requestBuffer.size() << "bytes, starting at" << m_chunkStart;
         while (m_chunkStart >= 0) {
@@ -240,8 +316,7 @@ void KDSoapServerSocket::slotReadyRead()
             bool ok;
             int chunkSize = chunkSizeStr.toInt(&ok, 16);
             if (!ok) {
-                const QByteArray badRequest = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
-                write(badRequest);
+                write(s_badRequest);
                 return;
             }
             if (chunkSize == 0) { // done!
@@ -252,7 +327,11 @@ void KDSoapServerSocket::slotReadyRead()
             if (nextEOL + 2 + chunkSize + 2 >= m_requestBuffer.size()) {
                 return; // not enough data, chunk is incomplete
             }
-            const QByteArray chunk = m_requestBuffer.mid(nextEOL + 2, chunkSize);
+            const QByteArray chunk = decodeRequestData(m_requestBuffer.mid(nextEOL + 2, chunkSize));
+            if (isRequestTooLarge()) {
+                rejectTooLargeRequest();
+                return;
+            }
             if (m_useRawXML) {
                 rawXmlInterface->processXML(chunk);
             } else {
@@ -264,7 +343,9 @@ void KDSoapServerSocket::slotReadyRead()
         if (!m_requestBuffer.contains("\r\n\r\n")) {
             return;
         }
-        if (m_useRawXML) {
+        if (!isRequestDecoded()) {
+            write(s_badRequest);
+        } else if (m_useRawXML) {
             rawXmlInterface->endRequest();
         } else {
             handleRequest(m_httpHeaders, m_decodedRequestBuffer);
@@ -274,13 +355,155 @@ void KDSoapServerSocket::slotReadyRead()
     }
     m_requestBuffer.clear();
     m_httpHeaders.clear();
+    m_requestInflater.reset();
     m_receivedData = false;
 }
 
+QByteArray KDSoapServerSocket::unsupportedEncodingResponse()
+{
+    // RFC 7694: list the supported encodings, and leave the end of the headers to the caller
+    return "HTTP/1.1 415 Unsupported Media Type\r\nAccept-Encoding: " + QByteArray(KDSoapCompression::isAvailable() ? "gzip, deflate" : "identity")
+        + "\r\nContent-Length: 0\r\n";
+}
+
+bool KDSoapServerSocket::setupRequestDecoding(const QMap<QByteArray, QByteArray> &httpHeaders)
+{
+    m_requestInflater.reset();
+    KDSoapCompression::Encoding encoding;
+    if (!KDSoapCompression::parseContentEncoding(httpHeaders.value("content-encoding"), &encoding)) {
+        return false;
+    }
+    if (encoding != KDSoapCompression::Identity) {
+        m_requestInflater.reset(new KDSoapInflater(encoding));
+        m_requestInflater->setMaxSize(m_owner->server()->maxDecompressedRequestSize());
+    }
+    return true;
+}
+
+QByteArray KDSoapServerSocket::decodeRequestData(const QByteArray &data)
+{
+    if (!m_requestInflater) {
+        return data;
+    }
+    // Invalid data is reported once the request is complete, see isRequestDecoded()
+    QByteArray decoded;
+    m_requestInflater->inflate(data, &decoded);
+    return decoded;
+}
+
+bool KDSoapServerSocket::isRequestDecoded() const
+{
+    return !m_requestInflater || m_requestInflater->isFinished();
+}
+
+bool KDSoapServerSocket::isRequestTooLarge() const
+{
+    return m_requestInflater && m_requestInflater->isTooLarge();
+}
+
+// The rest of the body would have to be decompressed to find the next request, so the connection is closed
+void KDSoapServerSocket::rejectTooLargeRequest()
+{
+    write(QByteArray(s_payloadTooLarge) + "Connection: close\r\n\r\n");
+    disconnectFromHost();
+    setSocketEnabled(false);
+}
+
+void KDSoapServerSocket::handleHttp2Data()
+{
+    if (!m_http2->processData(readAll())) {
+        disconnectFromHost();
+        return;
+    }
+
+    KDSoapServerRawXMLInterface *rawXmlInterface = qobject_cast<KDSoapServerRawXMLInterface *>(m_serverObject);
+    // The requests are handled one after the other, like those sent over several HTTP/1.1 connections to the same thread.
+    // Unlike with HTTP/1.1, a delayed response doesn't disable the socket: the frames of the other streams are still
+    // read and their requests handled, the delayed response is sent whenever sendDelayedReply() is called.
+    while (m_socketEnabled && m_http2->hasRequest()) {
+        KDSoapServerHttp2Connection::Request request = m_http2->takeRequest();
+        m_owner->increaseConnectionCount();
+        request.headers.insert("_path", cleanRequestPath(request.headers.value("_path")));
+        if (KDSoapTrace::isEnabled()) {
+            kdsoapTraceMessage(request.body, traceHeaders(request.headers));
+        }
+
+        // From here on, what is written is the response of this stream
+        m_http2StreamId = request.streamId;
+        m_acceptEncoding = request.headers.value("accept-encoding");
+        if (!setupRequestDecoding(request.headers)) {
+            write(unsupportedEncodingResponse() + "\r\n");
+            finishHttp2Response();
+            continue;
+        }
+        request.body = decodeRequestData(request.body);
+        const bool tooLarge = isRequestTooLarge();
+        const bool decoded = isRequestDecoded();
+        m_requestInflater.reset();
+        if (tooLarge) {
+            write(QByteArray(s_payloadTooLarge) + "\r\n");
+            finishHttp2Response();
+            continue;
+        }
+        if (!decoded) {
+            write(s_badRequest);
+            finishHttp2Response();
+            continue;
+        }
+        bool useRawXML = false;
+        if (rawXmlInterface) {
+            KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(m_serverObject);
+            serverObjectInterface->setServerSocket(this);
+            useRawXML = rawXmlInterface->newRequest(request.headers.value("_requestType"), request.headers);
+        }
+        if (useRawXML) {
+            rawXmlInterface->processXML(request.body);
+            rawXmlInterface->endRequest();
+        } else {
+            handleRequest(request.headers, request.body);
+        }
+        if (m_delayedResponse) {
+            // The state of the call was saved by setResponseDelayed()
+            m_delayedResponse = false;
+            m_http2StreamId = 0;
+            m_http2Response = QByteArray();
+        } else {
+            finishHttp2Response();
+        }
+    }
+}
+
+void KDSoapServerSocket::finishHttp2Response()
+{
+    const quint32 streamId = m_http2StreamId;
+    m_http2StreamId = 0; // the frames are written to the socket
+    if (m_http2ResponseAborted) {
+        m_http2->resetStream(streamId);
+        m_http2ResponseAborted = false;
+    } else {
+        m_http2->sendResponse(streamId, m_http2Response);
+    }
+    m_http2Response = QByteArray();
+}
+
+qint64 KDSoapServerSocket::writeData(const char *data, qint64 len)
+{
+    if (m_http2StreamId != 0) {
+        m_http2Response.append(data, int(len));
+        return len;
+    }
+#ifndef QT_NO_SSL
+    return QSslSocket::writeData(data, len);
+#else
+    return QTcpSocket::writeData(data, len);
+#endif
+}
+
 void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpHeaders, const QByteArray &receivedData)
 {
     const QByteArray requestType = httpHeaders.value("_requestType");
     const QString path = QString::fromLatin1(httpHeaders.value("_path").constData());
+    m_requestUsedMtom = false;
 
     if (!path.startsWith(QLatin1String("/"))) {
         // denied for security reasons (ex: path starting with "..")
@@ -346,11 +569,28 @@ void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpH
         return;
     }
 
+    KDSoapMessageReader reader;
+    reader.setUseArena(m_owner->server()->features().testFlag(KDSoapServer::ArenaAllocation));
+
+    QByteArray contentType = httpHeaders.value("content-type");
+    QByteArray envelope = receivedData;
+    m_requestUsedMtom = KDSoapMultipart::isMultipartRelated(contentType);
+    if (m_requestUsedMtom) {
+        // MTOM: the envelope is the root part, the attachments keep pointing into receivedData.
+        // From here on, contentType is the type of the envelope.
+        QHash<QString, KDSoapAttachment> attachments;
+        if (!KDSoapMultipart::parse(httpHeaders.value("content-type"), receivedData, &envelope, &contentType, &attachments)) {
+            handleError(replyMsg, "Client.Data", QString::fromLatin1("Invalid multipart/related request"));
+            sendReply(serverObjectInterface, replyMsg);
+            return;
+        }
+        reader.setXopAttachments(attachments);
+    }
+
     // parse message
     KDSoapMessage requestMsg;
     KDSoapHeaders requestHeaders;
-    KDSoapMessageReader reader;
-    KDSoapMessageReader::XmlError err = reader.xmlToMessage(receivedData, &requestMsg, &m_messageNamespace, &requestHeaders, KDSoap::SOAP1_1);
+    KDSoapMessageReader::XmlError err = reader.xmlToMessage(envelope, &requestMsg, &m_messageNamespace, &requestHeaders, KDSoap::SOAP1_1);
     if (err == KDSoapMessageReader::PrematureEndOfDocumentError) {
         // qDebug() << "Incomplete SOAP message, wait for more data";
         // This should never happen, since we check for content-size above.
@@ -359,7 +599,6 @@ void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpH
 
     // check soap version and extract soapAction header
     QByteArray soapAction;
-    const QByteArray contentType = httpHeaders.value("content-type");
     if (contentType.startsWith("text/xml")) { // krazy:exclude=strings
         // SOAP 1.1
         soapAction = httpHeaders.value("soapaction");
@@ -385,7 +624,10 @@ void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpH
 
     if (serverObjectInterface && m_delayedResponse) {
         // Delayed response. Disable the socket to make sure we don't handle another call at the same time.
-        setSocketEnabled(false);
+        // HTTP/2 streams are independent of each other, see handleHttp2Data().
+        if (!m_http2) {
+            setSocketEnabled(false);
+        }
     } else {
         sendReply(serverObjectInterface, replyMsg);
     }
@@ -422,58 +664,152 @@ bool KDSoapServerSocket::handleFileDownload(KDSoapServerObjectInterface *serverO
         return true; // handled!
     }
     const QByteArray response = httpResponseHeaders(false, contentType, device->size(), m_serverObject);
-    if (m_doDebug) {
-        qDebug() << "KDSoapServerSocket: file download response" << response;
+    if (KDSoapTrace::isEnabled()) {
+        kdsoapTraceMessage(QByteArray(), traceHeaders(response));
     }
     qint64 written = write(response);
     Q_ASSERT(written == response.size()); // Please report a bug if you hit this.
     Q_UNUSED(written);
 
+    if (!writeDevice(device)) {
+        abortResponse();
+    }
+
+    delete device;
+    // TODO log the file request, if logging is enabled?
+    return true;
+}
+
+bool KDSoapServerSocket::writeDevice(QIODevice *device)
+{
     char block[4096] = {0};
-    // qint64 totalRead = 0;
     while (!device->atEnd()) {
         const qint64 in = device->read(block, sizeof(block));
         if (in <= 0) {
-            break;
+            return false;
         }
-        // totalRead += in;
         if (in != write(block, in)) {
-            // error = true;
-            break;
+            return false;
         }
     }
-    // if (totalRead != device->size()) {
-    //    // Unable to read from the source.
-    //    error = true;
-    //}
-
-    delete device;
-    // TODO log the file request, if logging is enabled?
     return true;
 }
 
+// The Content-Length of the response was sent already, but reading its body failed (e.g. an attachment):
+// closing the connection (just the stream, with HTTP/2) is the only way to let the client know.
+void KDSoapServerSocket::abortResponse()
+{
+    qWarning("KDSoapServerSocket: error while writing the response, closing the connection");
+    if (m_http2) {
+        m_http2ResponseAborted = true;
+        return;
+    }
+    disconnectFromHost();
+    setSocketEnabled(false);
+}
+
 void KDSoapServerSocket::writeXML(const QByteArray &xmlResponse, bool isFault)
 {
-    const QByteArray httpHeaders = httpResponseHeaders(isFault, "text/xml", xmlResponse.size(),
-                                                       m_serverObject); // TODO return application/soap+xml;charset=utf-8 instead for SOAP 1.2
-    if (m_doDebug) {
-        qDebug() << "KDSoapServerSocket: writing" << httpHeaders << xmlResponse;
+    // Compress the response if it's large enough and the client accepts it
+    KDSoapServer *server = m_owner->server();
+    const int compressionThreshold = server->compressionThreshold();
+    KDSoapCompression::Encoding encoding = KDSoapCompression::Identity;
+    QByteArray compressedResponse;
+    if (compressionThreshold >= 0 && !xmlResponse.isEmpty() && xmlResponse.size() >= compressionThreshold) {
+        encoding = KDSoapCompression::negotiate(m_acceptEncoding);
+        if (encoding != KDSoapCompression::Identity) {
+            compressedResponse = KDSoapCompression::compress(xmlResponse, encoding, server->compressionLevel());
+            if (compressedResponse.isEmpty()) {
+                encoding = KDSoapCompression::Identity;
+            }
+        }
+    }
+    const QByteArray &responseData = encoding == KDSoapCompression::Identity ? xmlResponse : compressedResponse;
+    const QByteArray contentEncoding = encoding == KDSoapCompression::Identity ? QByteArray() : KDSoapCompression::encodingName(encoding);
+
+    const QByteArray httpHeaders = httpResponseHeaders(isFault, "text/xml", responseData.size(), m_serverObject,
+                                                       contentEncoding); // TODO return application/soap+xml;charset=utf-8 instead for SOAP 1.2
+    if (KDSoapTrace::isEnabled()) {
+        kdsoapTraceMessage(xmlResponse, traceHeaders(httpHeaders));
     }
     qint64 written = write(httpHeaders);
     Q_ASSERT(written == httpHeaders.size()); // Please report a bug if you hit this.
-    written = write(xmlResponse);
-    Q_ASSERT(written == xmlResponse.size()); // Please report a bug if you hit this.
+    written = write(responseData);
+    Q_ASSERT(written == responseData.size()); // Please report a bug if you hit this.
     Q_UNUSED(written);
     // flush() ?
 }
 
+void KDSoapServerSocket::writeStreamedXML(const QByteArray &xmlResponse, bool isFault, const QVector<KDSoapStreamedAttachment> &attachments)
+{
+    KDSoapStreamingBody body(xmlResponse, attachments);
+    body.open(QIODevice::ReadOnly);
+    const QByteArray httpHeaders = httpResponseHeaders(isFault, "text/xml", body.size(), m_serverObject);
+    if (KDSoapTrace::isEnabled()) {
+        kdsoapTraceMessage(xmlResponse, traceHeaders(httpHeaders)); // without the attachments
+    }
+    write(httpHeaders);
+    if (!writeDevice(&body)) {
+        abortResponse();
+    }
+}
+
+void KDSoapServerSocket::writeMultipartXML(const QByteArray &xmlResponse, bool isFault, const QVector<KDSoapAttachment> &attachments)
+{
+    const QByteArray soapContentType = "text/xml";
+    const QByteArray boundary = KDSoapMultipart::generateBoundary();
+    const QByteArray rootHeader = KDSoapMultipart::rootPartHeader(soapContentType, boundary);
+    const QByteArray closeDelimiter = KDSoapMultipart::closeDelimiter(boundary);
+
+    // The Content-Length has to be known up front: sequential devices are read in memory first
+    QVector<QByteArray> partHeaders;
+    QVector<QByteArray> partData;
+    partHeaders.reserve(attachments.size());
+    partData.reserve(attachments.size());
+    qint64 size = rootHeader.size() + xmlResponse.size() + closeDelimiter.size();
+    for (const KDSoapAttachment &attachment : attachments) {
+        partHeaders.append(KDSoapMultipart::attachmentPartHeader(attachment, boundary));
+        QByteArray data;
+        size += partHeaders.last().size() + KDSoapMultipart::prepareForSending(attachment, &data);
+        partData.append(data);
+    }
+
+    const QByteArray httpHeaders = httpResponseHeaders(isFault, KDSoapMultipart::contentType(soapContentType, boundary), size, m_serverObject);
+    if (KDSoapTrace::isEnabled()) {
+        kdsoapTraceMessage(xmlResponse, traceHeaders(httpHeaders)); // without the attachments
+    }
+    write(httpHeaders);
+    write(rootHeader);
+    write(xmlResponse);
+    for (int i = 0; i < attachments.size(); ++i) {
+        write(partHeaders.at(i));
+        if (partData.at(i).isNull()) {
+            if (!writeDevice(attachments.at(i).device())) {
+                abortResponse();
+                return;
+            }
+        } else {
+            write(partData.at(i));
+        }
+    }
+    write(closeDelimiter);
+}
+
 void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg)
 {
     const bool isFault = replyMsg.isFault();
 
-    QByteArray xmlResponse;
+    QByteArray &xmlResponse = m_owner->responseBuffer();
+    xmlResponse.resize(0);
+    QVector<KDSoapAttachment> attachments;
+    QVector<KDSoapStreamedAttachment> streamedAttachments;
     if (!replyMsg.isNull()) {
         KDSoapMessageWriter msgWriter;
+        if (m_requestUsedMtom) {
+            msgWriter.setXopAttachments(&attachments);
+        } else {
+            msgWriter.setStreamedAttachments(&streamedAttachments);
+        }
         // Note that the kdsoap client parsing code doesn't care for the name (except if it's fault), even in
         // Document mode. Other implementations do, though.
         QString responseName = isFault ? QString::fromLatin1("Fault") : replyMsg.name();
@@ -489,10 +825,19 @@ void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInte
             }
         }
         msgWriter.setMessageNamespace(responseNamespace);
-        xmlResponse = msgWriter.messageToXml(replyMsg, responseName, responseHeaders, QMap<QString, KDSoapMessage>());
+        msgWriter.messageToXml(xmlResponse, m_owner->responseSizeHint(m_method), replyMsg, responseName, responseHeaders,
+                               QMap<QString, KDSoapMessage>());
+        m_owner->setResponseSizeHint(m_method, xmlResponse.size());
     }
 
-    writeXML(xmlResponse, isFault);
+    if (m_requestUsedMtom) {
+        writeMultipartXML(xmlResponse, isFault, attachments);
+    } else if (!streamedAttachments.isEmpty()) {
+        writeStreamedXML(xmlResponse, isFault, streamedAttachments);
+    } else {
+        writeXML(xmlResponse, isFault);
+    }
+    m_owner->releaseResponseBuffer();
 
     // All done, check if we should log this
     KDSoapServer *server = m_owner->server();
@@ -510,16 +855,58 @@ void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInte
     }
 }
 
-void KDSoapServerSocket::sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg)
+void KDSoapServerSocket::sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg, quint32 http2StreamId)
 {
+    if (m_http2) {
+        const auto it = m_delayedCalls.find(http2StreamId);
+        if (it == m_delayedCalls.end()) {
+            return; // answered already
+        }
+        // Another stream may be handled right now, e.g. when its handler sends this delayed response
+        const CallState current = callState();
+        setCallState(it.value());
+        m_delayedCalls.erase(it);
+        sendReply(serverObjectInterface, replyMsg);
+        finishHttp2Response();
+        setCallState(current);
+        return;
+    }
     sendReply(serverObjectInterface, replyMsg);
     m_delayedResponse = false;
     setSocketEnabled(true);
 }
 
-void KDSoapServerSocket::setResponseDelayed()
+quint32 KDSoapServerSocket::setResponseDelayed()
 {
     m_delayedResponse = true;
+    if (m_http2) {
+        m_delayedCalls.insert(m_http2StreamId, callState());
+    }
+    return m_http2StreamId;
+}
+
+KDSoapServerSocket::CallState KDSoapServerSocket::callState() const
+{
+    CallState state;
+    state.messageNamespace = m_messageNamespace;
+    state.method = m_method;
+    state.requestUsedMtom = m_requestUsedMtom;
+    state.acceptEncoding = m_acceptEncoding;
+    state.http2StreamId = m_http2StreamId;
+    state.http2Response = m_http2Response;
+    state.http2ResponseAborted = m_http2ResponseAborted;
+    return state;
+}
+
+void KDSoapServerSocket::setCallState(const CallState &state)
+{
+    m_messageNamespace = state.messageNamespace;
+    m_method = state.method;
+    m_requestUsedMtom = state.requestUsedMtom;
+    m_acceptEncoding = state.acceptEncoding;
+    m_http2StreamId = state.http2StreamId;
+    m_http2Response = state.http2Response;
+    m_http2ResponseAborted = state.http2ResponseAborted;
 }
 
 void KDSoapServerSocket::handleError(KDSoapMessage &replyMsg, const char *errorCode, const QString &error)
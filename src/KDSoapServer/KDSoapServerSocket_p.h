@@ -17,14 +17,21 @@
 #include <QSslSocket>
 #endif
 
+#include <QHash>
 #include <QMap>
+#include <QScopedPointer>
+#include <QVector>
 QT_BEGIN_NAMESPACE
 class QObject;
 QT_END_NAMESPACE
+class KDSoapAttachment;
+struct KDSoapStreamedAttachment;
 class KDSoapSocketList;
 class KDSoapServerObjectInterface;
 class KDSoapMessage;
 class KDSoapHeaders;
+class KDSoapServerHttp2Connection;
+class KDSoapInflater;
 
 class KDSoapServerSocket
 #ifndef QT_NO_SSL
@@ -38,17 +45,44 @@ public:
     KDSoapServerSocket(KDSoapSocketList *owner, QObject *serverObject);
     ~KDSoapServerSocket();
 
-    void setResponseDelayed();
-    void sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg);
+    // Returns the HTTP/2 stream whose response is delayed, 0 with HTTP/1.1
+    quint32 setResponseDelayed();
+    void sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg, quint32 http2StreamId);
     void sendReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg);
 Q_SIGNALS:
     void socketDeleted(KDSoapServerSocket *);
 
+protected:
+    qint64 writeData(const char *data, qint64 len) override;
+
 private Q_SLOTS:
     void slotReadyRead();
 
 private:
+    // What sendReply() needs to know about the call being answered
+    struct CallState
+    {
+        QString messageNamespace;
+        QString method;
+        bool requestUsedMtom;
+        QByteArray acceptEncoding;
+        quint32 http2StreamId;
+        QByteArray http2Response;
+        bool http2ResponseAborted;
+    };
+    CallState callState() const;
+    void setCallState(const CallState &state);
+
+    void handleHttp2Data();
+    void finishHttp2Response();
     void handleRequest(const QMap<QByteArray, QByteArray> &headers, const QByteArray &receivedData);
+    static QByteArray unsupportedEncodingResponse();
+    // Prepares the decompression of the request body, returns false if its Content-Encoding isn't supported
+    bool setupRequestDecoding(const QMap<QByteArray, QByteArray> &httpHeaders);
+    QByteArray decodeRequestData(const QByteArray &data);
+    bool isRequestDecoded() const;
+    bool isRequestTooLarge() const;
+    void rejectTooLargeRequest();
     bool handleWsdlDownload();
     bool handleFileDownload(KDSoapServerObjectInterface *serverObjectInterface, const QString &path);
     void makeCall(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &requestMsg, KDSoapMessage &replyMsg,
@@ -56,12 +90,15 @@ private:
     void handleError(KDSoapMessage &replyMsg, const char *errorCode, const QString &error);
     void setSocketEnabled(bool enabled);
     void writeXML(const QByteArray &xmlResponse, bool isFault);
+    void writeMultipartXML(const QByteArray &xmlResponse, bool isFault, const QVector<KDSoapAttachment> &attachments);
+    void writeStreamedXML(const QByteArray &xmlResponse, bool isFault, const QVector<KDSoapStreamedAttachment> &attachments);
+    bool writeDevice(QIODevice *device);
+    void abortResponse();
     friend class KDSoapServerObjectInterface;
 
     KDSoapSocketList *m_owner;
     QObject *m_serverObject;
     bool m_delayedResponse;
-    bool m_doDebug;
     bool m_socketEnabled;
     bool m_receivedData;
 
@@ -71,11 +108,21 @@ private:
     int m_chunkStart;
     QMap<QByteArray, QByteArray> m_httpHeaders;
     QByteArray m_requestBuffer;
-    QByteArray m_decodedRequestBuffer; // used for chunked transfer encoding only
+    QByteArray m_decodedRequestBuffer; // used for chunked transfer encoding and compressed requests only
+    QScopedPointer<KDSoapInflater> m_requestInflater; // for compressed requests
 
     // Data for the current call (stored here for delayed replies)
     QString m_messageNamespace;
     QString m_method;
+    bool m_requestUsedMtom; // reply with MTOM as well
+    QByteArray m_acceptEncoding; // the encodings the client accepts for the response
+
+    // HTTP/2 connection, if the client started one
+    QScopedPointer<KDSoapServerHttp2Connection> m_http2;
+    quint32 m_http2StreamId; // the stream being answered, whose response is collected in m_http2Response
+    QByteArray m_http2Response;
+    bool m_http2ResponseAborted; // the stream is reset instead of being answered
+    QHash<quint32, CallState> m_delayedCalls; // by stream: the other streams are handled while their response is delayed
 };
 
 #endif // KDSOAPSERVERSOCKET_P_H
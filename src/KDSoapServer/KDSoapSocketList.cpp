@@ -26,6 +26,15 @@ KDSoapSocketList::~KDSoapSocketList()
     delete m_serverObject;
 }
 
+void KDSoapSocketList::releaseResponseBuffer()
+{
+    // Don't keep the memory of an unusually large response around
+    static const int s_maxRetainedSize = 1024 * 1024;
+    if (m_responseBuffer.capacity() > s_maxRetainedSize) {
+        m_responseBuffer = QByteArray();
+    }
+}
+
 KDSoapServerSocket *KDSoapSocketList::handleIncomingConnection(int socketDescriptor)
 {
     KDSoapServerSocket *socket = new KDSoapServerSocket(this, m_serverObject);
@@ -38,6 +47,11 @@ KDSoapServerSocket *KDSoapSocketList::handleIncomingConnection(int socketDescrip
         if (!m_server->sslConfiguration().isNull()) {
             socket->setSslConfiguration(m_server->sslConfiguration());
         }
+        if (m_server->features() & KDSoapServer::Http2) {
+            QSslConfiguration sslConfiguration = socket->sslConfiguration();
+            sslConfiguration.setAllowedNextProtocols(QList<QByteArray>() << QByteArrayLiteral("h2") << QSslConfiguration::NextProtocolHttp1_1);
+            socket->setSslConfiguration(sslConfiguration);
+        }
         socket->startServerEncryption();
     }
 #endif
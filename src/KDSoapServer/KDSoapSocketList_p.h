@@ -10,6 +10,7 @@
 #ifndef KDSOAPSOCKETLIST_P_H
 #define KDSOAPSOCKETLIST_P_H
 
+#include <QHash>
 #include <QObject>
 #include <QSet>
 QT_BEGIN_NAMESPACE
@@ -40,6 +41,22 @@ public:
         return m_server;
     }
 
+    // All sockets of this list live in the same thread, they share the buffer used for writing responses
+    QByteArray &responseBuffer()
+    {
+        return m_responseBuffer;
+    }
+    void releaseResponseBuffer();
+
+    int responseSizeHint(const QString &method) const
+    {
+        return m_responseSizeHints.value(method);
+    }
+    void setResponseSizeHint(const QString &method, int size)
+    {
+        m_responseSizeHints.insert(method, size);
+    }
+
 public Q_SLOTS:
     void socketDeleted(KDSoapServerSocket *socket);
 
@@ -48,6 +65,8 @@ private:
     QObject *m_serverObject;
     QSet<KDSoapServerSocket *> m_sockets;
     QAtomicInt m_totalConnectionCount;
+    QByteArray m_responseBuffer;
+    QHash<QString, int> m_responseSizeHints;
 };
 
 #endif // KDSOAPSOCKETLIST_P_H
@@ -12,6 +12,8 @@
 #include "KDSoapValue.h"
 #include <QTest>
 
+#include <limits>
+
 class Basic : public QObject
 {
     Q_OBJECT
@@ -52,6 +54,89 @@ private Q_SLOTS:
         kdt.setTimeZone(QString::fromLatin1("+01:00"));
         QCOMPARE(kdt.toDateString(), QString::fromLatin1("2011-03-15T23:59:59.999+01:00"));
     }
+
+    void testNumericArrays()
+    {
+        bool ok = false;
+        const KDSoapValue doubles(QLatin1String("list"), QString::fromLatin1("  1.5 -2\t3E4 .5 NaN -INF\n"));
+        const QVector<double> numbers = doubles.toDoubleArray(&ok);
+        QVERIFY(ok);
+        QCOMPARE(numbers.count(), 6);
+        QCOMPARE(numbers.at(0), 1.5);
+        QCOMPARE(numbers.at(1), -2.0);
+        QCOMPARE(numbers.at(2), 30000.0);
+        QCOMPARE(numbers.at(3), 0.5);
+        QVERIFY(qIsNaN(numbers.at(4)));
+        QVERIFY(qIsInf(numbers.at(5)) && numbers.at(5) < 0);
+        QVERIFY(KDSoapValue(QLatin1String("list"), QString()).toDoubleArray(&ok).isEmpty());
+        QVERIFY(ok);
+        QVERIFY(KDSoapValue(QLatin1String("list"), QString::fromLatin1("1 inf")).toDoubleArray(&ok).isEmpty());
+        QVERIFY(!ok);
+        QVERIFY(KDSoapValue(QLatin1String("list"), QString::fromLatin1("1 2,5")).toDoubleArray(&ok).isEmpty());
+        QVERIFY(!ok);
+
+        const KDSoapValue integers(QLatin1String("list"), QString::fromLatin1("7 -21 +30 9223372036854775807 -9223372036854775808"));
+        const QVector<qint64> expected = {7, -21, 30, std::numeric_limits<qint64>::max(), std::numeric_limits<qint64>::min()};
+        QCOMPARE(integers.toInt64Array(&ok), expected);
+        QVERIFY(ok);
+        QVERIFY(KDSoapValue(QLatin1String("list"), QString::fromLatin1("9223372036854775808")).toInt64Array(&ok).isEmpty());
+        QVERIFY(!ok);
+        QVERIFY(KDSoapValue(QLatin1String("list"), QString::fromLatin1("1 2.5")).toInt64Array(&ok).isEmpty());
+        QVERIFY(!ok);
+        QVERIFY(KDSoapValue(QLatin1String("list"), QString::fromLatin1("-")).toInt64Array(&ok).isEmpty());
+        QVERIFY(!ok);
+
+        // Array items: text, or values already converted with use=encoded
+        KDSoapValueList items;
+        items.addArgument(QLatin1String("item"), QString::fromLatin1(" 4 "));
+        items.addArgument(QLatin1String("item"), 5);
+        items.addArgument(QLatin1String("item"), qlonglong(6));
+        QCOMPARE(items.toInt64Array(&ok), QVector<qint64>({4, 5, 6}));
+        QVERIFY(ok);
+        QCOMPARE(items.toDoubleArray(&ok), QVector<double>({4, 5, 6}));
+        QVERIFY(ok);
+        items.addArgument(QLatin1String("item"), QVariant());
+        QVERIFY(items.toDoubleArray(&ok).isEmpty());
+        QVERIFY(!ok);
+    }
+
+    void benchmarkNumericList_data()
+    {
+        QTest::addColumn<bool>("typedArray");
+        QTest::newRow("split") << false;
+        QTest::newRow("toDoubleArray") << true;
+    }
+
+    // What the generated code for an xsd:list of doubles does, for 100000 numbers
+    void benchmarkNumericList()
+    {
+        QFETCH(bool, typedArray);
+        QString text;
+        for (int i = 0; i < 100000; ++i) {
+            text += QString::number(i * 0.37 - 1500.125) + QLatin1Char(' ');
+        }
+        const KDSoapValue value(QLatin1String("list"), text);
+        QList<double> entries;
+        if (typedArray) {
+            QBENCHMARK {
+                entries.clear();
+                const QVector<double> numbers = value.toDoubleArray();
+                entries.reserve(numbers.count());
+                for (double number : numbers) {
+                    entries.append(number);
+                }
+            }
+        } else {
+            QBENCHMARK {
+                entries.clear();
+                const KDSoapValueList list = value.split();
+                for (int i = 0; i < list.count(); ++i) {
+                    entries.append(list.at(i).value().value<double>());
+                }
+            }
+        }
+        QCOMPARE(entries.count(), 100000);
+    }
 };
 
 QTEST_MAIN(Basic)
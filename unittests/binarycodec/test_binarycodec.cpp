@@ -0,0 +1,162 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapBinaryCodec.h"
+#include "KDSoapNamespaceManager.h"
+#include "KDSoapValue.h"
+#include <QTest>
+
+// Deterministic pseudo-random data, covering all byte values
+static QByteArray binaryData(int size)
+{
+    QByteArray data;
+    data.resize(size);
+    quint32 seed = 42;
+    for (int i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = char(seed >> 16);
+    }
+    return data;
+}
+
+class BinaryCodecTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRoundTrip_data()
+    {
+        QTest::addColumn<int>("size");
+        // Around the 12 (base64) and 8 (hex) bytes processed at once
+        for (int size : {0, 1, 2, 3, 7, 8, 9, 11, 12, 13, 15, 16, 17, 23, 24, 25, 100, 1000, 4099}) {
+            QTest::newRow(QByteArray::number(size).constData()) << size;
+        }
+    }
+
+    void testRoundTrip()
+    {
+        QFETCH(int, size);
+        const QByteArray data = binaryData(size);
+
+        const QString base64 = KDSoapBinaryCodec::toBase64(data);
+        QCOMPARE(base64, QString::fromLatin1(data.toBase64()));
+        QCOMPARE(KDSoapBinaryCodec::fromBase64(base64), data);
+        const QByteArray base64Latin1 = base64.toLatin1();
+        QCOMPARE(KDSoapBinaryCodec::fromBase64(base64Latin1.constData(), base64Latin1.size()), data);
+
+        const QString hex = KDSoapBinaryCodec::toHex(data);
+        QCOMPARE(hex, QString::fromLatin1(data.toHex()));
+        QCOMPARE(KDSoapBinaryCodec::fromHex(hex), data);
+        QCOMPARE(KDSoapBinaryCodec::fromHex(hex.toUpper()), data);
+    }
+
+    void testLenientDecoding_data()
+    {
+        QTest::addColumn<QString>("base64");
+        QTest::addColumn<QString>("hex");
+
+        QTest::newRow("empty") << QString() << QString();
+        QTest::newRow("whitespace") << QString::fromLatin1("S0RT\n b2Fw\r\n") << QString::fromLatin1(" 4b 44\n53 6f 61 70 ");
+        QTest::newRow("line_breaks_in_block") << QString::fromLatin1("QUJDREVGR0hJSktM\nTU5PUFFSU1RVVldY\n")
+                                              << QString::fromLatin1("0123456789abcdef\n0123456789ABCDEF\n");
+        QTest::newRow("padding") << QString::fromLatin1("S0RTb2Fwcw==") << QString::fromLatin1("4b4453");
+        QTest::newRow("missing_padding") << QString::fromLatin1("S0RTb2Fwcw") << QString::fromLatin1("4b445");
+        QTest::newRow("invalid_chars") << QString::fromLatin1("S0R!Tb2F@wcw==!!!!!!!!!!!!!!!!!!!!!!!!")
+                                       << QString::fromLatin1("4g4z44x!5336f6f6f6f6f6f6f6f6f6f6f6f6f6f6f");
+        QTest::newRow("non_latin1") << (QString::fromLatin1("S0RTb2Fwcw==AAAA") + QChar(0x141) + QString::fromLatin1("AAAAAAAAAAAAAAAA"))
+                                    << (QString::fromLatin1("4b4453") + QChar(0x141) + QString::fromLatin1("00112233445566778899"));
+    }
+
+    void testLenientDecoding()
+    {
+        // Same behavior as QByteArray, which sees '?' for anything outside of Latin-1
+        QFETCH(QString, base64);
+        QFETCH(QString, hex);
+        QCOMPARE(KDSoapBinaryCodec::fromBase64(base64), QByteArray::fromBase64(base64.toLatin1()));
+        QCOMPARE(KDSoapBinaryCodec::fromHex(hex), QByteArray::fromHex(hex.toLatin1()));
+    }
+
+    void testValue()
+    {
+        const QByteArray data("KDSoap");
+        // Literal use: the text as is. Encoded use: the message reader stores the UTF-8 text.
+        QCOMPARE(KDSoapBinaryCodec::fromBase64Value(QVariant(QString::fromLatin1("S0RTb2Fw"))), data);
+        QCOMPARE(KDSoapBinaryCodec::fromBase64Value(QVariant(QByteArray("S0RTb2Fw"))), data);
+        QCOMPARE(KDSoapBinaryCodec::fromHexValue(QVariant(QString::fromLatin1("4b44536f6170"))), data);
+        QCOMPARE(KDSoapBinaryCodec::fromHexValue(QVariant(QByteArray("4b44536f6170"))), data);
+
+        // Serialization through KDSoapValue
+        KDSoapValue value(QString::fromLatin1("v"), data, KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("hexBinary"));
+        QVERIFY(value.toXml().contains(">4b44536f6170<"));
+        value.setType(KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("base64Binary"));
+        QVERIFY(value.toXml().contains(">S0RTb2Fw<"));
+    }
+
+    void benchmarkBase64_data()
+    {
+        QTest::addColumn<bool>("codec");
+        QTest::newRow("QByteArray") << false;
+        QTest::newRow("KDSoapBinaryCodec") << true;
+    }
+
+    // From the parsed text (QString) to the data and back
+    void benchmarkBase64()
+    {
+        QFETCH(bool, codec);
+        const QByteArray data = binaryData(1024 * 1024);
+        const QString text = QString::fromLatin1(data.toBase64());
+        QByteArray decoded;
+        QString encoded;
+        if (codec) {
+            QBENCHMARK {
+                decoded = KDSoapBinaryCodec::fromBase64(text);
+                encoded = KDSoapBinaryCodec::toBase64(decoded);
+            }
+        } else {
+            QBENCHMARK {
+                decoded = QByteArray::fromBase64(text.toLatin1());
+                const QByteArray base64 = decoded.toBase64();
+                encoded = QString::fromLatin1(base64.constData(), base64.size());
+            }
+        }
+        QCOMPARE(encoded, text);
+    }
+
+    void benchmarkHex_data()
+    {
+        benchmarkBase64_data();
+    }
+
+    void benchmarkHex()
+    {
+        QFETCH(bool, codec);
+        const QByteArray data = binaryData(1024 * 1024);
+        const QString text = QString::fromLatin1(data.toHex());
+        QByteArray decoded;
+        QString encoded;
+        if (codec) {
+            QBENCHMARK {
+                decoded = KDSoapBinaryCodec::fromHex(text);
+                encoded = KDSoapBinaryCodec::toHex(decoded);
+            }
+        } else {
+            QBENCHMARK {
+                decoded = QByteArray::fromHex(text.toLatin1());
+                const QByteArray hex = decoded.toHex();
+                encoded = QString::fromLatin1(hex.constData(), hex.size());
+            }
+        }
+        QCOMPARE(encoded, text);
+    }
+};
+
+QTEST_MAIN(BinaryCodecTest)
+
+#include "test_binarycodec.moc"
@@ -27,9 +27,15 @@
 
 using namespace KDSoapUnitTestHelpers;
 
+// The tests run once for each way of sending blocking calls
 class BuiltinHttpTest : public QObject
 {
     Q_OBJECT
+public:
+    explicit BuiltinHttpTest(KDSoapClientInterface::BlockingCallTransport transport)
+        : m_transport(transport)
+    {
+    }
 
 private Q_SLOTS:
 
@@ -40,6 +46,7 @@ private Q_SLOTS:
 
         qDebug() << "server ready, proceeding" << server.endPoint();
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapPendingCall call = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage());
         QVERIFY(!call.isFinished());
         QTest::qWait(1000);
@@ -52,6 +59,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(QByteArray(), HttpServerThread::Public | HttpServerThread::Error404);
         KDSoapClientInterface client(server.endPoint(), QString::fromLatin1("urn:msg"));
+        client.setBlockingCallTransport(m_transport);
         client.setSoapVersion(KDSoapClientInterface::SOAP1_1);
         KDSoapMessage message;
         KDSoapMessage ret = client.call(QLatin1String("Method1"), message);
@@ -75,6 +83,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(QByteArray(), HttpServerThread::Public | HttpServerThread::Error404);
         KDSoapClientInterface client(server.endPoint(), QString::fromLatin1("urn:msg"));
+        client.setBlockingCallTransport(m_transport);
         client.setSoapVersion(KDSoapClientInterface::SOAP1_2);
         KDSoapMessage message;
         KDSoapMessage ret = client.call(QLatin1String("Method1"), message);
@@ -86,6 +95,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(QByteArray(xmlEnvBegin11()) + "><soap:Body><broken></xml></soap:Body>", HttpServerThread::Public);
         KDSoapClientInterface client(server.endPoint(), QString::fromLatin1("urn:msg"));
+        client.setBlockingCallTransport(m_transport);
         KDSoapMessage message;
         KDSoapMessage ret = client.call(QLatin1String("Method1"), message);
         QVERIFY(ret.isFault());
@@ -97,6 +107,7 @@ private Q_SLOTS:
         HttpServerThread server(QByteArray(xmlEnvBegin11()) + "><soap:Body>&doesnotexist;</soap:Body>" + xmlEnvEnd() + '\n',
                                 HttpServerThread::Public);
         KDSoapClientInterface client(server.endPoint(), QString::fromLatin1("urn:msg"));
+        client.setBlockingCallTransport(m_transport);
         KDSoapMessage message;
         KDSoapMessage ret = client.call(QLatin1String("Method1"), message);
         QVERIFY(ret.isFault());
@@ -108,6 +119,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(countryResponse(), HttpServerThread::BasicAuth);
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapAuthentication auth;
         auth.setUser(QLatin1String("kdab"));
         auth.setPassword(QLatin1String("testpass"));
@@ -125,6 +137,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(countryResponse(), HttpServerThread::BasicAuth);
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapAuthentication auth;
         auth.setUser(QLatin1String("kdab"));
         auth.setPassword(QLatin1String("invalid"));
@@ -142,6 +155,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(countryResponse(), HttpServerThread::BasicAuth);
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapAuthentication auth;
         auth.setUser(QLatin1String("kdab"));
         auth.setPassword(QLatin1String("invalid"));
@@ -155,6 +169,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(countryResponse(), HttpServerThread::Public);
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapAuthentication auth;
 
         auth.setUser(QLatin1String("kdab"));
@@ -205,6 +220,7 @@ private Q_SLOTS:
 
         // First, make the proper call
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapAuthentication auth;
         auth.setUser(QLatin1String("kdab"));
         auth.setPassword(QLatin1String("unused"));
@@ -243,6 +259,7 @@ private Q_SLOTS:
     {
         HttpServerThread server(emptyResponse(), HttpServerThread::Public);
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         KDSoapMessage message;
         message.setUse(KDSoapMessage::EncodedUse); // write out types explicitly
 
@@ -328,11 +345,54 @@ private Q_SLOTS:
         QVERIFY(xmlBufferCompare(server.receivedData(), expectedRequestXmlNoHeader + expectedRequestBody));
     }
 
+    // The beginning of the envelope is reused between calls, until the configuration changes
+    void testEnvelopeReuse()
+    {
+        HttpServerThread server(countryResponse(), HttpServerThread::Public);
+        KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
+        for (int i = 0; i < 2; ++i) {
+            server.resetReceivedBuffers();
+            client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+            QVERIFY(xmlBufferCompare(server.receivedData(), expectedCountryRequest()));
+        }
+
+        server.resetReceivedBuffers();
+        KDSoapPendingCall call = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage());
+        waitForCallFinished(call);
+        QVERIFY(xmlBufferCompare(server.receivedData(), expectedCountryRequest()));
+
+        client.setSoapVersion(KDSoapClientInterface::SOAP1_2);
+        server.resetReceivedBuffers();
+        client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+        QVERIFY(xmlBufferCompare(server.receivedData(), expectedCountryRequest12()));
+
+        KDSoapMessage header1;
+        header1.addArgument(QString::fromLatin1("header1"), QString::fromLatin1("headerValue"));
+        client.setSoapVersion(KDSoapClientInterface::SOAP1_1);
+        client.setHeader(QLatin1String("header1"), header1);
+        server.resetReceivedBuffers();
+        client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+        const QByteArray expectedRequestWithHeader = QByteArray(xmlEnvBegin11())
+            + " xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\">"
+              "<soap:Header>"
+              "<n1:header1>headerValue</n1:header1>"
+              "</soap:Header>"
+              "<soap:Body>"
+              "<n1:getEmployeeCountry>"
+              "<employeeName>David Ä Faure</employeeName>"
+              "</n1:getEmployeeCountry>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+        QVERIFY(xmlBufferCompare(server.receivedData(), expectedRequestWithHeader));
+    }
+
     // Test parsing of complex replies, like with SugarCRM
     void testParseComplexReply()
     {
         HttpServerThread server(complexTypeResponse(), HttpServerThread::Public);
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         const KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage());
         QVERIFY(!response.isFault());
         QCOMPARE(response.arguments().count(), 1);
@@ -368,6 +428,8 @@ private Q_SLOTS:
         HttpServerThread server(countryResponse(), HttpServerThread::Public);
 
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+
+        client.setBlockingCallTransport(m_transport);
         client.setStyle(KDSoapClientInterface::DocumentStyle);
         QByteArray expectedRequestXml = expectedCountryRequest();
 
@@ -394,6 +456,7 @@ private Q_SLOTS:
 
         qDebug() << "server ready, proceeding" << server.endPoint();
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         client.setSendSoapActionInHttpHeader(false);
         client.setSoapVersion(KDSoapClientInterface::SOAP1_2);
         QString action = QStringLiteral("http://localhost/getEmployeeCountry");
@@ -412,6 +475,7 @@ private Q_SLOTS:
 
         qDebug() << "server ready, proceeding" << server.endPoint();
         KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(m_transport);
         client.setSendSoapActionInWsAddressingHeader(true);
         client.setSoapVersion(KDSoapClientInterface::SOAP1_2);
         QString action = QStringLiteral("http://localhost/getEmployeeCountry");
@@ -423,6 +487,8 @@ private Q_SLOTS:
 
 
 private:
+    const KDSoapClientInterface::BlockingCallTransport m_transport;
+
     static QByteArray countryResponse()
     {
         return QByteArray(xmlEnvBegin11())
@@ -505,6 +571,12 @@ private:
     }
 };
 
-QTEST_MAIN(BuiltinHttpTest)
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    BuiltinHttpTest qnamTest(KDSoapClientInterface::QNetworkAccessManagerTransport);
+    BuiltinHttpTest nativeTest(KDSoapClientInterface::NativeTransport);
+    return QTest::qExec(&qnamTest, argc, argv) | QTest::qExec(&nativeTest, argc, argv);
+}
 
 #include "test_builtinhttp.moc"
@@ -45,6 +45,31 @@ private Q_SLOTS:
         list.deserialize(soapValue);
         QVERIFY(list.entries().empty());
     }
+
+    void testNumbersAreParsed()
+    {
+        NS2__Orientation list;
+        KDSoapValue soapValue;
+        soapValue.setValue(QVariant::fromValue(QString(" 1.5 -2\n3E4\tINF ")));
+        list.deserialize(soapValue);
+        QCOMPARE(list.entries().count(), 4);
+        QCOMPARE(list.entries().at(0), 1.5);
+        QCOMPARE(list.entries().at(1), -2.0);
+        QCOMPARE(list.entries().at(2), 30000.0);
+        QVERIFY(qIsInf(list.entries().at(3)));
+    }
+
+    void testInvalidNumberFallsBack()
+    {
+        // Not a valid list of doubles: converted item by item, like before typed arrays
+        NS2__Orientation list;
+        KDSoapValue soapValue;
+        soapValue.setValue(QVariant::fromValue(QString("1.5 abc 2")));
+        list.deserialize(soapValue);
+        QCOMPARE(list.entries().count(), 3);
+        QCOMPARE(list.entries().at(0), 1.5);
+        QCOMPARE(list.entries().at(2), 2.0);
+    }
 };
 
 QTEST_MAIN(EmptyListTest)
@@ -0,0 +1,33 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "wsdl_test.h"
+#include <QTest>
+
+class IdempotentTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRetryPolicies()
+    {
+        // Set by kdwsdl2cpp -idempotent getValue
+        IdempotentService service;
+        const KDSoapRetryPolicy getPolicy = service.clientInterface()->retryPolicy(QLatin1String("getValue"));
+        QVERIFY(!getPolicy.isNull());
+        QCOMPARE(getPolicy.maxRetries(), KDSoapRetryPolicy::idempotentPolicy().maxRetries());
+        QCOMPARE(getPolicy.hedgeDelay(), KDSoapRetryPolicy::idempotentPolicy().hedgeDelay());
+        QVERIFY(service.clientInterface()->retryPolicy(QLatin1String("setValue")).isNull());
+    }
+};
+
+QTEST_MAIN(IdempotentTest)
+
+#include "test_idempotent_wsdl.moc"
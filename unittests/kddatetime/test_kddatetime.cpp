@@ -10,6 +10,7 @@
 
 #include "KDDateTime.h"
 #include "KDSoapValue.h"
+#include <QStringList>
 #include <QTest>
 
 class KDDateTimeTest : public QObject
@@ -35,6 +36,139 @@ private Q_SLOTS:
         QCOMPARE(inputDateTime.timeZone(), outputDateTime.timeZone());
         QCOMPARE(inputDateTime.toDateString(), outputDateTime.toDateString());
     }
+
+    void testFromDateString_data()
+    {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<QDateTime>("expected");
+        QTest::addColumn<QString>("timeZone");
+
+        QTest::newRow("local") << QStringLiteral("2011-03-15T23:59:59") << QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59)) << QString();
+        QTest::newRow("utc") << QStringLiteral("2011-03-15T23:59:59Z") << QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59), Qt::UTC) << QStringLiteral("Z");
+        QTest::newRow("offset") << QStringLiteral("2011-03-15T23:59:59+01:00") << QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59), Qt::OffsetFromUTC, 3600)
+                                << QStringLiteral("+01:00");
+        QTest::newRow("negative_offset") << QStringLiteral("2011-03-15T08:00:00-05:30")
+                                         << QDateTime(QDate(2011, 3, 15), QTime(8, 0), Qt::OffsetFromUTC, -(5 * 3600 + 30 * 60)) << QStringLiteral("-05:30");
+        QTest::newRow("msec") << QStringLiteral("2011-03-15T23:59:59.999Z") << QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59, 999), Qt::UTC) << QStringLiteral("Z");
+        QTest::newRow("one_fractional_digit") << QStringLiteral("2011-03-15T10:00:00.5") << QDateTime(QDate(2011, 3, 15), QTime(10, 0, 0, 500)) << QString();
+        QTest::newRow("rounded_fraction") << QStringLiteral("2011-03-15T10:00:00.12345678") << QDateTime(QDate(2011, 3, 15), QTime(10, 0, 0, 123)) << QString();
+        QTest::newRow("end_of_day") << QStringLiteral("2011-03-15T24:00:00") << QDateTime(QDate(2011, 3, 16), QTime(0, 0)) << QString();
+        QTest::newRow("date_only") << QStringLiteral("2011-03-15") << QDateTime(QDate(2011, 3, 15), QTime(0, 0)) << QString();
+        QTest::newRow("whitespace") << QStringLiteral(" 2011-03-15T23:59:59Z\n") << QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59), Qt::UTC) << QStringLiteral("Z");
+        QTest::newRow("leap_day") << QStringLiteral("2012-02-29T12:00:00") << QDateTime(QDate(2012, 2, 29), QTime(12, 0)) << QString();
+
+        const QDateTime invalid;
+        QTest::newRow("empty") << QString() << invalid << QString();
+        QTest::newRow("garbage") << QStringLiteral("yesterday") << invalid << QString();
+        QTest::newRow("short_year") << QStringLiteral("211-03-15T23:59:59") << invalid << QString();
+        QTest::newRow("year_zero") << QStringLiteral("0000-03-15T23:59:59") << invalid << QString();
+        QTest::newRow("bad_month") << QStringLiteral("2011-13-15T23:59:59") << invalid << QString();
+        QTest::newRow("bad_day") << QStringLiteral("2011-02-29T23:59:59") << invalid << QString();
+        QTest::newRow("bad_hour") << QStringLiteral("2011-03-15T25:00:00") << invalid << QString();
+        QTest::newRow("bad_end_of_day") << QStringLiteral("2011-03-15T24:00:01") << invalid << QString();
+        QTest::newRow("missing_seconds") << QStringLiteral("2011-03-15T23:59") << invalid << QString();
+        QTest::newRow("empty_fraction") << QStringLiteral("2011-03-15T23:59:59.") << invalid << QString();
+        QTest::newRow("space_separator") << QStringLiteral("2011-03-15 23:59:59") << invalid << QString();
+        QTest::newRow("bad_offset") << QStringLiteral("2011-03-15T23:59:59+15:00") << invalid << QString();
+        QTest::newRow("short_offset") << QStringLiteral("2011-03-15T23:59:59+01") << invalid << QString();
+        QTest::newRow("trailing_garbage") << QStringLiteral("2011-03-15T23:59:59Zx") << invalid << QString();
+    }
+
+    void testFromDateString()
+    {
+        QFETCH(QString, text);
+        QFETCH(QDateTime, expected);
+        QFETCH(QString, timeZone);
+
+        const KDDateTime kdt = KDDateTime::fromDateString(text);
+        QCOMPARE(kdt.isValid(), expected.isValid());
+        if (expected.isValid()) {
+            QCOMPARE(kdt.date(), expected.date());
+            QCOMPARE(kdt.time(), expected.time());
+            QCOMPARE(int(kdt.timeSpec()), int(expected.timeSpec()));
+            QCOMPARE(kdt.offsetFromUtc(), expected.offsetFromUtc());
+            QCOMPARE(kdt.timeZone(), timeZone);
+        }
+    }
+
+    void testDateAndTime()
+    {
+        QCOMPARE(KDDateTime::dateFromString(QStringLiteral("2011-03-15")), QDate(2011, 3, 15));
+        QCOMPARE(KDDateTime::dateFromString(QStringLiteral("2011-03-15Z")), QDate(2011, 3, 15));
+        QCOMPARE(KDDateTime::dateFromString(QStringLiteral("-0044-03-15")), QDate(-44, 3, 15));
+        QCOMPARE(KDDateTime::dateFromString(QStringLiteral("12011-03-15")), QDate(12011, 3, 15));
+        QVERIFY(!KDDateTime::dateFromString(QStringLiteral("02011-03-15")).isValid());
+        QVERIFY(!KDDateTime::dateFromString(QStringLiteral("2011-03-15T00:00:00")).isValid());
+
+        QCOMPARE(KDDateTime::timeFromString(QStringLiteral("23:59:59")), QTime(23, 59, 59));
+        QCOMPARE(KDDateTime::timeFromString(QStringLiteral("23:59:59.25-03:00")), QTime(23, 59, 59, 250));
+        QCOMPARE(KDDateTime::timeFromString(QStringLiteral("24:00:00")), QTime(0, 0));
+        QVERIFY(!KDDateTime::timeFromString(QStringLiteral("23:60:00")).isValid());
+        QVERIFY(!KDDateTime::timeFromString(QStringLiteral("2011-03-15")).isValid());
+    }
+
+    void testSetTimeZone()
+    {
+        // Same offsets as fromDateString()
+        KDDateTime kdt(QDateTime(QDate(2011, 3, 15), QTime(8, 0)));
+        kdt.setTimeZone(QStringLiteral("-05:30"));
+        QCOMPARE(int(kdt.timeSpec()), int(Qt::OffsetFromUTC));
+        QCOMPARE(kdt.offsetFromUtc(), -(5 * 3600 + 30 * 60));
+        QCOMPARE(kdt.timeZone(), QStringLiteral("-05:30"));
+        QCOMPARE(kdt.toMSecsSinceEpoch(), KDDateTime::fromDateString(QStringLiteral("2011-03-15T08:00:00-05:30")).toMSecsSinceEpoch());
+
+        kdt.setTimeZone(QStringLiteral("+01:00"));
+        QCOMPARE(kdt.offsetFromUtc(), 3600);
+        kdt.setTimeZone(QStringLiteral("Z"));
+        QCOMPARE(int(kdt.timeSpec()), int(Qt::UTC));
+        kdt.setTimeZone(QString());
+        QCOMPARE(int(kdt.timeSpec()), int(Qt::LocalTime));
+    }
+
+    void testRoundTrip()
+    {
+        KDDateTime kdt(QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59, 999)));
+        kdt.setTimeZone(QStringLiteral("+01:00"));
+        const KDDateTime parsed = KDDateTime::fromDateString(kdt.toDateString());
+        QCOMPARE(parsed.toDateString(), kdt.toDateString());
+        QCOMPARE(parsed.toMSecsSinceEpoch(), kdt.toMSecsSinceEpoch());
+    }
+
+    void benchmarkFromDateString_data()
+    {
+        QTest::addColumn<bool>("kdDateTime");
+        QTest::newRow("QDateTime::fromString") << false;
+        QTest::newRow("KDDateTime::fromDateString") << true;
+    }
+
+    // 100000 timestamps, like in a telemetry response
+    void benchmarkFromDateString()
+    {
+        QFETCH(bool, kdDateTime);
+        QStringList timestamps;
+        timestamps.reserve(100000);
+        const QDateTime start(QDate(2023, 1, 1), QTime(0, 0), Qt::UTC);
+        for (int i = 0; i < 100000; ++i) {
+            timestamps.append(start.addMSecs(qint64(i) * 1237).toString(QStringLiteral("yyyy-MM-ddThh:mm:ss.zzz")) + QLatin1Char('Z'));
+        }
+        qint64 sum = 0;
+        if (kdDateTime) {
+            QBENCHMARK {
+                sum = 0;
+                for (const QString &timestamp : qAsConst(timestamps)) {
+                    sum += KDDateTime::fromDateString(timestamp).toMSecsSinceEpoch();
+                }
+            }
+        } else {
+            QBENCHMARK {
+                sum = 0;
+                for (const QString &timestamp : qAsConst(timestamps)) {
+                    sum += QDateTime::fromString(timestamp, Qt::ISODate).toMSecsSinceEpoch();
+                }
+            }
+        }
+        QVERIFY(sum != 0);
+    }
 };
 
 QTEST_MAIN(KDDateTimeTest)
@@ -8,11 +8,43 @@
 **
 ****************************************************************************/
 
+#include "KDDateTime.h"
 #include "KDSoapMessage.h"
 #include "KDSoapMessageReader_p.h"
 #include <QDebug>
 #include <QTest>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Bytes currently allocated on the heap, or -1 if unknown on this platform
+static qint64 heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return qint64(mallinfo2().uordblks);
+#elif defined(__GLIBC__)
+    return qint64(mallinfo().uordblks);
+#else
+    return -1;
+#endif
+}
+
+static QByteArray itemsMessage(int count)
+{
+    QByteArray xml = "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                     "<soap:Body>"
+                     "<n1:getItemsResponse xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\">";
+    for (int i = 0; i < count; ++i) {
+        xml += "<n1:item><n1:id>" + QByteArray::number(i) + "</n1:id><n1:name>Item " + QByteArray::number(i)
+            + "</n1:name><n1:inStock>true</n1:inStock></n1:item>";
+    }
+    xml += "</n1:getItemsResponse>"
+           "</soap:Body>"
+           "</soap:Envelope>";
+    return xml;
+}
+
 class TestMessageReader : public QObject
 {
     Q_OBJECT
@@ -66,6 +98,48 @@ private Q_SLOTS:
         }
     }
 
+    void testEncodedTypes()
+    {
+        const QByteArray xml = "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\""
+                               " xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">"
+                               "<soap:Body>"
+                               "<n1:getValues xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\">"
+                               "<i xsi:type=\"xsd:int\">42</i>"
+                               "<badInt xsi:type=\"xsd:int\">forty-two</badInt>"
+                               "<u xsi:type=\"xsd:unsignedInt\">4294967296</u>"
+                               "<d xsi:type=\"xsd:double\">3.25</d>"
+                               "<b xsi:type=\"xsd:boolean\">false</b>"
+                               "<day xsi:type=\"xsd:date\">2011-03-15</day>"
+                               "<dt xsi:type=\"xsd:dateTime\">2011-03-15T23:59:59.999+01:00</dt>"
+                               "<s xsi:type=\"xsd:string\">12</s>"
+                               "<custom xsi:type=\"n1:MyType\">12</custom>"
+                               "</n1:getValues>"
+                               "</soap:Body>"
+                               "</soap:Envelope>";
+
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        const KDSoapMessageReader::XmlError err = reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1);
+        QCOMPARE(err, KDSoapMessageReader::NoError);
+        const KDSoapValueList &args = msg.childValues();
+        QCOMPARE(args.child(QLatin1String("i")).value(), QVariant(42));
+        QCOMPARE(args.child(QLatin1String("badInt")).value(), QVariant(QString::fromLatin1("forty-two")));
+        QCOMPARE(args.child(QLatin1String("u")).value(), QVariant(Q_UINT64_C(4294967296)));
+        QCOMPARE(args.child(QLatin1String("d")).value(), QVariant(3.25));
+        QCOMPARE(args.child(QLatin1String("b")).value(), QVariant(false));
+        QCOMPARE(args.child(QLatin1String("day")).value(), QVariant(QDate(2011, 3, 15)));
+        const QVariant dt = args.child(QLatin1String("dt")).value();
+        QCOMPARE(dt.userType(), qMetaTypeId<KDDateTime>());
+        QCOMPARE(dt.value<KDDateTime>().timeZone(), QString::fromLatin1("+01:00"));
+        QCOMPARE(dt.toString(), QString::fromLatin1("2011-03-15T23:59:59.999+01:00"));
+        QCOMPARE(dt.toDateTime(), QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59, 999), Qt::OffsetFromUTC, 3600));
+        QCOMPARE(args.child(QLatin1String("s")).value(), QVariant(QString::fromLatin1("12")));
+        QCOMPARE(args.child(QLatin1String("custom")).value(), QVariant(QString::fromLatin1("12")));
+        QCOMPARE(args.child(QLatin1String("custom")).type(), QString::fromLatin1("MyType"));
+        QCOMPARE(args.child(QLatin1String("custom")).typeNs(), QString::fromLatin1("http://www.kdab.com/xml/MyWsdl/"));
+    }
+
     void testFaultSoap11()
     {
         const QByteArray xmlMissingEnd =
@@ -99,6 +173,77 @@ private Q_SLOTS:
         QVERIFY(msg.isFault());
         QCOMPARE(msg.faultAsString(), QString::fromLatin1("Fault 4: XML error: [1:163] Premature end of document."));
     }
+
+    void testSharedStrings()
+    {
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(itemsMessage(2), &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        const KDSoapValueList &items = msg.childValues();
+        QCOMPARE(items.count(), 2);
+        const KDSoapValue first = items.at(0).childValues().child(QLatin1String("id"));
+        const KDSoapValue second = items.at(1).childValues().child(QLatin1String("id"));
+        QCOMPARE(second.value(), QVariant(QString::fromLatin1("1")));
+        // Element names and namespaces are stored once per message
+        QCOMPARE(first.name().constData(), second.name().constData());
+        QCOMPARE(first.namespaceUri().constData(), second.namespaceUri().constData());
+        QCOMPARE(first.namespaceUri(), QString::fromLatin1("http://www.kdab.com/xml/MyWsdl/"));
+        QVERIFY(first.type().isEmpty());
+        QVERIFY(first.namespaceDeclarations().isEmpty());
+        QCOMPARE(first.environmentNamespaceDeclarations().count(), 2);
+    }
+
+    void testArena()
+    {
+        KDSoapMessageReader reader;
+        reader.setUseArena(true);
+        KDSoapValue item;
+        {
+            KDSoapMessage msg;
+            KDSoapHeaders headers;
+            QCOMPARE(reader.xmlToMessage(itemsMessage(100), &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+            QCOMPARE(msg.childValues().count(), 100);
+            item = msg.childValues().at(42);
+        }
+        // The value outlives the message, and keeps the memory of the arena alive
+        QCOMPARE(item.childValues().child(QLatin1String("name")).value(), QVariant(QString::fromLatin1("Item 42")));
+        item.childValues().append(KDSoapValue(QString::fromLatin1("extra"), 1));
+        KDSoapValue copy = item;
+        copy.setName(QString::fromLatin1("copy"));
+        QCOMPARE(item.name(), QString::fromLatin1("item"));
+        QCOMPARE(copy.childValues().count(), 4);
+    }
+
+    void benchmarkParsedMessageMemory_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::addColumn<bool>("useArena");
+        QTest::newRow("100 items") << 100 << false;
+        QTest::newRow("10000 items") << 10000 << false;
+        QTest::newRow("10000 items, arena") << 10000 << true;
+    }
+
+    // Heap memory used by a parsed message, per item (an element with three leaf children)
+    void benchmarkParsedMessageMemory()
+    {
+        QFETCH(int, count);
+        QFETCH(bool, useArena);
+        const QByteArray xml = itemsMessage(count);
+        KDSoapMessageReader reader;
+        reader.setUseArena(useArena);
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        const qint64 before = heapInUse();
+        if (before < 0) {
+            QSKIP("Measuring heap usage is only implemented with glibc");
+        }
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        const qint64 after = heapInUse();
+        QCOMPARE(msg.childValues().count(), count);
+        const qint64 bytesPerItem = (after - before) / count;
+        QTest::setBenchmarkResult(bytesPerItem, QTest::BytesAllocated);
+    }
 };
 
 QTEST_MAIN(TestMessageReader)
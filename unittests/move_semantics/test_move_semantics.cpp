@@ -0,0 +1,169 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapMessage.h"
+#include "KDSoapMessageReader_p.h"
+#include "KDSoapValueArena_p.h"
+#include <QTest>
+
+// Counts the KDSoapValues allocated by the current thread since construction,
+// i.e. new values and copies made when detaching a shared value.
+class ValueAllocationCounter
+{
+public:
+    ValueAllocationCounter()
+        : m_start(KDSoapValueArena::allocationCount())
+    {
+    }
+    int count() const
+    {
+        return int(KDSoapValueArena::allocationCount() - m_start);
+    }
+
+private:
+    quint64 m_start;
+};
+
+static KDSoapValueList makeItems(int count)
+{
+    KDSoapValueList items;
+    items.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        items.addArgument(QString::fromLatin1("item"), i);
+    }
+    return items;
+}
+
+class MoveSemanticsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testMoveValue()
+    {
+        KDSoapValue value(QString::fromLatin1("id"), 1);
+        {
+            const ValueAllocationCounter counter;
+            KDSoapValue moved(std::move(value));
+            moved.setValue(QVariant(2));
+            moved.setQualified(true);
+            QCOMPARE(counter.count(), 0);
+
+            value = std::move(moved);
+            value.setNamespaceUri(QString::fromLatin1("urn:test"));
+            QCOMPARE(counter.count(), 0);
+        }
+        QCOMPARE(value.value().toInt(), 2);
+        QVERIFY(value.isQualified());
+
+        // For comparison: modifying a copy detaches it
+        const ValueAllocationCounter counter;
+        KDSoapValue copy(value);
+        copy.setValue(QVariant(3));
+        QCOMPARE(counter.count(), 1);
+        QCOMPARE(value.value().toInt(), 2);
+    }
+
+    void testMovedFrom()
+    {
+        KDSoapValue value(QString::fromLatin1("id"), 1);
+        KDSoapValue moved(std::move(value));
+        // A moved-from value is a null value, which can still be used
+        QVERIFY(value.isNull());
+        QVERIFY(value.childValues().isEmpty());
+        value.childValues().addArgument(QString::fromLatin1("child"), 2);
+        value.setValue(QVariant(3));
+        KDSoapValue other(std::move(moved));
+        // ... without changing the other moved-from values
+        QVERIFY(moved.isNull());
+        QVERIFY(moved.childValues().isEmpty());
+        QCOMPARE(value.childValues().count(), 1);
+        QCOMPARE(value.value().toInt(), 3);
+        QCOMPARE(other.value().toInt(), 1);
+
+        KDSoapMessage message;
+        message.setUse(KDSoapMessage::EncodedUse);
+        message.addArgument(QString::fromLatin1("id"), 1);
+        KDSoapMessage movedMessage(std::move(message));
+        QVERIFY(message.arguments().isEmpty());
+        QCOMPARE(message.use(), KDSoapMessage::LiteralUse);
+        message.addArgument(QString::fromLatin1("id"), 2);
+        QCOMPARE(message.arguments().count(), 1);
+        QCOMPARE(movedMessage.use(), KDSoapMessage::EncodedUse);
+        QCOMPARE(movedMessage.arguments().child(QString::fromLatin1("id")).value().toInt(), 1);
+    }
+
+    void testBuildMessage()
+    {
+        const int count = 1000;
+        KDSoapMessage message;
+        KDSoapValueList items = makeItems(count);
+
+        const ValueAllocationCounter counter;
+        message.addArgument(QString::fromLatin1("items"), std::move(items));
+        message.addArgument(QString::fromLatin1("total"), QVariant(count));
+        KDSoapValueList &args = message.arguments().first().childValues();
+        for (int i = 0; i < count; ++i) {
+            args[i].setValue(QVariant(i * 2));
+        }
+        KDSoapMessage sent(std::move(message));
+        sent.setQualified(true);
+        // Only the two new arguments were allocated, nothing was detached
+        QCOMPARE(counter.count(), 2);
+
+        QCOMPARE(sent.arguments().count(), 2);
+        QCOMPARE(sent.arguments().first().childValues().count(), count);
+        QCOMPARE(sent.arguments().first().childValues().at(10).value().toInt(), 20);
+        QCOMPARE(sent.arguments().child(QString::fromLatin1("total")).value().toInt(), count);
+    }
+
+    void testBuildMessageFromCopy()
+    {
+        // For comparison: if the caller keeps its list, each modified child is detached
+        const int count = 1000;
+        KDSoapMessage message;
+        const KDSoapValueList items = makeItems(count);
+
+        const ValueAllocationCounter counter;
+        message.addArgument(QString::fromLatin1("items"), items);
+        KDSoapValueList &args = message.arguments().first().childValues();
+        for (int i = 0; i < count; ++i) {
+            args[i].setValue(QVariant(i * 2));
+        }
+        QCOMPARE(counter.count(), count + 1);
+        QCOMPARE(items.at(10).value().toInt(), 10);
+    }
+
+    void testReaderAllocations()
+    {
+        const int count = 100;
+        QByteArray xml = "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                         "<soap:Body>"
+                         "<n1:getItemsResponse xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\">";
+        for (int i = 0; i < count; ++i) {
+            xml += "<n1:item>" + QByteArray::number(i) + "</n1:item>";
+        }
+        xml += "</n1:getItemsResponse></soap:Body></soap:Envelope>";
+
+        KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QString soapNamespace;
+        const ValueAllocationCounter counter;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, &soapNamespace, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        // One value per element, no copies
+        QCOMPARE(counter.count(), count + 1);
+        QCOMPARE(msg.childValues().count(), count);
+    }
+};
+
+QTEST_MAIN(MoveSemanticsTest)
+
+#include "test_move_semantics.moc"
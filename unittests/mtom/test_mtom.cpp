@@ -0,0 +1,294 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapAttachment.h"
+#include "KDSoapBinaryCodec.h"
+#include "KDSoapClientInterface.h"
+#include "KDSoapMessage.h"
+#include "KDSoapMessageReader_p.h"
+#include "KDSoapMessageWriter_p.h"
+#include "KDSoapMultipart_p.h"
+#include "KDSoapNamespaceManager.h"
+#include "KDSoapServer.h"
+#include "KDSoapServerObjectInterface.h"
+#include "httpserver_p.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QTest>
+#include <QXmlStreamReader>
+
+static const char s_messageNamespace[] = "http://www.kdab.com/xml/MyWsdl/";
+
+static QByteArray binaryData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = char(i * 7 + i / 256);
+    }
+    return data;
+}
+
+class MtomServerObject : public QObject, public KDSoapServerObjectInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(KDSoapServerObjectInterface)
+public:
+    void processRequest(const KDSoapMessage &request, KDSoapMessage &response, const QByteArray &soapAction) override
+    {
+        Q_UNUSED(soapAction);
+        const KDSoapValueList &args = request.childValues();
+        if (request.name() == QLatin1String("upload")) {
+            const QVariant document = args.child(QLatin1String("document")).value();
+            const bool isAttachment = document.userType() == qMetaTypeId<KDSoapAttachment>();
+            const QByteArray data = KDSoapBinaryCodec::fromBase64Value(document);
+            response.addArgument(QLatin1String("isAttachment"), isAttachment);
+            response.addArgument(QLatin1String("contentType"), isAttachment ? document.value<KDSoapAttachment>().contentType() : QString());
+            response.addArgument(QLatin1String("matches"), data == binaryData(data.size()));
+            response.addArgument(QLatin1String("size"), data.size());
+        } else if (request.name() == QLatin1String("download")) {
+            QBuffer *buffer = new QBuffer;
+            buffer->setData(binaryData(args.child(QLatin1String("size")).value().toInt()));
+            response.addArgument(QLatin1String("document"), QVariant::fromValue(KDSoapAttachment(buffer, QLatin1String("image/png"))));
+        } else {
+            setFault(QLatin1String("Server.MethodNotFound"), QLatin1String("Unknown method"));
+        }
+    }
+};
+
+class MtomServer : public KDSoapServer
+{
+    Q_OBJECT
+public:
+    QObject *createServerObject() override
+    {
+        return new MtomServerObject;
+    }
+};
+
+class MtomTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testWriteXopInclude()
+    {
+        KDSoapMessage message;
+        const KDSoapAttachment attachment(QByteArray("attached"), QLatin1String("text/plain"));
+        message.addArgument(QLatin1String("attachment"), QVariant::fromValue(attachment));
+        message.addArgument(QLatin1String("sameAttachment"), QVariant::fromValue(attachment));
+        message.addArgument(QLatin1String("bytes"), QByteArray("base64Binary"));
+        message.addArgument(QLatin1String("hex"), QByteArray("hexBinary"), KDSoapNamespaceManager::xmlSchema2001(), QLatin1String("hexBinary"));
+
+        QVector<KDSoapAttachment> attachments;
+        KDSoapMessageWriter writer;
+        writer.setMessageNamespace(QLatin1String(s_messageNamespace));
+        writer.setXopAttachments(&attachments);
+        const QByteArray xml = writer.messageToXml(message, QLatin1String("upload"), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+
+        // The attachment is only sent once, the hexBinary is written inline
+        QCOMPARE(int(attachments.count()), 2);
+        QCOMPARE(attachments.at(0).contentId(), attachment.contentId());
+        QCOMPARE(attachments.at(1).data(), QByteArray("base64Binary"));
+        QCOMPARE(int(xml.count("<xop:Include")), 3);
+        QVERIFY(xml.contains("href=\"cid:" + attachment.contentId().toUtf8() + '"'));
+        QVERIFY(xml.contains("<hex>" + QByteArray("hexBinary").toHex() + "</hex>"));
+
+        // Without MTOM, everything is inline
+        writer.setXopAttachments(nullptr);
+        const QByteArray inlineXml = writer.messageToXml(message, QLatin1String("upload"), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+        QVERIFY(!inlineXml.contains("xop:Include"));
+        QVERIFY(inlineXml.contains("<attachment>" + QByteArray("attached").toBase64() + "</attachment>"));
+    }
+
+    void testParse()
+    {
+        const QByteArray contentType = "multipart/related; type=\"application/xop+xml\"; boundary=\"MIME_boundary\"; "
+                                       "start=\"<root@example.com>\"; start-info=\"application/soap+xml\"; action=\"urn:upload\"";
+        const QByteArray envelope = "<soap:Envelope xmlns:soap=\"http://www.w3.org/2003/05/soap-envelope\"><soap:Body>"
+                                    "<n1:upload xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\">"
+                                    "<document><xop:Include xmlns:xop=\"http://www.w3.org/2004/08/xop/include\" href=\"cid:doc%40example.com\"/>\n</document>"
+                                    "<name>text</name>"
+                                    "</n1:upload></soap:Body></soap:Envelope>";
+        const QByteArray attachmentData = binaryData(1000) + "\r\n--MIME_boundar";
+        const QByteArray body = "--MIME_boundary\r\n"
+                                "Content-Type: application/xop+xml; charset=UTF-8; type=\"application/soap+xml\"\r\n"
+                                "Content-Transfer-Encoding: binary\r\n"
+                                "Content-ID: <root@example.com>\r\n"
+                                "\r\n"
+            + envelope
+            + "\r\n--MIME_boundary\r\n"
+              "Content-Type: image/png\r\n"
+              "Content-Transfer-Encoding: binary\r\n"
+              "Content-ID: <doc@example.com>\r\n"
+              "\r\n"
+            + attachmentData + "\r\n--MIME_boundary--\r\n";
+
+        QVERIFY(KDSoapMultipart::isMultipartRelated(contentType));
+        QByteArray parsedEnvelope;
+        QByteArray soapContentType;
+        QHash<QString, KDSoapAttachment> attachments;
+        QVERIFY(KDSoapMultipart::parse(contentType, body, &parsedEnvelope, &soapContentType, &attachments));
+        QCOMPARE(parsedEnvelope, envelope);
+        QCOMPARE(soapContentType, QByteArray("application/soap+xml;action=\"urn:upload\""));
+        QCOMPARE(int(attachments.count()), 1);
+        const KDSoapAttachment attachment = attachments.value(QLatin1String("doc@example.com"));
+        QCOMPARE(attachment.contentType(), QString::fromLatin1("image/png"));
+        QCOMPARE(attachment.size(), qint64(attachmentData.size()));
+        QCOMPARE(attachment.device()->readAll(), attachmentData);
+
+        KDSoapMessageReader reader;
+        reader.setXopAttachments(attachments);
+        KDSoapMessage message;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(parsedEnvelope, &message, nullptr, &headers, KDSoap::SOAP1_2), KDSoapMessageReader::NoError);
+        const QVariant document = message.childValues().child(QLatin1String("document")).value();
+        QCOMPARE(document.userType(), qMetaTypeId<KDSoapAttachment>());
+        QCOMPARE(document.value<KDSoapAttachment>().data(), attachmentData);
+        QCOMPARE(document.toByteArray(), attachmentData);
+        QCOMPARE(KDSoapBinaryCodec::fromBase64Value(document), attachmentData);
+        QCOMPARE(message.childValues().child(QLatin1String("name")).value().toString(), QString::fromLatin1("text"));
+
+        // A body reader isn't used for the body with attachments, which is parsed as usual
+        bool bodyRead = false;
+        const KDSoapMessageReader::BodyReader bodyReader = [&](QXmlStreamReader &xml) {
+            bodyRead = true;
+            xml.skipCurrentElement();
+        };
+        message = KDSoapMessage();
+        QCOMPARE(reader.xmlToMessage(parsedEnvelope, &message, nullptr, &headers, KDSoap::SOAP1_2, bodyReader), KDSoapMessageReader::NoError);
+        QVERIFY(!bodyRead);
+        QCOMPARE(message.childValues().child(QLatin1String("document")).value().value<KDSoapAttachment>().data(), attachmentData);
+        QCOMPARE(message.childValues().child(QLatin1String("name")).value().toString(), QString::fromLatin1("text"));
+    }
+
+    void testParseWithoutHeaders()
+    {
+        // Parts without headers: the delimiter line is followed directly by the empty line
+        const QByteArray body = "--x\r\n"
+                                "\r\n"
+                                "<envelope/>\r\n"
+                                "--x\r\n"
+                                "\r\n"
+                                "Content-ID: <not-a-header>\r\n"
+                                "\r\n"
+                                "data\r\n"
+                                "--x--\r\n";
+        QByteArray envelope;
+        QByteArray soapContentType;
+        QHash<QString, KDSoapAttachment> attachments;
+        QVERIFY(KDSoapMultipart::parse("multipart/related; boundary=x", body, &envelope, &soapContentType, &attachments));
+        QCOMPARE(envelope, QByteArray("<envelope/>"));
+        QCOMPARE(int(attachments.count()), 1);
+        const KDSoapAttachment attachment = attachments.value(QString());
+        QVERIFY(attachment.contentId().isEmpty());
+        QCOMPARE(attachment.data(), QByteArray("Content-ID: <not-a-header>\r\n\r\ndata"));
+    }
+
+    void testParseInvalid()
+    {
+        QByteArray envelope;
+        QByteArray soapContentType;
+        QHash<QString, KDSoapAttachment> attachments;
+        QVERIFY(!KDSoapMultipart::parse("multipart/related", "--x\r\n\r\n<a/>\r\n--x--", &envelope, &soapContentType, &attachments));
+        QVERIFY(!KDSoapMultipart::parse("multipart/related; boundary=x", "--x\r\n\r\n<a/>", &envelope, &soapContentType, &attachments));
+    }
+
+    void testUpload_data()
+    {
+        QTest::addColumn<bool>("mtom");
+        QTest::addColumn<bool>("sequential");
+
+        QTest::newRow("mtom") << true << false;
+        QTest::newRow("mtom_sequential_device") << true << true;
+        QTest::newRow("inline") << false << false;
+    }
+
+    void testUpload()
+    {
+        QFETCH(bool, mtom);
+        QFETCH(bool, sequential);
+
+        TestServerThread<MtomServer> serverThread;
+        MtomServer *server = serverThread.startThread();
+        KDSoapClientInterface client(server->endPoint(), QLatin1String(s_messageNamespace));
+        client.setMtomEnabled(mtom);
+
+        const QByteArray data = binaryData(300000);
+        QIODevice *device;
+        if (sequential) {
+            SequentialBuffer *buffer = new SequentialBuffer;
+            buffer->setData(data);
+            device = buffer;
+        } else {
+            QBuffer *buffer = new QBuffer;
+            buffer->setData(data);
+            device = buffer;
+        }
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("document"), QVariant::fromValue(KDSoapAttachment(device, QLatin1String("image/png"))));
+        const KDSoapMessage response = client.call(QLatin1String("upload"), message);
+        QVERIFY2(!response.isFault(), qPrintable(response.faultAsString()));
+        QCOMPARE(response.childValues().child(QLatin1String("isAttachment")).value().toBool(), mtom);
+        if (mtom) {
+            QCOMPARE(response.childValues().child(QLatin1String("contentType")).value().toString(), QString::fromLatin1("image/png"));
+        }
+        QVERIFY(response.childValues().child(QLatin1String("matches")).value().toBool());
+        QCOMPARE(response.childValues().child(QLatin1String("size")).value().toInt(), int(data.size()));
+    }
+
+    void testDownload_data()
+    {
+        QTest::addColumn<bool>("mtom");
+
+        QTest::newRow("mtom") << true;
+        QTest::newRow("inline") << false;
+    }
+
+    void testDownload()
+    {
+        QFETCH(bool, mtom);
+
+        TestServerThread<MtomServer> serverThread;
+        MtomServer *server = serverThread.startThread();
+        KDSoapClientInterface client(server->endPoint(), QLatin1String(s_messageNamespace));
+        // The server replies with MTOM if the request used it, even if the request itself has no attachments
+        client.setMtomEnabled(mtom);
+
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("size"), 200000);
+        const KDSoapMessage response = client.call(QLatin1String("download"), message);
+        QVERIFY2(!response.isFault(), qPrintable(response.faultAsString()));
+        const QVariant document = response.childValues().child(QLatin1String("document")).value();
+        QCOMPARE(KDSoapBinaryCodec::fromBase64Value(document), binaryData(200000));
+        if (mtom) {
+            QCOMPARE(document.userType(), qMetaTypeId<KDSoapAttachment>());
+            const KDSoapAttachment attachment = document.value<KDSoapAttachment>();
+            QCOMPARE(attachment.contentType(), QString::fromLatin1("image/png"));
+            QCOMPARE(attachment.size(), qint64(200000));
+        } else {
+            QVERIFY(document.userType() != qMetaTypeId<KDSoapAttachment>());
+        }
+    }
+
+private:
+    // A QBuffer pretending to be sequential, like a socket or a process
+    class SequentialBuffer : public QBuffer
+    {
+    public:
+        bool isSequential() const override
+        {
+            return true;
+        }
+    };
+};
+
+QTEST_MAIN(MtomTest)
+
+#include "test_mtom.moc"
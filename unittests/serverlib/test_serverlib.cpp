@@ -10,6 +10,7 @@
 
 #include "KDSoapAuthentication.h"
 #include "KDSoapClientInterface.h"
+#include "KDSoapCompression_p.h"
 #include "KDSoapMessage.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapPendingCallWatcher.h"
@@ -18,11 +19,14 @@
 #include "KDSoapServerCustomVerbRequestInterface.h"
 #include "KDSoapServerObjectInterface.h"
 #include "KDSoapServerRawXMLInterface.h"
+#include "KDSoapRetryPolicy.h"
 #include "KDSoapThreadPool.h"
+#include "KDSoapTrace.h"
 #include "KDSoapValue.h"
 #include "httpserver_p.h" // KDSoapUnitTestHelpers
 #include <QAuthenticator>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -31,7 +35,11 @@
 #include <QSslConfiguration>
 #endif
 #include <QSignalSpy>
+#include <QTcpServer>
 #include <QTimer>
+
+#include <algorithm>
+
 using namespace KDSoapUnitTestHelpers;
 
 Q_DECLARE_METATYPE(QFile::Permissions)
@@ -42,6 +50,7 @@ class CountryServerObject;
 typedef QMap<QThread *, CountryServerObject *> ServerObjectsMap;
 ServerObjectsMap s_serverObjects;
 QMutex s_serverObjectsMutex;
+static QAtomicInt s_slowOnceCalls; // for "SlowOnce", which is only slow the first time
 
 class PublicThread : public QThread
 {
@@ -200,6 +209,9 @@ public: // SOAP-accessible methods
         if (employeeName == QLatin1String("Slow")) {
             PublicThread::msleep(100);
         }
+        if (employeeName == QLatin1String("SlowOnce") && s_slowOnceCalls.fetchAndAddOrdered(1) == 0) {
+            PublicThread::msleep(1000);
+        }
         return employeeName + QString::fromLatin1(" France");
     }
 
@@ -239,6 +251,66 @@ private:
     QByteArray m_assembledXML;
 };
 
+// Answers every request with "503 Service Unavailable", and counts them.
+// The server runs in its own thread, so that the main thread can use synchronous calls.
+class UnavailableServer : public QThread
+{
+public:
+    UnavailableServer()
+    {
+        start();
+        m_semaphore.acquire(); // wait for the server to listen
+    }
+    ~UnavailableServer()
+    {
+        quit();
+        wait();
+    }
+
+    QString endPoint() const
+    {
+        return QString::fromLatin1("http://127.0.0.1:%1/path").arg(m_port);
+    }
+
+    int requestCount() const
+    {
+        return m_requestCount.loadAcquire();
+    }
+    void resetRequestCount()
+    {
+        m_requestCount.fetchAndStoreOrdered(0);
+    }
+
+protected:
+    void run() override
+    {
+        QTcpServer server;
+        connect(&server, &QTcpServer::newConnection, &server, [this, &server]() {
+            while (QTcpSocket *socket = server.nextPendingConnection()) {
+                connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+                    const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                    socket->setProperty("request", request);
+                    if (request.contains(":Envelope>")) {
+                        m_requestCount.ref();
+                        socket->write("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                        socket->disconnectFromHost();
+                    }
+                });
+                connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+        server.listen(QHostAddress::LocalHost);
+        m_port = server.serverPort();
+        m_semaphore.release();
+        exec();
+    }
+
+private:
+    QSemaphore m_semaphore;
+    quint16 m_port = 0;
+    QAtomicInt m_requestCount;
+};
+
 class CountryServer : public KDSoapServer
 {
     Q_OBJECT
@@ -288,6 +360,32 @@ private:
     bool m_useRawXML;
 };
 
+// Makes a blocking call from a secondary thread
+class BlockingCallThread : public QThread
+{
+public:
+    BlockingCallThread(KDSoapClientInterface *client, const KDSoapMessage &message)
+        : m_client(client)
+        , m_message(message)
+    {
+    }
+    KDSoapMessage response() const
+    {
+        return m_response;
+    }
+
+protected:
+    void run() override
+    {
+        m_response = m_client->call(QLatin1String("getEmployeeCountry"), m_message);
+    }
+
+private:
+    KDSoapClientInterface *m_client;
+    KDSoapMessage m_message;
+    KDSoapMessage m_response;
+};
+
 // We need to do the listening and socket handling in a separate thread,
 // so that the main thread can use synchronous calls. Note that this is
 // really specific to unit tests and doesn't need to be done in a real
@@ -599,6 +697,49 @@ private Q_SLOTS:
         QCOMPARE(s_serverObjects.count(), 0);
     }
 
+    void testConcurrentBlockingCalls_data()
+    {
+        QTest::addColumn<int>("maxBlockingCallThreads");
+        QTest::addColumn<int>("expectedServerObjects");
+
+        // One connection per client thread, each connection is handled by a server thread
+        QTest::newRow("one_client_thread") << 1 << 1;
+        QTest::newRow("four_client_threads") << 4 << 4;
+    }
+
+    void testConcurrentBlockingCalls()
+    {
+        QFETCH(int, maxBlockingCallThreads);
+        QFETCH(int, expectedServerObjects);
+        {
+            KDSoapThreadPool threadPool;
+            threadPool.setMaxThreadCount(4);
+            CountryServerThread serverThread(&threadPool);
+            CountryServer *server = serverThread.startThread();
+
+            KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+            QCOMPARE(client.maxBlockingCallThreads(), 1);
+            client.setMaxBlockingCallThreads(maxBlockingCallThreads);
+            QCOMPARE(client.maxBlockingCallThreads(), maxBlockingCallThreads);
+            client.cookieJar(); // created in this thread, shared by the threads of the client
+
+            QVector<BlockingCallThread *> callers;
+            for (int i = 0; i < 4; ++i) {
+                callers.append(new BlockingCallThread(&client, countryMessage(true))); // the server object sleeps for 100ms
+                callers.last()->start();
+            }
+            for (BlockingCallThread *caller : qAsConst(callers)) {
+                QVERIFY(caller->wait(10000));
+                QCOMPARE(caller->response().childValues().first().value().toString(), QString::fromLatin1("Slow France"));
+            }
+            qDeleteAll(callers);
+
+            QCOMPARE(s_serverObjects.count(), expectedServerObjects);
+            QCOMPARE(server->totalConnectionCount(), 4); // counts the requests, see KDSoapServerSocket::slotReadyRead
+        }
+        QCOMPARE(s_serverObjects.count(), 0);
+    }
+
 // OSX: "Fault code 99: Unknown error", sometimes
 // Windows/Linux with Qt 4.8 or 5.5: nothing happens after "82 sockets seen. 100 connected right now. Messages received 100"
 #if 0
@@ -1323,6 +1464,18 @@ private Q_SLOTS:
         server->setFeatures(KDSoapServer::Ssl);
         QVERIFY(server->endPoint().startsWith(QLatin1String("https")));
         makeSimpleCall(server->endPoint());
+
+        // NativeTransport doesn't reuse a connection which was verified with other TLS settings
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(KDSoapClientInterface::NativeTransport);
+        QVERIFY(!client.call(QLatin1String("getEmployeeCountry"), countryMessage()).isFault());
+        QSslConfiguration untrusted = QSslConfiguration::defaultConfiguration();
+        untrusted.setCaCertificates(QList<QSslCertificate>());
+        client.setSslConfiguration(untrusted);
+        QVERIFY(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).isFault());
+        client.ignoreSslErrors();
+        QVERIFY(!client.call(QLatin1String("getEmployeeCountry"), countryMessage()).isFault());
+        QCOMPARE(client.connectionPoolStatistics().tlsHandshakes, quint64(2));
 #endif
     }
 
@@ -1363,6 +1516,587 @@ private Q_SLOTS:
         QCOMPARE(pendingCall.returnMessage().faultAsString(), QString::fromLatin1("Fault code 4: Operation timed out"));
     }
 
+    void testDeadline()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        // The deadline of the call wins over the timeout of the client, both ways
+        client.setTimeout(10);
+        KDSoapPendingCall slowCall =
+            client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage(true), QDeadlineTimer(QDeadlineTimer::Forever)); // the server object sleeps for 100ms
+        client.setTimeout(-1);
+        QVector<KDSoapPendingCall> timedOutCalls;
+        for (int i = 0; i < 20; ++i) {
+            timedOutCalls.append(client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage(true), QDeadlineTimer(10 + i)));
+        }
+        for (const KDSoapPendingCall &call : qAsConst(timedOutCalls)) {
+            QTRY_VERIFY(call.isFinished());
+            QVERIFY(call.returnMessage().isFault());
+            QCOMPARE(call.returnMessage().faultAsString(), QString::fromLatin1("Fault code 4: Operation timed out"));
+        }
+        QTRY_VERIFY(slowCall.isFinished());
+        QVERIFY2(!slowCall.returnMessage().isFault(), qPrintable(slowCall.returnMessage().faultAsString()));
+        QCOMPARE(slowCall.returnMessage().childValues().first().value().toString(), expectedCountry());
+    }
+
+    void testTrace()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+
+        const bool wasOutputEnabled = KDSoapTrace::isOutputEnabled();
+        const KDSoapTrace::Options oldOptions = KDSoapTrace::options();
+        KDSoapTrace::setOutputEnabled(false);
+        KDSoapTrace::setOptions(KDSoapTrace::HttpHeaders);
+        KDSoapTrace::setEnabled(false);
+        KDSoapTrace::takeEntries();
+
+        // Nothing is recorded when disabled
+        QCOMPARE(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).childValues().first().value().toString(), expectedCountry());
+        QVERIFY(KDSoapTrace::takeEntries().isEmpty());
+
+        // The request and response, on the client and server sides
+        KDSoapTrace::setEnabled(true);
+        QVERIFY(KDSoapTrace::isEnabled());
+        QCOMPARE(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).childValues().first().value().toString(), expectedCountry());
+        QList<QByteArray> entries;
+        QTRY_VERIFY((entries += KDSoapTrace::takeEntries()).size() >= 4);
+        QCOMPARE(entries.size(), 4);
+        for (const QByteArray &entry : qAsConst(entries)) {
+            QVERIFY2(entry.contains("getEmployeeCountry"), entry.constData());
+        }
+        QCOMPARE(int(std::count_if(entries.cbegin(), entries.cend(), [](const QByteArray &entry) { return entry.startsWith("POST "); })), 2);
+        QCOMPARE(int(std::count_if(entries.cbegin(), entries.cend(), [](const QByteArray &entry) { return entry.startsWith("HTTP/1.1 200 OK"); })), 1);
+
+        // Only the newest entries are kept
+        const qint64 dropped = KDSoapTrace::droppedEntryCount();
+        KDSoapTrace::setCapacity(1);
+        QCOMPARE(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).childValues().first().value().toString(), expectedCountry());
+        QTRY_COMPARE(KDSoapTrace::droppedEntryCount(), dropped + 3);
+        QCOMPARE(KDSoapTrace::takeEntries().size(), 1);
+
+        KDSoapTrace::setCapacity(256);
+        KDSoapTrace::setEnabled(false);
+        KDSoapTrace::setOptions(oldOptions);
+        KDSoapTrace::setOutputEnabled(wasOutputEnabled);
+    }
+
+    void testRetryPolicy()
+    {
+        UnavailableServer server;
+        KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        KDSoapRetryPolicy policy;
+        policy.setMaxRetries(2);
+        policy.setInitialBackoff(10);
+        QVERIFY(!policy.isNull());
+        client.setRetryPolicy(QLatin1String("getEmployeeCountry"), policy);
+        QCOMPARE(client.retryPolicy(QLatin1String("getEmployeeCountry")).maxRetries(), 2);
+        QVERIFY(client.retryPolicy(QLatin1String("getStuff")).isNull());
+        QCOMPARE(client.retryBudgetMaxTokens(), 10);
+
+        // Each failed request takes a token from the budget (10 tokens), and requests are only retried with more than 5 left
+        const int expectedRequests[] = {3, 2, 1};
+        for (int expected : expectedRequests) {
+            server.resetRequestCount();
+            KDSoapPendingCall pendingCall = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage());
+            QTRY_VERIFY(pendingCall.isFinished());
+            QVERIFY(pendingCall.returnMessage().isFault());
+            QCOMPARE(pendingCall.returnMessage().childValues().child(QLatin1String("faultcode")).value().toString(),
+                     QString::number(QNetworkReply::ServiceUnavailableError));
+            QCOMPARE(server.requestCount(), expected);
+        }
+
+        // Refilled
+        client.setRetryBudget(10, 0.1);
+        server.resetRequestCount();
+        const KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+        QVERIFY(response.isFault());
+        QCOMPARE(server.requestCount(), 3);
+
+        // Without a policy, requests are sent once
+        client.setRetryPolicy(QLatin1String("getEmployeeCountry"), KDSoapRetryPolicy());
+        client.setRetryBudget(10, 0.1);
+        server.resetRequestCount();
+        QVERIFY(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).isFault());
+        QCOMPARE(server.requestCount(), 1);
+    }
+
+    void testHedging()
+    {
+        KDSoapThreadPool threadPool;
+        threadPool.setMaxThreadCount(2);
+        CountryServerThread serverThread(&threadPool);
+        CountryServer *server = serverThread.startThread();
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        KDSoapRetryPolicy policy;
+        policy.setHedgeDelay(50);
+        policy.setHedgePercentile(0);
+        client.setRetryPolicy(QLatin1String("getEmployeeCountry"), policy);
+
+        // The first request takes one second, the hedged one answers right away
+        s_slowOnceCalls = 0;
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("employeeName"), QString::fromLatin1("SlowOnce"));
+        QElapsedTimer timer;
+        timer.start();
+        KDSoapPendingCall pendingCall = client.asyncCall(QLatin1String("getEmployeeCountry"), message);
+        QTRY_VERIFY(pendingCall.isFinished());
+        QVERIFY2(!pendingCall.returnMessage().isFault(), qPrintable(pendingCall.returnMessage().faultAsString()));
+        QCOMPARE(pendingCall.returnMessage().childValues().first().value().toString(), QString::fromLatin1("SlowOnce France"));
+        QVERIFY2(timer.elapsed() < 900, QByteArray::number(timer.elapsed()).constData());
+        QCOMPARE(int(s_slowOnceCalls.loadAcquire()), 2);
+    }
+
+    void testLoadBalancing()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        UnavailableServer unavailableServer;
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        QCOMPARE(client.endPoints(), QStringList(server->endPoint()));
+        client.setEndPoints(QStringList() << server->endPoint() << unavailableServer.endPoint() << server->endPoint());
+        QCOMPARE(client.endPoints(), QStringList() << server->endPoint() << unavailableServer.endPoint());
+        QCOMPARE(client.endPoint(), server->endPoint());
+        QCOMPARE(client.loadBalancing(), KDSoapClientInterface::RoundRobin);
+        QCOMPARE(client.endPointEjectionFailures(), 3);
+        client.setEndPointEjection(2, 60000);
+
+        // Round robin, until the second end point is ejected after its second failure
+        for (int i = 0; i < 4; ++i) {
+            KDSoapPendingCall pendingCall = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage());
+            QTRY_VERIFY(pendingCall.isFinished());
+            QCOMPARE(pendingCall.returnMessage().isFault(), i % 2 == 1);
+        }
+        QCOMPARE(server->totalConnectionCount(), 2);
+        QCOMPARE(unavailableServer.requestCount(), 2);
+        QCOMPARE(client.ejectedEndPoints(), QStringList(unavailableServer.endPoint()));
+
+        // Blocking calls are balanced too
+        client.setLoadBalancing(KDSoapClientInterface::PowerOfTwoChoices);
+        QCOMPARE(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).childValues().first().value().toString(), expectedCountry());
+        client.setBlockingCallTransport(KDSoapClientInterface::NativeTransport);
+        QCOMPARE(client.call(QLatin1String("getEmployeeCountry"), countryMessage()).childValues().first().value().toString(), expectedCountry());
+        QCOMPARE(server->totalConnectionCount(), 4);
+        QCOMPARE(unavailableServer.requestCount(), 2);
+
+        // Without ejection, both end points get requests again
+        client.setEndPointEjection(0, 0);
+        QVERIFY(client.ejectedEndPoints().isEmpty());
+        client.setLoadBalancing(KDSoapClientInterface::RoundRobin);
+        for (int i = 0; i < 2; ++i) {
+            KDSoapPendingCall pendingCall = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage());
+            QTRY_VERIFY(pendingCall.isFinished());
+        }
+        QCOMPARE(server->totalConnectionCount(), 5);
+        QCOMPARE(unavailableServer.requestCount(), 3);
+
+        // A timeout is a failure too: each end point is ejected after one of them
+        client.setEndPointEjection(1, 60000);
+        client.setTimeout(10);
+        for (int i = 0; i < 2; ++i) {
+            KDSoapPendingCall pendingCall = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage(true)); // the server object sleeps for 100ms
+            QTRY_VERIFY(pendingCall.isFinished());
+            QVERIFY(pendingCall.returnMessage().isFault());
+        }
+        QCOMPARE(client.ejectedEndPoints().size(), 2);
+
+        // Also when the call has a retry policy: the timeout of the call aborts its requests
+        client.setEndPointEjection(0, 0);
+        client.setEndPointEjection(1, 60000);
+        KDSoapRetryPolicy policy;
+        policy.setHedgeDelay(60000);
+        client.setRetryPolicy(QLatin1String("getEmployeeCountry"), policy);
+        for (int i = 0; i < 2; ++i) {
+            KDSoapPendingCall pendingCall = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage(true));
+            QTRY_VERIFY(pendingCall.isFinished());
+            QVERIFY(pendingCall.returnMessage().isFault());
+        }
+        QCOMPARE(client.ejectedEndPoints().size(), 2);
+        client.setRetryPolicy(QLatin1String("getEmployeeCountry"), KDSoapRetryPolicy());
+        client.setTimeout(-1);
+
+        client.setEndPoint(server->endPoint());
+        QCOMPARE(client.endPoints(), QStringList(server->endPoint()));
+    }
+
+    void testNativeTransport()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(KDSoapClientInterface::NativeTransport);
+        for (int i = 0; i < 3; ++i) {
+            const KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+            QCOMPARE(response.childValues().first().value().toString(), expectedCountry());
+        }
+        // The connection is kept alive between calls
+        QCOMPARE(server->totalConnectionCount(), 3);
+        QCOMPARE(server->numConnectedSockets(), 1);
+
+        client.setTimeout(10);
+        const KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage(true)); // the server object sleeps for 100ms
+        QVERIFY(response.isFault());
+        QCOMPARE(response.faultAsString(), QString::fromLatin1("Fault code 4: Operation timed out"));
+    }
+
+    void testConnectionPool()
+    {
+        KDSoapThreadPool threadPool;
+        threadPool.setMaxThreadCount(4);
+        CountryServerThread serverThread(&threadPool);
+        CountryServer *server = serverThread.startThread();
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(KDSoapClientInterface::NativeTransport);
+        QCOMPARE(client.maxConnectionsPerHost(), 6);
+        QCOMPARE(client.connectionIdleTimeout(), 60000);
+        for (int i = 0; i < 3; ++i) {
+            const KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+            QCOMPARE(response.childValues().first().value().toString(), expectedCountry());
+        }
+        KDSoapClientInterface::ConnectionPoolStatistics statistics = client.connectionPoolStatistics();
+        QCOMPARE(statistics.misses, quint64(1));
+        QCOMPARE(statistics.hits, quint64(2));
+        QCOMPARE(statistics.tlsHandshakes, quint64(0));
+        QCOMPARE(statistics.openConnections, 1);
+        QCOMPARE(statistics.idleConnections, 1);
+
+        // The idle connection is closed before the next call
+        client.setConnectionIdleTimeout(0);
+        client.resetConnectionPoolStatistics();
+        QTest::qWait(10);
+        client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+        statistics = client.connectionPoolStatistics();
+        QCOMPARE(statistics.misses, quint64(1));
+        QCOMPARE(statistics.hits, quint64(0));
+        QTRY_COMPARE(server->numConnectedSockets(), 1);
+
+        // Concurrent calls from several threads wait for the single connection allowed
+        client.setConnectionIdleTimeout(-1);
+        client.setMaxConnectionsPerHost(1);
+        QVector<BlockingCallThread *> callers;
+        for (int i = 0; i < 4; ++i) {
+            callers.append(new BlockingCallThread(&client, countryMessage(true))); // the server object sleeps for 100ms
+            callers.last()->start();
+        }
+        for (BlockingCallThread *caller : qAsConst(callers)) {
+            QVERIFY(caller->wait(10000));
+            QCOMPARE(caller->response().childValues().first().value().toString(), QString::fromLatin1("Slow France"));
+        }
+        qDeleteAll(callers);
+        statistics = client.connectionPoolStatistics();
+        QCOMPARE(statistics.openConnections, 1);
+        QCOMPARE(server->numConnectedSockets(), 1);
+    }
+
+    void testWarmUp()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        client.setBlockingCallTransport(KDSoapClientInterface::NativeTransport);
+        QCOMPARE(client.warmUp(2), 2);
+        QTRY_COMPARE(server->numConnectedSockets(), 2);
+        KDSoapClientInterface::ConnectionPoolStatistics statistics = client.connectionPoolStatistics();
+        QCOMPARE(statistics.misses, quint64(0));
+        QCOMPARE(statistics.idleConnections, 2);
+
+        const KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+        QCOMPARE(response.childValues().first().value().toString(), expectedCountry());
+        statistics = client.connectionPoolStatistics();
+        QCOMPARE(statistics.hits, quint64(1));
+        QCOMPARE(statistics.misses, quint64(0));
+
+        // The open connections are kept, only the missing ones are opened, within the limit
+        QCOMPARE(client.warmUp(2), 2);
+        client.setMaxConnectionsPerHost(3);
+        QCOMPARE(client.warmUp(5), 3);
+        QTRY_COMPARE(server->numConnectedSockets(), 3);
+        QCOMPARE(client.connectionPoolStatistics().openConnections, 3);
+        QCOMPARE(server->totalConnectionCount(), 1); // the requests
+    }
+
+    void testHttp2()
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setFeatures(KDSoapServer::Http2);
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        client.setHttp2Mode(KDSoapClientInterface::Http2PriorKnowledge);
+        QCOMPARE(client.http2Mode(), KDSoapClientInterface::Http2PriorKnowledge);
+
+        // The calls are multiplexed over a single connection
+        m_returnMessages.clear();
+        m_expectedMessages = 20;
+        makeAsyncCalls(client, m_expectedMessages);
+        m_eventLoop.exec();
+        QCOMPARE(m_returnMessages.count(), m_expectedMessages);
+        for (const KDSoapMessage &response : qAsConst(m_returnMessages)) {
+            QCOMPARE(response.childValues().first().value().toString(), expectedCountry());
+        }
+        QCOMPARE(server->totalConnectionCount(), m_expectedMessages);
+        QCOMPARE(server->numConnectedSockets(), 1);
+
+        // Larger than the flow control windows, in both directions
+        const QString longName(100000, QLatin1Char('x'));
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("employeeName"), longName);
+        KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), message);
+        QCOMPARE(response.childValues().first().value().toString(), longName + QLatin1String(" France"));
+
+        // Faults come with the 500 status
+        message = KDSoapMessage();
+        message.addArgument(QLatin1String("employeeName"), QString());
+        response = client.call(QLatin1String("getEmployeeCountry"), message);
+        QVERIFY(response.isFault());
+        QVERIFY(response.faultAsString().contains(QLatin1String("Empty employee name")));
+        QCOMPARE(server->numConnectedSockets(), 1);
+#endif
+    }
+
+    void testHttp2Frames()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setFeatures(KDSoapServer::Http2);
+
+        ClientSocket socket(server);
+        QVERIFY(socket.waitForConnected());
+        QByteArray headerBlock;
+        appendHpackLiteral(&headerBlock, ":method", "POST");
+        appendHpackLiteral(&headerBlock, ":scheme", "http");
+        appendHpackLiteral(&headerBlock, ":path", "/");
+        appendHpackLiteral(&headerBlock, ":authority", "127.0.0.1");
+        appendHpackLiteral(&headerBlock, "content-type", "text/xml;charset=utf-8");
+        appendHpackLiteral(&headerBlock, "soapaction", "http://www.kdab.com/xml/MyWsdl/getEmployeeCountry");
+        socket.write("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+        socket.write(http2Frame(0x4 /*SETTINGS*/, 0, 0, QByteArray()));
+        socket.write(http2Frame(0x6 /*PING*/, 0, 0, "12345678"));
+        socket.write(http2Frame(0x1 /*HEADERS*/, 0x4 /*END_HEADERS*/, 1, headerBlock));
+        socket.write(http2Frame(0x0 /*DATA*/, 0x1 /*END_STREAM*/, 1, rawCountryMessage()));
+
+        bool serverSettings = false;
+        bool settingsAck = false;
+        bool pingAck = false;
+        bool endStream = false;
+        QByteArray responseHeaders;
+        QByteArray responseBody;
+        QByteArray received;
+        while (!endStream || !pingAck || !settingsAck) {
+            QVERIFY(socket.bytesAvailable() > 0 || socket.waitForReadyRead(5000));
+            received += socket.readAll();
+            while (received.size() >= 9) {
+                const uchar *header = reinterpret_cast<const uchar *>(received.constData());
+                const int length = (header[0] << 16) | (header[1] << 8) | header[2];
+                if (received.size() < 9 + length) {
+                    break;
+                }
+                const uchar type = header[3];
+                const uchar flags = header[4];
+                const quint32 streamId = ((header[5] & 0x7f) << 24) | (header[6] << 16) | (header[7] << 8) | header[8];
+                const QByteArray payload = received.mid(9, length);
+                received.remove(0, 9 + length);
+                switch (type) {
+                case 0x0: // DATA
+                    QCOMPARE(streamId, quint32(1));
+                    responseBody += payload;
+                    endStream = flags & 0x1;
+                    break;
+                case 0x1: // HEADERS
+                    QCOMPARE(streamId, quint32(1));
+                    QVERIFY(flags & 0x4);
+                    responseHeaders = payload;
+                    break;
+                case 0x4: // SETTINGS
+                    if (flags & 0x1) {
+                        settingsAck = true;
+                    } else {
+                        QVERIFY(!serverSettings);
+                        serverSettings = true;
+                    }
+                    break;
+                case 0x6: // PING
+                    QVERIFY(flags & 0x1);
+                    QCOMPARE(payload, QByteArray("12345678"));
+                    pingAck = true;
+                    break;
+                }
+            }
+        }
+        QVERIFY(serverSettings);
+        QVERIFY(responseHeaders.startsWith(char(0x88))); // ":status: 200", from the static table
+        QVERIFY(xmlBufferCompare(responseBody, expectedCountryResponse()));
+    }
+
+    void testHttp2DelayedResponse()
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setFeatures(KDSoapServer::Http2);
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        client.setHttp2Mode(KDSoapClientInterface::Http2PriorKnowledge);
+
+        // The delayed response doesn't hold up the next request on the same connection
+        KDSoapMessage delayedMessage;
+        delayedMessage.addArgument(QLatin1String("employeeName"), QLatin1String("Delayed"));
+        KDSoapPendingCall delayedCall = client.asyncCall(QLatin1String("getEmployeeCountry"), delayedMessage);
+        KDSoapPendingCall call = client.asyncCall(QLatin1String("getEmployeeCountry"), countryMessage());
+        QTRY_VERIFY(call.isFinished());
+        QVERIFY(!delayedCall.isFinished());
+        QCOMPARE(call.returnMessage().childValues().first().value().toString(), expectedCountry());
+
+        QTRY_VERIFY(delayedCall.isFinished());
+        QCOMPARE(delayedCall.returnMessage().childValues().first().value().toString(), QString::fromLatin1("Delayed France"));
+        QCOMPARE(server->numConnectedSockets(), 1);
+#endif
+    }
+
+    void testCompressionWithSocket_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::addColumn<bool>("useRawXML");
+
+        QTest::newRow("no_chunks") << 100000 << false;
+        QTest::newRow("10") << 10 << false;
+        QTest::newRow("rawXML") << 10 << true;
+    }
+
+    void testCompressionWithSocket()
+    {
+        if (!KDSoapCompression::isAvailable()) {
+            QSKIP("KD Soap was built without zlib");
+        }
+        QFETCH(int, chunkSize);
+        QFETCH(bool, useRawXML);
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setUseRawXML(useRawXML);
+        server->setCompressionThreshold(100);
+
+        ClientSocket socket(server);
+        QVERIFY(socket.waitForConnected());
+        const QByteArray message = KDSoapCompression::compress(rawCountryMessage(s_longEmployeeName), KDSoapCompression::Gzip);
+        const QByteArray request = "POST / HTTP/1.1\r\n"
+                                   "SoapAction: http://www.kdab.com/xml/MyWsdl/getEmployeeCountry\r\n"
+                                   "Content-Type: text/xml;charset=utf-8\r\n"
+                                   "Content-Encoding: gzip\r\n"
+                                   "Accept-Encoding: gzip;q=0.5, deflate\r\n"
+                                   "Content-Length: "
+            + QByteArray::number(message.size())
+            + "\r\n"
+              "\r\n"
+            + message;
+        for (int pos = 0; pos < request.size(); pos += chunkSize) {
+            socket.write(request.mid(pos, chunkSize));
+            QVERIFY(socket.waitForBytesWritten());
+        }
+
+        // The response is in the encoding preferred by the client
+        QByteArray response;
+        int headersEnd = -1;
+        while (headersEnd < 0 || response.size() < headersEnd + 4 + socketResponseHeader(response, "Content-Length").toInt()) {
+            QVERIFY(socket.bytesAvailable() > 0 || socket.waitForReadyRead(5000));
+            response += socket.readAll();
+            headersEnd = response.indexOf("\r\n\r\n");
+        }
+        QVERIFY(response.startsWith("HTTP/1.1 200 OK\r\n"));
+        QCOMPARE(socketResponseHeader(response, "Content-Encoding"), QByteArray("deflate"));
+        KDSoapInflater inflater(KDSoapCompression::Deflate);
+        QByteArray xmlResponse;
+        QVERIFY(inflater.inflate(response.mid(headersEnd + 4), &xmlResponse));
+        QVERIFY(inflater.isFinished());
+        QVERIFY(xmlBufferCompare(xmlResponse, expectedCountryResponse(s_longEmployeeName)));
+    }
+
+    void testDecompressedRequestTooLarge()
+    {
+        if (!KDSoapCompression::isAvailable()) {
+            QSKIP("KD Soap was built without zlib");
+        }
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        QCOMPARE(server->maxDecompressedRequestSize(), 64 * 1024 * 1024);
+        server->setMaxDecompressedRequestSize(10000);
+
+        // A few hundred bytes once compressed
+        ClientSocket socket(server);
+        QVERIFY(socket.waitForConnected());
+        const QByteArray message = KDSoapCompression::compress(rawCountryMessage(QByteArray(100000, 'x')), KDSoapCompression::Gzip);
+        const QByteArray request = "POST / HTTP/1.1\r\n"
+                                   "SoapAction: http://www.kdab.com/xml/MyWsdl/getEmployeeCountry\r\n"
+                                   "Content-Type: text/xml;charset=utf-8\r\n"
+                                   "Content-Encoding: gzip\r\n"
+                                   "Content-Length: "
+            + QByteArray::number(message.size())
+            + "\r\n"
+              "\r\n"
+            + message;
+        socket.write(request);
+        QVERIFY(socket.waitForBytesWritten());
+
+        QByteArray response;
+        while (socket.state() == QAbstractSocket::ConnectedState && socket.waitForReadyRead(5000)) {
+            response += socket.readAll();
+        }
+        response += socket.readAll();
+        QVERIFY(response.startsWith("HTTP/1.1 413 Payload Too Large\r\n"));
+        QCOMPARE(socketResponseHeader(response, "Connection"), QByteArray("close"));
+    }
+
+    void testCompression_data()
+    {
+        QTest::addColumn<bool>("nativeTransport");
+
+        QTest::newRow("qnam") << false;
+        QTest::newRow("native") << true;
+    }
+
+    void testCompression()
+    {
+        if (!KDSoapCompression::isAvailable()) {
+            QSKIP("KD Soap was built without zlib");
+        }
+        QFETCH(bool, nativeTransport);
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setCompressionThreshold(1000);
+        server->setCompressionLevel(1);
+
+        KDSoapClientInterface client(server->endPoint(), countryMessageNamespace());
+        if (nativeTransport) {
+            client.setBlockingCallTransport(KDSoapClientInterface::NativeTransport);
+        }
+        QVERIFY(client.isResponseCompressionEnabled());
+        client.setRequestCompressionThreshold(1000);
+        QCOMPARE(client.requestCompressionThreshold(), 1000);
+
+        // Below the thresholds
+        KDSoapMessage response = client.call(QLatin1String("getEmployeeCountry"), countryMessage());
+        QCOMPARE(response.childValues().first().value().toString(), expectedCountry());
+
+        // Compressed in both directions
+        const QString longName(100000, QLatin1Char('x'));
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("employeeName"), longName);
+        response = client.call(QLatin1String("getEmployeeCountry"), message);
+        QCOMPARE(response.childValues().first().value().toString(), longName + QLatin1String(" France"));
+
+        client.setResponseCompressionEnabled(false);
+        response = client.call(QLatin1String("getEmployeeCountry"), message);
+        QCOMPARE(response.childValues().first().value().toString(), longName + QLatin1String(" France"));
+    }
+
 public Q_SLOTS:
     void slotFinished(KDSoapPendingCallWatcher *watcher)
     {
@@ -1435,6 +2169,32 @@ private:
         return watchers;
     }
 
+    static QByteArray http2Frame(uchar type, uchar flags, quint32 streamId, const QByteArray &payload)
+    {
+        QByteArray frame;
+        frame.append(char(payload.size() >> 16));
+        frame.append(char(payload.size() >> 8));
+        frame.append(char(payload.size()));
+        frame.append(char(type));
+        frame.append(char(flags));
+        frame.append(char(streamId >> 24));
+        frame.append(char(streamId >> 16));
+        frame.append(char(streamId >> 8));
+        frame.append(char(streamId));
+        return frame + payload;
+    }
+
+    // HPACK literal without indexing, with a new name and short strings
+    static void appendHpackLiteral(QByteArray *block, const QByteArray &name, const QByteArray &value)
+    {
+        Q_ASSERT(name.size() < 127 && value.size() < 127);
+        block->append(char(0));
+        block->append(char(name.size()));
+        block->append(name);
+        block->append(char(value.size()));
+        block->append(value);
+    }
+
     static QString countryMessageNamespace()
     {
         return QString::fromLatin1(myWsdlNamespace);
@@ -1462,6 +2222,19 @@ private:
         QVERIFY(xmlBufferCompare(xmlResponse, expectedCountryResponse(employeeName)));
     }
 
+    // The value of a header of the HTTP response received on a socket
+    static QByteArray socketResponseHeader(const QByteArray &response, const QByteArray &name)
+    {
+        const QList<QByteArray> lines = response.left(response.indexOf("\r\n\r\n")).split('\n');
+        for (const QByteArray &line : lines) {
+            const int colon = line.indexOf(':');
+            if (colon > 0 && qstricmp(line.left(colon).constData(), name.constData()) == 0) {
+                return line.mid(colon + 1).trimmed();
+            }
+        }
+        return QByteArray();
+    }
+
     static KDSoapMessage getStuffMessage()
     {
         KDSoapMessage message;
@@ -1532,6 +2305,16 @@ void CountryServerObject::processRequest(const KDSoapMessage &request, KDSoapMes
             return;
         }
         const QString employeeName = request.childValues().child(QLatin1String("employeeName")).value().toString();
+        if (employeeName == QLatin1String("Delayed")) {
+            const KDSoapDelayedResponseHandle handle = prepareDelayedResponse();
+            QTimer::singleShot(2000, this, [this, handle]() {
+                KDSoapMessage delayedResponse;
+                delayedResponse.setValue(QLatin1String("getEmployeeCountryResponse"));
+                delayedResponse.addArgument(QLatin1String("employeeCountry"), QString::fromLatin1("Delayed France"));
+                sendDelayedResponse(handle, delayedResponse);
+            });
+            return;
+        }
         const QString ret = this->getEmployeeCountry(employeeName);
         if (!hasFault()) {
             response.setValue(QLatin1String("getEmployeeCountryResponse"));
@@ -0,0 +1,159 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapMessageWriter_p.h"
+#include "KDSoapStreamingBody_p.h"
+#include "httpserver_p.h"
+#include "wsdl_test.h"
+#include <QBuffer>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+static QByteArray binaryData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = char(i * 13 + i / 256);
+    }
+    return data;
+}
+
+static KDSoapAttachment bufferAttachment(const QByteArray &data)
+{
+    QBuffer *buffer = new QBuffer;
+    buffer->setData(data);
+    return KDSoapAttachment(buffer);
+}
+
+class StreamingBinaryTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray transferResponse(const QByteArray &document)
+    {
+        return QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<transferResponse xmlns=\"http://www.kdab.com/xml/StreamingBinaryTest/\">"
+              "<document>"
+            + document.toBase64()
+            + "</document>"
+              "<checksum>S0RTb2Fw</checksum>"
+              "</transferResponse>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+    }
+
+private Q_SLOTS:
+    void testStreamingBody_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::newRow("one byte") << 1;
+        QTest::newRow("two bytes") << 2;
+        QTest::newRow("one group") << 3;
+        QTest::newRow("large") << 200001;
+    }
+
+    void testStreamingBody()
+    {
+        QFETCH(int, size);
+        KDSoapMessage message;
+        message.addArgument(QString::fromLatin1("first"), QVariant::fromValue(bufferAttachment(binaryData(size))));
+        message.addArgument(QString::fromLatin1("text"), QString::fromLatin1("between"));
+        message.addArgument(QString::fromLatin1("second"), QVariant::fromValue(bufferAttachment(binaryData(size / 2 + 1))));
+
+        KDSoapMessageWriter writer;
+        const QByteArray inlineXml = writer.messageToXml(message, QString::fromLatin1("transfer"), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+
+        QVector<KDSoapStreamedAttachment> attachments;
+        writer.setStreamedAttachments(&attachments);
+        const QByteArray xml = writer.messageToXml(message, QString::fromLatin1("transfer"), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+        QCOMPARE(int(attachments.count()), 2);
+        QVERIFY(xml.size() < inlineXml.size());
+
+        KDSoapStreamingBody body(xml, attachments);
+        QVERIFY(body.open(QIODevice::ReadOnly));
+        QCOMPARE(body.size(), qint64(inlineXml.size()));
+        QCOMPARE(body.readAll(), inlineXml);
+
+        // Reads of any size, starting anywhere (e.g. when the request is sent again)
+        QVERIFY(body.seek(body.size() / 3 + 1));
+        QByteArray rest;
+        char block[1001];
+        qint64 read;
+        while ((read = body.read(block, sizeof(block))) > 0) {
+            rest.append(block, int(read));
+        }
+        QCOMPARE(rest, inlineXml.mid(int(body.size() / 3 + 1)));
+    }
+
+    void testDecodeIntoDevice()
+    {
+        const QByteArray data = binaryData(100000);
+        QString text = QString::fromLatin1(data.toBase64());
+        // Line breaks must not split the groups of four characters
+        for (int pos = 76; pos < text.size(); pos += 77) {
+            text.insert(pos, QLatin1Char('\n'));
+        }
+        const KDSoapAttachment attachment = KDSoapBinaryCodec::toAttachment(QVariant(text));
+        QVERIFY(attachment.device()->isSequential());
+        QByteArray decoded;
+        QBuffer sink(&decoded);
+        sink.open(QIODevice::WriteOnly);
+        QVERIFY(attachment.writeTo(&sink));
+        QCOMPARE(decoded, data);
+
+        // data() keeps the contents of the sequential device, for all the copies
+        const KDSoapAttachment other = KDSoapBinaryCodec::toAttachment(QVariant(text));
+        const KDSoapAttachment copy = other;
+        QCOMPARE(other.size(), qint64(-1));
+        QCOMPARE(other.data(), data);
+        QCOMPARE(other.data(), data);
+        QCOMPARE(copy.data(), data);
+        QCOMPARE(copy.size(), qint64(data.size()));
+        QCOMPARE(copy.device()->readAll(), data);
+
+        QVERIFY(KDSoapBinaryCodec::toAttachment(QVariant()).isNull());
+    }
+
+    void testTransfer()
+    {
+        const QByteArray document = binaryData(300000);
+        const QByteArray responseDocument = binaryData(150000);
+        HttpServerThread server(transferResponse(responseDocument), HttpServerThread::Public);
+        StreamingBinaryService service;
+        service.setEndPoint(server.endPoint());
+
+        TNS__Transfer params;
+        params.setName(QString::fromLatin1("picture.png"));
+        params.setDocument(bufferAttachment(document)); // KDSoapAttachment
+        params.setChecksum(QByteArray("KDSoap")); // not selected with -streaming-binary: QByteArray
+        const TNS__TransferResponse response = service.transfer(params);
+        QVERIFY2(service.lastError().isEmpty(), qPrintable(service.lastError()));
+
+        // The request has the base64 text inline, as usual
+        const QByteArray request = server.receivedData();
+        QVERIFY(request.contains("<n1:document>" + document.toBase64() + "</n1:document>"));
+        QVERIFY(request.contains("<n1:checksum>S0RTb2Fw</n1:checksum>"));
+
+        // The response is decoded into the device of our choice
+        QByteArray decoded;
+        QBuffer sink(&decoded);
+        sink.open(QIODevice::WriteOnly);
+        QVERIFY(response.document().writeTo(&sink));
+        QCOMPARE(decoded, responseDocument);
+        QCOMPARE(response.checksum(), QByteArray("KDSoap"));
+    }
+};
+
+QTEST_MAIN(StreamingBinaryTest)
+
+#include "test_streaming_binary_wsdl.moc"
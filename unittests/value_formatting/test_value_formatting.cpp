@@ -0,0 +1,165 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDDateTime.h"
+#include "KDSoapMessage.h"
+#include "KDSoapMessageWriter_p.h"
+#include "KDSoapValue.h"
+#include <QTest>
+#include <QXmlStreamWriter>
+
+#include <limits>
+
+static const char s_messageNamespace[] = "http://www.kdab.com/xml/MyWsdl/";
+
+static QByteArray writeMessage(const KDSoapMessage &message)
+{
+    KDSoapMessageWriter writer;
+    writer.setMessageNamespace(QLatin1String(s_messageNamespace));
+    return writer.messageToXml(message, QLatin1String("send"), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+}
+
+// The text of the element, written by KDSoapMessageWriter, which formats simple values straight into the output
+static QByteArray writtenText(const QVariant &value)
+{
+    KDSoapMessage message;
+    message.addArgument(QLatin1String("v"), value);
+    const QByteArray xml = writeMessage(message);
+    if (xml.contains("<v/>")) {
+        return QByteArray();
+    }
+    const int start = xml.indexOf("<v>") + 3;
+    return xml.mid(start, xml.indexOf("</v>") - start);
+}
+
+// The text of the element, written through a QString
+static QByteArray textThroughQString(const QVariant &value)
+{
+    QByteArray xml;
+    QXmlStreamWriter writer(&xml);
+    KDSoapValue(QLatin1String("v"), value).writeXmlContents(writer, QString());
+    return xml;
+}
+
+class ValueFormattingTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFormatting_data()
+    {
+        QTest::addColumn<QVariant>("value");
+        QTest::addColumn<QByteArray>("expected");
+
+        QTest::newRow("int") << QVariant(42) << QByteArray("42");
+        QTest::newRow("zero") << QVariant(0) << QByteArray("0");
+        QTest::newRow("negative_int") << QVariant(-7) << QByteArray("-7");
+        QTest::newRow("int_min") << QVariant(std::numeric_limits<int>::min()) << QByteArray("-2147483648");
+        QTest::newRow("uint_max") << QVariant(std::numeric_limits<uint>::max()) << QByteArray("4294967295");
+        QTest::newRow("longlong_min") << QVariant(std::numeric_limits<qlonglong>::min()) << QByteArray("-9223372036854775808");
+        QTest::newRow("ulonglong_max") << QVariant(std::numeric_limits<qulonglong>::max()) << QByteArray("18446744073709551615");
+        QTest::newRow("true") << QVariant(true) << QByteArray("true");
+        QTest::newRow("false") << QVariant(false) << QByteArray("false");
+        QTest::newRow("double") << QVariant(0.1) << QByteArray("0.1");
+        QTest::newRow("double_negative") << QVariant(-2.5) << QByteArray("-2.5");
+        QTest::newRow("double_integral") << QVariant(100.0) << QByteArray("100");
+        QTest::newRow("double_large") << QVariant(1e21) << QByteArray("1e+21");
+        QTest::newRow("double_small") << QVariant(1.5e-7) << QByteArray("1.5e-07");
+        QTest::newRow("double_digits") << QVariant(1.0 / 3) << QByteArray("0.3333333333333333");
+        QTest::newRow("date") << QVariant(QDate(2010, 12, 31)) << QByteArray("2010-12-31");
+        QTest::newRow("date_small_year") << QVariant(QDate(33, 1, 2)) << QByteArray("0033-01-02");
+        QTest::newRow("time") << QVariant(QTime(9, 5, 3)) << QByteArray("09:05:03");
+        QTest::newRow("time_msec") << QVariant(QTime(23, 59, 59, 7)) << QByteArray("23:59:59.007");
+        QTest::newRow("datetime_local") << QVariant(QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59))) << QByteArray("2011-03-15T23:59:59");
+        QTest::newRow("datetime_utc") << QVariant(QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59), Qt::UTC)) << QByteArray("2011-03-15T23:59:59Z");
+        QTest::newRow("datetime_offset") << QVariant(QDateTime(QDate(2011, 3, 15), QTime(8, 0), Qt::OffsetFromUTC, -(5 * 3600 + 30 * 60)))
+                                         << QByteArray("2011-03-15T08:00:00-05:30");
+
+        KDDateTime kdt(QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59, 999)));
+        kdt.setTimeZone(QString::fromLatin1("+01:00"));
+        QTest::newRow("kddatetime_msec") << QVariant::fromValue(kdt) << QByteArray("2011-03-15T23:59:59.999+01:00");
+        kdt = KDDateTime(QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59)));
+        kdt.setTimeZone(QString::fromLatin1("Z"));
+        QTest::newRow("kddatetime_utc") << QVariant::fromValue(kdt) << QByteArray("2011-03-15T23:59:59Z");
+
+        // Left to the QString path
+        QTest::newRow("date_large_year") << QVariant(QDate(12345, 1, 1)) << QByteArray();
+        QTest::newRow("string") << QVariant(QString::fromLatin1("a < b")) << QByteArray("a &lt; b");
+    }
+
+    // The text must be the same as when going through a QString
+    void testFormatting()
+    {
+        QFETCH(QVariant, value);
+        QFETCH(QByteArray, expected);
+
+        const QByteArray reference = textThroughQString(value);
+        if (!expected.isNull()) {
+            QCOMPARE(reference, expected);
+        }
+        QCOMPARE(writtenText(value), reference);
+    }
+
+    void testNestedValues()
+    {
+        KDSoapValueList children;
+        children.append(KDSoapValue(QLatin1String("count"), 3));
+        children.append(KDSoapValue(QLatin1String("ratio"), 0.75));
+        children.append(KDSoapValue(QLatin1String("name"), QString::fromLatin1("x")));
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("item"), children);
+        message.addArgument(QLatin1String("enabled"), true);
+        const QByteArray xml = writeMessage(message);
+        QVERIFY(xml.contains("<item><count>3</count><ratio>0.75</ratio><name>x</name></item><enabled>true</enabled>"));
+    }
+
+    void benchmarkNumericArray_data()
+    {
+        QTest::addColumn<bool>("direct");
+        QTest::newRow("QString") << false;
+        QTest::newRow("direct") << true;
+    }
+
+    // An array of 10000 items with a few numbers each, like a series of measurements
+    void benchmarkNumericArray()
+    {
+        QFETCH(bool, direct);
+        KDSoapValueList items;
+        for (int i = 0; i < 10000; ++i) {
+            KDSoapValueList item;
+            item.append(KDSoapValue(QLatin1String("index"), i));
+            item.append(KDSoapValue(QLatin1String("timestamp"), qlonglong(1700000000000LL + i * 250)));
+            item.append(KDSoapValue(QLatin1String("value"), i * 0.37 - 1500.125));
+            item.append(KDSoapValue(QLatin1String("valid"), i % 3 != 0));
+            items.append(KDSoapValue(QLatin1String("sample"), item));
+        }
+        const KDSoapValue array(QLatin1String("samples"), items);
+
+        QByteArray xml;
+        if (direct) {
+            KDSoapMessage message;
+            message.childValues() = items;
+            QBENCHMARK {
+                xml = writeMessage(message);
+            }
+        } else {
+            QBENCHMARK {
+                xml.clear();
+                QXmlStreamWriter writer(&xml);
+                array.writeXml(writer, QLatin1String(s_messageNamespace));
+            }
+        }
+        QCOMPARE(int(xml.count("<sample>")), 10000);
+    }
+};
+
+QTEST_MAIN(ValueFormattingTest)
+
+#include "test_value_formatting.moc"
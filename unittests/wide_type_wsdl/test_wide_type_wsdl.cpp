@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "wsdl_test.h"
+#include <QTest>
+
+class WideTypeTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // The children of a WideRecord, in reverse schema order, with the repeated "tag" element spread out
+    static KDSoapValue wideRecordValue()
+    {
+        KDSoapValue mainValue(QString::fromLatin1("record"), QVariant());
+        KDSoapValueList &args = mainValue.childValues();
+        for (int i = 100; i >= 1; --i) {
+            args.append(KDSoapValue(QString::fromLatin1("field%1").arg(i, 3, 10, QLatin1Char('0')), QString::fromLatin1("value %1").arg(i)));
+            if (i % 25 == 0) {
+                args.append(KDSoapValue(QString::fromLatin1("tag"), QString::fromLatin1("tag %1").arg(i)));
+            }
+        }
+        args.append(KDSoapValue(QString::fromLatin1("id"), 42));
+        args.attributes().append(KDSoapValue(QString::fromLatin1("version"), 3));
+        return mainValue;
+    }
+
+private Q_SLOTS:
+    void testChildIndexes()
+    {
+        KDSoapValueList list;
+        list.addArgument(QString::fromLatin1("a"), 1);
+        list.addArgument(QString::fromLatin1("b"), 2);
+        list.addArgument(QString::fromLatin1("a"), 3);
+
+        QCOMPARE(list.childIndexes(QString::fromLatin1("a")), QVector<int>() << 0 << 2);
+        QCOMPARE(list.childIndexes(QString::fromLatin1("b")), QVector<int>() << 1);
+        QVERIFY(list.childIndexes(QString::fromLatin1("c")).isEmpty());
+
+        // Modifying the list invalidates the index
+        list.addArgument(QString::fromLatin1("c"), 4);
+        QCOMPARE(list.childIndexes(QString::fromLatin1("c")), QVector<int>() << 3);
+        list.removeFirst();
+        QCOMPARE(list.childIndexes(QString::fromLatin1("a")), QVector<int>() << 1);
+        list[0] = KDSoapValue(QString::fromLatin1("a"), 5);
+        QCOMPARE(list.childIndexes(QString::fromLatin1("a")), QVector<int>() << 0 << 1);
+        QVERIFY(list.childIndexes(QString::fromLatin1("b")).isEmpty());
+
+        // A copy can reuse the index, and stays independent from the original
+        KDSoapValueList copy = list;
+        QCOMPARE(copy.childIndexes(QString::fromLatin1("a")), QVector<int>() << 0 << 1);
+        copy.clear();
+        QVERIFY(copy.childIndexes(QString::fromLatin1("a")).isEmpty());
+        QCOMPARE(list.childIndexes(QString::fromLatin1("a")), QVector<int>() << 0 << 1);
+    }
+
+    void testDeserializeWideType()
+    {
+        TNS__WideRecord record;
+        record.deserialize(wideRecordValue());
+        QCOMPARE(record.id(), 42);
+        QCOMPARE(record.version(), 3);
+        QCOMPARE(record.field001(), QString::fromLatin1("value 1"));
+        QCOMPARE(record.field050(), QString::fromLatin1("value 50"));
+        QCOMPARE(record.field100(), QString::fromLatin1("value 100"));
+        // Document order is kept for repeated elements
+        QCOMPARE(record.tag(),
+                 QStringList() << QString::fromLatin1("tag 100") << QString::fromLatin1("tag 75") << QString::fromLatin1("tag 50")
+                               << QString::fromLatin1("tag 25"));
+
+        // Round-trip
+        TNS__WideRecord copy;
+        copy.deserialize(record.serialize(QString::fromLatin1("record")));
+        QCOMPARE(copy.field099(), QString::fromLatin1("value 99"));
+        QCOMPARE(copy.tag().count(), 4);
+    }
+
+    void benchmarkDeserializeWideType()
+    {
+        const KDSoapValue value = wideRecordValue();
+        QBENCHMARK {
+            // Use a new list every time, like a freshly parsed message, so the name index isn't reused
+            KDSoapValue fresh(value.name(), QVariant());
+            KDSoapValueList &args = fresh.childValues();
+            args.reserve(value.childValues().count());
+            for (const KDSoapValue &child : value.childValues()) {
+                args.append(child);
+            }
+            args.attributes() = value.childValues().attributes();
+            TNS__WideRecord record;
+            record.deserialize(fresh);
+        }
+    }
+};
+
+QTEST_MAIN(WideTypeTest)
+
+#include "test_wide_type_wsdl.moc"
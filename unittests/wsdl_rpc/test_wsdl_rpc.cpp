@@ -189,6 +189,19 @@ private Q_SLOTS:
         QCOMPARE(QString::fromUtf8(server.receivedData().constData()), QString::fromUtf8(expectedCountryRequest().constData()));
     }
 
+    void testNumbersOutOfRange()
+    {
+        // 2^32 doesn't fit into an int: converted item by item, like before typed arrays
+        KDAB__Numbers numbers;
+        KDSoapValue soapValue;
+        soapValue.setValue(QVariant::fromValue(QString::fromLatin1("1 4294967296 -3")));
+        numbers.deserialize(soapValue);
+        QCOMPARE(numbers.entries().count(), 3);
+        QCOMPARE(numbers.entries().at(0), 1);
+        QCOMPARE(numbers.entries().at(1), QVariant(QString::fromLatin1("4294967296")).toInt());
+        QCOMPARE(numbers.entries().at(2), -3);
+    }
+
     // Test enum deserialization
     void testEnums()
     {
@@ -0,0 +1,123 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "httpserver_p.h"
+#include "wsdl_test.h"
+#include <QDebug>
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+class XmlStreamDeserializersTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray getItemsResponse()
+    {
+        return QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<getItemsResponse xmlns=\"http://www.kdab.com/xml/StreamTest/\" count=\"2\">\n"
+              "  <title>Fruits</title>\n"
+              "  <updated>2011-03-15T23:59:59.999+01:00</updated>\n"
+              "  <checksum>S0RTb2Fw</checksum>\n"
+              "  <item><name>Apple</name><price>1.5</price><unknown><nested>ignored</nested></unknown></item>\n"
+              "  <unknown>ignored</unknown>\n"
+              "  <item><name>Pear</name><price>2.25</price></item>\n"
+              "  <tag>green</tag>\n"
+              "  <tag>fresh</tag>\n"
+              "</getItemsResponse>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+    }
+
+    static QByteArray faultResponse()
+    {
+        return QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<soap:Fault>"
+              "<faultcode>soap:Server</faultcode>"
+              "<faultstring>No such category</faultstring>"
+              "</soap:Fault>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+    }
+
+private Q_SLOTS:
+    void testJob()
+    {
+        HttpServerThread server(getItemsResponse(), HttpServerThread::Public);
+        StreamService service;
+        service.setEndPoint(server.endPoint());
+
+        GetItemsJob job(&service);
+        TNS__GetItems params;
+        params.setCategory(QString::fromLatin1("fruits"));
+        job.setParameters(params);
+        QSignalSpy spy(&job, &GetItemsJob::finished);
+        job.start();
+        QVERIFY(spy.wait());
+
+        QVERIFY2(!job.isFault(), qPrintable(job.faultAsString()));
+        const TNS__GetItemsResponse response = job.resultParameters();
+        QCOMPARE(response.count(), 2);
+        QCOMPARE(response.title(), QString::fromLatin1("Fruits"));
+        QCOMPARE(response.updated().toDateString(), QString::fromLatin1("2011-03-15T23:59:59.999+01:00"));
+        QCOMPARE(response.checksum(), QByteArray("KDSoap"));
+        QCOMPARE(response.item().count(), 2);
+        QCOMPARE(response.item().at(0).name(), QString::fromLatin1("Apple"));
+        QCOMPARE(response.item().at(0).price(), 1.5);
+        QCOMPARE(response.item().at(1).name(), QString::fromLatin1("Pear"));
+        QCOMPARE(response.item().at(1).price(), 2.25);
+        QCOMPARE(response.tag(), QStringList() << QString::fromLatin1("green") << QString::fromLatin1("fresh"));
+        QVERIFY(!response.hasValueForNote());
+    }
+
+    void testJobFault()
+    {
+        HttpServerThread server(faultResponse(), HttpServerThread::Public);
+        StreamService service;
+        service.setEndPoint(server.endPoint());
+
+        GetItemsJob job(&service);
+        QSignalSpy spy(&job, &GetItemsJob::finished);
+        job.start();
+        QVERIFY(spy.wait());
+
+        QVERIFY(job.isFault());
+        QCOMPARE(job.faultAsString(), QString::fromLatin1("Fault code soap:Server: No such category"));
+        QCOMPARE(job.resultParameters().item().count(), 0);
+    }
+
+    void testDeserializeFromXml()
+    {
+        // The same result as going through a KDSoapValue
+        QXmlStreamReader reader(getItemsResponse());
+        while (reader.readNextStartElement() && reader.name() != QLatin1String("getItemsResponse")) {
+        }
+        TNS__GetItemsResponse fromStream;
+        fromStream.deserialize(reader);
+        QVERIFY(reader.isEndElement());
+        QCOMPARE(reader.name().toString(), QString::fromLatin1("getItemsResponse"));
+
+        QXmlStreamReader valueReader(getItemsResponse());
+        while (valueReader.readNextStartElement() && valueReader.name() != QLatin1String("getItemsResponse")) {
+        }
+        TNS__GetItemsResponse fromValue;
+        fromValue.deserialize(KDSoapValue::fromXml(valueReader));
+
+        QCOMPARE(fromStream.serialize(QString::fromLatin1("getItemsResponse")), fromValue.serialize(QString::fromLatin1("getItemsResponse")));
+    }
+};
+
+QTEST_MAIN(XmlStreamDeserializersTest)
+
+#include "test_xml_stream_deserializers.moc"
@@ -0,0 +1,162 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "httpserver_p.h"
+#include "wsdl_test.h"
+#include <QDebug>
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+class XmlStreamSerializersTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString streamNamespace()
+    {
+        return QString::fromLatin1("http://www.kdab.com/xml/StreamTest/");
+    }
+
+    static TNS__PutItems putItemsParameters()
+    {
+        TNS__PutItems params;
+        params.setPriority(2);
+        params.setCategory(QString::fromLatin1("fruits"));
+        params.setQuantity(3);
+        params.setUrgent(true);
+        params.setDue(KDDateTime::fromDateString(QString::fromLatin1("2011-03-15T23:59:59.999+01:00")));
+        params.setChecksum(QByteArray("KDSoap"));
+        TNS__Item apple;
+        apple.setName(QString::fromLatin1("Apple"));
+        apple.setPrice(1.5);
+        TNS__Item pear;
+        pear.setName(QString::fromLatin1("Pear"));
+        pear.setPrice(2.25);
+        params.setItem(QList<TNS__Item>() << apple << pear);
+        params.setTag(QStringList() << QString::fromLatin1("green") << QString::fromLatin1("fresh"));
+        return params;
+    }
+
+    static QByteArray expectedPutItemsRequest()
+    {
+        return QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<n1:putItems xmlns:n1=\"http://www.kdab.com/xml/StreamTest/\" priority=\"2\">"
+              "<n1:category>fruits</n1:category>"
+              "<n1:quantity>3</n1:quantity>"
+              "<n1:urgent>true</n1:urgent>"
+              "<n1:due>2011-03-15T23:59:59.999+01:00</n1:due>"
+              "<n1:checksum>S0RTb2Fw</n1:checksum>"
+              "<n1:item><n1:name>Apple</n1:name><n1:price>1.5</n1:price></n1:item>"
+              "<n1:item><n1:name>Pear</n1:name><n1:price>2.25</n1:price></n1:item>"
+              "<n1:tag>green</n1:tag>"
+              "<n1:tag>fresh</n1:tag>"
+              "</n1:putItems>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+    }
+
+    static QByteArray putItemsResponse()
+    {
+        return QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<putItemsResponse xmlns=\"http://www.kdab.com/xml/StreamTest/\"><status>ok</status></putItemsResponse>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+    }
+
+private Q_SLOTS:
+    void testCall()
+    {
+        HttpServerThread server(putItemsResponse(), HttpServerThread::Public);
+        StreamService service;
+        service.setEndPoint(server.endPoint());
+
+        const TNS__PutItemsResponse response = service.putItems(putItemsParameters());
+        QVERIFY2(service.lastError().isEmpty(), qPrintable(service.lastError()));
+        QCOMPARE(response.status(), QString::fromLatin1("ok"));
+        QVERIFY(xmlBufferCompare(server.receivedData(), expectedPutItemsRequest()));
+    }
+
+    void testJob()
+    {
+        HttpServerThread server(putItemsResponse(), HttpServerThread::Public);
+        StreamService service;
+        service.setEndPoint(server.endPoint());
+
+        PutItemsJob job(&service);
+        job.setParameters(putItemsParameters());
+        QSignalSpy spy(&job, &PutItemsJob::finished);
+        job.start();
+        QVERIFY(spy.wait());
+
+        QVERIFY2(!job.isFault(), qPrintable(job.faultAsString()));
+        QCOMPARE(job.resultParameters().status(), QString::fromLatin1("ok"));
+        QVERIFY(xmlBufferCompare(server.receivedData(), expectedPutItemsRequest()));
+    }
+
+    void testMtom()
+    {
+        // The generated code writes the binary element through the message writer, which makes it an attachment
+        HttpServerThread server(putItemsResponse(), HttpServerThread::Public);
+        StreamService service;
+        service.setEndPoint(server.endPoint());
+        service.clientInterface()->setMtomEnabled(true);
+
+        service.putItems(putItemsParameters());
+        const QByteArray request = server.receivedData();
+        QVERIFY2(request.contains("<xop:Include"), request.constData());
+        QVERIFY(!request.contains("S0RTb2Fw"));
+        QVERIFY(request.contains("<n1:category>fruits</n1:category>"));
+    }
+
+    void testWriteXml_data()
+    {
+        QTest::addColumn<bool>("withNote");
+        QTest::newRow("without note") << false;
+        QTest::newRow("with note") << true;
+    }
+
+    void testWriteXml()
+    {
+        // The same output as going through a KDSoapValue
+        QFETCH(bool, withNote);
+        TNS__PutItems params = putItemsParameters();
+        if (withNote) {
+            params.setNote(QString::fromLatin1("<handle with care>"));
+        }
+        const QString elementName = QString::fromLatin1("putItems");
+
+        QByteArray direct;
+        {
+            QXmlStreamWriter writer(&direct);
+            KDSoapValue::writeXmlStartElement(writer, streamNamespace(), elementName, true, streamNamespace());
+            params.writeXml(writer, streamNamespace());
+            writer.writeEndElement();
+        }
+
+        QByteArray viaValue;
+        {
+            QXmlStreamWriter writer(&viaValue);
+            KDSoapValue value = params.serialize(elementName);
+            value.setNamespaceUri(streamNamespace());
+            value.setQualified(true);
+            value.writeXml(writer, streamNamespace());
+        }
+
+        QCOMPARE(QString::fromUtf8(direct), QString::fromUtf8(viaValue));
+    }
+};
+
+QTEST_MAIN(XmlStreamSerializersTest)
+
+#include "test_xml_stream_serializers.moc"